@@ -17,6 +17,7 @@
 #include <gs-app-collation.h>
 #include <gs-app-permissions.h>
 #include <gs-app-query.h>
+#include <gs-cache-manager.h>
 #include <gs-category.h>
 #include <gs-category-manager.h>
 #include <gs-desktop-data.h>
@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <glib.h>
+#include <string.h>
 
 #include "gs-app-private.h"
 #include "gs-app-list-private.h"
@@ -31,6 +32,13 @@ struct _GsAppList
 	GObject			 parent_instance;
 	GPtrArray		*array;
 	GMutex			 mutex;
+	GHashTable		*app_counts;  /* (owned) (element-type GsApp guint); how many times each app is in @array */
+	/* Index of @array by the component ID part of the unique ID, which
+	 * unlike the other parts is never a wildcard in practice. Each value is
+	 * the apps with that component ID, in @array order. %NULL if the index
+	 * needs rebuilding. */
+	GHashTable		*cid_index;  /* (owned) (nullable) (element-type utf8 GPtrArray) */
+	guint			 n_wildcard_cids;  /* apps which can’t be indexed */
 	guint			 size_peak;
 	GsAppListFlags		 flags;
 	GsAppState		 state;
@@ -263,7 +271,8 @@ gs_app_list_maybe_unwatch_app (GsAppList *list, GsApp *app)
 	g_autoptr(GPtrArray) apps = gs_app_list_get_watched_for_app (list, app);
 	for (guint i = 0; i < apps->len; i++) {
 		GsApp *app_tmp = g_ptr_array_index (apps, i);
-		g_signal_handlers_disconnect_by_data (app_tmp, list);
+		g_signal_handlers_disconnect_by_func (app_tmp, gs_app_list_progress_notify_cb, list);
+		g_signal_handlers_disconnect_by_func (app_tmp, gs_app_list_state_notify_cb, list);
 	}
 }
 
@@ -300,11 +309,139 @@ gs_app_list_set_size_peak (GsAppList *list,
 	list->size_peak = size_peak;
 }
 
+/* Returns the component ID part of @unique_id, or the whole of @unique_id if
+ * it’s not a valid data ID, as as_utils_data_id_equal() then compares it
+ * literally. */
+static gchar *
+gs_app_list_get_index_key (const gchar *unique_id)
+{
+	const gchar *start = unique_id;
+	const gchar *end;
+
+	if (unique_id == NULL)
+		return NULL;
+
+	for (guint i = 0; i < 3 && start != NULL; i++) {
+		start = strchr (start, '/');
+		if (start != NULL)
+			start++;
+	}
+	if (start == NULL)
+		return g_strdup (unique_id);
+	end = strchr (start, '/');
+	if (end == NULL || strchr (end + 1, '/') != NULL)
+		return g_strdup (unique_id);
+
+	return g_strndup (start, end - start);
+}
+
+static void
+gs_app_list_index_app (GsAppList *list, GsApp *app)
+{
+	g_autofree gchar *key = gs_app_list_get_index_key (gs_app_get_unique_id (app));
+	GPtrArray *apps;
+
+	if (key == NULL)
+		return;
+	if (g_str_equal (key, "*")) {
+		list->n_wildcard_cids++;
+		return;
+	}
+
+	apps = g_hash_table_lookup (list->cid_index, key);
+	if (apps == NULL) {
+		apps = g_ptr_array_new ();
+		g_hash_table_insert (list->cid_index, g_steal_pointer (&key), apps);
+	}
+	g_ptr_array_add (apps, app);
+}
+
+static gboolean
+gs_app_list_index_is_valid (GsAppList *list)
+{
+	return (list->cid_index != NULL);
+}
+
+static void
+gs_app_list_invalidate_index (GsAppList *list)
+{
+	g_clear_pointer (&list->cid_index, g_hash_table_unref);
+}
+
+/* The ID of an app in the list has changed, so only this list’s index needs
+ * rebuilding. */
+static void
+gs_app_list_component_id_changed_cb (GsApp     *app,
+                                     GsAppList *list)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&list->mutex);
+
+	gs_app_list_invalidate_index (list);
+}
+
+static void
+gs_app_list_ensure_index (GsAppList *list)
+{
+	if (gs_app_list_index_is_valid (list))
+		return;
+
+	g_clear_pointer (&list->cid_index, g_hash_table_unref);
+	list->cid_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, (GDestroyNotify) g_ptr_array_unref);
+	list->n_wildcard_cids = 0;
+
+	for (guint i = 0; i < list->array->len; i++)
+		gs_app_list_index_app (list, g_ptr_array_index (list->array, i));
+}
+
+/* Returns the apps which could match @unique_id, in list order, or %NULL if
+ * the index can’t be used and the whole list has to be searched. */
+static GPtrArray *
+gs_app_list_lookup_candidates (GsAppList    *list,
+                               const gchar  *unique_id,
+                               gboolean     *out_use_index)
+{
+	g_autofree gchar *key = gs_app_list_get_index_key (unique_id);
+
+	gs_app_list_ensure_index (list);
+
+	*out_use_index = (key != NULL && !g_str_equal (key, "*") && list->n_wildcard_cids == 0);
+	if (!*out_use_index)
+		return NULL;
+
+	return g_hash_table_lookup (list->cid_index, key);
+}
+
+static void
+gs_app_list_count_app (GsAppList *list, GsApp *app, gint delta)
+{
+	guint count = GPOINTER_TO_UINT (g_hash_table_lookup (list->app_counts, app));
+
+	/* watch for the ID of each app in the list changing, as that moves it
+	 * in the index */
+	if (count == 0 && delta > 0)
+		g_signal_connect (app, "component-id-changed",
+				  G_CALLBACK (gs_app_list_component_id_changed_cb), list);
+
+	count += delta;
+	if (count == 0) {
+		g_signal_handlers_disconnect_by_func (app, gs_app_list_component_id_changed_cb, list);
+		g_hash_table_remove (list->app_counts, app);
+	} else {
+		g_hash_table_insert (list->app_counts, app, GUINT_TO_POINTER (count));
+	}
+}
+
 static GsApp *
 gs_app_list_lookup_safe (GsAppList *list, const gchar *unique_id)
 {
-	for (guint i = 0; i < list->array->len; i++) {
-		GsApp *app = g_ptr_array_index (list->array, i);
+	gboolean use_index;
+	GPtrArray *candidates = gs_app_list_lookup_candidates (list, unique_id, &use_index);
+
+	if (!use_index)
+		candidates = list->array;
+	for (guint i = 0; candidates != NULL && i < candidates->len; i++) {
+		GsApp *app = g_ptr_array_index (candidates, i);
 		if (as_utils_data_id_equal (gs_app_get_unique_id (app), unique_id))
 			return app;
 	}
@@ -380,8 +517,13 @@ gs_app_list_check_for_duplicate (GsAppList *list, GsApp *app)
 
 	/* adding a wildcard */
 	if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD)) {
-		for (guint i = 0; i < list->array->len; i++) {
-			GsApp *app_tmp = g_ptr_array_index (list->array, i);
+		gboolean use_index;
+		GPtrArray *candidates = gs_app_list_lookup_candidates (list, gs_app_get_unique_id (app), &use_index);
+
+		if (!use_index)
+			candidates = list->array;
+		for (guint i = 0; candidates != NULL && i < candidates->len; i++) {
+			GsApp *app_tmp = g_ptr_array_index (candidates, i);
 			if (!gs_app_has_quirk (app_tmp, GS_APP_QUIRK_IS_WILDCARD))
 				continue;
 			/* not adding exactly the same wildcard */
@@ -392,11 +534,8 @@ gs_app_list_check_for_duplicate (GsAppList *list, GsApp *app)
 		return TRUE;
 	}
 
-	for (guint i = 0; i < list->array->len; i++) {
-		GsApp *app_tmp = g_ptr_array_index (list->array, i);
-		if (app_tmp == app)
-			return FALSE;
-	}
+	if (g_hash_table_contains (list->app_counts, app))
+		return FALSE;
 
 	/* does not exist */
 	id = gs_app_get_unique_id (app);
@@ -433,6 +572,9 @@ gs_app_list_add_safe (GsAppList *list, GsApp *app, GsAppListAddFlag flag)
 	/* just use the ref */
 	gs_app_list_maybe_watch_app (list, app);
 	g_ptr_array_add (list->array, g_object_ref (app));
+	gs_app_list_count_app (list, app, 1);
+	if (gs_app_list_index_is_valid (list))
+		gs_app_list_index_app (list, app);
 
 	/* update the historical max */
 	if (list->array->len > list->size_peak)
@@ -491,6 +633,8 @@ gs_app_list_remove (GsAppList *list, GsApp *app)
 	locker = g_mutex_locker_new (&list->mutex);
 	removed = g_ptr_array_remove (list->array, app);
 	if (removed) {
+		gs_app_list_count_app (list, app, -1);
+		gs_app_list_invalidate_index (list);
 		gs_app_list_maybe_unwatch_app (list, app);
 
 		/* recalculate global state */
@@ -567,6 +711,17 @@ gs_app_list_length (GsAppList *list)
 	return list->array->len;
 }
 
+static void
+gs_app_list_disconnect_apps (GsAppList *list)
+{
+	GHashTableIter iter;
+	GsApp *app;
+
+	g_hash_table_iter_init (&iter, list->app_counts);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &app, NULL))
+		g_signal_handlers_disconnect_by_func (app, gs_app_list_component_id_changed_cb, list);
+}
+
 static void
 gs_app_list_remove_all_safe (GsAppList *list)
 {
@@ -574,7 +729,10 @@ gs_app_list_remove_all_safe (GsAppList *list)
 		GsApp *app = g_ptr_array_index (list->array, i);
 		gs_app_list_maybe_unwatch_app (list, app);
 	}
+	gs_app_list_disconnect_apps (list);
 	g_ptr_array_set_size (list->array, 0);
+	g_hash_table_remove_all (list->app_counts);
+	gs_app_list_invalidate_index (list);
 	gs_app_list_invalidate_state (list);
 	gs_app_list_invalidate_progress (list);
 }
@@ -665,6 +823,7 @@ gs_app_list_sort (GsAppList *list, GsAppListSortFunc func, gpointer user_data)
 	helper.func = func;
 	helper.user_data = user_data;
 	g_ptr_array_sort_with_data (list->array, gs_app_list_sort_cb, &helper);
+	gs_app_list_invalidate_index (list);
 }
 
 /**
@@ -696,7 +855,10 @@ gs_app_list_truncate (GsAppList *list, guint length)
 
 	/* remove the apps in the positions larger than the length */
 	locker = g_mutex_locker_new (&list->mutex);
+	for (guint i = length; i < list->array->len; i++)
+		gs_app_list_count_app (list, g_ptr_array_index (list->array, i), -1);
 	g_ptr_array_set_size (list->array, length);
+	gs_app_list_invalidate_index (list);
 }
 
 /**
@@ -736,6 +898,7 @@ gs_app_list_randomize (GsAppList *list)
 		list->array->pdata[i] = list->array->pdata[j];
 		list->array->pdata[j] = tmp;
 	}
+	gs_app_list_invalidate_index (list);
 
 	g_rand_free (rand);
 }
@@ -945,7 +1108,10 @@ static void
 gs_app_list_finalize (GObject *object)
 {
 	GsAppList *list = GS_APP_LIST (object);
+	gs_app_list_disconnect_apps (list);
 	g_ptr_array_unref (list->array);
+	g_hash_table_unref (list->app_counts);
+	g_clear_pointer (&list->cid_index, g_hash_table_unref);
 	g_mutex_clear (&list->mutex);
 	G_OBJECT_CLASS (gs_app_list_parent_class)->finalize (object);
 }
@@ -1001,6 +1167,7 @@ gs_app_list_init (GsAppList *list)
 {
 	g_mutex_init (&list->mutex);
 	list->array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	list->app_counts = g_hash_table_new (g_direct_hash, g_direct_equal);
 	list->custom_progress = GS_APP_PROGRESS_UNKNOWN;
 }
 
@@ -13,11 +13,49 @@
 
 G_BEGIN_DECLS
 
+/**
+ * GsAppNotifyStats:
+ * @n_queued: number of property changes which have queued a notification
+ * @n_emitted: number of notifications emitted, after removing duplicates
+ * @n_dispatches: number of main loop dispatches used to emit them
+ *
+ * Statistics about #GsApp property notifications, from
+ * gs_app_get_notify_stats().
+ *
+ * Since: 47
+ */
+typedef struct {
+	guint64 n_queued;
+	guint64 n_emitted;
+	guint64 n_dispatches;
+} GsAppNotifyStats;
+
+/**
+ * GsAppMemoryStats:
+ * @n_apps: number of apps measured
+ * @n_bytes: estimated memory owned by those apps, in bytes
+ * @n_bytes_shared: memory used by the interned strings shared between those
+ *   apps, in bytes
+ *
+ * Statistics about the memory used by #GsApps, from
+ * gs_app_get_memory_stats().
+ *
+ * Since: 47
+ */
+typedef struct {
+	guint n_apps;
+	gsize n_bytes;
+	gsize n_bytes_shared;
+} GsAppMemoryStats;
+
 void		 gs_app_set_priority		(GsApp		*app,
 						 guint		 priority);
 guint		 gs_app_get_priority		(GsApp		*app);
 void		 gs_app_set_unique_id		(GsApp		*app,
 						 const gchar	*unique_id);
+void		 gs_app_get_notify_stats	(GsAppNotifyStats *out_stats);
+void		 gs_app_get_memory_stats	(GsAppList	*list,
+						 GsAppMemoryStats *out_stats);
 void		 gs_app_remove_addon		(GsApp		*app,
 						 GsApp		*addon);
 GCancellable	*gs_app_get_cancellable		(GsApp		*app);
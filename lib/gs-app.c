@@ -49,30 +49,49 @@
 #include "gs-os-release.h"
 #include "gs-plugin.h"
 #include "gs-plugin-private.h"
+#include "gs-profiler.h"
 #include "gs-remote-icon.h"
 #include "gs-utils.h"
 
+/* Fields which only a few apps set, such as local files and apps being
+ * renamed. They’re allocated the first time one of them is set, so the tens
+ * of thousands of catalog apps don’t pay for them. */
+typedef struct
+{
+	gchar			*renamed_from;
+	gchar			*agreement;
+	gchar			*summary_missing;
+	gchar			*url_missing;
+	GFile			*local_file;
+	AsScreenshot		*action_screenshot;  /* (nullable) (owned) */
+	gboolean		 key_color_for_light_set;
+	GdkRGBA			 key_color_for_light;
+	gboolean		 key_color_for_dark_set;
+	GdkRGBA			 key_color_for_dark;
+} GsAppRareFields;
+
+/* The fields marked (interned) hold values which are repeated across many
+ * apps, so they’re #GRefStrings shared between all the apps, set with
+ * _g_set_interned_str(). */
 typedef struct
 {
 	GMutex			 mutex;
+	guint64			 pending_notify;  /* (locked-by pending_notify); bitmask of GsAppProperty */
 	gchar			*id;
 	gchar			*unique_id;
 	gboolean		 unique_id_valid;
-	gchar			*branch;
+	gchar			*branch;  /* (interned) */
 	gchar			*name;
-	gchar			*renamed_from;
 	GsAppQuality		 name_quality;
 	GPtrArray		*icons;  /* (nullable) (owned) (element-type AsIcon), sorted by pixel size, smallest first */
 	GPtrArray		*sources;
 	GPtrArray		*source_ids;
-	gchar			*project_group;
-	gchar			*developer_name;
-	gchar			*agreement;
-	gchar			*version;
+	gchar			*project_group;  /* (interned) */
+	gchar			*developer_name;  /* (interned) */
+	gchar			*version;  /* (interned) */
 	gchar			*version_ui;
 	gchar			*summary;
 	GsAppQuality		 summary_quality;
-	gchar			*summary_missing;
 	gchar			*description;
 	GsAppQuality		 description_quality;
 	GPtrArray		*screenshots;
@@ -81,14 +100,13 @@ typedef struct
 	gboolean		 user_key_colors;
 	GHashTable		*urls;  /* (element-type AsUrlKind utf8) (owned) (nullable) */
 	GHashTable		*launchables;
-	gchar			*url_missing;
-	gchar			*license;
+	gchar			*license;  /* (interned) */
 	GsAppQuality		 license_quality;
 	gchar			**menu_path;
-	gchar			*origin;
-	gchar			*origin_ui;
-	gchar			*origin_appstream;
-	gchar			*origin_hostname;
+	gchar			*origin;  /* (interned) */
+	gchar			*origin_ui;  /* (interned) */
+	gchar			*origin_appstream;  /* (interned) */
+	gchar			*origin_hostname;  /* (interned) */
 	gchar			*update_version;
 	gchar			*update_version_ui;
 	gchar			*update_details_markup;
@@ -120,7 +138,7 @@ typedef struct
 	AsBundleKind		 bundle_kind;
 	guint			 progress;  /* integer 0–100 (inclusive), or %GS_APP_PROGRESS_UNKNOWN */
 	gboolean		 allow_cancel;
-	GHashTable		*metadata;
+	GHashTable		*metadata;  /* (element-type utf8 GVariant) (owned), keys are interned */
 	GsAppList		*addons;
 	GsAppList		*related;
 	GsAppList		*history;
@@ -131,9 +149,7 @@ typedef struct
 	GsAppQuirk		 quirk;
 	gboolean		 license_is_free;
 	GsApp			*runtime;
-	GFile			*local_file;
 	AsContentRating		*content_rating;
-	AsScreenshot		*action_screenshot;  /* (nullable) (owned) */
 	GCancellable		*cancellable;
 	GsPluginAction		 pending_action;
 	GsAppPermissions        *permissions;
@@ -142,10 +158,7 @@ typedef struct
 	GPtrArray		*relations;  /* (nullable) (element-type AsRelation) (owned) */
 	gboolean		 has_translations;
 	GsAppIconsState		 icons_state;
-	gboolean		 key_color_for_light_set;
-	GdkRGBA			 key_color_for_light;
-	gboolean		 key_color_for_dark_set;
-	GdkRGBA			 key_color_for_dark;
+	GsAppRareFields		*rare;  /* (nullable) (owned) */
 } GsAppPrivate;
 
 typedef enum {
@@ -191,6 +204,12 @@ typedef enum {
 
 static GParamSpec *obj_props[PROP_ICONS_STATE + 1] = { NULL, };
 
+typedef enum {
+	SIGNAL_COMPONENT_ID_CHANGED,
+} GsAppSignal;
+
+static guint obj_signals[SIGNAL_COMPONENT_ID_CHANGED + 1] = { 0, };
+
 G_DEFINE_TYPE_WITH_PRIVATE (GsApp, gs_app, G_TYPE_OBJECT)
 
 static gboolean
@@ -203,6 +222,46 @@ _g_set_str (gchar **str_ptr, const gchar *new_str)
 	return TRUE;
 }
 
+static gboolean
+_g_set_interned_str (gchar **str_ptr, const gchar *new_str)
+{
+	gchar *old_str = *str_ptr;
+
+	if (old_str == new_str || g_strcmp0 (old_str, new_str) == 0)
+		return FALSE;
+	*str_ptr = (new_str != NULL) ? g_ref_string_new_intern (new_str) : NULL;
+	if (old_str != NULL)
+		g_ref_string_release (old_str);
+	return TRUE;
+}
+
+static void
+_g_clear_interned_str (gchar **str_ptr)
+{
+	_g_set_interned_str (str_ptr, NULL);
+}
+
+static void
+gs_app_rare_fields_free (GsAppRareFields *rare)
+{
+	g_free (rare->renamed_from);
+	g_free (rare->agreement);
+	g_free (rare->summary_missing);
+	g_free (rare->url_missing);
+	g_clear_object (&rare->local_file);
+	g_clear_object (&rare->action_screenshot);
+	g_free (rare);
+}
+
+/* Must be called with priv->mutex held. */
+static GsAppRareFields *
+gs_app_ensure_rare_fields (GsAppPrivate *priv)
+{
+	if (priv->rare == NULL)
+		priv->rare = g_new0 (GsAppRareFields, 1);
+	return priv->rare;
+}
+
 static gboolean
 _g_set_strv (gchar ***strv_ptr, gchar **new_strv)
 {
@@ -579,8 +638,8 @@ gs_app_to_string_append (GsApp *app, GString *str)
 			  gs_app_get_kudos_percentage (app));
 	if (priv->name != NULL)
 		gs_app_kv_lpad (str, "name", priv->name);
-	if (priv->action_screenshot != NULL)
-		gs_app_kv_printf (str, "action-screenshot", "%p", priv->action_screenshot);
+	if (priv->rare != NULL && priv->rare->action_screenshot != NULL)
+		gs_app_kv_printf (str, "action-screenshot", "%p", priv->rare->action_screenshot);
 	for (i = 0; priv->icons != NULL && i < priv->icons->len; i++) {
 		GIcon *icon = g_ptr_array_index (priv->icons, i);
 		g_autofree gchar *icon_str = g_icon_to_string (icon);
@@ -636,8 +695,8 @@ gs_app_to_string_append (GsApp *app, GString *str)
 		key = g_strdup_printf ("source-id-%02u", i);
 		gs_app_kv_lpad (str, key, tmp);
 	}
-	if (priv->local_file != NULL) {
-		g_autofree gchar *fn = g_file_get_path (priv->local_file);
+	if (priv->rare != NULL && priv->rare->local_file != NULL) {
+		g_autofree gchar *fn = g_file_get_path (priv->rare->local_file);
 		gs_app_kv_lpad (str, "local-filename", fn);
 	}
 	if (priv->content_rating != NULL) {
@@ -670,8 +729,8 @@ gs_app_to_string_append (GsApp *app, GString *str)
 	management_plugin = g_weak_ref_get (&priv->management_plugin_weak);
 	if (management_plugin != NULL)
 		gs_app_kv_lpad (str, "management-plugin", gs_plugin_get_name (management_plugin));
-	if (priv->summary_missing != NULL)
-		gs_app_kv_lpad (str, "summary-missing", priv->summary_missing);
+	if (priv->rare != NULL && priv->rare->summary_missing != NULL)
+		gs_app_kv_lpad (str, "summary-missing", priv->rare->summary_missing);
 	if (priv->menu_path != NULL &&
 	    priv->menu_path[0] != NULL &&
 	    priv->menu_path[0][0] != '\0') {
@@ -758,17 +817,17 @@ gs_app_to_string_append (GsApp *app, GString *str)
 				  color->green * 255.f,
 				  color->blue * 255.f);
 	}
-	if (priv->key_color_for_light_set) {
+	if (priv->rare != NULL && priv->rare->key_color_for_light_set) {
 		gs_app_kv_printf (str, "key-color-for-light-scheme", "%.0f,%.0f,%.0f",
-				  priv->key_color_for_light.red * 255.f,
-				  priv->key_color_for_light.green * 255.f,
-				  priv->key_color_for_light.blue * 255.f);
+				  priv->rare->key_color_for_light.red * 255.f,
+				  priv->rare->key_color_for_light.green * 255.f,
+				  priv->rare->key_color_for_light.blue * 255.f);
 	}
-	if (priv->key_color_for_dark_set) {
+	if (priv->rare != NULL && priv->rare->key_color_for_dark_set) {
 		gs_app_kv_printf (str, "key-color-for-dark-scheme", "%.0f,%.0f,%.0f",
-				  priv->key_color_for_dark.red * 255.f,
-				  priv->key_color_for_dark.green * 255.f,
-				  priv->key_color_for_dark.blue * 255.f);
+				  priv->rare->key_color_for_dark.red * 255.f,
+				  priv->rare->key_color_for_dark.green * 255.f,
+				  priv->rare->key_color_for_dark.blue * 255.f);
 	}
 	keys = g_hash_table_get_keys (priv->metadata);
 	for (GList *l = keys; l != NULL; l = l->next) {
@@ -814,20 +873,63 @@ gs_app_to_string_append (GsApp *app, GString *str)
 	g_string_append_printf (str, "\n");
 }
 
-typedef struct {
-	GsApp *app;
-	GParamSpec *pspec;
-} AppNotifyData;
+/* Property notifications may be queued from any thread, and are emitted in
+ * the main context. Each app has a bitmask of properties with pending
+ * notifications, and all apps with pending notifications are flushed from a
+ * single idle source, so that a burst of changes (such as refining a list of
+ * apps) costs one main loop dispatch, and repeated changes to the same
+ * property are only notified once. */
+G_LOCK_DEFINE_STATIC (pending_notify);
+static GPtrArray *pending_notify_apps = NULL;  /* (owned) (nullable) (element-type GsApp) (locked-by pending_notify) */
+static guint pending_notify_source_id = 0;  /* (locked-by pending_notify) */
+static GsAppNotifyStats notify_stats = { 0, };  /* (locked-by pending_notify) */
+
+G_STATIC_ASSERT (G_N_ELEMENTS (obj_props) <= 64);
 
 static gboolean
 notify_idle_cb (gpointer data)
 {
-	AppNotifyData *notify_data = data;
-
-	g_object_notify_by_pspec (G_OBJECT (notify_data->app), notify_data->pspec);
+	g_autoptr(GPtrArray) apps = NULL;
+	gint64 begin_time_nsec G_GNUC_UNUSED = GS_PROFILER_CURRENT_TIME;
+	guint n_emitted G_GNUC_UNUSED = 0;
+
+	G_LOCK (pending_notify);
+	apps = g_steal_pointer (&pending_notify_apps);
+	pending_notify_source_id = 0;
+	notify_stats.n_dispatches++;
+	G_UNLOCK (pending_notify);
+
+	for (guint i = 0; apps != NULL && i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		GsAppPrivate *priv = gs_app_get_instance_private (app);
+		guint64 pending;
+
+		/* an app is only in @pending_notify_apps while its bitmask is
+		 * non-zero, so clearing it here means that further changes
+		 * will queue it again */
+		G_LOCK (pending_notify);
+		pending = priv->pending_notify;
+		priv->pending_notify = 0;
+		G_UNLOCK (pending_notify);
+
+		for (guint j = 1; j < G_N_ELEMENTS (obj_props); j++) {
+			if (pending & (G_GUINT64_CONSTANT (1) << j)) {
+				g_object_notify_by_pspec (G_OBJECT (app), obj_props[j]);
+				n_emitted++;
+
+				G_LOCK (pending_notify);
+				notify_stats.n_emitted++;
+				G_UNLOCK (pending_notify);
+			}
+		}
+	}
 
-	g_object_unref (notify_data->app);
-	g_free (notify_data);
+	GS_PROFILER_ADD_MARK_TAKE (AppNotifyDispatch,
+				   begin_time_nsec,
+				   g_strdup ("app-notify-dispatch"),
+				   g_strdup_printf ("%u apps, %u notifications",
+						    (apps != NULL) ? apps->len : 0, n_emitted));
+	GS_PROFILER_COUNTER_ADD (GS_PROFILER_COUNTER_NOTIFIES, n_emitted);
 
 	return G_SOURCE_REMOVE;
 }
@@ -835,13 +937,160 @@ notify_idle_cb (gpointer data)
 static void
 gs_app_queue_notify (GsApp *app, GParamSpec *pspec)
 {
-	AppNotifyData *notify_data;
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+
+	g_assert (pspec->param_id < G_N_ELEMENTS (obj_props) &&
+		  obj_props[pspec->param_id] == pspec);
+
+	G_LOCK (pending_notify);
+
+	notify_stats.n_queued++;
 
-	notify_data = g_new (AppNotifyData, 1);
-	notify_data->app = g_object_ref (app);
-	notify_data->pspec = pspec;
+	if (priv->pending_notify == 0) {
+		if (pending_notify_apps == NULL)
+			pending_notify_apps = g_ptr_array_new_with_free_func (g_object_unref);
+		g_ptr_array_add (pending_notify_apps, g_object_ref (app));
+	}
+	priv->pending_notify |= G_GUINT64_CONSTANT (1) << pspec->param_id;
+
+	if (pending_notify_source_id == 0)
+		pending_notify_source_id = g_idle_add (notify_idle_cb, NULL);
 
-	g_idle_add (notify_idle_cb, notify_data);
+	G_UNLOCK (pending_notify);
+}
+
+/**
+ * gs_app_get_notify_stats:
+ * @out_stats: (out caller-allocates): return location for the statistics
+ *
+ * Gets statistics about the property notifications queued by all #GsApps
+ * so far, to measure how well they are being coalesced.
+ *
+ * Since: 47
+ */
+void
+gs_app_get_notify_stats (GsAppNotifyStats *out_stats)
+{
+	g_return_if_fail (out_stats != NULL);
+
+	G_LOCK (pending_notify);
+	*out_stats = notify_stats;
+	G_UNLOCK (pending_notify);
+}
+
+static gsize
+gs_app_str_size (const gchar *str)
+{
+	return (str != NULL) ? strlen (str) + 1 : 0;
+}
+
+static gsize
+gs_app_str_array_size (GPtrArray *array)
+{
+	gsize size = sizeof (GPtrArray) + array->len * sizeof (gpointer);
+
+	for (guint i = 0; i < array->len; i++)
+		size += gs_app_str_size (g_ptr_array_index (array, i));
+	return size;
+}
+
+/* Interned strings are only counted the first time they’re seen in
+ * @interned_seen, as they’re shared between all the apps. */
+static void
+gs_app_interned_str_size (const gchar *str,
+			  GHashTable  *interned_seen,
+			  gsize       *shared_size)
+{
+	if (str != NULL && g_hash_table_add (interned_seen, (gpointer) str))
+		*shared_size += strlen (str) + 1;
+}
+
+/* Estimates the memory owned by @app, not counting the objects it refers
+ * to such as icons, screenshots and other apps. Must be called with
+ * priv->mutex held. */
+static gsize
+gs_app_get_memory_size_locked (GsApp      *app,
+			       GHashTable *interned_seen,
+			       gsize      *shared_size)
+{
+	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	GTypeQuery query;
+	GHashTableIter iter;
+	const gchar *key;
+	GVariant *value;
+	gsize size;
+	const gchar *interned[] = {
+		priv->branch, priv->project_group, priv->developer_name,
+		priv->version, priv->license, priv->origin, priv->origin_ui,
+		priv->origin_appstream, priv->origin_hostname,
+	};
+
+	g_type_query (G_OBJECT_TYPE (app), &query);
+	size = query.instance_size + sizeof (GsAppPrivate);
+
+	size += gs_app_str_size (priv->id);
+	size += gs_app_str_size (priv->unique_id);
+	size += gs_app_str_size (priv->name);
+	size += gs_app_str_size (priv->summary);
+	size += gs_app_str_size (priv->description);
+	size += gs_app_str_size (priv->version_ui);
+	size += gs_app_str_size (priv->update_version);
+	size += gs_app_str_size (priv->update_version_ui);
+	size += gs_app_str_size (priv->update_details_markup);
+	size += gs_app_str_array_size (priv->sources);
+	size += gs_app_str_array_size (priv->source_ids);
+	size += gs_app_str_array_size (priv->categories);
+
+	for (gsize i = 0; i < G_N_ELEMENTS (interned); i++)
+		gs_app_interned_str_size (interned[i], interned_seen, shared_size);
+
+	g_hash_table_iter_init (&iter, priv->metadata);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &value)) {
+		size += 3 * sizeof (gpointer) + g_variant_get_size (value);
+		gs_app_interned_str_size (key, interned_seen, shared_size);
+	}
+
+	if (priv->rare != NULL) {
+		size += sizeof (GsAppRareFields);
+		size += gs_app_str_size (priv->rare->renamed_from);
+		size += gs_app_str_size (priv->rare->agreement);
+		size += gs_app_str_size (priv->rare->summary_missing);
+		size += gs_app_str_size (priv->rare->url_missing);
+	}
+
+	return size;
+}
+
+/**
+ * gs_app_get_memory_stats:
+ * @list: the apps to measure
+ * @out_stats: (out caller-allocates): return location for the statistics
+ *
+ * Gets an estimate of the memory used by the apps in @list, to track
+ * regressions in memory usage.
+ *
+ * Since: 47
+ */
+void
+gs_app_get_memory_stats (GsAppList        *list,
+                         GsAppMemoryStats *out_stats)
+{
+	g_autoptr(GHashTable) interned_seen = g_hash_table_new (NULL, NULL);
+
+	g_return_if_fail (GS_IS_APP_LIST (list));
+	g_return_if_fail (out_stats != NULL);
+
+	memset (out_stats, 0, sizeof (*out_stats));
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		GsAppPrivate *priv = gs_app_get_instance_private (app);
+		g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->mutex);
+
+		out_stats->n_bytes += gs_app_get_memory_size_locked (app, interned_seen,
+								    &out_stats->n_bytes_shared);
+		out_stats->n_apps++;
+	}
 }
 
 /**
@@ -876,8 +1125,13 @@ gs_app_set_id (GsApp *app, const gchar *id)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	if (_g_set_str (&priv->id, id))
-		priv->unique_id_valid = FALSE;
+	if (!_g_set_str (&priv->id, id))
+		return;
+	priv->unique_id_valid = FALSE;
+
+	/* emitted without the lock held, as handlers may query the app */
+	g_clear_pointer (&locker, g_mutex_locker_free);
+	g_signal_emit (app, obj_signals[SIGNAL_COMPONENT_ID_CHANGED], 0);
 }
 
 /**
@@ -1384,6 +1638,7 @@ gs_app_set_unique_id (GsApp *app, const gchar *unique_id)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_autoptr(GMutexLocker) locker = NULL;
+	gboolean changed;
 	g_return_if_fail (GS_IS_APP (app));
 
 	locker = g_mutex_locker_new (&priv->mutex);
@@ -1392,9 +1647,16 @@ gs_app_set_unique_id (GsApp *app, const gchar *unique_id)
 	if (!as_utils_data_id_valid (unique_id))
 		g_warning ("unique_id %s not valid", unique_id);
 
+	changed = (g_strcmp0 (priv->unique_id, unique_id) != 0);
+
 	g_free (priv->unique_id);
 	priv->unique_id = g_strdup (unique_id);
 	priv->unique_id_valid = TRUE;
+
+	/* emitted without the lock held, as handlers may query the app */
+	g_clear_pointer (&locker, g_mutex_locker_free);
+	if (changed)
+		g_signal_emit (app, obj_signals[SIGNAL_COMPONENT_ID_CHANGED], 0);
 }
 
 /**
@@ -1458,7 +1720,7 @@ gs_app_get_renamed_from (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	return priv->renamed_from;
+	return (priv->rare != NULL) ? priv->rare->renamed_from : NULL;
 }
 
 /**
@@ -1477,7 +1739,9 @@ gs_app_set_renamed_from (GsApp *app, const gchar *renamed_from)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	_g_set_str (&priv->renamed_from, renamed_from);
+	if (renamed_from == NULL && priv->rare == NULL)
+		return;
+	_g_set_str (&gs_app_ensure_rare_fields (priv)->renamed_from, renamed_from);
 }
 
 /**
@@ -1514,7 +1778,7 @@ gs_app_set_branch (GsApp *app, const gchar *branch)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	if (_g_set_str (&priv->branch, branch))
+	if (_g_set_interned_str (&priv->branch, branch))
 		priv->unique_id_valid = FALSE;
 }
 
@@ -1766,7 +2030,7 @@ gs_app_set_project_group (GsApp *app, const gchar *project_group)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	_g_set_str (&priv->project_group, project_group);
+	_g_set_interned_str (&priv->project_group, project_group);
 }
 
 /**
@@ -1785,7 +2049,7 @@ gs_app_set_developer_name (GsApp *app, const gchar *developer_name)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	_g_set_str (&priv->developer_name, developer_name);
+	_g_set_interned_str (&priv->developer_name, developer_name);
 }
 
 static GtkIconTheme *
@@ -1940,7 +2204,7 @@ gs_app_get_action_screenshot (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	return priv->action_screenshot;
+	return (priv->rare != NULL) ? priv->rare->action_screenshot : NULL;
 }
 
 /**
@@ -2118,7 +2382,7 @@ gs_app_get_agreement (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	return priv->agreement;
+	return (priv->rare != NULL) ? priv->rare->agreement : NULL;
 }
 
 /**
@@ -2138,7 +2402,9 @@ gs_app_set_agreement (GsApp *app, const gchar *agreement)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	_g_set_str (&priv->agreement, agreement);
+	if (agreement == NULL && priv->rare == NULL)
+		return;
+	_g_set_str (&gs_app_ensure_rare_fields (priv)->agreement, agreement);
 }
 
 /**
@@ -2157,7 +2423,7 @@ gs_app_get_local_file (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	return priv->local_file;
+	return (priv->rare != NULL) ? priv->rare->local_file : NULL;
 }
 
 /**
@@ -2177,7 +2443,9 @@ gs_app_set_local_file (GsApp *app, GFile *local_file)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	g_set_object (&priv->local_file, local_file);
+	if (local_file == NULL && priv->rare == NULL)
+		return;
+	g_set_object (&gs_app_ensure_rare_fields (priv)->local_file, local_file);
 }
 
 /**
@@ -2279,7 +2547,9 @@ gs_app_set_action_screenshot (GsApp *app, AsScreenshot *action_screenshot)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	g_set_object (&priv->action_screenshot, action_screenshot);
+	if (action_screenshot == NULL && priv->rare == NULL)
+		return;
+	g_set_object (&gs_app_ensure_rare_fields (priv)->action_screenshot, action_screenshot);
 }
 
 typedef enum {
@@ -2447,7 +2717,7 @@ gs_app_set_version (GsApp *app, const gchar *version)
 
 	locker = g_mutex_locker_new (&priv->mutex);
 
-	if (_g_set_str (&priv->version, version)) {
+	if (_g_set_interned_str (&priv->version, version)) {
 		gs_app_ui_versions_invalidate (app);
 		gs_app_queue_notify (app, obj_props[PROP_VERSION]);
 	}
@@ -2622,7 +2892,7 @@ gs_app_get_url_missing (GsApp *app)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
 	locker = g_mutex_locker_new (&priv->mutex);
-	return priv->url_missing;
+	return (priv->rare != NULL) ? priv->rare->url_missing : NULL;
 }
 
 /**
@@ -2643,11 +2913,10 @@ gs_app_set_url_missing (GsApp *app, const gchar *url)
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
 
-	if (g_strcmp0 (priv->url_missing, url) == 0)
+	if (url == NULL && priv->rare == NULL)
 		return;
-	g_free (priv->url_missing);
-	priv->url_missing = g_strdup (url);
-	gs_app_queue_notify (app, obj_props[PROP_URL_MISSING]);
+	if (_g_set_str (&gs_app_ensure_rare_fields (priv)->url_missing, url))
+		gs_app_queue_notify (app, obj_props[PROP_URL_MISSING]);
 }
 
 /**
@@ -2768,7 +3037,7 @@ gs_app_set_license (GsApp *app, GsAppQuality quality, const gchar *license)
 
 	priv->license_is_free = as_license_is_free_license (license);
 
-	if (_g_set_str (&priv->license, license))
+	if (_g_set_interned_str (&priv->license, license))
 		gs_app_queue_notify (app, obj_props[PROP_LICENSE]);
 }
 
@@ -2787,7 +3056,7 @@ gs_app_get_summary_missing (GsApp *app)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
 	g_return_val_if_fail (GS_IS_APP (app), NULL);
-	return priv->summary_missing;
+	return (priv->rare != NULL) ? priv->rare->summary_missing : NULL;
 }
 
 /**
@@ -2806,7 +3075,9 @@ gs_app_set_summary_missing (GsApp *app, const gchar *summary_missing)
 	g_autoptr(GMutexLocker) locker = NULL;
 	g_return_if_fail (GS_IS_APP (app));
 	locker = g_mutex_locker_new (&priv->mutex);
-	_g_set_str (&priv->summary_missing, summary_missing);
+	if (summary_missing == NULL && priv->rare == NULL)
+		return;
+	_g_set_str (&gs_app_ensure_rare_fields (priv)->summary_missing, summary_missing);
 }
 
 static gboolean
@@ -2947,8 +3218,7 @@ gs_app_set_origin (GsApp *app, const gchar *origin)
 		return;
 	}
 
-	g_free (priv->origin);
-	priv->origin = g_strdup (origin);
+	_g_set_interned_str (&priv->origin, origin);
 
 	/* no longer valid */
 	priv->unique_id_valid = FALSE;
@@ -2994,8 +3264,7 @@ gs_app_set_origin_appstream (GsApp *app, const gchar *origin_appstream)
 	if (g_strcmp0 (origin_appstream, priv->origin_appstream) == 0)
 		return;
 
-	g_free (priv->origin_appstream);
-	priv->origin_appstream = g_strdup (origin_appstream);
+	_g_set_interned_str (&priv->origin_appstream, origin_appstream);
 }
 
 /**
@@ -3047,7 +3316,6 @@ gs_app_set_origin_hostname (GsApp *app, const gchar *origin_hostname)
 	/* same */
 	if (g_strcmp0 (origin_hostname, priv->origin_hostname) == 0)
 		return;
-	g_free (priv->origin_hostname);
 
 	/* convert a URL */
 	uri = g_uri_parse (origin_hostname, SOUP_HTTP_URI_FLAGS, NULL);
@@ -3065,7 +3333,7 @@ gs_app_set_origin_hostname (GsApp *app, const gchar *origin_hostname)
 		origin_hostname = "localhost";
 
 	/* success */
-	priv->origin_hostname = g_strdup (origin_hostname);
+	_g_set_interned_str (&priv->origin_hostname, origin_hostname);
 }
 
 /**
@@ -4192,7 +4460,7 @@ gs_app_set_metadata_variant (GsApp *app, const gchar *key, GVariant *value)
 		}
 		return;
 	}
-	g_hash_table_insert (priv->metadata, g_strdup (key), g_variant_ref (value));
+	g_hash_table_insert (priv->metadata, g_ref_string_new_intern (key), g_variant_ref (value));
 }
 
 /**
@@ -4754,7 +5022,7 @@ calculate_key_colors (GsApp *app)
 
 	/* get a list of key colors */
 	g_clear_pointer (&priv->key_colors, g_array_unref);
-	priv->key_colors = gs_calculate_key_colors (pb_small);
+	priv->key_colors = gs_calculate_key_colors_full (pb_small, GS_KEY_COLORS_FLAGS_USE_CACHE);
 }
 
 /**
@@ -4866,37 +5134,46 @@ gs_app_set_key_color_for_color_scheme (GsApp *app,
 				       const GdkRGBA *rgba)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	g_autoptr(GMutexLocker) locker = NULL;
+	GsAppRareFields *rare;
+
 	g_return_if_fail (GS_IS_APP (app));
+
+	locker = g_mutex_locker_new (&priv->mutex);
+	if (rgba == NULL && priv->rare == NULL)
+		return;
+	rare = gs_app_ensure_rare_fields (priv);
+
 	switch (for_color_scheme) {
 	case GS_COLOR_SCHEME_ANY:
 		if (rgba != NULL) {
-			if (!priv->key_color_for_light_set) {
-				priv->key_color_for_light = *rgba;
-				priv->key_color_for_light_set = TRUE;
+			if (!rare->key_color_for_light_set) {
+				rare->key_color_for_light = *rgba;
+				rare->key_color_for_light_set = TRUE;
 			}
-			if (!priv->key_color_for_dark_set) {
-				priv->key_color_for_dark = *rgba;
-				priv->key_color_for_dark_set = TRUE;
+			if (!rare->key_color_for_dark_set) {
+				rare->key_color_for_dark = *rgba;
+				rare->key_color_for_dark_set = TRUE;
 			}
 		} else {
-			priv->key_color_for_light_set = FALSE;
-			priv->key_color_for_dark_set = FALSE;
+			rare->key_color_for_light_set = FALSE;
+			rare->key_color_for_dark_set = FALSE;
 		}
 		break;
 	case GS_COLOR_SCHEME_LIGHT:
 		if (rgba != NULL) {
-			priv->key_color_for_light = *rgba;
-			priv->key_color_for_light_set = TRUE;
+			rare->key_color_for_light = *rgba;
+			rare->key_color_for_light_set = TRUE;
 		} else {
-			priv->key_color_for_light_set = FALSE;
+			rare->key_color_for_light_set = FALSE;
 		}
 		break;
 	case GS_COLOR_SCHEME_DARK:
 		if (rgba != NULL) {
-			priv->key_color_for_dark = *rgba;
-			priv->key_color_for_dark_set = TRUE;
+			rare->key_color_for_dark = *rgba;
+			rare->key_color_for_dark_set = TRUE;
 		} else {
-			priv->key_color_for_dark_set = FALSE;
+			rare->key_color_for_dark_set = FALSE;
 		}
 		break;
 	default:
@@ -4930,27 +5207,34 @@ gs_app_get_key_color_for_color_scheme (GsApp *app,
 				       GdkRGBA *out_rgba)
 {
 	GsAppPrivate *priv = gs_app_get_instance_private (app);
+	GsAppRareFields *rare;
+
 	g_return_val_if_fail (GS_IS_APP (app), FALSE);
+
+	rare = priv->rare;
+	if (rare == NULL)
+		return FALSE;
+
 	switch (for_color_scheme) {
 	case GS_COLOR_SCHEME_ANY:
-		if (priv->key_color_for_light_set) {
-			*out_rgba = priv->key_color_for_light;
+		if (rare->key_color_for_light_set) {
+			*out_rgba = rare->key_color_for_light;
 			return TRUE;
 		}
-		if (priv->key_color_for_dark_set) {
-			*out_rgba = priv->key_color_for_dark;
+		if (rare->key_color_for_dark_set) {
+			*out_rgba = rare->key_color_for_dark;
 			return TRUE;
 		}
 		break;
 	case GS_COLOR_SCHEME_LIGHT:
-		if (priv->key_color_for_light_set) {
-			*out_rgba = priv->key_color_for_light;
+		if (rare->key_color_for_light_set) {
+			*out_rgba = rare->key_color_for_light;
 			return TRUE;
 		}
 		break;
 	case GS_COLOR_SCHEME_DARK:
-		if (priv->key_color_for_dark_set) {
-			*out_rgba = priv->key_color_for_dark;
+		if (rare->key_color_for_dark_set) {
+			*out_rgba = rare->key_color_for_dark;
 			return TRUE;
 		}
 		break;
@@ -5428,7 +5712,7 @@ gs_app_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *
 		g_value_set_boxed (value, priv->urls);
 		break;
 	case PROP_URL_MISSING:
-		g_value_set_string (value, priv->url_missing);
+		g_value_set_string (value, (priv->rare != NULL) ? priv->rare->url_missing : NULL);
 		break;
 	case PROP_CONTENT_RATING:
 		g_value_set_object (value, priv->content_rating);
@@ -5677,27 +5961,23 @@ gs_app_finalize (GObject *object)
 	g_mutex_clear (&priv->mutex);
 	g_free (priv->id);
 	g_free (priv->unique_id);
-	g_free (priv->branch);
+	_g_clear_interned_str (&priv->branch);
 	g_free (priv->name);
-	g_free (priv->renamed_from);
-	g_free (priv->url_missing);
 	g_clear_pointer (&priv->urls, g_hash_table_unref);
 	g_hash_table_unref (priv->launchables);
-	g_free (priv->license);
+	_g_clear_interned_str (&priv->license);
 	g_strfreev (priv->menu_path);
-	g_free (priv->origin);
-	g_free (priv->origin_ui);
-	g_free (priv->origin_appstream);
-	g_free (priv->origin_hostname);
+	_g_clear_interned_str (&priv->origin);
+	_g_clear_interned_str (&priv->origin_ui);
+	_g_clear_interned_str (&priv->origin_appstream);
+	_g_clear_interned_str (&priv->origin_hostname);
 	g_ptr_array_unref (priv->sources);
 	g_ptr_array_unref (priv->source_ids);
-	g_free (priv->project_group);
-	g_free (priv->developer_name);
-	g_free (priv->agreement);
-	g_free (priv->version);
+	_g_clear_interned_str (&priv->project_group);
+	_g_clear_interned_str (&priv->developer_name);
+	_g_clear_interned_str (&priv->version);
 	g_free (priv->version_ui);
 	g_free (priv->summary);
-	g_free (priv->summary_missing);
 	g_free (priv->description);
 	g_free (priv->update_version);
 	g_free (priv->update_version_ui);
@@ -5706,11 +5986,10 @@ gs_app_finalize (GObject *object)
 	g_ptr_array_unref (priv->categories);
 	g_clear_pointer (&priv->key_colors, g_array_unref);
 	g_clear_object (&priv->cancellable);
-	g_clear_object (&priv->local_file);
 	g_clear_object (&priv->content_rating);
-	g_clear_object (&priv->action_screenshot);
 	g_clear_object (&priv->update_permissions);
 	g_clear_object (&priv->permissions);
+	g_clear_pointer (&priv->rare, gs_app_rare_fields_free);
 
 	G_OBJECT_CLASS (gs_app_parent_class)->finalize (object);
 }
@@ -6180,6 +6459,25 @@ gs_app_class_init (GsAppClass *klass)
 					G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
 
 	g_object_class_install_properties (object_class, G_N_ELEMENTS (obj_props), obj_props);
+
+	/**
+	 * GsApp::component-id-changed:
+	 *
+	 * Emitted when the component ID part of the app’s unique ID may have
+	 * changed, including when it is first set, from gs_app_set_id() or
+	 * gs_app_set_unique_id().
+	 *
+	 * Unlike property notifications, this is emitted straight away, in
+	 * the thread which changed the ID. It is used by #GsAppList to keep
+	 * its lookup index up to date.
+	 *
+	 * Since: 47
+	 */
+	obj_signals[SIGNAL_COMPONENT_ID_CHANGED] =
+		g_signal_new ("component-id-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__VOID,
+			      G_TYPE_NONE, 0);
 }
 
 static void
@@ -6197,7 +6495,7 @@ gs_app_init (GsApp *app)
 	priv->provided = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	priv->metadata = g_hash_table_new_full (g_str_hash,
 	                                        g_str_equal,
-	                                        g_free,
+	                                        (GDestroyNotify) g_ref_string_release,
 	                                        (GDestroyNotify) g_variant_unref);
 	priv->launchables = g_hash_table_new_full (g_str_hash,
 	                                           g_str_equal,
@@ -6401,8 +6699,7 @@ gs_app_set_origin_ui (GsApp *app,
 	if (g_strcmp0 (priv->origin_ui, origin_ui) == 0)
 		return;
 
-	g_free (priv->origin_ui);
-	priv->origin_ui = g_strdup (origin_ui);
+	_g_set_interned_str (&priv->origin_ui, origin_ui);
 	gs_app_queue_notify (app, obj_props[PROP_ORIGIN_UI]);
 }
 
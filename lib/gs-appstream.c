@@ -12,9 +12,12 @@
 #include <glib/gstdio.h>
 #include <gnome-software.h>
 #include <locale.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "gs-external-appstream-utils.h"
 #include "gs-appstream.h"
+#include "gs-profiler.h"
 
 #define	GS_APPSTREAM_MAX_SCREENSHOTS	5
 
@@ -1611,6 +1614,567 @@ gs_appstream_read_silo_info_from_component (XbNode *component,
 	}
 }
 
+/* Search index
+ *
+ * Evaluating the weighted search queries against every component in the silo
+ * is slow for large catalogs, so an index of the bigrams in the searched
+ * fields is built once per silo and used to prune the set of components which
+ * the queries need to be run against.
+ *
+ * The queries match the stem of each search term, as a token prefix with `~=`
+ * or a substring with `contains()`. The English stemmer only rewrites word
+ * endings, and can remove or change anything after the first two letters of a
+ * word (“ads” → “ad”, “cry” → “cri”), so only the first two bytes of a
+ * casefolded term are looked up; a few irregular words which it replaces
+ * completely are indexed and looked up by their stems. Every component which
+ * could possibly match a term then contains that bigram in one of its searched
+ * fields, so the candidate set is always a superset of the real matches and
+ * the existing queries still decide the match value. Trigrams would prune
+ * more, but they’d have to be taken from the stem rather than the term, and
+ * the stem isn’t known until libxmlb computes it inside the query.
+ *
+ * Each silo has its own index, built without holding any lock, so searches
+ * of different silos never wait for each other. If two searches build the
+ * index for the same silo at once, the first one to attach it wins.
+ *
+ * While typing, each search usually extends the terms of the previous one. A
+ * longer term doesn’t always match fewer components, as its stem can be
+ * shorter (“gamin” → “gaming”, which stems to “game”), so the components which
+ * matched the previous search are only used to narrow down the next one when
+ * the stem of each previous term is a prefix of the stem of the new one. The
+ * stems are compared by libxmlb, with the same stemmer as the queries use.
+ *
+ * The index is stored as a #GVariant so it can be mmapped straight from the
+ * cache directory next to the silo it was built for. */
+
+#define GS_APPSTREAM_SEARCH_INDEX_VERSION	3
+/* (version, silo GUID, number of components, sorted bigram keys,
+ *  component index posting list for each key) */
+#define GS_APPSTREAM_SEARCH_INDEX_TYPE		"(usuauaau)"
+
+typedef struct {
+	GVariant	*variant;	/* (owned) */
+	GVariant	*keys_variant;	/* (owned) */
+	GVariant	*postings;	/* (owned) */
+	const guint32	*keys;
+	gsize		 n_keys;
+	guint32		 n_components;
+
+	GMutex		 mutex;
+	XbQuery		*extends_query;		/* (owned) (nullable) (locked-by mutex) */
+	const gchar	*last_search_kind;	/* (locked-by mutex) */
+	gchar		**last_search_values;	/* (owned) (locked-by mutex) */
+	GArray		*last_search_matches;	/* (owned) (locked-by mutex) (element-type guint32) */
+} GsAppstreamSearchIndex;
+
+static void
+gs_appstream_search_index_free (GsAppstreamSearchIndex *search_index)
+{
+	g_mutex_clear (&search_index->mutex);
+	g_clear_object (&search_index->extends_query);
+	g_clear_pointer (&search_index->last_search_values, g_strfreev);
+	g_clear_pointer (&search_index->last_search_matches, g_array_unref);
+	g_clear_pointer (&search_index->keys_variant, g_variant_unref);
+	g_clear_pointer (&search_index->postings, g_variant_unref);
+	g_clear_pointer (&search_index->variant, g_variant_unref);
+	g_free (search_index);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsAppstreamSearchIndex, gs_appstream_search_index_free)
+
+static inline guint32
+gs_appstream_search_index_key (const gchar *str)
+{
+	return ((guint32) (guchar) str[0] << 8) | (guint32) (guchar) str[1];
+}
+
+/* The words which the English stemmer replaces rather than stripping their
+ * endings, so their stems don’t start with their first two letters. */
+static const gchar *
+gs_appstream_search_index_irregular_stem (const gchar *word)
+{
+	if (g_str_equal (word, "dying"))
+		return "die";
+	if (g_str_equal (word, "lying"))
+		return "lie";
+	if (g_str_equal (word, "tying"))
+		return "tie";
+	return NULL;
+}
+
+/* Returns how many of the leading bytes of the casefolded search term @folded
+ * its stem is guaranteed to start with. Words of up to two letters aren’t
+ * stemmed, and longer ones keep at least their first two letters, unless the
+ * stemmer strips a possessive or everything after a leading vowel
+ * (“a's” → “a”, “aed” → “a”). */
+static gsize
+gs_appstream_search_index_stem_prefix_len (const gchar *folded)
+{
+	gsize len = strlen (folded);
+
+	if (len <= 2)
+		return len;
+	if (folded[0] == '\'')
+		return 0;
+	if (folded[1] == '\'')
+		return 1;
+	if (strchr ("aeiou", folded[0]) != NULL &&
+	    (g_str_equal (folded + 1, "ed") ||
+	     g_str_equal (folded + 1, "edly") ||
+	     g_str_equal (folded + 1, "ing") ||
+	     g_str_equal (folded + 1, "ingly")))
+		return 1;
+	return 2;
+}
+
+static void
+gs_appstream_search_index_add_key (GHashTable *postings,
+				   guint32 key,
+				   guint32 idx)
+{
+	GArray *array = g_hash_table_lookup (postings, GUINT_TO_POINTER (key));
+
+	if (array == NULL) {
+		array = g_array_new (FALSE, FALSE, sizeof (guint32));
+		g_hash_table_insert (postings, GUINT_TO_POINTER (key), array);
+	}
+	if (array->len == 0 || g_array_index (array, guint32, array->len - 1) != idx)
+		g_array_append_val (array, idx);
+}
+
+static void
+gs_appstream_search_index_add_ngrams (GHashTable *postings,
+				      const gchar *str,
+				      guint32 idx,
+				      gboolean word_starts_only)
+{
+	gsize len = strlen (str);
+
+	for (gsize i = 0; i + 2 <= len; i++) {
+		if (word_starts_only && i > 0 && g_ascii_isalnum (str[i - 1]))
+			continue;
+
+		gs_appstream_search_index_add_key (postings, gs_appstream_search_index_key (str + i), idx);
+	}
+}
+
+static void
+gs_appstream_search_index_add_text (GHashTable *postings,
+				    const gchar *text,
+				    guint32 idx,
+				    gboolean all_positions)
+{
+	g_autofree gchar *folded = NULL;
+	g_auto(GStrv) tokens = NULL;
+	g_auto(GStrv) ascii_tokens = NULL;
+
+	if (text == NULL || *text == '\0')
+		return;
+
+	folded = g_utf8_casefold (text, -1);
+	gs_appstream_search_index_add_ngrams (postings, folded, idx, !all_positions);
+
+	/* also cover the tokens and ASCII alternates libxmlb matches with `~=` */
+	tokens = g_str_tokenize_and_fold (text, NULL, &ascii_tokens);
+	for (guint i = 0; tokens != NULL && tokens[i] != NULL; i++) {
+		const gchar *irregular_stem = gs_appstream_search_index_irregular_stem (tokens[i]);
+
+		gs_appstream_search_index_add_ngrams (postings, tokens[i], idx, !all_positions);
+		if (irregular_stem != NULL)
+			gs_appstream_search_index_add_ngrams (postings, irregular_stem, idx, TRUE);
+	}
+	for (guint i = 0; ascii_tokens != NULL && ascii_tokens[i] != NULL; i++)
+		gs_appstream_search_index_add_ngrams (postings, ascii_tokens[i], idx, !all_positions);
+}
+
+static void
+gs_appstream_search_index_add_component (GHashTable *postings,
+					 XbNode *component,
+					 guint32 idx)
+{
+	g_autoptr(XbNode) child = NULL;
+	g_autoptr(XbNode) parent = NULL;
+
+	/* the elements used by gs_appstream_search() and
+	 * gs_appstream_search_developer_apps() */
+	for (child = xb_node_get_child (component); child != NULL; node_set_to_next (&child)) {
+		const gchar *elem = xb_node_get_element (child);
+
+		if (g_strcmp0 (elem, "summary") == 0) {
+			/* only ever matched by token, and long */
+			gs_appstream_search_index_add_text (postings, xb_node_get_text (child), idx, FALSE);
+		} else if (g_strcmp0 (elem, "id") == 0 ||
+			   g_strcmp0 (elem, "name") == 0 ||
+			   g_strcmp0 (elem, "pkgname") == 0 ||
+			   g_strcmp0 (elem, "launchable") == 0 ||
+			   g_strcmp0 (elem, "developer_name") == 0 ||
+			   g_strcmp0 (elem, "project_group") == 0) {
+			gs_appstream_search_index_add_text (postings, xb_node_get_text (child), idx, TRUE);
+		} else if (g_strcmp0 (elem, "keywords") == 0 ||
+			   g_strcmp0 (elem, "provides") == 0 ||
+			   g_strcmp0 (elem, "mimetypes") == 0 ||
+			   g_strcmp0 (elem, "developer") == 0) {
+			g_autoptr(XbNode) grandchild = NULL;
+			for (grandchild = xb_node_get_child (child); grandchild != NULL; node_set_to_next (&grandchild))
+				gs_appstream_search_index_add_text (postings, xb_node_get_text (grandchild), idx, TRUE);
+		}
+	}
+
+	parent = xb_node_get_parent (component);
+	if (parent != NULL)
+		gs_appstream_search_index_add_text (postings, xb_node_get_attr (parent, "origin"), idx, TRUE);
+}
+
+static gint
+gs_appstream_search_index_key_cmp (gconstpointer a,
+				   gconstpointer b)
+{
+	guint32 key_a = *((const guint32 *) a);
+	guint32 key_b = *((const guint32 *) b);
+	return (key_a > key_b) - (key_a < key_b);
+}
+
+static GsAppstreamSearchIndex *
+gs_appstream_search_index_new_from_variant (GVariant *variant,
+					    XbSilo *silo)
+{
+	g_autoptr(GsAppstreamSearchIndex) search_index = g_new0 (GsAppstreamSearchIndex, 1);
+	guint32 version = 0;
+	const gchar *guid = NULL;
+
+	g_mutex_init (&search_index->mutex);
+	search_index->variant = g_variant_ref_sink (variant);
+	g_variant_get (search_index->variant, "(u&su@au@aau)",
+		       &version, &guid, &search_index->n_components,
+		       &search_index->keys_variant, &search_index->postings);
+	if (version != GS_APPSTREAM_SEARCH_INDEX_VERSION ||
+	    g_strcmp0 (guid, xb_silo_get_guid (silo)) != 0)
+		return NULL;
+
+	search_index->keys = g_variant_get_fixed_array (search_index->keys_variant, &search_index->n_keys, sizeof (guint32));
+	if (g_variant_n_children (search_index->postings) != search_index->n_keys)
+		return NULL;
+
+	return g_steal_pointer (&search_index);
+}
+
+static GsAppstreamSearchIndex *
+gs_appstream_search_index_build (XbSilo *silo)
+{
+	g_autoptr(GPtrArray) components = NULL;
+	g_autoptr(GHashTable) postings = NULL;
+	g_autoptr(GArray) keys = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+	GVariantBuilder builder;
+	GHashTableIter iter;
+	gpointer key;
+
+	components = xb_silo_query (silo, "components/component", 0, NULL);
+	if (components == NULL)
+		components = g_ptr_array_new ();
+
+	postings = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					  NULL, (GDestroyNotify) g_array_unref);
+	for (guint i = 0; i < components->len; i++)
+		gs_appstream_search_index_add_component (postings, g_ptr_array_index (components, i), i);
+
+	keys = g_array_sized_new (FALSE, FALSE, sizeof (guint32), g_hash_table_size (postings));
+	g_hash_table_iter_init (&iter, postings);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		guint32 key32 = GPOINTER_TO_UINT (key);
+		g_array_append_val (keys, key32);
+	}
+	g_array_sort (keys, gs_appstream_search_index_key_cmp);
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aau"));
+	for (guint i = 0; i < keys->len; i++) {
+		guint32 key32 = g_array_index (keys, guint32, i);
+		GArray *array = g_hash_table_lookup (postings, GUINT_TO_POINTER (key32));
+		g_variant_builder_add_value (&builder,
+					     g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+									array->data, array->len,
+									sizeof (guint32)));
+	}
+
+	g_debug ("building search index for %u components with %u keys took %fms",
+		 components->len, keys->len, g_timer_elapsed (timer, NULL) * 1000);
+
+	return gs_appstream_search_index_new_from_variant (
+		g_variant_new ("(usu@au@aau)",
+			       (guint32) GS_APPSTREAM_SEARCH_INDEX_VERSION,
+			       (xb_silo_get_guid (silo) != NULL) ? xb_silo_get_guid (silo) : "",
+			       (guint32) components->len,
+			       g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+							  keys->data, keys->len,
+							  sizeof (guint32)),
+			       g_variant_builder_end (&builder)),
+		silo);
+}
+
+static GsAppstreamSearchIndex *
+gs_appstream_search_index_load (XbSilo *silo,
+				GFile *file)
+{
+	g_autofree gchar *path = g_file_get_path (file);
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	mapped_file = g_mapped_file_new (path, FALSE, &error_local);
+	if (mapped_file == NULL) {
+		if (!g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("failed to load search index %s: %s", path, error_local->message);
+		return NULL;
+	}
+
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	return gs_appstream_search_index_new_from_variant (
+		g_variant_new_from_bytes (G_VARIANT_TYPE (GS_APPSTREAM_SEARCH_INDEX_TYPE), bytes, FALSE),
+		silo);
+}
+
+/* Returns the index attached to @silo, building it if required. The returned
+ * index is owned by @silo. */
+static GsAppstreamSearchIndex *
+gs_appstream_search_index_get (XbSilo *silo,
+			       GFile *file)
+{
+	g_autoptr(GsAppstreamSearchIndex) new_index = NULL;
+	GsAppstreamSearchIndex *search_index;
+
+	search_index = g_object_get_data (G_OBJECT (silo), "gs-appstream-search-index");
+	if (search_index != NULL)
+		return search_index;
+
+	if (file != NULL)
+		search_index = gs_appstream_search_index_load (silo, file);
+	if (search_index == NULL) {
+		search_index = gs_appstream_search_index_build (silo);
+		if (search_index != NULL && file != NULL) {
+			g_autoptr(GError) error_local = NULL;
+			if (!g_file_replace_contents (file,
+						      g_variant_get_data (search_index->variant),
+						      g_variant_get_size (search_index->variant),
+						      NULL, FALSE,
+						      G_FILE_CREATE_REPLACE_DESTINATION,
+						      NULL, NULL, &error_local))
+				g_debug ("failed to save search index: %s", error_local->message);
+		}
+	}
+	if (search_index == NULL)
+		return NULL;
+
+	/* another thread may have attached an index while this one was built */
+	new_index = search_index;
+	if (g_object_replace_data (G_OBJECT (silo), "gs-appstream-search-index",
+				   NULL, new_index,
+				   (GDestroyNotify) gs_appstream_search_index_free, NULL)) {
+		g_steal_pointer (&new_index);
+		return search_index;
+	}
+
+	return g_object_get_data (G_OBJECT (silo), "gs-appstream-search-index");
+}
+
+/**
+ * gs_appstream_search_index_ensure:
+ * @silo: an #XbSilo
+ * @file: (nullable): cache file to load the index from, or save it to
+ *
+ * Loads the search index for @silo from @file, or builds it and saves it to
+ * @file if it is missing or was built for a different silo. The index is
+ * attached to @silo and is used by gs_appstream_search().
+ *
+ * If this is not called, the index is built in memory on the first search.
+ **/
+void
+gs_appstream_search_index_ensure (XbSilo *silo,
+				  GFile *file)
+{
+	g_return_if_fail (XB_IS_SILO (silo));
+	g_return_if_fail (file == NULL || G_IS_FILE (file));
+
+	gs_appstream_search_index_get (silo, file);
+}
+
+/* Intersects the sorted component indices in @candidates, or all of them if
+ * %NULL, with the sorted @idxs. */
+static GArray *
+gs_appstream_search_index_intersect (GArray *candidates,
+				     const guint32 *idxs,
+				     gsize n_idxs,
+				     guint n_components)
+{
+	GArray *intersection = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+	if (candidates == NULL) {
+		for (gsize j = 0; j < n_idxs; j++) {
+			if (idxs[j] < n_components)
+				g_array_append_val (intersection, idxs[j]);
+		}
+		return intersection;
+	}
+
+	for (gsize j = 0, k = 0; j < n_idxs && k < candidates->len;) {
+		guint32 candidate = g_array_index (candidates, guint32, k);
+		if (idxs[j] < candidate) {
+			j++;
+		} else if (idxs[j] > candidate) {
+			k++;
+		} else {
+			g_array_append_val (intersection, candidate);
+			j++;
+			k++;
+		}
+	}
+	return intersection;
+}
+
+/* Whether a search term is a single word, so libxmlb doesn’t split it into
+ * several tokens, any one of which may match. */
+static gboolean
+gs_appstream_search_value_is_word (const gchar *value)
+{
+	for (const gchar *p = value; *p != '\0'; p = g_utf8_next_char (p)) {
+		if (!g_unichar_isalnum (g_utf8_get_char (p)))
+			return FALSE;
+	}
+	return *value != '\0';
+}
+
+/* Whether every component matching @values also matches @last_values, which
+ * is the case when the stem of each term in @last_values is a prefix of the
+ * stem of the term at the same position in @values: the queries then match a
+ * token or substring starting with the old stem wherever they match the new
+ * one. The stems are only known to libxmlb, so it compares them against the
+ * root of @silo. Must be called with the index mutex held. */
+static gboolean
+gs_appstream_search_index_values_extend (GsAppstreamSearchIndex *search_index,
+					 XbSilo *silo,
+					 const gchar * const *values,
+					 const gchar * const *last_values)
+{
+	guint i;
+
+	if (search_index->extends_query == NULL) {
+		g_autoptr(GError) error_local = NULL;
+
+		search_index->extends_query = xb_query_new (silo, "components[starts-with(stem(?),stem(?))]", &error_local);
+		if (search_index->extends_query == NULL) {
+			g_debug ("not narrowing searches: %s", error_local->message);
+			return FALSE;
+		}
+	}
+
+	for (i = 0; last_values[i] != NULL; i++) {
+		g_auto(XbQueryContext) context = XB_QUERY_CONTEXT_INIT ();
+		g_autoptr(XbNode) root = NULL;
+
+		if (values[i] == NULL ||
+		    !gs_appstream_search_value_is_word (values[i]) ||
+		    !gs_appstream_search_value_is_word (last_values[i]))
+			return FALSE;
+
+		xb_value_bindings_bind_str (xb_query_context_get_bindings (&context), 0, values[i], NULL);
+		xb_value_bindings_bind_str (xb_query_context_get_bindings (&context), 1, last_values[i], NULL);
+		root = xb_silo_query_first_with_context (silo, search_index->extends_query, &context, NULL);
+		if (root == NULL)
+			return FALSE;
+	}
+	return i > 0;
+}
+
+/* Returns the sorted indices of components in @silo which may match all of
+ * @values for a search of @kind, or %NULL if the index can’t narrow the
+ * search down. */
+static GArray *
+gs_appstream_search_index_lookup (XbSilo *silo,
+				  const gchar *kind,
+				  guint n_components,
+				  const gchar * const *values)
+{
+	GsAppstreamSearchIndex *search_index = gs_appstream_search_index_get (silo, NULL);
+	g_autoptr(GArray) candidates = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (search_index == NULL || search_index->n_components != n_components)
+		return NULL;
+
+	for (guint i = 0; values[i] != NULL; i++) {
+		g_autofree gchar *folded = g_utf8_casefold (values[i], -1);
+		const gchar *irregular_stem = gs_appstream_search_index_irregular_stem (folded);
+		g_autoptr(GVariant) posting = NULL;
+		g_autoptr(GArray) intersection = NULL;
+		const guint32 *key_ptr;
+		const guint32 *idxs;
+		gsize n_idxs;
+		guint32 key;
+
+		/* the stem is too short to look up, the queries will have to
+		 * check it */
+		if (irregular_stem != NULL)
+			key = gs_appstream_search_index_key (irregular_stem);
+		else if (gs_appstream_search_index_stem_prefix_len (folded) >= 2)
+			key = gs_appstream_search_index_key (folded);
+		else
+			continue;
+
+		key_ptr = bsearch (&key, search_index->keys, search_index->n_keys, sizeof (guint32),
+				   gs_appstream_search_index_key_cmp);
+		if (key_ptr == NULL)
+			return g_array_new (FALSE, FALSE, sizeof (guint32));
+
+		posting = g_variant_get_child_value (search_index->postings, key_ptr - search_index->keys);
+		idxs = g_variant_get_fixed_array (posting, &n_idxs, sizeof (guint32));
+		intersection = gs_appstream_search_index_intersect (candidates, idxs, n_idxs, n_components);
+		g_clear_pointer (&candidates, g_array_unref);
+		candidates = g_steal_pointer (&intersection);
+	}
+
+	/* only re-check what matched last time if the search was refined */
+	locker = g_mutex_locker_new (&search_index->mutex);
+	if (search_index->last_search_matches != NULL &&
+	    g_strcmp0 (kind, search_index->last_search_kind) == 0 &&
+	    gs_appstream_search_index_values_extend (search_index, silo, values,
+						     (const gchar * const *) search_index->last_search_values)) {
+		GArray *last_matches = search_index->last_search_matches;
+		GArray *intersection;
+
+		g_debug ("narrowing search to the %u previous matches", last_matches->len);
+		intersection = gs_appstream_search_index_intersect (candidates,
+								    (const guint32 *) last_matches->data,
+								    last_matches->len,
+								    n_components);
+		g_clear_pointer (&candidates, g_array_unref);
+		candidates = intersection;
+	}
+
+	return g_steal_pointer (&candidates);
+}
+
+/* Remembers the components which matched @values, so a refined search can be
+ * narrowed down to them. */
+static void
+gs_appstream_search_index_set_matches (XbSilo *silo,
+				       const gchar *kind,
+				       const gchar * const *values,
+				       GArray *matches)
+{
+	GsAppstreamSearchIndex *search_index = g_object_get_data (G_OBJECT (silo), "gs-appstream-search-index");
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (search_index == NULL)
+		return;
+
+	locker = g_mutex_locker_new (&search_index->mutex);
+
+	search_index->last_search_kind = kind;
+	g_strfreev (search_index->last_search_values);
+	search_index->last_search_values = g_strdupv ((gchar **) values);
+	g_clear_pointer (&search_index->last_search_matches, g_array_unref);
+	search_index->last_search_matches = g_array_ref (matches);
+}
+
 typedef struct {
 	guint16			 match_value;
 	XbQuery			*query;
@@ -1656,6 +2220,78 @@ gs_appstream_silo_search_component (GPtrArray *array, XbNode *component, const g
 	return matches_sum;
 }
 
+/* Large searches are split into shards of this many components, which are
+ * evaluated in parallel */
+#define GS_APPSTREAM_SEARCH_SHARD_SIZE		256
+#define GS_APPSTREAM_SEARCH_THREADS_MAX		16
+
+typedef struct {
+	GPtrArray		*helpers;	/* (element-type GsAppstreamSearchHelper) */
+	GPtrArray		*components;	/* (element-type XbNode) */
+	GArray			*candidates;	/* (element-type guint32) (nullable) */
+	const gchar * const	*values;
+	GCancellable		*cancellable;	/* (nullable) */
+	guint16			*match_values;	/* indexed like the candidates */
+	guint			 n_candidates;
+	guint			 n_shards;
+	guint			 next_shard;	/* (atomic) */
+} GsAppstreamSearchShards;
+
+static void
+gs_appstream_search_shards_cb (gpointer user_data)
+{
+	GsAppstreamSearchShards *shards = user_data;
+	guint shard;
+
+	while ((shard = (guint) g_atomic_int_add (&shards->next_shard, 1)) < shards->n_shards) {
+		guint start = shard * GS_APPSTREAM_SEARCH_SHARD_SIZE;
+		guint end = MIN (start + GS_APPSTREAM_SEARCH_SHARD_SIZE, shards->n_candidates);
+
+		for (guint i = start; i < end; i++) {
+			guint32 idx = (shards->candidates != NULL) ? g_array_index (shards->candidates, guint32, i) : i;
+			XbNode *component = g_ptr_array_index (shards->components, idx);
+
+			if (g_cancellable_is_cancelled (shards->cancellable))
+				return;
+			shards->match_values[i] = gs_appstream_silo_search_component (shards->helpers, component, shards->values);
+		}
+	}
+}
+
+/* Evaluates the search queries against all the candidates, splitting them into
+ * shards which are shared out between the calling thread and the shared
+ * worker pool if there are enough of them. The XbQuery objects are only read,
+ * with per-thread query contexts. */
+static guint16 *
+gs_appstream_search_components (GPtrArray *helpers,
+				GPtrArray *components,
+				GArray *candidates,
+				guint n_candidates,
+				const gchar * const *values,
+				GCancellable *cancellable)
+{
+	g_autofree guint16 *match_values = g_new0 (guint16, MAX (n_candidates, 1));
+	GsAppstreamSearchShards shards = {
+		.helpers = helpers,
+		.components = components,
+		.candidates = candidates,
+		.values = values,
+		.cancellable = cancellable,
+		.match_values = match_values,
+		.n_candidates = n_candidates,
+		.n_shards = (n_candidates + GS_APPSTREAM_SEARCH_SHARD_SIZE - 1) / GS_APPSTREAM_SEARCH_SHARD_SIZE,
+		.next_shard = 0,
+	};
+
+	gs_utils_run_in_parallel (gs_appstream_search_shards_cb, &shards,
+				  MIN (shards.n_shards, GS_APPSTREAM_SEARCH_THREADS_MAX));
+
+	if (shards.n_shards > 1)
+		g_debug ("searched %u components in %u shards", n_candidates, shards.n_shards);
+
+	return g_steal_pointer (&match_values);
+}
+
 typedef struct {
 	guint16			match_value;
 	const gchar		*xpath;
@@ -1664,6 +2300,7 @@ typedef struct {
 static gboolean
 gs_appstream_do_search (GsPlugin *plugin,
 			XbSilo *silo,
+			const gchar *kind,
 			const gchar * const *values,
 			const Query queries[],
 			GsAppList *list,
@@ -1675,6 +2312,10 @@ gs_appstream_do_search (GsPlugin *plugin,
 	g_autoptr(GError) error_local = NULL;
 	g_autoptr(GPtrArray) array = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_appstream_search_helper_free);
 	g_autoptr(GPtrArray) components = NULL;
+	g_autoptr(GArray) candidates = NULL;
+	g_autoptr(GArray) matches = g_array_new (FALSE, FALSE, sizeof (guint32));
+	g_autofree guint16 *match_values = NULL;
+	guint n_candidates;
 	g_autoptr(GTimer) timer = g_timer_new ();
 #if AS_CHECK_VERSION(1, 0, 0)
 	const guint16 component_id_weight = as_utils_get_tag_search_weight ("id");
@@ -1712,13 +2353,23 @@ gs_appstream_do_search (GsPlugin *plugin,
 	if (components->len > 0)
 		gs_appstream_read_silo_info_from_component (g_ptr_array_index (components, 0), &silo_filename, &default_scope);
 
-	for (guint i = 0; i < components->len; i++) {
-		XbNode *component = g_ptr_array_index (components, i);
-		guint16 match_value = gs_appstream_silo_search_component (array, component, values);
+	/* only run the queries on components which can possibly match */
+	candidates = gs_appstream_search_index_lookup (silo, kind, components->len, values);
+	n_candidates = (candidates != NULL) ? candidates->len : components->len;
+	match_values = gs_appstream_search_components (array, components, candidates, n_candidates,
+						       values, cancellable);
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	for (guint i = 0; i < n_candidates; i++) {
+		guint32 idx = (candidates != NULL) ? g_array_index (candidates, guint32, i) : i;
+		XbNode *component = g_ptr_array_index (components, idx);
+		guint16 match_value = match_values[i];
 		if (match_value != 0) {
 			g_autoptr(GsApp) app = gs_appstream_create_app (plugin, silo, component, silo_filename ? silo_filename : "", default_scope, error);
 			if (app == NULL)
 				return FALSE;
+			g_array_append_val (matches, idx);
 			if (gs_app_has_quirk (app, GS_APP_QUIRK_IS_WILDCARD)) {
 				g_debug ("not returning wildcard %s",
 					 gs_app_get_unique_id (app));
@@ -1755,7 +2406,9 @@ gs_appstream_do_search (GsPlugin *plugin,
 		if (g_cancellable_set_error_if_cancelled (cancellable, error))
 			return FALSE;
 	}
-	g_debug ("search took %fms", g_timer_elapsed (timer, NULL) * 1000);
+	gs_appstream_search_index_set_matches (silo, kind, values, matches);
+	g_debug ("search of %u/%u components took %fms", n_candidates, components->len,
+		 g_timer_elapsed (timer, NULL) * 1000);
 	return TRUE;
 }
 
@@ -1808,7 +2461,7 @@ gs_appstream_search (GsPlugin *plugin,
 	};
 #endif
 
-	return gs_appstream_do_search (plugin, silo, values, queries, list, cancellable, error);
+	return gs_appstream_do_search (plugin, silo, "search", values, queries, list, cancellable, error);
 }
 
 gboolean
@@ -1835,7 +2488,7 @@ gs_appstream_search_developer_apps (GsPlugin *plugin,
 	};
 #endif
 
-	return gs_appstream_do_search (plugin, silo, values, queries, list, cancellable, error);
+	return gs_appstream_do_search (plugin, silo, "developer", values, queries, list, cancellable, error);
 }
 
 gboolean
@@ -1902,38 +2555,87 @@ gs_appstream_add_category_apps (GsPlugin *plugin,
 	return TRUE;
 }
 
-static guint
-gs_appstream_count_component_for_groups (XbSilo      *silo,
-                                         const gchar *desktop_group)
+/* the overview page checks for 100 apps, then try to get them */
+#define GS_APPSTREAM_CATEGORY_SIZE_LIMIT 100
+
+/* protects the category counts attached to each silo */
+static GMutex gs_appstream_category_counts_mutex;
+
+/* Counts the components in each ‘Category’ and ‘Category::Subcategory’
+ * desktop group, in a single pass over the components in @silo. */
+static GHashTable *
+gs_appstream_build_category_counts (XbSilo *silo)
 {
-	/* the overview page checks for 100 apps, then try to get them */
-	const guint limit = 100;
-	g_autofree gchar *xpath = NULL;
-	g_auto(GStrv) split = g_strsplit (desktop_group, "::", -1);
-	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GHashTable) counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_autoptr(GHashTable) groups = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_autoptr(GPtrArray) categories = g_ptr_array_new ();
+	g_autoptr(GPtrArray) components = NULL;
 	g_autoptr(GError) error_local = NULL;
 
-	if (g_strv_length (split) == 1) { /* "all" group for a parent category */
-		xpath = g_strdup_printf ("components/component[not(@merge)]/categories/"
-					 "category[text()='%s']/../..",
-					 split[0]);
-	} else if (g_strv_length (split) == 2) {
-		xpath = g_strdup_printf ("components/component[not(@merge)]/categories/"
-					 "category[text()='%s']/../"
-					 "category[text()='%s']/../..",
-					 split[0], split[1]);
-	} else {
-		return 0;
+	components = xb_silo_query (silo, "components/component[not(@merge)]", 0, &error_local);
+	if (components == NULL) {
+		if (!g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+			g_warning ("%s", error_local->message);
+		return g_steal_pointer (&counts);
 	}
 
-	array = xb_silo_query (silo, xpath, limit, &error_local);
-	if (array == NULL) {
-		if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
-			return 0;
-		g_warning ("%s", error_local->message);
-		return 0;
+	for (guint i = 0; i < components->len; i++) {
+		XbNode *component = g_ptr_array_index (components, i);
+		GHashTableIter iter;
+		gpointer key;
+
+		/* a component is only counted once per group, even if it lists
+		 * a category several times */
+		g_hash_table_remove_all (groups);
+		for (g_autoptr(XbNode) n = xb_node_get_child (component); n != NULL; node_set_to_next (&n)) {
+			if (g_strcmp0 (xb_node_get_element (n), "categories") != 0)
+				continue;
+
+			g_ptr_array_set_size (categories, 0);
+			for (g_autoptr(XbNode) c = xb_node_get_child (n); c != NULL; node_set_to_next (&c)) {
+				const gchar *text = xb_node_get_text (c);
+				if (text != NULL && g_strcmp0 (xb_node_get_element (c), "category") == 0)
+					g_ptr_array_add (categories, (gpointer) text);
+			}
+
+			for (guint j = 0; j < categories->len; j++) {
+				const gchar *category = g_ptr_array_index (categories, j);
+				g_hash_table_add (groups, g_strdup (category));
+				for (guint k = 0; k < categories->len; k++) {
+					if (k == j)
+						continue;
+					g_hash_table_add (groups, g_strdup_printf ("%s::%s", category,
+										   (const gchar *) g_ptr_array_index (categories, k)));
+				}
+			}
+		}
+
+		g_hash_table_iter_init (&iter, groups);
+		while (g_hash_table_iter_next (&iter, &key, NULL)) {
+			guint cnt = GPOINTER_TO_UINT (g_hash_table_lookup (counts, key));
+			g_hash_table_iter_steal (&iter);
+			g_hash_table_insert (counts, key, GUINT_TO_POINTER (cnt + 1));
+		}
 	}
-	return array->len;
+
+	return g_steal_pointer (&counts);
+}
+
+/* Returns the number of components in each desktop group, which is worked
+ * out once per silo and then kept alongside it. */
+static GHashTable *
+gs_appstream_get_category_counts (XbSilo *silo)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&gs_appstream_category_counts_mutex);
+	GHashTable *counts = g_object_get_data (G_OBJECT (silo), "gs-appstream-category-counts");
+
+	if (counts == NULL) {
+		counts = gs_appstream_build_category_counts (silo);
+		g_object_set_data_full (G_OBJECT (silo), "gs-appstream-category-counts",
+					counts, (GDestroyNotify) g_hash_table_unref);
+	}
+
+	return g_hash_table_ref (counts);
 }
 
 /* we're not actually adding categories here, we're just setting the number of
@@ -1944,9 +2646,13 @@ gs_appstream_refine_category_sizes (XbSilo        *silo,
                                     GCancellable  *cancellable,
                                     GError       **error)
 {
+	g_autoptr(GHashTable) counts = NULL;
+
 	g_return_val_if_fail (XB_IS_SILO (silo), FALSE);
 	g_return_val_if_fail (list != NULL, FALSE);
 
+	counts = gs_appstream_get_category_counts (silo);
+
 	for (guint j = 0; j < list->len; j++) {
 		GsCategory *parent = GS_CATEGORY (g_ptr_array_index (list, j));
 		GPtrArray *children = gs_category_get_children (parent);
@@ -1956,7 +2662,8 @@ gs_appstream_refine_category_sizes (XbSilo        *silo,
 			GPtrArray *groups = gs_category_get_desktop_groups (cat);
 			for (guint k = 0; k < groups->len; k++) {
 				const gchar *group = g_ptr_array_index (groups, k);
-				guint cnt = gs_appstream_count_component_for_groups (silo, group);
+				guint cnt = MIN (GPOINTER_TO_UINT (g_hash_table_lookup (counts, group)),
+						 GS_APPSTREAM_CATEGORY_SIZE_LIMIT);
 				if (cnt > 0) {
 					gs_category_increment_size (parent, cnt);
 					if (children->len > 1) {
@@ -2498,6 +3205,200 @@ gs_appstream_add_current_locales (XbBuilder *builder)
 		xb_builder_add_locale (builder, locales[i]);
 }
 
+/* Prefix of the silos cached by gs_appstream_import_cached_silo(), which are
+ * kept apart from the merge silos so unused ones can be found and removed */
+#define GS_APPSTREAM_SOURCE_SILO_PREFIX "source-"
+
+static gchar *
+gs_appstream_cached_silo_basename (const gchar *prefix,
+				   const gchar *cache_id)
+{
+	g_autofree gchar *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, cache_id, -1);
+	return g_strdup_printf ("%s%s.xmlb", prefix, checksum);
+}
+
+/* Compiles @builder into a silo cached on disk under a name derived from
+ * @prefix and @cache_id. libxmlb derives the silo GUID from the file names and
+ * modification times of the sources, so the cached silo is reused until one of
+ * them changes. */
+static XbSilo *
+gs_appstream_compile_cached (XbBuilder *builder,
+			     const gchar *prefix,
+			     const gchar *cache_id,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	g_autofree gchar *basename = gs_appstream_cached_silo_basename (prefix, cache_id);
+	g_autofree gchar *blobfn = NULL;
+	g_autoptr(GFile) file = NULL;
+	g_autoptr(GError) error_local = NULL;
+	XbSilo *silo;
+
+	xb_builder_append_guid (builder, PACKAGE_VERSION);
+
+	blobfn = gs_utils_get_cache_filename ("appstream", basename,
+					      GS_UTILS_CACHE_FLAG_WRITEABLE |
+					      GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					      &error_local);
+
+	GS_PROFILER_BEGIN_SCOPED (AppstreamCompileSilo, "appstream-compile-silo", cache_id);
+
+	if (blobfn == NULL) {
+		g_debug ("not caching silo for %s: %s", cache_id, error_local->message);
+		silo = xb_builder_compile (builder,
+					   XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
+					   XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
+					   cancellable, error);
+	} else {
+		file = g_file_new_for_path (blobfn);
+		silo = xb_builder_ensure (builder, file,
+					  XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
+					  XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
+					  cancellable, error);
+	}
+
+	GS_PROFILER_END_SCOPED (AppstreamCompileSilo);
+
+	return silo;
+}
+
+static XbBuilderNode *
+gs_appstream_builder_node_new_from_node (XbNode *node,
+					 const gchar * const *elements_to_tokenize)
+{
+	XbBuilderNode *bn = xb_builder_node_new (xb_node_get_element (node));
+	XbNodeAttrIter attr_iter;
+	XbNodeChildIter child_iter;
+	XbNode *child = NULL;
+	const gchar *attr_name, *attr_value;
+	const gchar *text;
+
+	text = xb_node_get_text (node);
+	if (text != NULL) {
+		xb_builder_node_set_text (bn, text, -1);
+		if (elements_to_tokenize != NULL &&
+		    g_strv_contains (elements_to_tokenize, xb_node_get_element (node)))
+			xb_builder_node_tokenize_text (bn);
+	}
+	text = xb_node_get_tail (node);
+	if (text != NULL)
+		xb_builder_node_set_tail (bn, text, -1);
+
+	xb_node_attr_iter_init (&attr_iter, node);
+	while (xb_node_attr_iter_next (&attr_iter, &attr_name, &attr_value))
+		xb_builder_node_set_attr (bn, attr_name, attr_value);
+
+	xb_node_child_iter_init (&child_iter, node);
+	while (xb_node_child_iter_loop (&child_iter, &child)) {
+		g_autoptr(XbBuilderNode) child_bn = gs_appstream_builder_node_new_from_node (child, elements_to_tokenize);
+		xb_builder_node_add_child (bn, child_bn);
+	}
+
+	return bn;
+}
+
+/**
+ * gs_appstream_import_cached_silo:
+ * @builder: an #XbBuilder to import the nodes into
+ * @sub_builder: an #XbBuilder with sources and fixups already added
+ * @cache_id: unique identifier for the sources of @sub_builder, such as their path
+ * @elements_to_tokenize: (nullable): elements whose text is tokenized for searching
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Compiles the sources in @sub_builder into a separate silo, which is cached
+ * on disk and only recompiled when one of its sources changes, and imports its
+ * nodes into @builder.
+ *
+ * Splitting the sources of a large silo like this means that a change to one
+ * source does not require re-parsing all of the others, and their fixups are
+ * not run again. Builder-level fixups on @builder still apply to the imported
+ * nodes. Node tokens are not carried over from the cached silo, so the text of
+ * elements in @elements_to_tokenize is tokenized again on import.
+ *
+ * Returns: %TRUE on success
+ **/
+gboolean
+gs_appstream_import_cached_silo (XbBuilder *builder,
+				 XbBuilder *sub_builder,
+				 const gchar *cache_id,
+				 const gchar * const *elements_to_tokenize,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	g_autoptr(XbSilo) silo = NULL;
+
+	g_return_val_if_fail (XB_IS_BUILDER (builder), FALSE);
+	g_return_val_if_fail (XB_IS_BUILDER (sub_builder), FALSE);
+	g_return_val_if_fail (cache_id != NULL, FALSE);
+
+	silo = gs_appstream_compile_cached (sub_builder, GS_APPSTREAM_SOURCE_SILO_PREFIX, cache_id, cancellable, error);
+	if (silo == NULL)
+		return FALSE;
+
+	for (g_autoptr(XbNode) node = xb_silo_get_root (silo); node != NULL; node_set_to_next (&node)) {
+		g_autoptr(XbBuilderNode) bn = gs_appstream_builder_node_new_from_node (node, elements_to_tokenize);
+		xb_builder_import_node (builder, bn);
+	}
+
+	/* the imported nodes are not sources, so make sure @builder is
+	 * recompiled when the cached silo changes */
+	xb_builder_append_guid (builder, xb_silo_get_guid (silo));
+
+	return TRUE;
+}
+
+/**
+ * gs_appstream_remove_unused_cached_silos:
+ * @cache_ids: (element-type utf8): cache IDs passed to
+ *   gs_appstream_import_cached_silo() which are still in use
+ *
+ * Deletes the silos cached by gs_appstream_import_cached_silo() for any cache
+ * ID not in @cache_ids, such as those of sources which have been removed.
+ *
+ * This should be called after each rebuild which imported all the cached
+ * silos in use.
+ **/
+void
+gs_appstream_remove_unused_cached_silos (GPtrArray *cache_ids)
+{
+	g_autofree gchar *blobfn = NULL;
+	g_autofree gchar *cache_dir = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GHashTable) used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	const gchar *fn;
+
+	g_return_if_fail (cache_ids != NULL);
+
+	blobfn = gs_utils_get_cache_filename ("appstream", GS_APPSTREAM_SOURCE_SILO_PREFIX,
+					      GS_UTILS_CACHE_FLAG_WRITEABLE,
+					      NULL);
+	if (blobfn == NULL)
+		return;
+	cache_dir = g_path_get_dirname (blobfn);
+	dir = g_dir_open (cache_dir, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	for (guint i = 0; i < cache_ids->len; i++)
+		g_hash_table_add (used, gs_appstream_cached_silo_basename (GS_APPSTREAM_SOURCE_SILO_PREFIX,
+									   g_ptr_array_index (cache_ids, i)));
+
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *filename = NULL;
+
+		if (!g_str_has_prefix (fn, GS_APPSTREAM_SOURCE_SILO_PREFIX) ||
+		    !g_str_has_suffix (fn, ".xmlb") ||
+		    g_hash_table_contains (used, fn))
+			continue;
+
+		filename = g_build_filename (cache_dir, fn, NULL);
+		g_debug ("removing unused cached silo %s", filename);
+		if (g_unlink (filename) != 0)
+			g_debug ("failed to remove %s: %s", filename, g_strerror (errno));
+	}
+}
+
 static gboolean
 gs_appstream_is_merge_node (XbBuilderNode *bn)
 {
@@ -2822,6 +3723,16 @@ gs_appstream_create_silo_index (XbSilo *silo,
 	return index;
 }
 
+static gchar *
+gs_appstream_merge_cache_id (const gchar *prefix,
+			     GPtrArray *paths)
+{
+	g_autoptr(GString) cache_id = g_string_new (prefix);
+	for (guint i = 0; i < paths->len; i++)
+		g_string_append_printf (cache_id, ":%s", (const gchar *) g_ptr_array_index (paths, i));
+	return g_string_free (g_steal_pointer (&cache_id), FALSE);
+}
+
 static MergeData *
 gs_appstream_gather_merge_data (GPtrArray *appstream_paths,
 				GPtrArray *desktop_paths,
@@ -2852,10 +3763,8 @@ gs_appstream_gather_merge_data (GPtrArray *appstream_paths,
 			any_loaded = gs_appstream_load_appstream_dir (builder, path, cancellable) || any_loaded;
 		}
 		if (any_loaded && !g_cancellable_is_cancelled (cancellable)) {
-			md->appstream_silo = xb_builder_compile (builder,
-								 XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
-								 XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
-								 cancellable, &local_error);
+			g_autofree gchar *cache_id = gs_appstream_merge_cache_id ("merge-appstream", appstream_paths);
+			md->appstream_silo = gs_appstream_compile_cached (builder, "silo-", cache_id, cancellable, &local_error);
 			if (md->appstream_silo != NULL)
 				md->appstream_index = gs_appstream_create_silo_index (md->appstream_silo, TRUE);
 			else
@@ -2871,10 +3780,7 @@ gs_appstream_gather_merge_data (GPtrArray *appstream_paths,
 			any_loaded = gs_appstream_load_appstream_dir (builder, path, cancellable) || any_loaded;
 		}
 		if (any_loaded && !g_cancellable_is_cancelled (cancellable)) {
-			md->appstream_silo = xb_builder_compile (builder,
-								 XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
-								 XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
-								 cancellable, &local_error);
+			md->appstream_silo = gs_appstream_compile_cached (builder, "silo-", "merge-appstream-common", cancellable, &local_error);
 			if (md->appstream_silo != NULL)
 				md->appstream_index = gs_appstream_create_silo_index (md->appstream_silo, TRUE);
 			else
@@ -2893,10 +3799,8 @@ gs_appstream_gather_merge_data (GPtrArray *appstream_paths,
 			any_loaded = any_loaded || this_loaded;
 		}
 		if (any_loaded && !g_cancellable_is_cancelled (cancellable)) {
-			md->desktop_silo = xb_builder_compile (builder,
-							       XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
-							       XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
-							       cancellable, &local_error);
+			g_autofree gchar *cache_id = gs_appstream_merge_cache_id ("merge-desktop", desktop_paths);
+			md->desktop_silo = gs_appstream_compile_cached (builder, "silo-", cache_id, cancellable, &local_error);
 			if (md->desktop_silo != NULL)
 				md->desktop_index = gs_appstream_create_silo_index (md->desktop_silo, FALSE);
 			else
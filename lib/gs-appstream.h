@@ -34,6 +34,8 @@ gboolean	 gs_appstream_search			(GsPlugin	*plugin,
 							 GsAppList	*list,
 							 GCancellable	*cancellable,
 							 GError		**error);
+void		 gs_appstream_search_index_ensure	(XbSilo		*silo,
+							 GFile		*file);
 gboolean	 gs_appstream_search_developer_apps	(GsPlugin	*plugin,
 							 XbSilo		*silo,
 							 const gchar * const *values,
@@ -93,6 +95,14 @@ gboolean	 gs_appstream_load_desktop_files	(XbBuilder	*builder,
 							 GError		**error);
 GPtrArray	*gs_appstream_get_appstream_data_dirs	(void);
 void		 gs_appstream_add_current_locales	(XbBuilder	*builder);
+gboolean	 gs_appstream_import_cached_silo	(XbBuilder	*builder,
+							 XbBuilder	*sub_builder,
+							 const gchar	*cache_id,
+							 const gchar * const *elements_to_tokenize,
+							 GCancellable	*cancellable,
+							 GError		**error);
+void		 gs_appstream_remove_unused_cached_silos
+							(GPtrArray	*cache_ids);
 void		 gs_appstream_add_data_merge_fixup	(XbBuilder	*builder,
 							 GPtrArray	*appstream_paths,
 							 GPtrArray	*desktop_paths,
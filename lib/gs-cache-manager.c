@@ -0,0 +1,477 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Software contributors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+/**
+ * SECTION:gs-cache-manager
+ * @short_description: Size-bounded LRU management of the on-disk caches
+ *
+ * The cache manager keeps the icon and screenshot caches in the user’s cache
+ * directory below a size quota. Code which looks up or stores files in one of
+ * the caches reports it with gs_cache_manager_record_lookup() and
+ * gs_cache_manager_record_store(), which keep running totals of the cache
+ * size and hit rate.
+ *
+ * Once a cache grows past its quota (set with gs_cache_manager_set_quota()),
+ * an eviction pass is started in a thread with idle I/O priority. It deletes
+ * the least recently used files until the cache is comfortably below the
+ * quota again. ‘Recently used’ is tracked using the access time of each file,
+ * which is updated explicitly on cache hits as many file systems are mounted
+ * with `noatime` or `relatime`.
+ *
+ * The cache manager has no instance; its state is global to the process, as
+ * the caches themselves are.
+ *
+ * Since: 47
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+
+#include "gs-cache-manager.h"
+#include "gs-ioprio.h"
+#include "gs-profiler.h"
+
+/* Once a cache is over its quota, files are evicted until it’s at this
+ * proportion of the quota, so the next few stores don’t immediately trigger
+ * another eviction pass. */
+#define EVICTION_LOW_WATER_MARK 0.9
+
+/* Files modified more recently than this are never evicted, as they may
+ * still be being written, or be about to be used. */
+#define EVICTION_MIN_AGE_SECS 60
+
+/* The access time of a file is only updated on a cache hit if it’s older
+ * than this, to avoid a metadata write on every lookup. */
+#define ACCESS_TIME_RESOLUTION_SECS (60 * 60)
+
+/* How deep to recurse into a cache directory; screenshots are stored one
+ * level down, in a directory per size. */
+#define MAX_SCAN_DEPTH 4
+
+G_LOCK_DEFINE_STATIC (cache_manager);
+static GsCacheStats cache_stats[GS_CACHE_KIND_LAST];  /* (locked-by cache_manager) */
+static gboolean eviction_running = FALSE;  /* (locked-by cache_manager) */
+
+/**
+ * gs_cache_kind_to_string:
+ * @kind: a #GsCacheKind
+ *
+ * Get the name of the cache directory for @kind, which is also suitable for
+ * use in debug output.
+ *
+ * Returns: name of the cache
+ * Since: 47
+ */
+const gchar *
+gs_cache_kind_to_string (GsCacheKind kind)
+{
+	switch (kind) {
+	case GS_CACHE_KIND_ICONS:
+		return "icons";
+	case GS_CACHE_KIND_SCREENSHOTS:
+		return "screenshots";
+	case GS_CACHE_KIND_LAST:
+	default:
+		g_assert_not_reached ();
+	}
+}
+
+static gchar *
+get_cache_dir (GsCacheKind kind)
+{
+	const gchar *tmp;
+
+	/* Matches the directory used by gs_utils_get_cache_filename() */
+	tmp = g_getenv ("GS_SELF_TEST_CACHEDIR");
+	if (tmp != NULL)
+		return g_build_filename (tmp, gs_cache_kind_to_string (kind), NULL);
+
+	return g_build_filename (g_get_user_cache_dir (), "gnome-software",
+				 gs_cache_kind_to_string (kind), NULL);
+}
+
+/**
+ * gs_cache_manager_set_quota:
+ * @kind: a #GsCacheKind
+ * @quota_bytes: maximum size of the cache, in bytes, or `0` for no limit
+ *
+ * Set the maximum size of the cache for @kind. The cache isn’t trimmed
+ * immediately; that happens on the next call to gs_cache_manager_evict_async(),
+ * or when the next file is stored.
+ *
+ * Since: 47
+ */
+void
+gs_cache_manager_set_quota (GsCacheKind kind,
+                            guint64     quota_bytes)
+{
+	g_return_if_fail (kind < GS_CACHE_KIND_LAST);
+
+	G_LOCK (cache_manager);
+	cache_stats[kind].quota_bytes = quota_bytes;
+	G_UNLOCK (cache_manager);
+}
+
+static void
+touch_access_time (const gchar *filename)
+{
+	GStatBuf stat_buf;
+	const struct timespec times[2] = {
+		{ 0, UTIME_NOW },  /* atime */
+		{ 0, UTIME_OMIT },  /* mtime */
+	};
+
+	if (g_stat (filename, &stat_buf) != 0 ||
+	    g_get_real_time () / G_USEC_PER_SEC - stat_buf.st_atime < ACCESS_TIME_RESOLUTION_SECS)
+		return;
+
+	/* The mtime is left alone, as #GsRemoteIcon uses it to track when the
+	 * file was last revalidated. */
+	if (utimensat (AT_FDCWD, filename, times, 0) != 0)
+		g_debug ("Failed to update access time of ‘%s’: %s",
+			 filename, g_strerror (errno));
+}
+
+/**
+ * gs_cache_manager_record_lookup:
+ * @kind: a #GsCacheKind
+ * @filename: (nullable): path of the cached file which was looked up
+ * @hit: %TRUE if the file was in the cache and usable, %FALSE otherwise
+ *
+ * Record a lookup in the cache for @kind. On a hit, the access time of
+ * @filename is updated so that it’s evicted later than files which haven’t
+ * been used recently.
+ *
+ * This is thread-safe.
+ *
+ * Since: 47
+ */
+void
+gs_cache_manager_record_lookup (GsCacheKind  kind,
+                                const gchar *filename,
+                                gboolean     hit)
+{
+	g_return_if_fail (kind < GS_CACHE_KIND_LAST);
+
+	G_LOCK (cache_manager);
+	if (hit)
+		cache_stats[kind].n_hits++;
+	else
+		cache_stats[kind].n_misses++;
+	G_UNLOCK (cache_manager);
+
+	GS_PROFILER_COUNTER_ADD (hit ? GS_PROFILER_COUNTER_CACHE_HITS : GS_PROFILER_COUNTER_CACHE_MISSES, 1);
+
+	if (hit && filename != NULL)
+		touch_access_time (filename);
+}
+
+/**
+ * gs_cache_manager_record_store:
+ * @kind: a #GsCacheKind
+ * @filename: path of the file which was stored in the cache
+ *
+ * Record that @filename has been written to the cache for @kind. If this
+ * takes the cache over its quota, an eviction pass is started in the
+ * background.
+ *
+ * The size of the cache is tracked approximately between eviction passes; if
+ * @filename replaced an existing cached file, both are counted until the next
+ * pass rescans the cache.
+ *
+ * This is thread-safe.
+ *
+ * Since: 47
+ */
+void
+gs_cache_manager_record_store (GsCacheKind  kind,
+                               const gchar *filename)
+{
+	GStatBuf stat_buf;
+	gboolean start_eviction;
+
+	g_return_if_fail (kind < GS_CACHE_KIND_LAST);
+	g_return_if_fail (filename != NULL);
+
+	if (g_stat (filename, &stat_buf) != 0)
+		return;
+
+	G_LOCK (cache_manager);
+	cache_stats[kind].size_bytes += stat_buf.st_size;
+	start_eviction = (!eviction_running &&
+			  cache_stats[kind].quota_bytes > 0 &&
+			  cache_stats[kind].size_bytes > cache_stats[kind].quota_bytes);
+	G_UNLOCK (cache_manager);
+
+	if (start_eviction)
+		gs_cache_manager_evict_async (NULL, NULL, NULL);
+}
+
+/**
+ * gs_cache_manager_get_stats:
+ * @kind: a #GsCacheKind
+ * @stats_out: (out caller-allocates): return location for the statistics
+ *
+ * Get a snapshot of the statistics for the cache for @kind.
+ *
+ * This is thread-safe.
+ *
+ * Since: 47
+ */
+void
+gs_cache_manager_get_stats (GsCacheKind   kind,
+                            GsCacheStats *stats_out)
+{
+	g_return_if_fail (kind < GS_CACHE_KIND_LAST);
+	g_return_if_fail (stats_out != NULL);
+
+	G_LOCK (cache_manager);
+	*stats_out = cache_stats[kind];
+	G_UNLOCK (cache_manager);
+}
+
+typedef struct {
+	gchar *path;  /* (owned) */
+	guint64 size;
+	gint64 last_used_secs;
+	gint64 modified_secs;
+} CacheEntry;
+
+static void
+cache_entry_clear (gpointer data)
+{
+	CacheEntry *entry = data;
+
+	g_free (entry->path);
+}
+
+static gint
+cache_entry_compare_last_used (gconstpointer a,
+                               gconstpointer b)
+{
+	const CacheEntry *entry_a = a;
+	const CacheEntry *entry_b = b;
+
+	if (entry_a->last_used_secs < entry_b->last_used_secs)
+		return -1;
+	else if (entry_a->last_used_secs > entry_b->last_used_secs)
+		return 1;
+	else
+		return 0;
+}
+
+static void
+scan_cache_dir (const gchar  *path,
+                guint         depth,
+                GArray       *entries,
+                GCancellable *cancellable)
+{
+	g_autoptr(GDir) dir = NULL;
+	const gchar *name;
+
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *child_path = g_build_filename (path, name, NULL);
+		GStatBuf stat_buf;
+
+		if (g_cancellable_is_cancelled (cancellable))
+			return;
+		if (g_lstat (child_path, &stat_buf) != 0)
+			continue;
+
+		if (S_ISDIR (stat_buf.st_mode) && depth < MAX_SCAN_DEPTH) {
+			scan_cache_dir (child_path, depth + 1, entries, cancellable);
+		} else if (S_ISREG (stat_buf.st_mode)) {
+			CacheEntry entry;
+
+			/* Writing a file counts as using it. */
+			entry.path = g_steal_pointer (&child_path);
+			entry.size = stat_buf.st_size;
+			entry.last_used_secs = MAX (stat_buf.st_atime, stat_buf.st_mtime);
+			entry.modified_secs = stat_buf.st_mtime;
+			g_array_append_val (entries, entry);
+		}
+	}
+}
+
+/* Rescan the cache for @kind, and delete the least recently used files in it
+ * if it’s over quota. Returns the number of files deleted. */
+static guint64
+evict_cache (GsCacheKind   kind,
+             GCancellable *cancellable)
+{
+	g_autofree gchar *cache_dir = get_cache_dir (kind);
+	g_autoptr(GArray) entries = NULL;
+	guint64 size_bytes = 0, quota_bytes;
+	guint64 n_evicted = 0;
+	gint64 now_secs = g_get_real_time () / G_USEC_PER_SEC;
+
+	entries = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
+	g_array_set_clear_func (entries, cache_entry_clear);
+
+	scan_cache_dir (cache_dir, 0, entries, cancellable);
+	if (g_cancellable_is_cancelled (cancellable))
+		return 0;
+
+	for (guint i = 0; i < entries->len; i++)
+		size_bytes += g_array_index (entries, CacheEntry, i).size;
+
+	G_LOCK (cache_manager);
+	quota_bytes = cache_stats[kind].quota_bytes;
+	G_UNLOCK (cache_manager);
+
+	if (quota_bytes > 0 && size_bytes > quota_bytes) {
+		guint64 target_bytes = quota_bytes * EVICTION_LOW_WATER_MARK;
+
+		g_array_sort (entries, cache_entry_compare_last_used);
+
+		for (guint i = 0; i < entries->len && size_bytes > target_bytes; i++) {
+			const CacheEntry *entry = &g_array_index (entries, CacheEntry, i);
+
+			if (g_cancellable_is_cancelled (cancellable))
+				break;
+			if (now_secs - entry->modified_secs < EVICTION_MIN_AGE_SECS)
+				continue;
+
+			/* The file may have been removed or replaced since
+			 * the scan, which is fine. */
+			if (g_unlink (entry->path) != 0) {
+				if (errno != ENOENT)
+					g_debug ("Failed to evict ‘%s’ from cache: %s",
+						 entry->path, g_strerror (errno));
+				continue;
+			}
+
+			size_bytes -= entry->size;
+			n_evicted++;
+		}
+
+		g_debug ("Evicted %" G_GUINT64_FORMAT " files from %s cache; "
+			 "now %" G_GUINT64_FORMAT " bytes of %" G_GUINT64_FORMAT,
+			 n_evicted, gs_cache_kind_to_string (kind),
+			 size_bytes, quota_bytes);
+	}
+
+	G_LOCK (cache_manager);
+	cache_stats[kind].size_bytes = size_bytes;
+	cache_stats[kind].n_evictions += n_evicted;
+	G_UNLOCK (cache_manager);
+
+	return n_evicted;
+}
+
+static void
+evict_thread_cb (GTask        *task,
+                 gpointer      source_object,
+                 gpointer      task_data,
+                 GCancellable *cancellable)
+{
+	guint64 *n_evicted = task_data;
+
+	gs_ioprio_set (G_PRIORITY_LOW);
+
+	for (GsCacheKind kind = 0; kind < GS_CACHE_KIND_LAST; kind++)
+		*n_evicted += evict_cache (kind, cancellable);
+
+	/* Restore the I/O priority, as this is a thread pool thread. */
+	gs_ioprio_set (G_PRIORITY_DEFAULT);
+
+	G_LOCK (cache_manager);
+	eviction_running = FALSE;
+	G_UNLOCK (cache_manager);
+
+	if (!g_task_return_error_if_cancelled (task))
+		g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * gs_cache_manager_evict_async:
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (nullable): callback to call once eviction is complete
+ * @user_data: data to pass to @callback
+ *
+ * Rescan all the caches to update their sizes, and evict the least recently
+ * used files from any which are over quota.
+ *
+ * This is done in a worker thread with idle I/O priority. If an eviction
+ * pass is already running, this returns immediately without evicting
+ * anything.
+ *
+ * Since: 47
+ */
+void
+gs_cache_manager_evict_async (GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	gboolean already_running;
+
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_cache_manager_evict_async);
+	g_task_set_priority (task, G_PRIORITY_LOW);
+	g_task_set_task_data (task, g_new0 (guint64, 1), g_free);
+
+	G_LOCK (cache_manager);
+	already_running = eviction_running;
+	eviction_running = TRUE;
+	G_UNLOCK (cache_manager);
+
+	if (already_running) {
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	g_task_run_in_thread (task, evict_thread_cb);
+}
+
+/**
+ * gs_cache_manager_evict_finish:
+ * @result: a #GAsyncResult
+ * @out_n_evicted: (out) (optional): return location for the number of files
+ *   evicted, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish an asynchronous operation started with
+ * gs_cache_manager_evict_async().
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 47
+ */
+gboolean
+gs_cache_manager_evict_finish (GAsyncResult  *result,
+                               guint64       *out_n_evicted,
+                               GError       **error)
+{
+	GTask *task;
+
+	g_return_val_if_fail (g_task_is_valid (result, NULL), FALSE);
+	g_return_val_if_fail (g_async_result_is_tagged (result, gs_cache_manager_evict_async), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	task = G_TASK (result);
+
+	if (!g_task_propagate_boolean (task, error))
+		return FALSE;
+
+	if (out_n_evicted != NULL)
+		*out_n_evicted = *((guint64 *) g_task_get_task_data (task));
+
+	return TRUE;
+}
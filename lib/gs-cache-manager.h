@@ -0,0 +1,73 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Software contributors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * GsCacheKind:
+ * @GS_CACHE_KIND_ICONS: Remote app icons, see #GsRemoteIcon
+ * @GS_CACHE_KIND_SCREENSHOTS: App screenshots, at all the sizes they’ve been
+ *   shown at
+ *
+ * The caches managed by the cache manager. Each one is a directory in the
+ * user’s gnome-software cache directory.
+ *
+ * Since: 47
+ */
+typedef enum {
+	GS_CACHE_KIND_ICONS,
+	GS_CACHE_KIND_SCREENSHOTS,
+	GS_CACHE_KIND_LAST  /*< skip >*/
+} GsCacheKind;
+
+/**
+ * GsCacheStats:
+ * @size_bytes: total size of the files in the cache, as of the last eviction
+ *   pass plus the files stored since
+ * @quota_bytes: maximum size of the cache, or `0` if it’s unlimited
+ * @n_hits: number of lookups which found the file in the cache
+ * @n_misses: number of lookups which didn’t find the file in the cache
+ * @n_evictions: number of files evicted from the cache
+ *
+ * Statistics about a cache, from gs_cache_manager_get_stats().
+ *
+ * Since: 47
+ */
+typedef struct {
+	guint64		 size_bytes;
+	guint64		 quota_bytes;
+	guint64		 n_hits;
+	guint64		 n_misses;
+	guint64		 n_evictions;
+} GsCacheStats;
+
+const gchar	*gs_cache_kind_to_string		(GsCacheKind		 kind);
+
+void		 gs_cache_manager_set_quota		(GsCacheKind		 kind,
+							 guint64		 quota_bytes);
+void		 gs_cache_manager_record_lookup		(GsCacheKind		 kind,
+							 const gchar		*filename,
+							 gboolean		 hit);
+void		 gs_cache_manager_record_store		(GsCacheKind		 kind,
+							 const gchar		*filename);
+void		 gs_cache_manager_get_stats		(GsCacheKind		 kind,
+							 GsCacheStats		*stats_out);
+
+void		 gs_cache_manager_evict_async		(GCancellable		*cancellable,
+							 GAsyncReadyCallback	 callback,
+							 gpointer		 user_data);
+gboolean	 gs_cache_manager_evict_finish		(GAsyncResult		*result,
+							 guint64		*out_n_evicted,
+							 GError		       **error);
+
+G_END_DECLS
@@ -16,6 +16,7 @@
 #include "gnome-software-private.h"
 
 #include "gs-debug.h"
+#include "gs-profiler.h"
 
 typedef struct {
 	GsPluginLoader	*plugin_loader;
@@ -282,6 +283,10 @@ app_sort_kind_cb (GsApp *app1, GsApp *app2, gpointer user_data)
 int
 main (int argc, char **argv)
 {
+	/* declared first so the capture is finished after everything else has
+	 * been torn down */
+	g_autoptr(GsProfilerCapture) capture = NULL;
+	g_autofree gchar *profile_filename = NULL;
 	g_autoptr(GOptionContext) context = NULL;
 	gboolean prefer_local = FALSE;
 	gboolean ret;
@@ -325,6 +330,8 @@ main (int argc, char **argv)
 		  "Allow interactive authentication", NULL },
 		{ "only-freely-licensed", '\0', 0, G_OPTION_ARG_NONE, &self->only_freely_licensed,
 		  "Filter results to include only freely licensed apps", NULL },
+		{ "profile", '\0', 0, G_OPTION_ARG_FILENAME, &profile_filename,
+		  "Write a Sysprof capture of the action to FILE", "FILE" },
 		{ NULL}
 	};
 
@@ -346,6 +353,16 @@ main (int argc, char **argv)
 	}
 	gs_debug_set_verbose (debug, verbose);
 
+	/* start profiling before the plugins are loaded so that setup is
+	 * included in the capture */
+	if (profile_filename != NULL) {
+		capture = gs_profiler_capture_new (profile_filename, &error);
+		if (capture == NULL) {
+			g_print ("Failed to start profiling: %s\n", error->message);
+			return EXIT_FAILURE;
+		}
+	}
+
 	/* prefer local sources */
 	if (prefer_local)
 		g_setenv ("GNOME_SOFTWARE_PREFER_LOCAL", "true", TRUE);
@@ -26,6 +26,7 @@
 #include <libsoup/soup.h>
 
 #include "gs-download-utils.h"
+#include "gs-profiler.h"
 #include "gs-utils.h"
 
 G_DEFINE_QUARK (gs-download-error-quark, gs_download_error)
@@ -122,6 +123,7 @@ typedef struct {
 	gsize total_written_bytes;
 	gsize expected_stream_size_bytes;
 	GBytes *currently_unwritten_chunk;  /* (nullable) (owned) */
+	gint64 begin_time_nsec;
 
 	/* Output data. */
 	gchar *new_etag;  /* (nullable) (owned) */
@@ -236,6 +238,7 @@ gs_download_stream_async (SoupSession                *soup_session,
 	data->io_priority = io_priority;
 	data->progress_callback = progress_callback;
 	data->progress_user_data = progress_user_data;
+	data->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
 
 	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) download_data_free);
 
@@ -520,6 +523,9 @@ finish_download (GTask  *task,
 		download_progress (task);
 	}
 
+	GS_PROFILER_ADD_MARK (DownloadStream, data->begin_time_nsec, "download", data->uri);
+	GS_PROFILER_COUNTER_ADD (GS_PROFILER_COUNTER_BYTES_DOWNLOADED, data->total_read_bytes);
+
 	/* Record the error from the operation, if set. */
 	g_assert (data->error == NULL);
 	data->error = g_steal_pointer (&error);
@@ -872,65 +878,127 @@ gs_download_file_finish (SoupSession   *soup_session,
 	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+/* Maximum number of resources downloaded at once by
+ * gs_download_rewrite_resources_async(). */
+#define MAX_PARALLEL_RESOURCE_DOWNLOADS 4
+
+/* Remote resource URIs which have been downloaded to the cache, so later
+ * rewrites can skip working out their cache filename. */
+G_LOCK_DEFINE_STATIC (resource_cache);
+static GHashTable *resource_cache = NULL;  /* (element-type utf8 filename) (owned) (locked-by resource_cache) */
+
+typedef struct {
+	GTask *task;  /* (unowned) (not nullable); a ref is held while downloading */
+	gchar *uri;  /* (owned) (not nullable) */
+	gchar *cache_filename;  /* (owned) (not nullable) */
+	GArray *resource_indices;  /* (owned) (element-type guint); resources using this download */
+	gsize bytes_downloaded;
+} ResourceDownload;
+
+static void
+resource_download_free (ResourceDownload *download)
+{
+	g_free (download->uri);
+	g_free (download->cache_filename);
+	g_array_unref (download->resource_indices);
+	g_free (download);
+}
+
+static void
+error_free_nullable (GError *error)
+{
+	g_clear_error (&error);
+}
+
 typedef struct {
-	guint n_pending_downloads;
-	GError *saved_error;  /* (nullable) (owned) */
-	GString *rewritten_resource;  /* (owned) */
+	SoupSession *soup_session;  /* (owned) (nullable) */
+	GPtrArray *rewritten_resources;  /* (owned) (element-type utf8) (nullable elements) */
+	GPtrArray *errors;  /* (owned) (element-type GError) (nullable elements) */
+	GHashTable *downloads;  /* (owned) (element-type utf8 ResourceDownload); keyed by URI */
+	GQueue pending_downloads;  /* (element-type ResourceDownload) (unowned) */
+	guint n_running_downloads;
+	guint64 bytes_downloaded;
 } DownloadRewriteData;
 
 static void
 download_rewrite_data_free (DownloadRewriteData *data)
 {
-	g_clear_error (&data->saved_error);
-	if (data->rewritten_resource != NULL)
-		g_string_free (data->rewritten_resource, TRUE);
+	g_assert (data->n_running_downloads == 0);
+
+	g_clear_object (&data->soup_session);
+	g_clear_pointer (&data->rewritten_resources, g_ptr_array_unref);
+	g_clear_pointer (&data->errors, g_ptr_array_unref);
+	g_queue_clear (&data->pending_downloads);
+	g_clear_pointer (&data->downloads, g_hash_table_unref);
 	g_free (data);
 }
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (DownloadRewriteData, download_rewrite_data_free)
 
+static void start_resource_downloads (GTask *task);
+static void download_rewrite_progress_cb (gsize    bytes_downloaded,
+                                          gsize    total_download_size,
+                                          gpointer user_data);
 static void download_rewrite_cb (GObject      *source_object,
                                  GAsyncResult *result,
                                  gpointer      user_data);
-static void finish_download_rewrite (GTask  *task,
-                                     GError *error);
+static void finish_download_rewrite (GTask *task);
 
-/**
- * gs_download_rewrite_resource_async:
- * @resource: the CSS resource
- * @cancellable: a #GCancellable, or %NULL
- * @callback: a #GAsyncReadyCallback
- * @user_data: data to pass to @callback
- *
- * Downloads remote assets and rewrites a CSS resource to use cached local URIs.
- *
- * Since: 45
- **/
-void
-gs_download_rewrite_resource_async (const gchar         *resource,
-                                    GCancellable        *cancellable,
-                                    GAsyncReadyCallback  callback,
-                                    gpointer             user_data)
+/* Get the cache filename for the remote resource @uri, and whether it needs
+ * downloading. */
+static gchar *
+get_resource_cache_filename (const gchar  *uri,
+                             gboolean     *out_needs_download,
+                             GError      **error)
 {
-	g_autoptr(GTask) task = NULL;
-	g_autoptr(DownloadRewriteData) data_owned = NULL;
-	DownloadRewriteData *data;
-	guint start = 0;
-	g_autoptr(GString) resource_str = g_string_new (resource);
-	g_autoptr(SoupSession) soup_session = NULL;
-	g_autoptr(GError) local_error = NULL;
-
-	g_return_if_fail (resource != NULL);
-	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+	g_autofree gchar *cache_filename = NULL;
+
+	G_LOCK (resource_cache);
+	if (resource_cache != NULL)
+		cache_filename = g_strdup (g_hash_table_lookup (resource_cache, uri));
+	G_UNLOCK (resource_cache);
+
+	/* the file may have been removed from the cache since */
+	if (cache_filename != NULL && g_file_test (cache_filename, G_FILE_TEST_EXISTS)) {
+		GS_PROFILER_COUNTER_ADD (GS_PROFILER_COUNTER_CACHE_HITS, 1);
+		*out_needs_download = FALSE;
+		return g_steal_pointer (&cache_filename);
+	}
+	g_clear_pointer (&cache_filename, g_free);
+
+	cache_filename = gs_utils_get_cache_filename ("cssresource", uri,
+						      GS_UTILS_CACHE_FLAG_WRITEABLE |
+						      GS_UTILS_CACHE_FLAG_USE_HASH |
+						      GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+						      error);
+	if (cache_filename == NULL)
+		return NULL;
 
-	task = g_task_new (NULL, cancellable, callback, user_data);
-	g_task_set_source_tag (task, gs_download_rewrite_resource_async);
+	*out_needs_download = !g_file_test (cache_filename, G_FILE_TEST_EXISTS);
+	GS_PROFILER_COUNTER_ADD (*out_needs_download ? GS_PROFILER_COUNTER_CACHE_MISSES : GS_PROFILER_COUNTER_CACHE_HITS, 1);
+	if (!*out_needs_download) {
+		G_LOCK (resource_cache);
+		if (resource_cache == NULL)
+			resource_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		g_hash_table_replace (resource_cache, g_strdup (uri), g_strdup (cache_filename));
+		G_UNLOCK (resource_cache);
+	}
 
-	data = data_owned = g_new0 (DownloadRewriteData, 1);
-	data->n_pending_downloads = 1;  /* start with 1 to represent the string rewrite */
-	data->rewritten_resource = g_string_new ("");
+	return g_steal_pointer (&cache_filename);
+}
 
-	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) download_rewrite_data_free);
+/* Rewrite the url() links in @resource to refer to local files, and queue
+ * downloads for any remote files which aren’t cached yet. */
+static gchar *
+rewrite_resource (GTask        *task,
+                  const gchar  *resource,
+                  guint         resource_index,
+                  GError      **error)
+{
+	DownloadRewriteData *data = g_task_get_task_data (task);
+	guint start = 0;
+	g_autoptr(GString) resource_str = g_string_new (resource);
+	g_autoptr(GString) rewritten_resource = g_string_new ("");
 
 	/* replace datadir */
 	gs_utils_gstring_replace (resource_str, "@datadir@", DATADIR);
@@ -943,7 +1011,7 @@ gs_download_rewrite_resource_async (const gchar         *resource,
 			continue;
 		}
 		if (start == 0) {
-			g_string_append_c (data->rewritten_resource, resource[i]);
+			g_string_append_c (rewritten_resource, resource[i]);
 			continue;
 		}
 		if (resource[i] == ')') {
@@ -970,51 +1038,151 @@ gs_download_rewrite_resource_async (const gchar         *resource,
 
 			if (g_str_has_prefix (unprefixed_uri, "/")) {
 				if (!g_file_test (unprefixed_uri, G_FILE_TEST_EXISTS)) {
-					g_set_error (&local_error,
+					g_set_error (error,
 						     G_IO_ERROR,
 						     G_IO_ERROR_NOT_FOUND,
 						     "Failed to find file: %s", unprefixed_uri);
-					finish_download_rewrite (task, g_steal_pointer (&local_error));
-					return;
+					return NULL;
 				}
 				cachefn = g_strdup (unprefixed_uri);
 			} else {
-				/* get cache location */
-				cachefn = gs_utils_get_cache_filename ("cssresource", unprefixed_uri,
-								       GS_UTILS_CACHE_FLAG_WRITEABLE |
-								       GS_UTILS_CACHE_FLAG_USE_HASH |
-								       GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
-								       &local_error);
-				if (cachefn == NULL) {
-					finish_download_rewrite (task, g_steal_pointer (&local_error));
-					return;
+				ResourceDownload *download;
+				gboolean needs_download;
+
+				/* the same file may be used by several resources */
+				download = g_hash_table_lookup (data->downloads, unprefixed_uri);
+				if (download != NULL) {
+					cachefn = g_strdup (download->cache_filename);
+					needs_download = TRUE;
+				} else {
+					cachefn = get_resource_cache_filename (unprefixed_uri, &needs_download, error);
+					if (cachefn == NULL)
+						return NULL;
 				}
 
 				/* Download it if it doesn’t already exist */
-				if (!g_file_test (cachefn, G_FILE_TEST_EXISTS)) {
-					g_autoptr(GFile) output_file = NULL;
-
-					if (soup_session == NULL)
-						soup_session = gs_build_soup_session ();
-
-					/* Do the download. */
-					output_file = g_file_new_for_path (cachefn);
-					data->n_pending_downloads++;
-					gs_download_file_async (soup_session, unprefixed_uri, output_file,
-								G_PRIORITY_LOW,
-								NULL, NULL,
-								cancellable,
-								download_rewrite_cb, g_object_ref (task));
+				if (needs_download) {
+					if (download == NULL) {
+						download = g_new0 (ResourceDownload, 1);
+						download->task = task;
+						download->uri = g_strdup (unprefixed_uri);
+						download->cache_filename = g_strdup (cachefn);
+						download->resource_indices = g_array_new (FALSE, FALSE, sizeof (guint));
+						g_hash_table_insert (data->downloads, download->uri, download);
+						g_queue_push_tail (&data->pending_downloads, download);
+					}
+					g_array_append_val (download->resource_indices, resource_index);
 				}
 			}
 
-			g_string_append_printf (data->rewritten_resource, "'file://%s'", cachefn);
-			g_string_append_c (data->rewritten_resource, resource[i]);
+			g_string_append_printf (rewritten_resource, "'file://%s'", cachefn);
+			g_string_append_c (rewritten_resource, resource[i]);
 			start = 0;
 		}
 	}
 
-	finish_download_rewrite (task, NULL);
+	return g_string_free (g_steal_pointer (&rewritten_resource), FALSE);
+}
+
+/**
+ * gs_download_rewrite_resources_async:
+ * @soup_session: (nullable): a #SoupSession to download with, or %NULL to
+ *   create one if needed
+ * @resources: (array zero-terminated=1): the CSS resources
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback
+ * @user_data: data to pass to @callback
+ *
+ * Downloads remote assets and rewrites several CSS resources to use cached
+ * local URIs.
+ *
+ * Each remote asset is downloaded once, even if it’s used by several of the
+ * @resources, and only a few assets are downloaded at a time. Assets which have
+ * already been cached are not downloaded again.
+ *
+ * Since: 47
+ **/
+void
+gs_download_rewrite_resources_async (SoupSession         *soup_session,
+                                     const gchar * const *resources,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(DownloadRewriteData) data_owned = NULL;
+	DownloadRewriteData *data;
+	guint n_resources;
+
+	g_return_if_fail (soup_session == NULL || SOUP_IS_SESSION (soup_session));
+	g_return_if_fail (resources != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_download_rewrite_resources_async);
+
+	n_resources = g_strv_length ((gchar **) resources);
+
+	data = data_owned = g_new0 (DownloadRewriteData, 1);
+	data->soup_session = (soup_session != NULL) ? g_object_ref (soup_session) : NULL;
+	data->rewritten_resources = g_ptr_array_new_full (n_resources, g_free);
+	data->errors = g_ptr_array_new_full (n_resources, (GDestroyNotify) error_free_nullable);
+	data->downloads = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) resource_download_free);
+	g_queue_init (&data->pending_downloads);
+
+	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) download_rewrite_data_free);
+
+	for (guint i = 0; i < n_resources; i++) {
+		GError *local_error = NULL;
+
+		g_ptr_array_add (data->rewritten_resources, rewrite_resource (task, resources[i], i, &local_error));
+		g_ptr_array_add (data->errors, local_error);
+	}
+
+	if (g_queue_is_empty (&data->pending_downloads)) {
+		finish_download_rewrite (task);
+		return;
+	}
+
+	g_debug ("Downloading %u resources for %u CSS resources",
+		 g_queue_get_length (&data->pending_downloads), n_resources);
+
+	if (data->soup_session == NULL)
+		data->soup_session = gs_build_soup_session ();
+
+	start_resource_downloads (task);
+}
+
+/* Start queued downloads, up to %MAX_PARALLEL_RESOURCE_DOWNLOADS at once. */
+static void
+start_resource_downloads (GTask *task)
+{
+	DownloadRewriteData *data = g_task_get_task_data (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	while (data->n_running_downloads < MAX_PARALLEL_RESOURCE_DOWNLOADS &&
+	       !g_queue_is_empty (&data->pending_downloads)) {
+		ResourceDownload *download = g_queue_pop_head (&data->pending_downloads);
+		g_autoptr(GFile) output_file = g_file_new_for_path (download->cache_filename);
+
+		data->n_running_downloads++;
+		g_object_ref (task);
+		gs_download_file_async (data->soup_session, download->uri, output_file,
+					G_PRIORITY_LOW,
+					download_rewrite_progress_cb, download,
+					cancellable,
+					download_rewrite_cb, download);
+	}
+}
+
+static void
+download_rewrite_progress_cb (gsize    bytes_downloaded,
+                              gsize    total_download_size,
+                              gpointer user_data)
+{
+	ResourceDownload *download = user_data;
+
+	download->bytes_downloaded = bytes_downloaded;
 }
 
 static void
@@ -1023,40 +1191,164 @@ download_rewrite_cb (GObject      *source_object,
                      gpointer      user_data)
 {
 	SoupSession *soup_session = SOUP_SESSION (source_object);
-	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	ResourceDownload *download = user_data;
+	g_autoptr(GTask) task = download->task;  /* ref taken in start_resource_downloads() */
+	DownloadRewriteData *data = g_task_get_task_data (task);
 	g_autoptr(GError) local_error = NULL;
 
+	g_assert (data->n_running_downloads > 0);
+	data->n_running_downloads--;
+
 	if (!gs_download_file_finish (soup_session, result, &local_error) &&
 	    g_error_matches (local_error, GS_DOWNLOAD_ERROR, GS_DOWNLOAD_ERROR_NOT_MODIFIED)) {
 		/* Ignore cache matches. */
 		g_clear_error (&local_error);
 	}
 
-	finish_download_rewrite (task, g_steal_pointer (&local_error));
+	if (local_error == NULL) {
+		data->bytes_downloaded += download->bytes_downloaded;
+
+		G_LOCK (resource_cache);
+		if (resource_cache == NULL)
+			resource_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+		g_hash_table_replace (resource_cache, g_strdup (download->uri), g_strdup (download->cache_filename));
+		G_UNLOCK (resource_cache);
+	} else {
+		/* fail all the resources which use this download */
+		g_debug ("Failed to download resource ‘%s’: %s", download->uri, local_error->message);
+
+		for (guint i = 0; i < download->resource_indices->len; i++) {
+			guint idx = g_array_index (download->resource_indices, guint, i);
+
+			if (data->errors->pdata[idx] == NULL)
+				data->errors->pdata[idx] = g_error_copy (local_error);
+			g_clear_pointer (&data->rewritten_resources->pdata[idx], g_free);
+		}
+	}
+
+	/* carry on with the other downloads, unless cancelled */
+	if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		g_queue_clear (&data->pending_downloads);
+	else
+		start_resource_downloads (task);
+
+	if (data->n_running_downloads == 0)
+		finish_download_rewrite (task);
 }
 
-/* @error is (transfer full) if non-%NULL. */
 static void
-finish_download_rewrite (GTask  *task,
-                         GError *error)
+finish_download_rewrite (GTask *task)
 {
-	g_autoptr(GError) error_owned = g_steal_pointer (&error);
 	DownloadRewriteData *data = g_task_get_task_data (task);
 
-	g_assert (data->n_pending_downloads > 0);
-	data->n_pending_downloads--;
+	if (g_task_return_error_if_cancelled (task))
+		return;
 
-	if (data->saved_error == NULL)
-		data->saved_error = g_steal_pointer (&error_owned);
-	else if (error_owned != NULL)
-		g_debug ("Additional error while downloading resources: %s", error_owned->message);
+	g_task_return_pointer (task, g_ptr_array_ref (data->rewritten_resources), (GDestroyNotify) g_ptr_array_unref);
+}
 
-	if (data->n_pending_downloads == 0) {
-		if (data->saved_error != NULL)
-			g_task_return_error (task, g_steal_pointer (&data->saved_error));
-		else
-			g_task_return_pointer (task, g_string_free (g_steal_pointer (&data->rewritten_resource), FALSE), g_free);
-	}
+/**
+ * gs_download_rewrite_resources_finish:
+ * @result: a #GAsyncResult
+ * @out_bytes_downloaded: (out) (optional): return location for the number of
+ *   bytes downloaded, or %NULL
+ * @errors_out: (out) (optional) (transfer container) (element-type GError):
+ *   return location for the error for each resource which couldn’t be
+ *   rewritten, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish a download/rewrite operation started with
+ * gs_download_rewrite_resources_async().
+ *
+ * The returned array has an element for each of the resources passed in. If a
+ * resource couldn’t be rewritten, its element is %NULL, and the corresponding
+ * element of @errors_out is set; otherwise that element of @errors_out is
+ * %NULL.
+ *
+ * Returns: (transfer container) (element-type utf8): the rewritten CSS, or
+ *   %NULL if the operation was cancelled
+ * Since: 47
+ */
+GPtrArray *
+gs_download_rewrite_resources_finish (GAsyncResult  *result,
+                                      guint64       *out_bytes_downloaded,
+                                      GPtrArray    **errors_out,
+                                      GError       **error)
+{
+	DownloadRewriteData *data;
+	g_autoptr(GPtrArray) rewritten_resources = NULL;
+
+	g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+	g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gs_download_rewrite_resources_async, NULL);
+
+	data = g_task_get_task_data (G_TASK (result));
+
+	if (out_bytes_downloaded != NULL)
+		*out_bytes_downloaded = data->bytes_downloaded;
+	if (errors_out != NULL)
+		*errors_out = g_ptr_array_ref (data->errors);
+
+	rewritten_resources = g_task_propagate_pointer (G_TASK (result), error);
+	if (rewritten_resources == NULL && errors_out != NULL)
+		g_clear_pointer (errors_out, g_ptr_array_unref);
+
+	return g_steal_pointer (&rewritten_resources);
+}
+
+static void download_rewrite_resource_cb (GObject      *source_object,
+                                          GAsyncResult *result,
+                                          gpointer      user_data);
+
+/**
+ * gs_download_rewrite_resource_async:
+ * @resource: the CSS resource
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback
+ * @user_data: data to pass to @callback
+ *
+ * Downloads remote assets and rewrites a CSS resource to use cached local URIs.
+ *
+ * To rewrite several resources, use gs_download_rewrite_resources_async(),
+ * which shares downloads between them.
+ *
+ * Since: 45
+ **/
+void
+gs_download_rewrite_resource_async (const gchar         *resource,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	const gchar *resources[] = { resource, NULL };
+
+	g_return_if_fail (resource != NULL);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (NULL, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_download_rewrite_resource_async);
+
+	gs_download_rewrite_resources_async (NULL, resources, cancellable,
+					     download_rewrite_resource_cb, g_steal_pointer (&task));
+}
+
+static void
+download_rewrite_resource_cb (GObject      *source_object,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	g_autoptr(GPtrArray) rewritten_resources = NULL;
+	g_autoptr(GPtrArray) errors = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	rewritten_resources = gs_download_rewrite_resources_finish (result, NULL, &errors, &local_error);
+	if (rewritten_resources == NULL)
+		g_task_return_error (task, g_steal_pointer (&local_error));
+	else if (rewritten_resources->pdata[0] == NULL)
+		g_task_return_error (task, g_error_copy (errors->pdata[0]));
+	else
+		g_task_return_pointer (task, g_strdup (rewritten_resources->pdata[0]), g_free);
 }
 
 /**
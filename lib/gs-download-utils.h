@@ -91,5 +91,14 @@ void		 gs_download_rewrite_resource_async	(const gchar		*resource,
 							 gpointer		 user_data);
 gchar		*gs_download_rewrite_resource_finish	(GAsyncResult		 *result,
 							 GError			**error);
+void		 gs_download_rewrite_resources_async	(SoupSession		 *soup_session,
+							 const gchar * const	 *resources,
+							 GCancellable		 *cancellable,
+							 GAsyncReadyCallback	  callback,
+							 gpointer		  user_data);
+GPtrArray	*gs_download_rewrite_resources_finish	(GAsyncResult		 *result,
+							 guint64		 *out_bytes_downloaded,
+							 GPtrArray		**errors_out,
+							 GError			**error);
 
 G_END_DECLS
@@ -21,6 +21,10 @@
  * download using gs_icon_downloader_queue_app(). The actual download may
  * happen at any arbitrary time in the future.
  *
+ * Up to %MAX_PARALLEL_DOWNLOADS icons are downloaded at once, with icons for
+ * interactive requests started first. An icon which is used by several apps is
+ * only downloaded once.
+ *
  * Since: 44
  */
 
@@ -30,6 +34,41 @@
 #include "gs-remote-icon.h"
 #include "gs-worker-thread.h"
 
+/* Maximum number of icons to download at once. libsoup multiplexes these over
+ * one connection per host for HTTP/2 servers, and limits the number of
+ * connections per host itself for HTTP/1.1 ones. */
+#define MAX_PARALLEL_DOWNLOADS 8
+
+/* A download of one remote icon, which may be needed by several apps. */
+typedef struct {
+	GsIconDownloader *downloader;  /* (unowned) */
+	GPtrArray *icons;  /* (owned) (element-type GsRemoteIcon) (not nullable), all with the same URI */
+	GPtrArray *app_tasks;  /* (owned) (element-type GTask) (not nullable) */
+	gboolean interactive;
+	gboolean started;
+} IconDownload;
+
+static void
+icon_download_free (IconDownload *download)
+{
+	g_ptr_array_unref (download->icons);
+	g_ptr_array_unref (download->app_tasks);
+	g_free (download);
+}
+
+typedef struct {
+	GsApp *app;  /* (owned) (not nullable) */
+	gboolean interactive;
+	guint n_pending_icons;
+} AppData;
+
+static void
+app_data_free (AppData *data)
+{
+	g_clear_object (&data->app);
+	g_free (data);
+}
+
 struct _GsIconDownloader
 {
 	GObject 	 parent_instance;
@@ -39,6 +78,14 @@ struct _GsIconDownloader
 
 	GsWorkerThread	*worker; /* (owned) */
 	GCancellable	*cancellable; /* (owned) */
+	gboolean	 shutting_down;
+
+	/* These are only accessed from @worker. */
+	GHashTable	*downloads; /* (owned) (element-type utf8 IconDownload) */
+	GQueue		 pending_interactive; /* (element-type IconDownload) (unowned) */
+	GQueue		 pending_background; /* (element-type IconDownload) (unowned) */
+	guint		 n_downloads_in_flight;
+	GTask		*drain_task; /* (owned) (nullable) */
 };
 
 G_DEFINE_FINAL_TYPE (GsIconDownloader, gs_icon_downloader, G_TYPE_OBJECT)
@@ -60,6 +107,10 @@ gs_icon_downloader_finalize (GObject *object)
 	g_clear_object (&self->worker);
 	g_clear_object (&self->soup_session);
 
+	g_assert (self->n_downloads_in_flight == 0);
+	g_assert (self->drain_task == NULL);
+	g_clear_pointer (&self->downloads, g_hash_table_unref);
+
 	G_OBJECT_CLASS (gs_icon_downloader_parent_class)->finalize (object);
 }
 
@@ -147,6 +198,9 @@ static void
 gs_icon_downloader_init (GsIconDownloader *self)
 {
 	self->worker = gs_worker_thread_new ("gs-icon-downloader");
+	self->downloads = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) icon_download_free);
+	g_queue_init (&self->pending_interactive);
+	g_queue_init (&self->pending_background);
 }
 
 /**
@@ -169,10 +223,10 @@ gs_icon_downloader_new (SoupSession *soup_session,
 }
 
 
-static void download_remote_icons_of_the_app_cb (GTask        *task,
-                                                 gpointer      source_object,
-                                                 gpointer      task_data,
-                                                 GCancellable *cancellable);
+static void queue_remote_icons_of_the_app_cb (GTask        *task,
+                                              gpointer      source_object,
+                                              gpointer      task_data,
+                                              GCancellable *cancellable);
 
 static void app_remote_icons_download_finished (GObject      *source_object,
                                                 GAsyncResult *result,
@@ -196,6 +250,7 @@ gs_icon_downloader_queue_app (GsIconDownloader *self,
 	g_autoptr(GTask) task = NULL;
 	g_autoptr(GPtrArray) icons = NULL;
 	gboolean has_remote_icon = FALSE;
+	AppData *data;
 
 	g_return_if_fail (GS_IS_ICON_DOWNLOADER (self));
 	g_return_if_fail (GS_IS_APP (app));
@@ -216,67 +271,175 @@ gs_icon_downloader_queue_app (GsIconDownloader *self,
 
 	gs_app_set_icons_state (app, GS_APP_ICONS_STATE_PENDING_DOWNLOAD);
 
+	data = g_new0 (AppData, 1);
+	data->app = g_object_ref (app);
+	data->interactive = interactive;
+
 	task = g_task_new (self, self->cancellable, app_remote_icons_download_finished, NULL);
-	g_task_set_task_data (task, g_object_ref (app), g_object_unref);
+	g_task_set_task_data (task, data, (GDestroyNotify) app_data_free);
 	g_task_set_source_tag (task, gs_icon_downloader_queue_app);
 
 	gs_worker_thread_queue (self->worker, interactive ? G_PRIORITY_DEFAULT : G_PRIORITY_LOW,
-				download_remote_icons_of_the_app_cb, g_steal_pointer (&task));
+				queue_remote_icons_of_the_app_cb, g_steal_pointer (&task));
 }
 
-/* Run in @worker. */
+static void start_downloads (GsIconDownloader *self);
+
+/* Run in @worker. Adds the remote icons of the app to the download queues and
+ * returns; @task is completed once all of them have been downloaded. */
 static void
-download_remote_icons_of_the_app_cb (GTask        *task,
-                                     gpointer      source_object,
-                                     gpointer      task_data,
-                                     GCancellable *cancellable)
+queue_remote_icons_of_the_app_cb (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
 {
 	GsIconDownloader *self = GS_ICON_DOWNLOADER (source_object);
-	g_autoptr(GPtrArray) remote_icons = NULL;
+	AppData *data = task_data;
+	gboolean interactive = data->interactive;
 	g_autoptr(GPtrArray) icons = NULL;
-	GsApp *app;
 
 	g_assert (gs_worker_thread_is_in_worker_context (self->worker));
 
-	app = GS_APP (task_data);
-	icons = gs_app_dup_icons (app);
-	remote_icons = g_ptr_array_new_full (icons ? icons->len : 0, g_object_unref);
+	if (g_task_return_error_if_cancelled (task)) {
+		gs_app_set_icons_state (data->app, GS_APP_ICONS_STATE_AVAILABLE);
+		return;
+	}
+
+	icons = gs_app_dup_icons (data->app);
 
 	for (guint j = 0; icons && j < icons->len; j++) {
 		GObject *icon = g_ptr_array_index (icons, j);
+		const gchar *uri;
+		IconDownload *download;
+
+		if (!GS_IS_REMOTE_ICON (icon))
+			continue;
+
+		uri = gs_remote_icon_get_uri (GS_REMOTE_ICON (icon));
+		download = g_hash_table_lookup (self->downloads, uri);
+
+		if (download == NULL) {
+			download = g_new0 (IconDownload, 1);
+			download->downloader = self;
+			download->icons = g_ptr_array_new_with_free_func (g_object_unref);
+			download->app_tasks = g_ptr_array_new_with_free_func (g_object_unref);
+			download->interactive = interactive;
+			g_hash_table_insert (self->downloads, g_strdup (uri), download);
+
+			g_queue_push_tail (interactive ? &self->pending_interactive : &self->pending_background,
+					   download);
+		} else if (interactive && !download->interactive && !download->started) {
+			/* Bump it up the queue. */
+			g_queue_remove (&self->pending_background, download);
+			g_queue_push_tail (&self->pending_interactive, download);
+			download->interactive = TRUE;
+		}
 
-		if (GS_IS_REMOTE_ICON (icon))
-			g_ptr_array_add (remote_icons, g_object_ref (icon));
+		if (!g_ptr_array_find (download->icons, icon, NULL))
+			g_ptr_array_add (download->icons, g_object_ref (icon));
+		if (!g_ptr_array_find (download->app_tasks, task, NULL)) {
+			g_ptr_array_add (download->app_tasks, g_object_ref (task));
+			data->n_pending_icons++;
+		}
+	}
+
+	/* The icons may have changed since the app was queued. */
+	if (data->n_pending_icons == 0) {
+		gs_app_set_icons_state (data->app, GS_APP_ICONS_STATE_AVAILABLE);
+		g_task_return_boolean (task, TRUE);
+		return;
 	}
 
-	g_assert (remote_icons->len > 0);
+	g_debug ("Queued %u icons for app %s", data->n_pending_icons, gs_app_get_id (data->app));
 
-	g_debug ("Downloading %u icons for app %s", remote_icons->len, gs_app_get_id (app));
+	gs_app_set_icons_state (data->app, GS_APP_ICONS_STATE_DOWNLOADING);
 
-	gs_app_set_icons_state (app, GS_APP_ICONS_STATE_DOWNLOADING);
+	start_downloads (self);
+}
 
-	for (guint j = 0; j < remote_icons->len; j++) {
-		GObject *icon = g_ptr_array_index (remote_icons, j);
-		g_autoptr(GError) local_error = NULL;
+static void icon_download_cb (GObject      *source_object,
+                              GAsyncResult *result,
+                              gpointer      user_data);
 
-		gs_remote_icon_ensure_cached (GS_REMOTE_ICON (icon),
-					      self->soup_session,
-					      self->maximum_size_px,
-					      cancellable,
-					      &local_error);
+/* Run in @worker. Start queued downloads until the limit is reached. */
+static void
+start_downloads (GsIconDownloader *self)
+{
+	while (self->n_downloads_in_flight < MAX_PARALLEL_DOWNLOADS) {
+		IconDownload *download;
 
-		if (local_error)
-			g_debug ("Error downloading remote icon: %s", local_error->message);
+		download = g_queue_pop_head (&self->pending_interactive);
+		if (download == NULL)
+			download = g_queue_pop_head (&self->pending_background);
+		if (download == NULL)
+			break;
 
-		if (g_task_return_error_if_cancelled (task)) {
-			gs_app_set_icons_state (app, GS_APP_ICONS_STATE_AVAILABLE);
-			return;
-		}
+		download->started = TRUE;
+		self->n_downloads_in_flight++;
+
+		gs_remote_icon_ensure_cached_async (g_ptr_array_index (download->icons, 0),
+						    self->soup_session,
+						    self->maximum_size_px,
+						    download->interactive ? G_PRIORITY_DEFAULT : G_PRIORITY_LOW,
+						    self->cancellable,
+						    icon_download_cb,
+						    download);
 	}
+}
+
+static void maybe_finish_drain (GsIconDownloader *self);
+
+/* Run in @worker. */
+static void
+icon_download_cb (GObject      *source_object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+	GsRemoteIcon *icon = GS_REMOTE_ICON (source_object);
+	IconDownload *download = user_data;
+	g_autoptr(GsIconDownloader) self = g_object_ref (download->downloader);
+	g_autoptr(GError) local_error = NULL;
+	gpointer width, height;
+
+	if (!gs_remote_icon_ensure_cached_finish (icon, result, &local_error))
+		g_debug ("Error downloading remote icon: %s", local_error->message);
 
-	gs_app_set_icons_state (app, GS_APP_ICONS_STATE_AVAILABLE);
+	/* The other icons with the same URI share the cached file, so give
+	 * them the same dimensions. */
+	width = g_object_get_data (G_OBJECT (icon), "width");
+	height = g_object_get_data (G_OBJECT (icon), "height");
 
-	g_task_return_boolean (task, TRUE);
+	for (guint i = 1; i < download->icons->len; i++) {
+		GObject *other_icon = g_ptr_array_index (download->icons, i);
+
+		g_object_set_data (other_icon, "width", width);
+		g_object_set_data (other_icon, "height", height);
+	}
+
+	for (guint i = 0; i < download->app_tasks->len; i++) {
+		GTask *task = g_ptr_array_index (download->app_tasks, i);
+		AppData *data = g_task_get_task_data (task);
+
+		g_assert (data->n_pending_icons > 0);
+		data->n_pending_icons--;
+
+		if (data->n_pending_icons > 0)
+			continue;
+
+		gs_app_set_icons_state (data->app, GS_APP_ICONS_STATE_AVAILABLE);
+
+		if (!g_task_return_error_if_cancelled (task))
+			g_task_return_boolean (task, TRUE);
+	}
+
+	g_assert (self->n_downloads_in_flight > 0);
+	self->n_downloads_in_flight--;
+
+	/* Frees @download. */
+	g_hash_table_remove (self->downloads, gs_remote_icon_get_uri (icon));
+
+	start_downloads (self);
+	maybe_finish_drain (self);
 }
 
 static void
@@ -293,6 +456,38 @@ app_remote_icons_download_finished (GObject      *source_object,
 		g_warning ("Failed to download icons of one app: %s", error->message);
 }
 
+/* Run in @worker. Complete the pending shutdown, if there is one, once all
+ * the queued downloads have finished. */
+static void
+maybe_finish_drain (GsIconDownloader *self)
+{
+	if (self->drain_task == NULL ||
+	    self->n_downloads_in_flight > 0 ||
+	    g_hash_table_size (self->downloads) > 0)
+		return;
+
+	g_task_return_boolean (self->drain_task, TRUE);
+	g_clear_object (&self->drain_task);
+}
+
+/* Run in @worker. */
+static void
+drain_cb (GTask        *task,
+          gpointer      source_object,
+          gpointer      task_data,
+          GCancellable *cancellable)
+{
+	GsIconDownloader *self = GS_ICON_DOWNLOADER (source_object);
+
+	g_assert (self->drain_task == NULL);
+	self->drain_task = g_object_ref (task);
+
+	maybe_finish_drain (self);
+}
+
+static void drained_cb (GObject      *source_object,
+                        GAsyncResult *result,
+                        gpointer      user_data);
 static void shutdown_cb (GObject      *source_object,
                          GAsyncResult *result,
                          gpointer      user_data);
@@ -306,8 +501,8 @@ static void shutdown_cb (GObject      *source_object,
  *
  * Shut down the icon downloader.
  *
- * This will shut down the internal worker thread that @self uses to
- * queue app downloads.
+ * This will wait for the queued icon downloads to finish, and then shut down
+ * the internal worker thread that @self uses to queue app downloads.
  *
  * This is a no-op if called subsequently.
  *
@@ -320,6 +515,7 @@ gs_icon_downloader_shutdown_async (GsIconDownloader    *self,
                                    gpointer             user_data)
 {
 	g_autoptr(GTask) task = NULL;
+	g_autoptr(GTask) drain_task = NULL;
 
 	g_return_if_fail (GS_IS_ICON_DOWNLOADER (self));
 	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
@@ -327,6 +523,37 @@ gs_icon_downloader_shutdown_async (GsIconDownloader    *self,
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_icon_downloader_shutdown_async);
 
+	/* Already called? Shutting down the worker thread is a no-op then. */
+	if (self->shutting_down) {
+		gs_worker_thread_shutdown_async (self->worker, cancellable, shutdown_cb,
+						 g_steal_pointer (&task));
+		return;
+	}
+
+	self->shutting_down = TRUE;
+
+	/* Downloads in progress don’t block the worker thread’s queue, so
+	 * wait for them in the worker before shutting it down. The worker
+	 * thread has to be shut down from this thread, so @drain_task returns
+	 * here. */
+	drain_task = g_task_new (self, NULL, drained_cb, g_steal_pointer (&task));
+	g_task_set_source_tag (drain_task, drain_cb);
+
+	gs_worker_thread_queue (self->worker, G_PRIORITY_LOW, drain_cb, g_steal_pointer (&drain_task));
+}
+
+static void
+drained_cb (GObject      *source_object,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+	GsIconDownloader *self = GS_ICON_DOWNLOADER (source_object);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+
+	/* This can’t fail. */
+	g_task_propagate_boolean (G_TASK (result), NULL);
+
 	gs_worker_thread_shutdown_async (self->worker, cancellable, shutdown_cb,
 					 g_steal_pointer (&task));
 }
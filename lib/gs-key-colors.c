@@ -21,18 +21,32 @@
  * Key colors are RGB colors which represent an app, and they are derived from
  * the app’s icon, or manually specified as an override.
  *
- * Use gs_calculate_key_colors() to calculate the key colors from an app’s icon.
+ * Use gs_calculate_key_colors() to calculate the key colors from an app’s icon,
+ * or gs_calculate_key_colors_batch() to calculate them for many icons at once.
  *
  * Since: 40
  */
 
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 #include <gdk/gdk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
 #include "gs-key-colors.h"
+#include "gs-profiler.h"
+#include "gs-utils.h"
 
 /* Hard-code the number of clusters to split the icon color space into. This
  * gives the maximum number of key colors returned for an icon. This number has
@@ -56,13 +70,16 @@ typedef struct {
 	guint8 blue;
 } Pixel8;
 
+/* The pixels being clustered, stored one channel per array so that the
+ * clustering steps can process several pixels at once. Only pixels which are
+ * opaque enough to be clustered are stored. */
 typedef struct {
-	Pixel8 color;
-	union {
-		guint8 alpha;
-		guint8 cluster;
-	};
-} ClusterPixel8;
+	guint8 *red;
+	guint8 *green;
+	guint8 *blue;
+	guint8 *cluster;
+	gsize n_pixels;
+} ClusterPixels;
 
 typedef struct {
 	guint red;
@@ -89,7 +106,8 @@ color_distance (const Pixel8 *a,
 }
 
 /* NOTE: This has to return stable results when more than one cluster is
- * equidistant from the @pixel, or the k_means() function may not terminate. */
+ * equidistant from the @pixel, or the k_means() function may not terminate.
+ * The vectorised implementations below must pick the same cluster as this. */
 static inline gsize
 nearest_cluster (const Pixel8 *pixel,
                  const Pixel8 *cluster_centres,
@@ -109,6 +127,289 @@ nearest_cluster (const Pixel8 *pixel,
 	return nearest_cluster;
 }
 
+/* Update step: sum the colors in each cluster. @accumulators has @n_clusters
+ * elements, and must be zeroed by the caller. */
+static void
+accumulate_scalar (const ClusterPixels *pixels,
+                   gsize                start,
+                   CentroidAccumulator *accumulators)
+{
+	for (gsize i = start; i < pixels->n_pixels; i++) {
+		CentroidAccumulator *accumulator = &accumulators[pixels->cluster[i]];
+
+		accumulator->red += pixels->red[i];
+		accumulator->green += pixels->green[i];
+		accumulator->blue += pixels->blue[i];
+		accumulator->n_members++;
+	}
+}
+
+/* Assignment step: move each pixel to the cluster with the nearest centre.
+ * Returns the number of pixels whose cluster changed. */
+static guint
+assign_scalar (ClusterPixels *pixels,
+               gsize          start,
+               const Pixel8  *cluster_centres)
+{
+	guint n_assignments_changed = 0;
+
+	for (gsize i = start; i < pixels->n_pixels; i++) {
+		Pixel8 color = { pixels->red[i], pixels->green[i], pixels->blue[i] };
+		gsize new_cluster = nearest_cluster (&color, cluster_centres, n_clusters);
+
+		if (new_cluster != pixels->cluster[i])
+			n_assignments_changed++;
+		pixels->cluster[i] = new_cluster;
+	}
+
+	return n_assignments_changed;
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target ("sse2")))
+static void
+accumulate_sse2 (const ClusterPixels *pixels,
+                 gsize                start,
+                 CentroidAccumulator *accumulators)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	gsize i = start;
+
+	/* Mask out the pixels in each cluster and use the sum of absolute
+	 * differences against zero to add up 16 channel values at a time. */
+	for (gsize k = 0; k < n_clusters; k++) {
+		const __m128i k_vec = _mm_set1_epi8 (k);
+		__m128i red_sum = zero, green_sum = zero, blue_sum = zero;
+		guint n_members = 0;
+
+		for (i = start; i + 16 <= pixels->n_pixels; i += 16) {
+			__m128i mask = _mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *) &pixels->cluster[i]), k_vec);
+
+			red_sum = _mm_add_epi64 (red_sum, _mm_sad_epu8 (_mm_and_si128 (mask, _mm_loadu_si128 ((const __m128i *) &pixels->red[i])), zero));
+			green_sum = _mm_add_epi64 (green_sum, _mm_sad_epu8 (_mm_and_si128 (mask, _mm_loadu_si128 ((const __m128i *) &pixels->green[i])), zero));
+			blue_sum = _mm_add_epi64 (blue_sum, _mm_sad_epu8 (_mm_and_si128 (mask, _mm_loadu_si128 ((const __m128i *) &pixels->blue[i])), zero));
+			n_members += __builtin_popcount (_mm_movemask_epi8 (mask));
+		}
+
+		accumulators[k].red += _mm_cvtsi128_si32 (red_sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (red_sum, 8));
+		accumulators[k].green += _mm_cvtsi128_si32 (green_sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (green_sum, 8));
+		accumulators[k].blue += _mm_cvtsi128_si32 (blue_sum) + _mm_cvtsi128_si32 (_mm_srli_si128 (blue_sum, 8));
+		accumulators[k].n_members += n_members;
+	}
+
+	accumulate_scalar (pixels, i, accumulators);
+}
+
+__attribute__((target ("sse2")))
+static inline __m128i
+select_sse2 (__m128i mask,
+             __m128i if_true,
+             __m128i if_false)
+{
+	return _mm_or_si128 (_mm_and_si128 (mask, if_true), _mm_andnot_si128 (mask, if_false));
+}
+
+__attribute__((target ("sse2")))
+static guint
+assign_sse2 (ClusterPixels *pixels,
+             gsize          start,
+             const Pixel8  *cluster_centres)
+{
+	const __m128i zero = _mm_setzero_si128 ();
+	guint n_assignments_changed = 0;
+	gsize i;
+
+	/* Work on 8 pixels at a time, widening the channels to 16 bits so that
+	 * the squared differences can be computed and summed in pairs. */
+	for (i = start; i + 8 <= pixels->n_pixels; i += 8) {
+		__m128i red = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) &pixels->red[i]), zero);
+		__m128i green = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) &pixels->green[i]), zero);
+		__m128i blue = _mm_unpacklo_epi8 (_mm_loadl_epi64 ((const __m128i *) &pixels->blue[i]), zero);
+		__m128i best_lo = zero, best_hi = zero, cluster_lo = zero, cluster_hi = zero;
+		__m128i old_cluster, new_cluster;
+
+		for (gsize k = 0; k < n_clusters; k++) {
+			__m128i dr = _mm_sub_epi16 (red, _mm_set1_epi16 (cluster_centres[k].red));
+			__m128i dg = _mm_sub_epi16 (green, _mm_set1_epi16 (cluster_centres[k].green));
+			__m128i db = _mm_sub_epi16 (blue, _mm_set1_epi16 (cluster_centres[k].blue));
+			__m128i rg_lo = _mm_unpacklo_epi16 (dr, dg), rg_hi = _mm_unpackhi_epi16 (dr, dg);
+			__m128i b_lo = _mm_unpacklo_epi16 (db, zero), b_hi = _mm_unpackhi_epi16 (db, zero);
+			__m128i distance_lo = _mm_add_epi32 (_mm_madd_epi16 (rg_lo, rg_lo), _mm_madd_epi16 (b_lo, b_lo));
+			__m128i distance_hi = _mm_add_epi32 (_mm_madd_epi16 (rg_hi, rg_hi), _mm_madd_epi16 (b_hi, b_hi));
+
+			if (k == 0) {
+				best_lo = distance_lo;
+				best_hi = distance_hi;
+			} else {
+				/* strictly less than, so ties go to the lower cluster */
+				__m128i nearer_lo = _mm_cmplt_epi32 (distance_lo, best_lo);
+				__m128i nearer_hi = _mm_cmplt_epi32 (distance_hi, best_hi);
+				__m128i k_vec = _mm_set1_epi32 (k);
+
+				best_lo = select_sse2 (nearer_lo, distance_lo, best_lo);
+				best_hi = select_sse2 (nearer_hi, distance_hi, best_hi);
+				cluster_lo = select_sse2 (nearer_lo, k_vec, cluster_lo);
+				cluster_hi = select_sse2 (nearer_hi, k_vec, cluster_hi);
+			}
+		}
+
+		new_cluster = _mm_packus_epi16 (_mm_packs_epi32 (cluster_lo, cluster_hi), zero);
+		old_cluster = _mm_loadl_epi64 ((const __m128i *) &pixels->cluster[i]);
+		n_assignments_changed += 8 - __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (new_cluster, old_cluster)) & 0xff);
+		_mm_storel_epi64 ((__m128i *) &pixels->cluster[i], new_cluster);
+	}
+
+	return n_assignments_changed + assign_scalar (pixels, i, cluster_centres);
+}
+
+__attribute__((target ("avx2")))
+static void
+accumulate_avx2 (const ClusterPixels *pixels,
+                 gsize                start,
+                 CentroidAccumulator *accumulators)
+{
+	const __m256i zero = _mm256_setzero_si256 ();
+	gsize i = start;
+
+	/* As with accumulate_sse2(), but 32 pixels at a time. */
+	for (gsize k = 0; k < n_clusters; k++) {
+		const __m256i k_vec = _mm256_set1_epi8 (k);
+		__m256i red_sum = zero, green_sum = zero, blue_sum = zero;
+		guint n_members = 0;
+		guint64 sums[4];
+
+		for (i = start; i + 32 <= pixels->n_pixels; i += 32) {
+			__m256i mask = _mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i *) &pixels->cluster[i]), k_vec);
+
+			red_sum = _mm256_add_epi64 (red_sum, _mm256_sad_epu8 (_mm256_and_si256 (mask, _mm256_loadu_si256 ((const __m256i *) &pixels->red[i])), zero));
+			green_sum = _mm256_add_epi64 (green_sum, _mm256_sad_epu8 (_mm256_and_si256 (mask, _mm256_loadu_si256 ((const __m256i *) &pixels->green[i])), zero));
+			blue_sum = _mm256_add_epi64 (blue_sum, _mm256_sad_epu8 (_mm256_and_si256 (mask, _mm256_loadu_si256 ((const __m256i *) &pixels->blue[i])), zero));
+			n_members += __builtin_popcount ((guint) _mm256_movemask_epi8 (mask));
+		}
+
+		_mm256_storeu_si256 ((__m256i *) sums, red_sum);
+		accumulators[k].red += sums[0] + sums[1] + sums[2] + sums[3];
+		_mm256_storeu_si256 ((__m256i *) sums, green_sum);
+		accumulators[k].green += sums[0] + sums[1] + sums[2] + sums[3];
+		_mm256_storeu_si256 ((__m256i *) sums, blue_sum);
+		accumulators[k].blue += sums[0] + sums[1] + sums[2] + sums[3];
+		accumulators[k].n_members += n_members;
+	}
+
+	accumulate_scalar (pixels, i, accumulators);
+}
+
+__attribute__((target ("avx2")))
+static guint
+assign_avx2 (ClusterPixels *pixels,
+             gsize          start,
+             const Pixel8  *cluster_centres)
+{
+	guint n_assignments_changed = 0;
+	gsize i;
+
+	/* Work on 8 pixels at a time, widening the channels to 32 bits. */
+	for (i = start; i + 8 <= pixels->n_pixels; i += 8) {
+		__m256i red = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) &pixels->red[i]));
+		__m256i green = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) &pixels->green[i]));
+		__m256i blue = _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) &pixels->blue[i]));
+		__m256i best = _mm256_setzero_si256 (), cluster = _mm256_setzero_si256 ();
+		__m128i old_cluster, new_cluster;
+
+		for (gsize k = 0; k < n_clusters; k++) {
+			__m256i dr = _mm256_sub_epi32 (red, _mm256_set1_epi32 (cluster_centres[k].red));
+			__m256i dg = _mm256_sub_epi32 (green, _mm256_set1_epi32 (cluster_centres[k].green));
+			__m256i db = _mm256_sub_epi32 (blue, _mm256_set1_epi32 (cluster_centres[k].blue));
+			__m256i distance = _mm256_add_epi32 (_mm256_add_epi32 (_mm256_mullo_epi32 (dr, dr),
+									       _mm256_mullo_epi32 (dg, dg)),
+							     _mm256_mullo_epi32 (db, db));
+
+			if (k == 0) {
+				best = distance;
+			} else {
+				/* strictly less than, so ties go to the lower cluster */
+				__m256i nearer = _mm256_cmpgt_epi32 (best, distance);
+
+				best = _mm256_blendv_epi8 (best, distance, nearer);
+				cluster = _mm256_blendv_epi8 (cluster, _mm256_set1_epi32 (k), nearer);
+			}
+		}
+
+		new_cluster = _mm_packus_epi16 (_mm_packs_epi32 (_mm256_castsi256_si128 (cluster),
+								 _mm256_extracti128_si256 (cluster, 1)),
+						_mm_setzero_si128 ());
+		old_cluster = _mm_loadl_epi64 ((const __m128i *) &pixels->cluster[i]);
+		n_assignments_changed += 8 - __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (new_cluster, old_cluster)) & 0xff);
+		_mm_storel_epi64 ((__m128i *) &pixels->cluster[i], new_cluster);
+	}
+
+	return n_assignments_changed + assign_scalar (pixels, i, cluster_centres);
+}
+#endif  /* HAVE_X86_SIMD */
+
+typedef struct {
+	const gchar *name;
+	void (*accumulate) (const ClusterPixels *pixels,
+			    gsize                start,
+			    CentroidAccumulator *accumulators);
+	guint (*assign) (ClusterPixels *pixels,
+			 gsize          start,
+			 const Pixel8  *cluster_centres);
+} KMeansImpl;
+
+static const KMeansImpl k_means_impls[] = {
+#ifdef HAVE_X86_SIMD
+	{ "avx2", accumulate_avx2, assign_avx2 },
+	{ "sse2", accumulate_sse2, assign_sse2 },
+#endif
+	{ "scalar", accumulate_scalar, assign_scalar },
+};
+
+static gboolean
+k_means_impl_is_supported (const KMeansImpl *impl)
+{
+#ifdef HAVE_X86_SIMD
+	if (impl->accumulate == accumulate_avx2)
+		return __builtin_cpu_supports ("avx2");
+	if (impl->accumulate == accumulate_sse2)
+		return __builtin_cpu_supports ("sse2");
+#endif
+	return TRUE;
+}
+
+/* Choose the fastest implementation the CPU supports, unless one has been
+ * chosen using `GS_KEY_COLORS_IMPL`, for profiling. */
+static const KMeansImpl *
+get_k_means_impl (void)
+{
+	static gsize impl_once = 0;
+
+	if (g_once_init_enter (&impl_once)) {
+		const gchar *requested = g_getenv ("GS_KEY_COLORS_IMPL");
+		const KMeansImpl *impl = NULL;
+
+		for (gsize i = 0; i < G_N_ELEMENTS (k_means_impls); i++) {
+			if (!k_means_impl_is_supported (&k_means_impls[i]))
+				continue;
+			if (requested != NULL && g_strcmp0 (requested, k_means_impls[i].name) != 0)
+				continue;
+
+			impl = &k_means_impls[i];
+			break;
+		}
+
+		if (impl == NULL) {
+			g_warning ("Key colors implementation ‘%s’ is not supported", requested);
+			impl = &k_means_impls[G_N_ELEMENTS (k_means_impls) - 1];
+		}
+
+		g_debug ("Using %s implementation for key colors", impl->name);
+		g_once_init_leave (&impl_once, (gsize) impl);
+	}
+
+	return (const KMeansImpl *) impl_once;
+}
+
 /* A variant of g_random_int_range() which chooses without replacement,
  * tracking the used integers in @used_ints and @n_used_ints.
  * Once all integers in 0..max_ints have been used once, it will choose
@@ -161,16 +462,21 @@ random_int_range_no_replacement (guint max_ints,
  * Various other shortcuts have been taken which make this approach quite
  * specific to key color extraction from icons, with the aim of making it
  * faster. That’s fine — it doesn’t matter if the results this function produces
- * are optimal, only that they’re good enough. */
+ * are optimal, only that they’re good enough.
+ *
+ * The update and assignment steps are run by one of the #KMeansImpl
+ * implementations, which process several pixels at once where the CPU
+ * supports it. */
 static void
 k_means (GArray    *colors,
          GdkPixbuf *pb)
 {
+	const KMeansImpl *impl = get_k_means_impl ();
 	gint rowstride, n_channels;
 	gint width, height;
-	guint8 *raw_pixels;
-	ClusterPixel8 *pixels;
-	const ClusterPixel8 *pixels_end;
+	const guint8 *raw_pixels;
+	g_autofree guint8 *pixels_data = NULL;
+	ClusterPixels pixels;
 	Pixel8 cluster_centres[n_clusters];
 	CentroidAccumulator cluster_accumulators[n_clusters];
 	gboolean used_clusters[n_clusters];
@@ -181,7 +487,7 @@ k_means (GArray    *colors,
 
 	n_channels = gdk_pixbuf_get_n_channels (pb);
 	rowstride = gdk_pixbuf_get_rowstride (pb);
-	raw_pixels = gdk_pixbuf_get_pixels (pb);
+	raw_pixels = gdk_pixbuf_read_pixels (pb);
 	width = gdk_pixbuf_get_width (pb);
 	height = gdk_pixbuf_get_height (pb);
 
@@ -191,13 +497,13 @@ k_means (GArray    *colors,
 	g_assert (rowstride == width * n_channels);
 	g_assert (n_channels == 4);
 
-	pixels = (ClusterPixel8 *) raw_pixels;
-	pixels_end = &pixels[height * width];
-
 	memset (cluster_centres, 0, sizeof (cluster_centres));
 	memset (used_clusters, 0, sizeof (used_clusters));
 
-	/* Initialise the clusters using the Random Partition method: randomly
+	/* Split the pixels into channels, discarding the ones which are too
+	 * transparent to use.
+	 *
+	 * Initialise the clusters using the Random Partition method: randomly
 	 * assign a starting cluster to each pixel.
 	 *
 	 * The Forgy method (choosing random pixels as the starting cluster
@@ -205,11 +511,22 @@ k_means (GArray    *colors,
 	 * they aren’t transparent or duplicated colors mean that the
 	 * initialisation step may never complete. Consider the case of an icon
 	 * which is a block of solid color. */
-	for (ClusterPixel8 *p = pixels; p < pixels_end; p++) {
-		if (p->alpha < minimum_alpha)
-			p->cluster = G_N_ELEMENTS (cluster_centres);
-		else
-			p->cluster = random_int_range_no_replacement (G_N_ELEMENTS (cluster_centres), used_clusters, &n_used_clusters);
+	pixels_data = g_malloc (width * height * 4);
+	pixels.red = pixels_data;
+	pixels.green = pixels.red + width * height;
+	pixels.blue = pixels.green + width * height;
+	pixels.cluster = pixels.blue + width * height;
+	pixels.n_pixels = 0;
+
+	for (const guint8 *p = raw_pixels; p < raw_pixels + width * height * 4; p += 4) {
+		if (p[3] < minimum_alpha)
+			continue;
+
+		pixels.red[pixels.n_pixels] = p[0];
+		pixels.green[pixels.n_pixels] = p[1];
+		pixels.blue[pixels.n_pixels] = p[2];
+		pixels.cluster[pixels.n_pixels] = random_int_range_no_replacement (G_N_ELEMENTS (cluster_centres), used_clusters, &n_used_clusters);
+		pixels.n_pixels++;
 	}
 
 	/* Iterate until every cluster is relatively settled. This is determined
@@ -231,16 +548,7 @@ k_means (GArray    *colors,
 		/* Update step. Re-calculate the centroid of each cluster from
 		 * the colors which are in it. */
 		memset (cluster_accumulators, 0, sizeof (cluster_accumulators));
-
-		for (const ClusterPixel8 *p = pixels; p < pixels_end; p++) {
-			if (p->cluster >= G_N_ELEMENTS (cluster_centres))
-				continue;
-
-			cluster_accumulators[p->cluster].red += p->color.red;
-			cluster_accumulators[p->cluster].green += p->color.green;
-			cluster_accumulators[p->cluster].blue += p->color.blue;
-			cluster_accumulators[p->cluster].n_members++;
-		}
+		impl->accumulate (&pixels, 0, cluster_accumulators);
 
 		for (gsize i = 0; i < G_N_ELEMENTS (cluster_centres); i++) {
 			if (cluster_accumulators[i].n_members == 0)
@@ -252,18 +560,7 @@ k_means (GArray    *colors,
 		}
 
 		/* Update assignments of colors to clusters. */
-		n_assignments_changed = 0;
-		for (ClusterPixel8 *p = pixels; p < pixels_end; p++) {
-			gsize new_cluster;
-
-			if (p->cluster >= G_N_ELEMENTS (cluster_centres))
-				continue;
-
-			new_cluster = nearest_cluster (&p->color, cluster_centres, G_N_ELEMENTS (cluster_centres));
-			if (new_cluster != p->cluster)
-				n_assignments_changed++;
-			p->cluster = new_cluster;
-		}
+		n_assignments_changed = impl->assign (&pixels, 0, cluster_centres);
 
 		n_iterations++;
 	} while (n_assignments_changed > assignments_termination_limit && n_iterations < 50);
@@ -283,26 +580,198 @@ k_means (GArray    *colors,
 	}
 }
 
+/* Key colors are persisted in a text file in the user’s cache directory, with
+ * one line per icon, so they only ever need to be calculated once per icon:
+ * |[
+ * <SHA-1 checksum of the scaled icon pixels> RRGGBB RRGGBB RRGGBB
+ * ]|
+ * New lines are appended, so several processes can share the file. The
+ * header must be changed if the algorithm above changes its results; a file
+ * with a different header is replaced the next time an entry is added. */
+#define KEY_COLORS_CACHE_HEADER "# gnome-software key colors 1\n"
+
+G_LOCK_DEFINE_STATIC (key_colors_cache);
+static GHashTable *key_colors_cache = NULL;  /* (element-type utf8 GArray) (owned) (locked-by key_colors_cache) */
+static gboolean key_colors_cache_file_is_current = FALSE;  /* (locked-by key_colors_cache); whether new entries can be appended to the file */
+
+static gchar *
+key_colors_cache_get_filename (void)
+{
+	return gs_utils_get_cache_filename ("key-colors", "key-colors.txt",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE |
+					    GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					    NULL);
+}
+
+static void
+key_colors_cache_append_line (GString     *str,
+                              const gchar *checksum,
+                              GArray      *colors)
+{
+	g_string_append (str, checksum);
+	for (guint i = 0; i < colors->len; i++) {
+		const GdkRGBA *color = &g_array_index (colors, GdkRGBA, i);
+		g_string_append_printf (str, " %02x%02x%02x",
+					(guint) (color->red * 255.0 + 0.5),
+					(guint) (color->green * 255.0 + 0.5),
+					(guint) (color->blue * 255.0 + 0.5));
+	}
+	g_string_append_c (str, '\n');
+}
+
+/* Called with the key_colors_cache lock held. */
+static void
+key_colors_cache_ensure_loaded_locked (void)
+{
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *contents = NULL;
+	g_auto(GStrv) lines = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	if (key_colors_cache != NULL)
+		return;
+
+	key_colors_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+
+	filename = key_colors_cache_get_filename ();
+	if (filename == NULL)
+		return;
+	if (!g_file_get_contents (filename, &contents, NULL, &local_error)) {
+		/* an empty file is started when the first entry is added */
+		key_colors_cache_file_is_current = g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT);
+		return;
+	}
+	key_colors_cache_file_is_current = (*contents == '\0' ||
+					    g_str_has_prefix (contents, KEY_COLORS_CACHE_HEADER));
+	if (*contents == '\0' || !key_colors_cache_file_is_current)
+		return;
+
+	lines = g_strsplit (contents + strlen (KEY_COLORS_CACHE_HEADER), "\n", -1);
+	for (gsize i = 0; lines[i] != NULL; i++) {
+		g_auto(GStrv) fields = g_strsplit (lines[i], " ", -1);
+		g_autoptr(GArray) colors = NULL;
+		gsize n_fields = g_strv_length (fields);
+
+		/* ignore blank or truncated lines */
+		if (n_fields < 1 || strlen (fields[0]) != 40 || n_fields - 1 > n_clusters)
+			continue;
+
+		colors = g_array_sized_new (FALSE, FALSE, sizeof (GdkRGBA), n_fields - 1);
+		for (gsize j = 1; j < n_fields; j++) {
+			guint64 rgb;
+			GdkRGBA color;
+
+			if (strlen (fields[j]) != 6 ||
+			    !g_ascii_string_to_unsigned (fields[j], 16, 0, 0xffffff, &rgb, NULL))
+				break;
+
+			color.red = (gdouble) ((rgb >> 16) & 0xff) / 255.0;
+			color.green = (gdouble) ((rgb >> 8) & 0xff) / 255.0;
+			color.blue = (gdouble) (rgb & 0xff) / 255.0;
+			color.alpha = 1.0;
+			g_array_append_val (colors, color);
+		}
+
+		if (colors->len == n_fields - 1)
+			g_hash_table_replace (key_colors_cache, g_strdup (fields[0]), g_steal_pointer (&colors));
+	}
+}
+
+static GArray *
+key_colors_cache_lookup (const gchar *checksum)
+{
+	GArray *colors;
+
+	G_LOCK (key_colors_cache);
+	key_colors_cache_ensure_loaded_locked ();
+	colors = g_hash_table_lookup (key_colors_cache, checksum);
+	if (colors != NULL)
+		colors = g_array_copy (colors);
+	G_UNLOCK (key_colors_cache);
+
+	GS_PROFILER_COUNTER_ADD ((colors != NULL) ? GS_PROFILER_COUNTER_CACHE_HITS : GS_PROFILER_COUNTER_CACHE_MISSES, 1);
+
+	return colors;
+}
+
+static void
+key_colors_cache_add (const gchar *checksum,
+                      GArray      *colors)
+{
+	g_autofree gchar *filename = key_colors_cache_get_filename ();
+	g_autoptr(GString) line = g_string_new (NULL);
+	g_autoptr(GString) contents = NULL;
+	g_autoptr(GError) local_error = NULL;
+	struct stat st;
+	int fd;
+
+	key_colors_cache_append_line (line, checksum, colors);
+
+	G_LOCK (key_colors_cache);
+	key_colors_cache_ensure_loaded_locked ();
+	g_hash_table_replace (key_colors_cache, g_strdup (checksum), g_array_copy (colors));
+
+	/* if the file was written by a different version of the algorithm,
+	 * replace it with what’s been calculated by this one so far, rather
+	 * than appending to it */
+	if (filename != NULL && !key_colors_cache_file_is_current) {
+		GHashTableIter iter;
+		gpointer key, value;
+
+		contents = g_string_new (KEY_COLORS_CACHE_HEADER);
+		g_hash_table_iter_init (&iter, key_colors_cache);
+		while (g_hash_table_iter_next (&iter, &key, &value))
+			key_colors_cache_append_line (contents, key, value);
+		key_colors_cache_file_is_current = TRUE;
+	}
+	G_UNLOCK (key_colors_cache);
+
+	if (filename == NULL)
+		return;
+
+	if (contents != NULL) {
+		if (!g_file_set_contents (filename, contents->str, contents->len, &local_error))
+			g_debug ("Failed to write key colors cache ‘%s’: %s", filename, local_error->message);
+		return;
+	}
+
+	/* append the line with a single write(), so lines written by several
+	 * processes don’t get interleaved */
+	fd = g_open (filename, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return;
+	if (fstat (fd, &st) == 0 && st.st_size == 0)
+		g_string_prepend (line, KEY_COLORS_CACHE_HEADER);
+	if (write (fd, line->str, line->len) != (gssize) line->len)
+		g_debug ("Failed to write key colors cache ‘%s’: %s", filename, g_strerror (errno));
+	g_close (fd, NULL);
+}
+
 /**
- * gs_calculate_key_colors:
+ * gs_calculate_key_colors_full:
  * @pixbuf: an app icon to calculate key colors from
+ * @flags: flags affecting how the key colors are calculated
  *
- * Calculate the set of key colors present in @pixbuf. These are the colors
- * which stand out the most, and they are subjective. This function does not
- * guarantee to return perfect results, but should return workable results for
- * most icons.
+ * Calculate the set of key colors present in @pixbuf, as with
+ * gs_calculate_key_colors().
  *
- * @pixbuf will be scaled down to 32×32 pixels, so if it can be provided at
- * that resolution by the caller, this function will return faster.
+ * If %GS_KEY_COLORS_FLAGS_USE_CACHE is set, the key colors are looked up in,
+ * and saved to, a cache in the user’s cache directory, keyed by the checksum
+ * of the scaled icon. This makes the results stable for a given icon, and
+ * means they only need to be calculated once.
+ *
+ * This function is thread-safe.
  *
  * Returns: (transfer full) (element-type GdkRGBA): key colors for @pixbuf
- * Since: 40
+ * Since: 47
  */
 GArray *
-gs_calculate_key_colors (GdkPixbuf *pixbuf)
+gs_calculate_key_colors_full (GdkPixbuf        *pixbuf,
+                              GsKeyColorsFlags  flags)
 {
 	g_autoptr(GdkPixbuf) pb_small = NULL;
-	g_autoptr(GArray) colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
+	g_autoptr(GArray) colors = NULL;
+	g_autofree gchar *checksum = NULL;
 
 	/* people almost always use BILINEAR scaling with pixbufs, but we can
 	 * use NEAREST here since we only care about the rough colour data, not
@@ -310,15 +779,102 @@ gs_calculate_key_colors (GdkPixbuf *pixbuf)
 	 * NEAREST is twice as fast as BILINEAR */
 	pb_small = gdk_pixbuf_scale_simple (pixbuf, 32, 32, GDK_INTERP_NEAREST);
 
-	/* require an alpha channel for storing temporary values; most images
+	/* require an alpha channel, so all pixels are 4 bytes; most images
 	 * have one already, about 2% don’t */
 	if (gdk_pixbuf_get_n_channels (pixbuf) != 4) {
 		g_autoptr(GdkPixbuf) temp = g_steal_pointer (&pb_small);
 		pb_small = gdk_pixbuf_add_alpha (temp, FALSE, 0, 0, 0);
 	}
 
+	if (flags & GS_KEY_COLORS_FLAGS_USE_CACHE) {
+		checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+							gdk_pixbuf_read_pixels (pb_small),
+							gdk_pixbuf_get_byte_length (pb_small));
+		colors = key_colors_cache_lookup (checksum);
+		if (colors != NULL)
+			return g_steal_pointer (&colors);
+	}
+
 	/* get a list of key colors */
+	colors = g_array_new (FALSE, FALSE, sizeof (GdkRGBA));
 	k_means (colors, pb_small);
 
+	if (checksum != NULL)
+		key_colors_cache_add (checksum, colors);
+
 	return g_steal_pointer (&colors);
 }
+
+/**
+ * gs_calculate_key_colors:
+ * @pixbuf: an app icon to calculate key colors from
+ *
+ * Calculate the set of key colors present in @pixbuf. These are the colors
+ * which stand out the most, and they are subjective. This function does not
+ * guarantee to return perfect results, but should return workable results for
+ * most icons.
+ *
+ * @pixbuf will be scaled down to 32×32 pixels, so if it can be provided at
+ * that resolution by the caller, this function will return faster.
+ *
+ * Returns: (transfer full) (element-type GdkRGBA): key colors for @pixbuf
+ * Since: 40
+ */
+GArray *
+gs_calculate_key_colors (GdkPixbuf *pixbuf)
+{
+	return gs_calculate_key_colors_full (pixbuf, GS_KEY_COLORS_FLAGS_NONE);
+}
+
+typedef struct {
+	GPtrArray *pixbufs;  /* (element-type GdkPixbuf) (not owned) */
+	GPtrArray *results;  /* (element-type GArray) (not owned) */
+	GsKeyColorsFlags flags;
+	gint next_index;  /* (atomic) */
+} BatchData;
+
+static void
+batch_thread_cb (gpointer user_data)
+{
+	BatchData *data = user_data;
+	gint i;
+
+	while ((i = g_atomic_int_add (&data->next_index, 1)) < (gint) data->pixbufs->len)
+		data->results->pdata[i] = gs_calculate_key_colors_full (data->pixbufs->pdata[i], data->flags);
+}
+
+/**
+ * gs_calculate_key_colors_batch:
+ * @pixbufs: (element-type GdkPixbuf): app icons to calculate key colors from
+ * @flags: flags affecting how the key colors are calculated
+ *
+ * Calculate the key colors for each of @pixbufs, as with
+ * gs_calculate_key_colors_full(), spreading the work across the shared thread
+ * pool used by gs_utils_run_in_parallel().
+ *
+ * Returns: (transfer full) (element-type GArray): key colors for each of
+ *   @pixbufs, in the same order
+ * Since: 47
+ */
+GPtrArray *
+gs_calculate_key_colors_batch (GPtrArray        *pixbufs,
+                               GsKeyColorsFlags  flags)
+{
+	g_autoptr(GPtrArray) results = NULL;
+	BatchData data;
+
+	g_return_val_if_fail (pixbufs != NULL, NULL);
+
+	results = g_ptr_array_new_full (pixbufs->len, (GDestroyNotify) g_array_unref);
+	g_ptr_array_set_size (results, pixbufs->len);
+
+	data.pixbufs = pixbufs;
+	data.results = results;
+	data.flags = flags;
+	data.next_index = 0;
+
+	gs_utils_run_in_parallel (batch_thread_cb, &data,
+				  CLAMP (g_get_num_processors (), 1, MAX (pixbufs->len, 1)));
+
+	return g_steal_pointer (&results);
+}
@@ -22,6 +22,25 @@
 
 G_BEGIN_DECLS
 
-GArray	*gs_calculate_key_colors	(GdkPixbuf	*pixbuf);
+/**
+ * GsKeyColorsFlags:
+ * @GS_KEY_COLORS_FLAGS_NONE: No flags set.
+ * @GS_KEY_COLORS_FLAGS_USE_CACHE: Look up and save the key colors in the
+ *   persistent cache.
+ *
+ * Flags for gs_calculate_key_colors_full().
+ *
+ * Since: 47
+ */
+typedef enum {
+	GS_KEY_COLORS_FLAGS_NONE = 0,
+	GS_KEY_COLORS_FLAGS_USE_CACHE = 1 << 0,
+} GsKeyColorsFlags;
+
+GArray		*gs_calculate_key_colors	(GdkPixbuf		*pixbuf);
+GArray		*gs_calculate_key_colors_full	(GdkPixbuf		*pixbuf,
+						 GsKeyColorsFlags	 flags);
+GPtrArray	*gs_calculate_key_colors_batch	(GPtrArray		*pixbufs,
+						 GsKeyColorsFlags	 flags);
 
 G_END_DECLS
@@ -31,9 +31,11 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <glib.h>
 #include <glib-object.h>
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 #include <gnome-software.h>
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
@@ -43,23 +45,43 @@
 
 G_DEFINE_QUARK (gs-odrs-provider-error-quark, gs_odrs_provider_error)
 
-/* Element in self->ratings, all allocated in one big block and sorted
- * alphabetically to reduce the number of allocations and fragmentation. */
+/* The downloaded ratings.json is converted once into a binary index, which is
+ * saved next to it as ratings.bin and is then mapped and searched in place,
+ * rather than parsing the JSON each time the ratings are loaded.
+ *
+ * The index is a #GsOdrsRatingsHeader, followed by @n_ratings
+ * #GsOdrsRatingRecords sorted by app ID, followed by a table of nul-terminated
+ * app IDs which is @strings_size bytes long. All integers are little-endian.
+ * @source_mtime and @source_size are from the JSON file the index was built
+ * from, so that a stale index can be detected. */
+#define GS_ODRS_RATINGS_INDEX_MAGIC "GSODRS01"
+
+typedef struct {
+	gchar magic[8];
+	guint64 source_mtime;
+	guint64 source_size;
+	guint32 n_ratings;
+	guint32 strings_size;
+} GsOdrsRatingsHeader;
+
+typedef struct {
+	guint32 app_id_offset;  /* into the string table */
+	guint32 n_star_ratings[6];
+} GsOdrsRatingRecord;
+
+G_STATIC_ASSERT (sizeof (GsOdrsRatingsHeader) == 32);
+G_STATIC_ASSERT (sizeof (GsOdrsRatingRecord) == 28);
+
+/* Used while building the index from the JSON. */
 typedef struct {
-	gchar *app_id;  /* (owned) */
+	const gchar *app_id;  /* (unowned) */
 	guint32 n_star_ratings[6];
 } GsOdrsRating;
 
 static int
 rating_compare (const GsOdrsRating *a, const GsOdrsRating *b)
 {
-	return g_strcmp0 (a->app_id, b->app_id);
-}
-
-static void
-rating_clear (GsOdrsRating *rating)
-{
-	g_free (rating->app_id);
+	return strcmp (a->app_id, b->app_id);
 }
 
 struct _GsOdrsProvider
@@ -69,8 +91,12 @@ struct _GsOdrsProvider
 	gchar		*distro;  /* (not nullable) (owned) */
 	gchar		*user_hash;  /* (not nullable) (owned) */
 	gchar		*review_server;  /* (not nullable) (owned) */
-	GArray		*ratings;  /* (element-type GsOdrsRating) (mutex ratings_mutex) (owned) (nullable) */
+	/* The current ratings index is an immutable snapshot. Readers take a
+	 * ref on it and then read it without locking, so when it’s replaced
+	 * the old one is freed once the last reader has finished with it. */
+	GBytes		*ratings;  /* (mutex ratings_mutex) (owned) (nullable); a ratings index */
 	GMutex		 ratings_mutex;
+	gsize		 ratings_loaded_once;
 	guint64		 max_cache_age_secs;
 	guint		 n_results_max;
 	SoupSession	*session;  /* (owned) (not nullable) */
@@ -104,15 +130,16 @@ gs_odrs_provider_load_ratings_for_app (JsonObject   *json_app,
 		rating_out->n_star_ratings[i] = (guint64) json_object_get_int_member (json_app, names[i]);
 	}
 
-	rating_out->app_id = g_strdup (app_id);
+	rating_out->app_id = app_id;
 
 	return TRUE;
 }
 
-static gboolean
-gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
-                               const gchar     *filename,
-                               GError         **error)
+/* Builds a ratings index (see #GsOdrsRatingsHeader) from the JSON in @filename. */
+static GBytes *
+gs_odrs_provider_build_ratings_index (const gchar      *filename,
+                                      const GStatBuf   *source_stat,
+                                      GError          **error)
 {
 	JsonNode *json_root;
 	JsonObject *json_item;
@@ -120,8 +147,10 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 	const gchar *app_id;
 	JsonNode *json_app_node;
 	JsonObjectIter iter;
-	g_autoptr(GArray) new_ratings = NULL;
-	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GArray) ratings = NULL;
+	g_autoptr(GByteArray) index = NULL;
+	g_autoptr(GString) strings = NULL;
+	GsOdrsRatingsHeader header = { { 0, }, 0, };
 	g_autoptr(GError) local_error = NULL;
 
 	/* parse the data and find the success */
@@ -131,7 +160,7 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 			     GS_ODRS_PROVIDER_ERROR,
 			     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
 			     "Error parsing ODRS data: %s", local_error->message);
-		return FALSE;
+		return NULL;
 	}
 	json_root = json_parser_get_root (json_parser);
 	if (json_root == NULL) {
@@ -139,23 +168,22 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 				     GS_ODRS_PROVIDER_ERROR,
 				     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
 				     "no ratings root");
-		return FALSE;
+		return NULL;
 	}
 	if (json_node_get_node_type (json_root) != JSON_NODE_OBJECT) {
 		g_set_error_literal (error,
 				     GS_ODRS_PROVIDER_ERROR,
 				     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
 				     "no ratings array");
-		return FALSE;
+		return NULL;
 	}
 
 	json_item = json_node_get_object (json_root);
 
-	new_ratings = g_array_sized_new (FALSE,  /* don’t zero-terminate */
-					 FALSE,  /* don’t clear */
-					 sizeof (GsOdrsRating),
-					 json_object_get_size (json_item));
-	g_array_set_clear_func (new_ratings, (GDestroyNotify) rating_clear);
+	ratings = g_array_sized_new (FALSE,  /* don’t zero-terminate */
+				     FALSE,  /* don’t clear */
+				     sizeof (GsOdrsRating),
+				     json_object_get_size (json_item));
 
 	/* parse each app */
 	json_object_iter_init (&iter, json_item);
@@ -168,20 +196,202 @@ gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
 		json_app = json_node_get_object (json_app_node);
 
 		if (gs_odrs_provider_load_ratings_for_app (json_app, app_id, &rating))
-			g_array_append_val (new_ratings, rating);
+			g_array_append_val (ratings, rating);
 	}
 
 	/* Allow for binary searches later. */
-	g_array_sort (new_ratings, (GCompareFunc) rating_compare);
+	g_array_sort (ratings, (GCompareFunc) rating_compare);
+
+	/* Lay out the records, followed by the string table */
+	index = g_byte_array_sized_new (sizeof (header) + ratings->len * sizeof (GsOdrsRatingRecord));
+	g_byte_array_set_size (index, sizeof (header));
+	strings = g_string_new (NULL);
+	for (guint i = 0; i < ratings->len; i++) {
+		const GsOdrsRating *rating = &g_array_index (ratings, GsOdrsRating, i);
+		GsOdrsRatingRecord record;
+
+		record.app_id_offset = GUINT32_TO_LE (strings->len);
+		for (guint j = 0; j < G_N_ELEMENTS (record.n_star_ratings); j++)
+			record.n_star_ratings[j] = GUINT32_TO_LE (rating->n_star_ratings[j]);
+		g_byte_array_append (index, (const guint8 *) &record, sizeof (record));
+		g_string_append_len (strings, rating->app_id, strlen (rating->app_id) + 1);
+	}
+	g_byte_array_append (index, (const guint8 *) strings->str, strings->len);
+
+	memcpy (header.magic, GS_ODRS_RATINGS_INDEX_MAGIC, sizeof (header.magic));
+	header.source_mtime = GUINT64_TO_LE ((guint64) source_stat->st_mtime);
+	header.source_size = GUINT64_TO_LE ((guint64) source_stat->st_size);
+	header.n_ratings = GUINT32_TO_LE (ratings->len);
+	header.strings_size = GUINT32_TO_LE (strings->len);
+	memcpy (index->data, &header, sizeof (header));
+
+	return g_byte_array_free_to_bytes (g_steal_pointer (&index));
+}
+
+/* Checks the structure of a ratings index, and whether it was built from the
+ * file described by @source_stat. The records are not checked here, so that
+ * loading stays cheap; gs_odrs_provider_ratings_index_lookup() bounds checks
+ * them as it goes. */
+static gboolean
+gs_odrs_provider_ratings_index_validate (GBytes         *index,
+                                         const GStatBuf *source_stat)
+{
+	gsize size;
+	const guint8 *data = g_bytes_get_data (index, &size);
+	const GsOdrsRatingsHeader *header = (const GsOdrsRatingsHeader *) data;
+	guint64 n_ratings, strings_size;
 
-	/* Update the shared state */
-	locker = g_mutex_locker_new (&self->ratings_mutex);
-	g_clear_pointer (&self->ratings, g_array_unref);
+	if (size < sizeof (*header) ||
+	    memcmp (header->magic, GS_ODRS_RATINGS_INDEX_MAGIC, sizeof (header->magic)) != 0)
+		return FALSE;
+	if (GUINT64_FROM_LE (header->source_mtime) != (guint64) source_stat->st_mtime ||
+	    GUINT64_FROM_LE (header->source_size) != (guint64) source_stat->st_size)
+		return FALSE;
+
+	n_ratings = GUINT32_FROM_LE (header->n_ratings);
+	strings_size = GUINT32_FROM_LE (header->strings_size);
+	if (size != sizeof (*header) + n_ratings * sizeof (GsOdrsRatingRecord) + strings_size)
+		return FALSE;
+
+	/* the string table must be nul-terminated so lookups can’t overrun it */
+	return (strings_size == 0 || data[size - 1] == '\0');
+}
+
+static const GsOdrsRatingRecord *
+gs_odrs_provider_ratings_index_lookup (GBytes      *index,
+                                       const gchar *app_id)
+{
+	const guint8 *data = g_bytes_get_data (index, NULL);
+	const GsOdrsRatingsHeader *header = (const GsOdrsRatingsHeader *) data;
+	const GsOdrsRatingRecord *records = (const GsOdrsRatingRecord *) (data + sizeof (*header));
+	guint32 n_ratings = GUINT32_FROM_LE (header->n_ratings);
+	guint32 strings_size = GUINT32_FROM_LE (header->strings_size);
+	const gchar *strings = (const gchar *) (records + n_ratings);
+	guint32 lower = 0;
+	guint32 upper = n_ratings;
+
+	while (lower < upper) {
+		guint32 mid = lower + (upper - lower) / 2;
+		guint32 offset = GUINT32_FROM_LE (records[mid].app_id_offset);
+		int cmp;
+
+		if (offset >= strings_size)
+			return NULL;
+
+		cmp = strcmp (app_id, strings + offset);
+		if (cmp == 0)
+			return &records[mid];
+		else if (cmp < 0)
+			upper = mid;
+		else
+			lower = mid + 1;
+	}
+
+	return NULL;
+}
+
+static gboolean
+gs_odrs_provider_load_ratings (GsOdrsProvider  *self,
+                               const gchar     *filename,
+                               GError         **error)
+{
+	GStatBuf source_stat;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *index_filename = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GBytes) new_ratings = NULL;
+	g_autoptr(GBytes) old_ratings = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	if (g_stat (filename, &source_stat) != 0) {
+		int errsv = errno;
+		g_set_error (error,
+			     GS_ODRS_PROVIDER_ERROR,
+			     GS_ODRS_PROVIDER_ERROR_PARSING_DATA,
+			     "Error parsing ODRS data: %s", g_strerror (errsv));
+		return FALSE;
+	}
+
+	/* use the binary index if it’s up to date */
+	dirname = g_path_get_dirname (filename);
+	index_filename = g_build_filename (dirname, "ratings.bin", NULL);
+	mapped_file = g_mapped_file_new (index_filename, FALSE, NULL);
+	if (mapped_file != NULL) {
+		new_ratings = g_mapped_file_get_bytes (mapped_file);
+		if (!gs_odrs_provider_ratings_index_validate (new_ratings, &source_stat)) {
+			g_debug ("Ignoring out of date ODRS ratings index ‘%s’", index_filename);
+			g_clear_pointer (&new_ratings, g_bytes_unref);
+		}
+	}
+
+	/* otherwise rebuild it from the JSON; the index is still usable from
+	 * memory if it can’t be saved */
+	if (new_ratings == NULL) {
+		new_ratings = gs_odrs_provider_build_ratings_index (filename, &source_stat, error);
+		if (new_ratings == NULL)
+			return FALSE;
+
+		if (!g_file_set_contents (index_filename,
+					  g_bytes_get_data (new_ratings, NULL),
+					  g_bytes_get_size (new_ratings),
+					  &local_error))
+			g_debug ("Failed to save ODRS ratings index ‘%s’: %s",
+				 index_filename, local_error->message);
+	}
+
+	/* Publish the new snapshot; the old one is freed once nothing is
+	 * reading it any more */
+	g_mutex_lock (&self->ratings_mutex);
+	old_ratings = g_steal_pointer (&self->ratings);
 	self->ratings = g_steal_pointer (&new_ratings);
+	g_mutex_unlock (&self->ratings_mutex);
 
 	return TRUE;
 }
 
+static GBytes *
+gs_odrs_provider_dup_current_ratings (GsOdrsProvider *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->ratings_mutex);
+
+	return (self->ratings != NULL) ? g_bytes_ref (self->ratings) : NULL;
+}
+
+/* Returns a ref on the current ratings index, loading it from the local cache
+ * the first time it’s needed, if it’s not already been loaded by a refresh.
+ * Concurrent callers wait for that load rather than repeating it. */
+static GBytes *
+gs_odrs_provider_dup_ratings (GsOdrsProvider *self)
+{
+	GBytes *ratings = gs_odrs_provider_dup_current_ratings (self);
+
+	if (ratings != NULL)
+		return ratings;
+
+	if (g_once_init_enter (&self->ratings_loaded_once)) {
+		g_autofree gchar *cache_filename = NULL;
+
+		/* Load from the local cache, if available, when in offline or
+		   when refresh/download disabled on start */
+		cache_filename = gs_utils_get_cache_filename ("odrs",
+							      "ratings.json",
+							      GS_UTILS_CACHE_FLAG_WRITEABLE |
+							      GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+							      NULL);
+
+		if (cache_filename != NULL &&
+		    !gs_odrs_provider_load_ratings (self, cache_filename, NULL)) {
+			g_autoptr(GFile) cache_file = g_file_new_for_path (cache_filename);
+			g_debug ("Failed to load cache file ‘%s’, deleting it", cache_filename);
+			g_file_delete (cache_file, NULL, NULL);
+		}
+
+		g_once_init_leave (&self->ratings_loaded_once, 1);
+	}
+
+	return gs_odrs_provider_dup_current_ratings (self);
+}
+
 static AsReview *
 gs_odrs_provider_parse_review_object (JsonObject *item)
 {
@@ -556,8 +766,11 @@ _gs_app_get_reviewable_ids (GsApp *app)
 	return ids;
 }
 
+/* @ratings is the snapshot of the ratings index taken for the whole refine,
+ * so refining each app doesn’t have to look it up again. */
 static gboolean
 gs_odrs_provider_refine_ratings (GsOdrsProvider  *self,
+                                 GBytes          *ratings,
                                  GsApp           *app,
                                  GCancellable    *cancellable,
                                  GError         **error)
@@ -567,65 +780,29 @@ gs_odrs_provider_refine_ratings (GsOdrsProvider  *self,
 	guint cnt = 0;
 	g_autoptr(GArray) review_ratings = NULL;
 	g_autoptr(GPtrArray) reviewable_ids = NULL;
-	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (ratings == NULL)
+		return TRUE;
 
 	/* get ratings for each reviewable ID */
 	reviewable_ids = _gs_app_get_reviewable_ids (app);
 
-	locker = g_mutex_locker_new (&self->ratings_mutex);
-
-	if (!self->ratings) {
-		g_autofree gchar *cache_filename = NULL;
-
-		g_clear_pointer (&locker, g_mutex_locker_free);
-
-		/* Load from the local cache, if available, when in offline or
-		   when refresh/download disabled on start */
-		cache_filename = gs_utils_get_cache_filename ("odrs",
-							      "ratings.json",
-							      GS_UTILS_CACHE_FLAG_WRITEABLE |
-							      GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
-							      error);
-
-		if (!cache_filename)
-			return TRUE;
-
-		if (!gs_odrs_provider_load_ratings (self, cache_filename, NULL)) {
-			g_autoptr(GFile) cache_file = g_file_new_for_path (cache_filename);
-			g_debug ("Failed to load cache file ‘%s’, deleting it", cache_filename);
-			g_file_delete (cache_file, NULL, NULL);
-			return TRUE;
-		}
-
-		locker = g_mutex_locker_new (&self->ratings_mutex);
-
-		if (!self->ratings)
-			return TRUE;
-	}
-
 	for (guint i = 0; i < reviewable_ids->len; i++) {
 		const gchar *id = g_ptr_array_index (reviewable_ids, i);
-		const GsOdrsRating search_rating = { (gchar *) id, { 0, }};
-		guint found_index;
-		const GsOdrsRating *found_rating;
+		const GsOdrsRatingRecord *found_rating;
 
-		if (!g_array_binary_search (self->ratings, &search_rating,
-					    (GCompareFunc) rating_compare, &found_index))
+		found_rating = gs_odrs_provider_ratings_index_lookup (ratings, id);
+		if (found_rating == NULL)
 			continue;
 
-		found_rating = &g_array_index (self->ratings, GsOdrsRating, found_index);
-
 		/* copy into accumulator array */
 		for (guint j = 0; j < 6; j++)
-			ratings_raw[j] += found_rating->n_star_ratings[j];
+			ratings_raw[j] += GUINT32_FROM_LE (found_rating->n_star_ratings[j]);
 		cnt++;
 	}
 	if (cnt == 0)
 		return TRUE;
 
-	/* Done with self->ratings now */
-	g_clear_pointer (&locker, g_mutex_locker_free);
-
 	/* merge to accumulator array back to one GArray blob */
 	review_ratings = g_array_sized_new (FALSE, TRUE, sizeof(guint32), 6);
 	for (guint i = 0; i < 6; i++)
@@ -1184,7 +1361,7 @@ gs_odrs_provider_finalize (GObject *object)
 	g_free (self->user_hash);
 	g_free (self->distro);
 	g_free (self->review_server);
-	g_clear_pointer (&self->ratings, g_array_unref);
+	g_clear_pointer (&self->ratings, g_bytes_unref);
 	g_mutex_clear (&self->ratings_mutex);
 
 	G_OBJECT_CLASS (gs_odrs_provider_parent_class)->finalize (object);
@@ -1470,6 +1647,7 @@ typedef struct {
 	/* Input data. */
 	GsAppList *list;  /* (owned) (not nullable) */
 	GsOdrsProviderRefineFlags flags;
+	GBytes *ratings;  /* (owned) (nullable); snapshot of the ratings index */
 
 	/* In-progress data. */
 	guint n_pending_ops;
@@ -1482,6 +1660,7 @@ refine_data_free (RefineData *data)
 	g_assert (data->n_pending_ops == 0);
 
 	g_clear_object (&data->list);
+	g_clear_pointer (&data->ratings, g_bytes_unref);
 	g_clear_error (&data->error);
 
 	g_free (data);
@@ -1529,6 +1708,10 @@ gs_odrs_provider_refine_async (GsOdrsProvider            *self,
 		return;
 	}
 
+	/* take one snapshot of the ratings for all the apps */
+	if (flags & GS_ODRS_PROVIDER_REFINE_FLAGS_GET_RATINGS)
+		data_unowned->ratings = gs_odrs_provider_dup_ratings (self);
+
 	/* Mark one operation as pending while all the operations are started,
 	 * so the overall operation can’t complete while things are still being
 	 * started. */
@@ -1557,12 +1740,13 @@ refine_app_op (GsOdrsProvider            *self,
                GsOdrsProviderRefineFlags  flags,
                GCancellable              *cancellable)
 {
+	RefineData *data = g_task_get_task_data (task);
 	g_autoptr(GError) local_error = NULL;
 
 	/* add ratings if possible */
 	if ((flags & GS_ODRS_PROVIDER_REFINE_FLAGS_GET_RATINGS) &&
 	    gs_app_get_review_ratings (app) == NULL) {
-		if (!gs_odrs_provider_refine_ratings (self, app, cancellable, &local_error)) {
+		if (!gs_odrs_provider_refine_ratings (self, data->ratings, app, cancellable, &local_error)) {
 			if (g_error_matches (local_error, GS_ODRS_PROVIDER_ERROR, GS_ODRS_PROVIDER_ERROR_NO_NETWORK)) {
 				g_debug ("failed to refine app %s: %s",
 					 gs_app_get_unique_id (app), local_error->message);
@@ -29,6 +29,7 @@
 #include "gs-plugin-job-cancel-offline-update.h"
 #include "gs-plugin-job-private.h"
 #include "gs-plugin-types.h"
+#include "gs-profiler.h"
 
 struct _GsPluginJobCancelOfflineUpdate
 {
@@ -41,6 +42,7 @@ struct _GsPluginJobCancelOfflineUpdate
 	GError *saved_error;  /* (owned) (nullable) */
 	guint n_pending_ops;
 	gboolean did_refine;
+	gint64 begin_time_nsec;
 };
 
 G_DEFINE_TYPE (GsPluginJobCancelOfflineUpdate, gs_plugin_job_cancel_offline_update, GS_TYPE_PLUGIN_JOB)
@@ -128,6 +130,7 @@ gs_plugin_job_cancel_offline_update_run_async (GsPluginJob         *job,
 	 * initialised to 1 until all the operations are started */
 	self->n_pending_ops = 1;
 	plugins = gs_plugin_loader_get_plugins (plugin_loader);
+	self->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
 
 	for (guint i = 0; i < plugins->len; i++) {
 		GsPlugin *plugin = g_ptr_array_index (plugins, i);
@@ -164,12 +167,20 @@ plugin_func_cb (GObject      *source_object,
 	GsPlugin *plugin = GS_PLUGIN (source_object);
 	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
 	g_autoptr(GTask) task = G_TASK (user_data);
+	GsPluginJobCancelOfflineUpdate *self G_GNUC_UNUSED = g_task_get_source_object (task);
 	gboolean success;
 	g_autoptr(GError) local_error = NULL;
 
 	success = plugin_class->cancel_offline_update_finish (plugin, result, &local_error);
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	GS_PROFILER_ADD_MARK_TAKE (PluginJobCancelOfflineUpdate,
+				   self->begin_time_nsec,
+				   g_strdup_printf ("%s:%s",
+						    G_OBJECT_TYPE_NAME (self),
+						    gs_plugin_get_name (plugin)),
+				   NULL);
+
 	g_assert (success || local_error != NULL);
 
 	finish_op (task, g_steal_pointer (&local_error));
@@ -27,6 +27,13 @@
  * Retrieve the resulting #GsAppList using
  * gs_plugin_job_list_apps_get_result_list().
  *
+ * If #GsPluginJobListApps::partial-results is connected to before the job is
+ * run, the results from each plugin are refined as soon as that plugin has
+ * returned them, and the results gathered so far are emitted, so that callers
+ * can show them without waiting for the slowest plugin. Only one of these
+ * refines runs at a time; results which arrive while it is running are
+ * queued and refined together once it finishes.
+ *
  * See also: #GsPluginClass.list_apps_async
  * Since: 43
  */
@@ -61,6 +68,10 @@ struct _GsPluginJobListApps
 	GsAppList *merged_list;  /* (owned) (nullable) */
 	GError *saved_error;  /* (owned) (nullable) */
 	guint n_pending_ops;
+	GsPluginRefineFlags refine_flags;
+	gboolean stream_results;
+	GsAppList *refine_queue;  /* (owned) (nullable) */
+	gboolean refine_running;
 
 	/* Results. */
 	GsAppList *result_list;  /* (owned) (nullable) */
@@ -79,6 +90,12 @@ typedef enum {
 
 static GParamSpec *props[PROP_FLAGS + 1] = { NULL, };
 
+typedef enum {
+	SIGNAL_PARTIAL_RESULTS,
+} GsPluginJobListAppsSignal;
+
+static guint signals[SIGNAL_PARTIAL_RESULTS + 1] = { 0, };
+
 static void
 gs_plugin_job_list_apps_dispose (GObject *object)
 {
@@ -87,6 +104,7 @@ gs_plugin_job_list_apps_dispose (GObject *object)
 	g_assert (self->merged_list == NULL);
 	g_assert (self->saved_error == NULL);
 	g_assert (self->n_pending_ops == 0);
+	g_assert (self->refine_queue == NULL);
 
 	g_clear_object (&self->result_list);
 	g_clear_object (&self->query);
@@ -243,8 +261,14 @@ static void finish_op (GTask  *task,
 static void refine_cb (GObject      *source_object,
                        GAsyncResult *result,
                        gpointer      user_data);
+static void plugin_refine_cb (GObject      *source_object,
+                              GAsyncResult *result,
+                              gpointer      user_data);
 static void finish_task (GTask     *task,
                          GsAppList *merged_list);
+static void filter_and_sort_list (GsPluginJobListApps *self,
+                                  GsPluginLoader      *plugin_loader,
+                                  GsAppList           *list);
 
 static void
 gs_plugin_job_list_apps_run_async (GsPluginJob         *job,
@@ -257,12 +281,30 @@ gs_plugin_job_list_apps_run_async (GsPluginJob         *job,
 	g_autoptr(GTask) task = NULL;
 	GPtrArray *plugins;  /* (element-type GsPlugin) */
 	gboolean anything_ran = FALSE;
+	GsAppQueryLicenseType license_type = GS_APP_QUERY_LICENSE_ANY;
 	g_autoptr(GError) local_error = NULL;
 
 	task = g_task_new (job, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_plugin_job_list_apps_run_async);
 	g_task_set_task_data (task, g_object_ref (plugin_loader), (GDestroyNotify) g_object_unref);
 
+	/* work out the refine flags for the results */
+	self->refine_flags = GS_PLUGIN_REFINE_FLAGS_NONE;
+	if (self->query != NULL) {
+		self->refine_flags = gs_app_query_get_refine_flags (self->query);
+		license_type = gs_app_query_get_license_type (self->query);
+	}
+
+	if (!(self->refine_flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE) &&
+	    license_type != GS_APP_QUERY_LICENSE_ANY) {
+		/* Needs the license information when filtering with it */
+		self->refine_flags |= GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE;
+	}
+
+	/* only refine each plugin’s results separately if anyone is
+	 * interested in partial results */
+	self->stream_results = g_signal_has_handler_pending (self, signals[SIGNAL_PARTIAL_RESULTS], 0, TRUE);
+
 	/* run each plugin, keeping a counter of pending operations which is
 	 * initialised to 1 until all the operations are started */
 	self->n_pending_ops = 1;
@@ -300,6 +342,47 @@ gs_plugin_job_list_apps_run_async (GsPluginJob         *job,
 	finish_op (task, g_steal_pointer (&local_error));
 }
 
+/* Must be called before finish_op() for the operation which added the
+ * results */
+static void
+emit_partial_results (GTask *task)
+{
+	GsPluginJobListApps *self = g_task_get_source_object (task);
+	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
+	g_autoptr(GsAppList) partial_list = NULL;
+
+	/* nothing more to come, the job will return the full results */
+	if (self->n_pending_ops <= 1 || self->saved_error != NULL)
+		return;
+
+	partial_list = gs_app_list_copy (self->merged_list);
+	filter_and_sort_list (self, plugin_loader, partial_list);
+
+	g_signal_emit (self, signals[SIGNAL_PARTIAL_RESULTS], 0, partial_list);
+}
+
+/* Starts refining all the plugin results which have been queued so far */
+static void
+refine_queued_results (GTask *task)
+{
+	GsPluginJobListApps *self = g_task_get_source_object (task);
+	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
+	g_autoptr(GsAppList) queued_list = g_steal_pointer (&self->refine_queue);
+	g_autoptr(GsPluginJob) refine_job = NULL;
+
+	g_assert (!self->refine_running);
+	self->refine_running = TRUE;
+
+	self->n_pending_ops++;
+	refine_job = gs_plugin_job_refine_new (queued_list,
+					       self->refine_flags |
+					       GS_PLUGIN_REFINE_FLAGS_DISABLE_FILTERING);
+	gs_plugin_loader_job_process_async (plugin_loader, refine_job,
+					    g_task_get_cancellable (task),
+					    plugin_refine_cb,
+					    g_object_ref (task));
+}
+
 static void
 plugin_list_apps_cb (GObject      *source_object,
                      GAsyncResult *result,
@@ -315,8 +398,23 @@ plugin_list_apps_cb (GObject      *source_object,
 	plugin_apps = plugin_class->list_apps_finish (plugin, result, &local_error);
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
-	if (plugin_apps != NULL)
+	if (plugin_apps != NULL && self->stream_results &&
+	    gs_app_list_length (plugin_apps) > 0 &&
+	    self->refine_flags != GS_PLUGIN_REFINE_FLAGS_NONE) {
+		/* refine these results now, rather than waiting for the
+		 * other plugins; if a refine is already running, they’re
+		 * refined along with anything else which arrives meanwhile
+		 * once it’s finished */
+		if (self->refine_queue == NULL)
+			self->refine_queue = gs_app_list_new ();
+		gs_app_list_add_list (self->refine_queue, plugin_apps);
+		if (!self->refine_running)
+			refine_queued_results (task);
+	} else if (plugin_apps != NULL) {
 		gs_app_list_add_list (self->merged_list, plugin_apps);
+		if (self->stream_results && gs_app_list_length (plugin_apps) > 0)
+			emit_partial_results (task);
+	}
 
 	/* Only log errors from plugins. No need to discard everything when one plugin fails. */
 	if (local_error != NULL &&
@@ -338,6 +436,39 @@ plugin_list_apps_cb (GObject      *source_object,
 	finish_op (task, g_steal_pointer (&local_error));
 }
 
+static void
+plugin_refine_cb (GObject      *source_object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+	GsPluginLoader *plugin_loader = GS_PLUGIN_LOADER (source_object);
+	g_autoptr(GTask) task = G_TASK (user_data);
+	GsPluginJobListApps *self = g_task_get_source_object (task);
+	g_autoptr(GsAppList) refined_list = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	self->refine_running = FALSE;
+
+	refined_list = gs_plugin_loader_job_process_finish (plugin_loader, result, &local_error);
+	if (refined_list == NULL) {
+		gs_utils_error_convert_gio (&local_error);
+		g_clear_object (&self->refine_queue);
+		finish_op (task, g_steal_pointer (&local_error));
+		return;
+	}
+
+	gs_app_list_add_list (self->merged_list, refined_list);
+
+	/* start on the results which arrived while this batch was being
+	 * refined, before emitting, so the job isn’t seen as finished */
+	if (self->refine_queue != NULL)
+		refine_queued_results (task);
+
+	emit_partial_results (task);
+
+	finish_op (task, NULL);
+}
+
 /* @error is (transfer full) if non-%NULL */
 static void
 finish_op (GTask  *task,
@@ -347,8 +478,6 @@ finish_op (GTask  *task,
 	GCancellable *cancellable = g_task_get_cancellable (task);
 	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
 	g_autoptr(GsAppList) merged_list = NULL;
-	GsPluginRefineFlags refine_flags = GS_PLUGIN_REFINE_FLAGS_NONE;
-	GsAppQueryLicenseType license_type = GS_APP_QUERY_LICENSE_ANY;
 	g_autoptr(GError) error_owned = g_steal_pointer (&error);
 
 	if (error_owned != NULL && self->saved_error == NULL)
@@ -371,25 +500,16 @@ finish_op (GTask  *task,
 		return;
 	}
 
-	/* run refine() on each one if required */
-	if (self->query != NULL) {
-		refine_flags = gs_app_query_get_refine_flags (self->query);
-		license_type = gs_app_query_get_license_type (self->query);
-	}
-
-	if (!(refine_flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE) &&
-	    license_type != GS_APP_QUERY_LICENSE_ANY) {
-		/* Needs the license information when filtering with it */
-		refine_flags |= GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE;
-	}
-
+	/* run refine() on each one if required, unless each plugin’s
+	 * results have already been refined */
 	if (merged_list != NULL &&
 	    gs_app_list_length (merged_list) > 0 &&
-	    refine_flags != GS_PLUGIN_REFINE_FLAGS_NONE) {
+	    self->refine_flags != GS_PLUGIN_REFINE_FLAGS_NONE &&
+	    !self->stream_results) {
 		g_autoptr(GsPluginJob) refine_job = NULL;
 
 		refine_job = gs_plugin_job_refine_new (merged_list,
-						       refine_flags |
+						       self->refine_flags |
 						       GS_PLUGIN_REFINE_FLAGS_DISABLE_FILTERING);
 		gs_plugin_loader_job_process_async (plugin_loader, refine_job,
 						    cancellable,
@@ -424,11 +544,10 @@ refine_cb (GObject      *source_object,
 }
 
 static void
-finish_task (GTask     *task,
-             GsAppList *merged_list)
+filter_and_sort_list (GsPluginJobListApps *self,
+                      GsPluginLoader      *plugin_loader,
+                      GsAppList           *merged_list)
 {
-	GsPluginJobListApps *self = g_task_get_source_object (task);
-	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
 	GsAppListFilterFlags dedupe_flags = GS_APP_LIST_FILTER_FLAG_NONE;
 	GsAppListSortFunc sort_func = NULL;
 	gpointer sort_func_data = NULL;
@@ -439,7 +558,6 @@ finish_task (GTask     *task,
 	GsAppListFilterFunc filter_func = NULL;
 	gpointer filter_func_data = NULL;
 	guint max_results = 0;
-	g_autofree gchar *job_debug = NULL;
 
 	if (self->query != NULL) {
 		license_type = gs_app_query_get_license_type (self->query);
@@ -504,6 +622,17 @@ finish_task (GTask     *task,
 			 gs_app_list_length (merged_list), max_results);
 		gs_app_list_truncate (merged_list, max_results);
 	}
+}
+
+static void
+finish_task (GTask     *task,
+             GsAppList *merged_list)
+{
+	GsPluginJobListApps *self = g_task_get_source_object (task);
+	GsPluginLoader *plugin_loader = g_task_get_task_data (task);
+	g_autofree gchar *job_debug = NULL;
+
+	filter_and_sort_list (self, plugin_loader, merged_list);
 
 	/* show elapsed time */
 	job_debug = gs_plugin_job_to_string (GS_PLUGIN_JOB (self));
@@ -520,11 +649,10 @@ finish_task (GTask     *task,
 	g_signal_emit_by_name (G_OBJECT (self), "completed");
 
 #ifdef HAVE_SYSPROF
-	sysprof_collector_mark (self->begin_time_nsec,
-				SYSPROF_CAPTURE_CURRENT_TIME - self->begin_time_nsec,
-				"gnome-software",
-				G_OBJECT_TYPE_NAME (self),
-				NULL);
+	GS_PROFILER_ADD_MARK (PluginJobListApps,
+			      self->begin_time_nsec,
+			      G_OBJECT_TYPE_NAME (self),
+			      NULL);
 #endif
 }
 
@@ -581,6 +709,33 @@ gs_plugin_job_list_apps_class_init (GsPluginJobListAppsClass *klass)
 				    G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
 
 	g_object_class_install_properties (object_class, G_N_ELEMENTS (props), props);
+
+	/**
+	 * GsPluginJobListApps::partial-results:
+	 * @list: (not nullable): the results gathered so far
+	 *
+	 * Emitted during #GsPluginJob.run_async() each time a plugin’s results
+	 * have been listed and refined, while other plugins are still running.
+	 *
+	 * @list contains the refined results from all the plugins which have
+	 * finished so far, filtered, sorted and truncated in the same way as the
+	 * final results. It is not emitted for the last plugin to finish; the
+	 * final results are returned by the job as normal.
+	 *
+	 * Handlers must be connected before the job is run for this to be
+	 * emitted.
+	 *
+	 * It’s emitted in the thread which is running the #GMainContext which
+	 * was the thread-default context when #GsPluginJob.run_async() was
+	 * called.
+	 *
+	 * Since: 47
+	 */
+	signals[SIGNAL_PARTIAL_RESULTS] =
+		g_signal_new ("partial-results",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      0, NULL, NULL, g_cclosure_marshal_VOID__OBJECT,
+			      G_TYPE_NONE, 1, GS_TYPE_APP_LIST);
 }
 
 static void
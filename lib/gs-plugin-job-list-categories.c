@@ -299,11 +299,10 @@ finish_op (GTask  *task,
 	g_signal_emit_by_name (G_OBJECT (self), "completed");
 
 #ifdef HAVE_SYSPROF
-	sysprof_collector_mark (self->begin_time_nsec,
-				SYSPROF_CAPTURE_CURRENT_TIME - self->begin_time_nsec,
-				"gnome-software",
-				G_OBJECT_TYPE_NAME (self),
-				NULL);
+	GS_PROFILER_ADD_MARK (PluginJobListCategories,
+			      self->begin_time_nsec,
+			      G_OBJECT_TYPE_NAME (self),
+			      NULL);
 #endif
 }
 
@@ -53,6 +53,7 @@
 #include "gs-plugin-job-refine.h"
 #include "gs-plugin-private.h"
 #include "gs-plugin-types.h"
+#include "gs-profiler.h"
 #include "gs-utils.h"
 
 struct _GsPluginJobListDistroUpgrades
@@ -67,6 +68,7 @@ struct _GsPluginJobListDistroUpgrades
 	GsAppList *merged_list;  /* (owned) (nullable) */
 	GError *saved_error;  /* (owned) (nullable) */
 	guint n_pending_ops;
+	gint64 begin_time_nsec;
 
 	/* Results. */
 	GsAppList *result_list;  /* (owned) (nullable) */
@@ -186,6 +188,7 @@ gs_plugin_job_list_distro_upgrades_run_async (GsPluginJob         *job,
 	self->n_pending_ops = 1;
 	self->merged_list = gs_app_list_new ();
 	plugins = gs_plugin_loader_get_plugins (plugin_loader);
+	self->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
 
 	for (guint i = 0; i < plugins->len; i++) {
 		GsPlugin *plugin = g_ptr_array_index (plugins, i);
@@ -229,6 +232,13 @@ plugin_list_distro_upgrades_cb (GObject      *source_object,
 	plugin_apps = plugin_class->list_distro_upgrades_finish (plugin, result, &local_error);
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	GS_PROFILER_ADD_MARK_TAKE (PluginJobListDistroUpgrades,
+				   self->begin_time_nsec,
+				   g_strdup_printf ("%s:%s",
+						    G_OBJECT_TYPE_NAME (self),
+						    gs_plugin_get_name (plugin)),
+				   NULL);
+
 	if (plugin_apps != NULL)
 		gs_app_list_add_list (self->merged_list, plugin_apps);
 
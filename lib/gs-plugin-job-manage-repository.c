@@ -32,6 +32,7 @@
 #include "gs-plugin-job-manage-repository.h"
 #include "gs-plugin-job-private.h"
 #include "gs-plugin-types.h"
+#include "gs-profiler.h"
 
 struct _GsPluginJobManageRepository
 {
@@ -44,6 +45,7 @@ struct _GsPluginJobManageRepository
 	/* In-progress data. */
 	GError *saved_error;  /* (owned) (nullable) */
 	guint n_pending_ops;
+	gint64 begin_time_nsec;
 };
 
 G_DEFINE_TYPE (GsPluginJobManageRepository, gs_plugin_job_manage_repository, GS_TYPE_PLUGIN_JOB)
@@ -144,6 +146,7 @@ gs_plugin_job_manage_repository_run_async (GsPluginJob         *job,
 	 * initialised to 1 until all the operations are started */
 	self->n_pending_ops = 1;
 	plugins = gs_plugin_loader_get_plugins (plugin_loader);
+	self->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
 
 	for (guint i = 0; i < plugins->len; i++) {
 		GsPlugin *plugin = g_ptr_array_index (plugins, i);
@@ -218,6 +221,13 @@ plugin_repository_func_cb (GObject      *source_object,
 	success = repository_func_finish (plugin, result, &local_error);
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	GS_PROFILER_ADD_MARK_TAKE (PluginJobManageRepository,
+				   self->begin_time_nsec,
+				   g_strdup_printf ("%s:%s",
+						    G_OBJECT_TYPE_NAME (self),
+						    gs_plugin_get_name (plugin)),
+				   NULL);
+
 	g_assert (success || local_error != NULL);
 
 	finish_op (task, g_steal_pointer (&local_error));
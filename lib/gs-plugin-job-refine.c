@@ -45,10 +45,12 @@
  * refer to locally cached resources, rather than HTTP/HTTPS URIs for images
  * (for example).
  *
- * FIXME: Ideally, the #GsPluginClass.refine_async() calls would happen in
- * parallel, but this cannot be the case until the results of the refine_async()
- * call in one plugin don’t depend on the results of refine_async() in another.
- * This still happens with several pairs of plugins.
+ * The #GsPluginClass.refine_async() calls happen in parallel, except where the
+ * results of the refine_async() call in one plugin depend on the results of
+ * refine_async() in another. A plugin is started once all the plugins ordered
+ * before it (see gs_plugin_add_rule()) which produce data it consumes have
+ * finished; see #GsPluginClass.refine_flags_consumed and
+ * #GsPluginClass.refine_flags_produced.
  *
  * ```
  *                                    run_async()
@@ -110,9 +112,7 @@ struct _GsPluginJobRefine
 	/* Output data. */
 	GsAppList *result_list;  /* (owned) (nullable) */
 
-#ifdef HAVE_SYSPROF
 	gint64 begin_time_nsec;
-#endif
 };
 
 G_DEFINE_TYPE (GsPluginJobRefine, gs_plugin_job_refine, GS_TYPE_PLUGIN_JOB)
@@ -253,12 +253,8 @@ typedef struct {
 	/* In-progress data. */
 	guint n_pending_ops;
 	guint n_pending_recursions;
-	guint next_plugin_index;
-	guint next_plugin_order;
-
-#ifdef HAVE_SYSPROF
-	gint64 plugin_begin_time_nsec;
-#endif
+	GArray *plugin_nodes;  /* (owned) (element-type RefinePluginNode) */
+	gboolean plugins_finished;
 
 	/* Output data. */
 	GError *error;  /* (nullable) (owned) */
@@ -269,6 +265,7 @@ refine_internal_data_free (RefineInternalData *data)
 {
 	g_clear_object (&data->plugin_loader);
 	g_clear_object (&data->list);
+	g_clear_pointer (&data->plugin_nodes, g_array_unref);
 
 	g_assert (data->n_pending_ops == 0);
 	g_assert (data->n_pending_recursions == 0);
@@ -282,6 +279,116 @@ refine_internal_data_free (RefineInternalData *data)
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (RefineInternalData, refine_internal_data_free)
 
+/* A plugin to be refined, and its place in the dependency graph. */
+typedef struct {
+	GsPlugin *plugin;  /* (not nullable) (unowned) */
+	guint n_pending_deps;
+	GArray *dependents;  /* (owned) (element-type guint) */
+	gboolean started;
+	gint64 begin_time_nsec;
+} RefinePluginNode;
+
+static void
+refine_plugin_node_clear (RefinePluginNode *node)
+{
+	g_clear_pointer (&node->dependents, g_array_unref);
+}
+
+static GsPluginRefineFlags
+get_refine_flags_consumed (GsPlugin *plugin)
+{
+	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
+
+	/* plugins which don’t declare anything might depend on anything */
+	if (plugin_class->refine_flags_consumed == 0 &&
+	    plugin_class->refine_flags_produced == 0)
+		return GS_PLUGIN_REFINE_FLAGS_MASK;
+	return plugin_class->refine_flags_consumed;
+}
+
+static GsPluginRefineFlags
+get_refine_flags_produced (GsPlugin *plugin)
+{
+	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
+
+	if (plugin_class->refine_flags_consumed == 0 &&
+	    plugin_class->refine_flags_produced == 0)
+		return GS_PLUGIN_REFINE_FLAGS_MASK;
+	return plugin_class->refine_flags_produced;
+}
+
+/* Builds the graph of plugins which can refine apps. A plugin depends on
+ * every plugin ordered before it which produces data it consumes. The plugins
+ * are already sorted by order, so the graph has no cycles. */
+static GArray *
+build_plugin_nodes (GsPluginLoader *plugin_loader)
+{
+	GPtrArray *plugins = gs_plugin_loader_get_plugins (plugin_loader);
+	g_autoptr(GArray) nodes = g_array_new (FALSE, TRUE, sizeof (RefinePluginNode));
+
+	g_array_set_clear_func (nodes, (GDestroyNotify) refine_plugin_node_clear);
+
+	for (guint i = 0; i < plugins->len; i++) {
+		GsPlugin *plugin = g_ptr_array_index (plugins, i);
+		RefinePluginNode node = { plugin, 0, NULL, FALSE, 0 };
+
+		if (!gs_plugin_get_enabled (plugin))
+			continue;
+		if (GS_PLUGIN_GET_CLASS (plugin)->refine_async == NULL)
+			continue;
+
+		node.dependents = g_array_new (FALSE, FALSE, sizeof (guint));
+		g_array_append_val (nodes, node);
+	}
+
+	for (guint j = 0; j < nodes->len; j++) {
+		RefinePluginNode *node = &g_array_index (nodes, RefinePluginNode, j);
+		GsPluginRefineFlags consumed = get_refine_flags_consumed (node->plugin);
+
+		for (guint i = 0; i < j; i++) {
+			RefinePluginNode *dep = &g_array_index (nodes, RefinePluginNode, i);
+
+			if (gs_plugin_get_order (dep->plugin) >= gs_plugin_get_order (node->plugin))
+				break;
+			if ((get_refine_flags_produced (dep->plugin) & consumed) == 0)
+				continue;
+
+			g_array_append_val (dep->dependents, j);
+			node->n_pending_deps++;
+		}
+	}
+
+	return g_steal_pointer (&nodes);
+}
+
+/* Starts refining with every plugin whose dependencies have all finished. */
+static void
+run_ready_plugins (GTask *task)
+{
+	GCancellable *cancellable = g_task_get_cancellable (task);
+	RefineInternalData *data = g_task_get_task_data (task);
+
+	for (guint i = 0; i < data->plugin_nodes->len; i++) {
+		RefinePluginNode *node = &g_array_index (data->plugin_nodes, RefinePluginNode, i);
+
+		if (node->started || node->n_pending_deps > 0)
+			continue;
+
+		/* Handle cancellation */
+		if (data->error != NULL)
+			return;
+		if (g_cancellable_set_error_if_cancelled (cancellable, &data->error))
+			return;
+
+		/* run the batched plugin symbol */
+		node->started = TRUE;
+		node->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
+		data->n_pending_ops++;
+		GS_PLUGIN_GET_CLASS (node->plugin)->refine_async (node->plugin, data->list, data->flags,
+								  cancellable, plugin_refine_cb, g_object_ref (task));
+	}
+}
+
 static void
 run_refine_internal_async (GsPluginJobRefine   *self,
                            GsPluginLoader      *plugin_loader,
@@ -291,12 +398,9 @@ run_refine_internal_async (GsPluginJobRefine   *self,
                            GAsyncReadyCallback  callback,
                            gpointer             user_data)
 {
-	GPtrArray *plugins;  /* (element-type GsPlugin) */
 	g_autoptr(GTask) task = NULL;
 	RefineInternalData *data;
 	g_autoptr(RefineInternalData) data_owned = NULL;
-	gboolean anything_ran = FALSE;
-	g_autoptr(GError) local_error = NULL;
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, run_refine_internal_async);
@@ -305,67 +409,19 @@ run_refine_internal_async (GsPluginJobRefine   *self,
 	data->plugin_loader = g_object_ref (plugin_loader);
 	data->list = g_object_ref (list);
 	data->flags = flags;
-#ifdef HAVE_SYSPROF
-	data->plugin_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
-#endif
 	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) refine_internal_data_free);
 
 	/* try to adopt each app with a plugin */
 	gs_plugin_loader_run_adopt (plugin_loader, list);
 
-	data->n_pending_ops = 0;
-	data->next_plugin_order = 0;
-
-	/* run each plugin
-	 *
-	 * FIXME: For now, we have to run these vfuncs sequentially rather than
-	 * all in parallel. This is because there are still dependencies between
-	 * some of the plugins, where the code to refine an app in one plugin
-	 * depends on the results of refining it in another plugin first.
-	 *
-	 * Eventually, the plugins should all be changed/removed so that they
-	 * can operate independently. At that point, this code can be reverted
-	 * so that the refine_async() vfuncs are called in parallel. */
-	plugins = gs_plugin_loader_get_plugins (plugin_loader);
-
-	for (guint i = 0; i < plugins->len; i++) {
-		GsPlugin *plugin = g_ptr_array_index (plugins, i);
-		GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
-
-		if (gs_plugin_get_order (plugin) > data->next_plugin_order) {
-			if (!anything_ran)
-				data->next_plugin_order = gs_plugin_get_order (plugin);
-			else
-				return;
-		}
-
-		if (!gs_plugin_get_enabled (plugin))
-			continue;
-		if (plugin_class->refine_async == NULL)
-			continue;
-
-		/* at least one plugin supports this vfunc */
-		anything_ran = TRUE;
-
-		/* Handle cancellation */
-		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
-			break;
-
-		/* FIXME: The next refine_async() call is made in
-		 * finish_refine_internal_op(). */
-		data->next_plugin_index = i + 1;
-
-		/* run the batched plugin symbol */
-		data->n_pending_ops++;
-		plugin_class->refine_async (plugin, list, flags,
-					    cancellable, plugin_refine_cb, g_object_ref (task));
-	}
-
-	if (!anything_ran)
+	data->plugin_nodes = build_plugin_nodes (plugin_loader);
+	if (data->plugin_nodes->len == 0)
 		g_debug ("no plugin could handle refining apps");
 
+	/* run each plugin, as soon as the plugins it depends on have finished */
 	data->n_pending_ops++;
-	finish_refine_internal_op (task, g_steal_pointer (&local_error));
+	run_ready_plugins (task);
+	finish_refine_internal_op (task, NULL);
 }
 
 static void
@@ -377,13 +433,19 @@ plugin_refine_cb (GObject      *source_object,
 	g_autoptr(GTask) task = g_steal_pointer (&user_data);
 	GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
 	g_autoptr(GError) local_error = NULL;
-#ifdef HAVE_SYSPROF
-	GsPluginJobRefine *self = g_task_get_source_object (task);
 	RefineInternalData *data = g_task_get_task_data (task);
-#endif
+	GsPluginJobRefine *self G_GNUC_UNUSED = g_task_get_source_object (task);
+	RefinePluginNode *node = NULL;
+
+	for (guint i = 0; i < data->plugin_nodes->len; i++) {
+		node = &g_array_index (data->plugin_nodes, RefinePluginNode, i);
+		if (node->plugin == plugin)
+			break;
+	}
+	g_assert (node != NULL && node->plugin == plugin);
 
 	GS_PROFILER_ADD_MARK_TAKE (PluginJobRefine,
-				   data->plugin_begin_time_nsec,
+				   node->begin_time_nsec,
 				   g_strdup_printf ("%s:%s",
 						    G_OBJECT_TYPE_NAME (self),
 						    gs_plugin_get_name (plugin)),
@@ -400,6 +462,13 @@ plugin_refine_cb (GObject      *source_object,
 
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 
+	/* unblock the plugins which were waiting for this one */
+	for (guint j = 0; j < node->dependents->len; j++) {
+		guint idx = g_array_index (node->dependents, guint, j);
+		g_array_index (data->plugin_nodes, RefinePluginNode, idx).n_pending_deps--;
+	}
+	run_ready_plugins (task);
+
 	finish_refine_internal_op (task, NULL);
 }
 
@@ -428,9 +497,17 @@ rewrite_resources_cb (GObject      *source_object,
                       gpointer      user_data)
 {
 	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	guint64 bytes_downloaded = 0;
 	g_autoptr(GError) local_error = NULL;
+	gboolean success;
 
-	if (!gs_rewrite_resources_finish (result, &local_error) &&
+	success = gs_rewrite_resources_finish_full (result, &bytes_downloaded, &local_error);
+	if (bytes_downloaded > 0) {
+		g_autofree gchar *size = g_format_size (bytes_downloaded);
+		g_debug ("Downloaded %s of resources when refining apps", size);
+	}
+
+	if (!success &&
 	    !g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
 	    !g_error_matches (local_error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED)) {
 		g_debug ("Rewriting resources failed when refine apps: %s",
@@ -454,8 +531,6 @@ finish_refine_internal_op (GTask  *task,
 	GsPluginRefineFlags flags = data->flags;
 	GsOdrsProvider *odrs_provider;
 	GsOdrsProviderRefineFlags odrs_refine_flags = 0;
-	GPtrArray *plugins;  /* (element-type GsPlugin) */
-	gboolean anything_ran = FALSE;
 
 	if (data->error == NULL && error_owned != NULL) {
 		data->error = g_steal_pointer (&error_owned);
@@ -466,53 +541,13 @@ finish_refine_internal_op (GTask  *task,
 	g_assert (data->n_pending_ops > 0);
 	data->n_pending_ops--;
 
-#ifdef HAVE_SYSPROF
-	data->plugin_begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
-#endif
-
 	if (data->n_pending_ops > 0)
 		return;
 
-	/* We reach this line after all plugins of a certain order ran, and now
-	 * we need to run the next set of plugins. */
-	data->next_plugin_order++;
-
-	plugins = gs_plugin_loader_get_plugins (plugin_loader);
-
-	for (guint i = data->next_plugin_index; i < plugins->len; i++) {
-		GsPlugin *plugin = g_ptr_array_index (plugins, i);
-		GsPluginClass *plugin_class = GS_PLUGIN_GET_CLASS (plugin);
-
-		if (gs_plugin_get_order (plugin) > data->next_plugin_order) {
-			if (!anything_ran)
-				data->next_plugin_order = gs_plugin_get_order (plugin);
-			else
-				return;
-		}
-
-		if (!gs_plugin_get_enabled (plugin))
-			continue;
-		if (plugin_class->refine_async == NULL)
-			continue;
-		if (gs_plugin_get_order (plugin) < data->next_plugin_order)
-			continue;
-
-		/* at least one plugin supports this vfunc */
-		anything_ran = TRUE;
-
-		/* FIXME: The next refine_async() call is made in
-		 * finish_refine_internal_op(). */
-		data->next_plugin_index = i + 1;
-
-		/* run the batched plugin symbol */
-		data->n_pending_ops++;
-		plugin_class->refine_async (plugin, list, flags,
-					    cancellable, plugin_refine_cb, g_object_ref (task));
-	}
-
-	if (data->next_plugin_index == plugins->len) {
+	/* We reach this line after all the plugins ran, unless cancelled. */
+	if (!data->plugins_finished && data->error == NULL) {
 		/* Avoid the ODRS and rewrite refines being run multiple times. */
-		data->next_plugin_index++;
+		data->plugins_finished = TRUE;
 
 		/* Add ODRS data if needed */
 		odrs_provider = gs_plugin_loader_get_odrs_provider (plugin_loader);
@@ -754,9 +789,8 @@ gs_plugin_job_refine_run_async (GsPluginJob         *job,
 		g_object_freeze_notify (G_OBJECT (app));
 	}
 
-#ifdef HAVE_SYSPROF
-	self->begin_time_nsec = SYSPROF_CAPTURE_CURRENT_TIME;
-#endif
+	self->begin_time_nsec = GS_PROFILER_CURRENT_TIME;
+	GS_PROFILER_COUNTER_ADD (GS_PROFILER_COUNTER_APPS_REFINED, gs_app_list_length (self->app_list));
 
 	/* Start refining the apps. */
 	run_refine_internal_async (self, plugin_loader, result_list,
@@ -22,6 +22,7 @@
 #include "gs-app-collation.h"
 #include "gs-app-private.h"
 #include "gs-app-list-private.h"
+#include "gs-cache-manager.h"
 #include "gs-category-manager.h"
 #include "gs-category-private.h"
 #include "gs-external-appstream-utils.h"
@@ -37,6 +38,7 @@
 
 #define GS_PLUGIN_LOADER_UPDATES_CHANGED_DELAY	3	/* s */
 #define GS_PLUGIN_LOADER_RELOAD_DELAY		5	/* s */
+#define GS_PLUGIN_LOADER_PARALLEL_OPS_INTERVAL	2	/* s */
 
 struct _GsPluginLoader
 {
@@ -58,9 +60,19 @@ struct _GsPluginLoader
 	GsAppList		*pending_apps;		/* (nullable) (owned) */
 	GCancellable		*pending_apps_cancellable;  /* (nullable) (owned) */
 
-	GThreadPool		*queued_ops_pool;
+	GThreadPool		*queued_ops_pool;  /* (owned) (nullable); background jobs */
+	GThreadPool		*interactive_ops_pool;  /* (owned) (nullable) */
 	gint			 active_jobs;
 
+	GMutex			 parallel_ops_mutex;
+	guint			 max_parallel_ops_override;  /* (locked-by parallel_ops_mutex); 0 if adaptive */
+	guint			 max_background_ops;  /* (locked-by parallel_ops_mutex) */
+	guint			 max_interactive_ops;  /* (locked-by parallel_ops_mutex) */
+	gdouble			 memory_pressure;  /* (locked-by parallel_ops_mutex); percent */
+	gdouble			 io_pressure;  /* (locked-by parallel_ops_mutex); percent */
+	gint64			 parallel_ops_updated;  /* (locked-by parallel_ops_mutex); monotonic time */
+	GHashTable		*job_latencies;  /* (locked-by parallel_ops_mutex) (owned) (element-type GsPluginAction GsPluginLoaderJobLatency) */
+
 	GSettings		*settings;
 
 	GMutex			 events_by_id_mutex;
@@ -102,6 +114,9 @@ static void async_result_cb (GObject      *source_object,
                              gpointer      user_data);
 static void gs_plugin_loader_process_old_api_job_cb (gpointer task_data,
                                                      gpointer user_data);
+static void gs_plugin_loader_dump_parallel_ops (GsPluginLoader *plugin_loader);
+static void gs_plugin_loader_dump_caches (void);
+static void gs_plugin_loader_dump_app_memory (GsPluginLoader *plugin_loader);
 
 G_DEFINE_TYPE (GsPluginLoader, gs_plugin_loader, G_TYPE_OBJECT)
 
@@ -1874,6 +1889,10 @@ notify_setup_complete (GsPluginLoader *plugin_loader)
 	plugin_loader->setup_complete = TRUE;
 	g_cancellable_cancel (plugin_loader->setup_complete_cancellable);
 	g_clear_object (&plugin_loader->setup_complete_cancellable);
+
+	/* Trim the icon and screenshot caches in the background, in case
+	 * they grew past their quotas in a previous run. */
+	gs_cache_manager_evict_async (NULL, NULL, NULL);
 }
 
 /**
@@ -2401,6 +2420,10 @@ gs_plugin_loader_dump_state (GsPluginLoader *plugin_loader)
 		g_string_truncate (str_disabled, str_disabled->len - 2);
 	g_info ("enabled plugins: %s", str_enabled->str);
 	g_info ("disabled plugins: %s", str_disabled->str);
+
+	gs_plugin_loader_dump_parallel_ops (plugin_loader);
+	gs_plugin_loader_dump_caches ();
+	gs_plugin_loader_dump_app_memory (plugin_loader);
 }
 
 static void
@@ -2497,10 +2520,18 @@ gs_plugin_loader_dispose (GObject *object)
 		plugin_loader->network_metered_notify_handler = 0;
 	}
 	if (plugin_loader->queued_ops_pool != NULL) {
+		GThreadPool *queued_ops_pool, *interactive_ops_pool;
+
+		/* the running jobs may still update the pools’ limits */
+		g_mutex_lock (&plugin_loader->parallel_ops_mutex);
+		queued_ops_pool = g_steal_pointer (&plugin_loader->queued_ops_pool);
+		interactive_ops_pool = g_steal_pointer (&plugin_loader->interactive_ops_pool);
+		g_mutex_unlock (&plugin_loader->parallel_ops_mutex);
+
 		/* stop accepting more requests and wait until any currently
 		 * running ones are finished */
-		g_thread_pool_free (plugin_loader->queued_ops_pool, TRUE, TRUE);
-		plugin_loader->queued_ops_pool = NULL;
+		g_thread_pool_free (queued_ops_pool, TRUE, TRUE);
+		g_thread_pool_free (interactive_ops_pool, TRUE, TRUE);
 	}
 	g_clear_object (&plugin_loader->network_monitor);
 	g_clear_object (&plugin_loader->power_profile_monitor);
@@ -2532,9 +2563,11 @@ gs_plugin_loader_finalize (GObject *object)
 	g_ptr_array_unref (plugin_loader->file_monitors);
 	g_hash_table_unref (plugin_loader->events_by_id);
 	g_hash_table_unref (plugin_loader->disallow_updates);
+	g_hash_table_unref (plugin_loader->job_latencies);
 
 	g_mutex_clear (&plugin_loader->pending_apps_mutex);
 	g_mutex_clear (&plugin_loader->events_by_id_mutex);
+	g_mutex_clear (&plugin_loader->parallel_ops_mutex);
 
 	G_OBJECT_CLASS (gs_plugin_loader_parent_class)->finalize (object);
 }
@@ -2679,23 +2712,314 @@ gs_plugin_loader_allow_updates_recheck (GsPluginLoader *plugin_loader)
 		g_object_notify_by_pspec (G_OBJECT (plugin_loader), obj_props[PROP_ALLOW_UPDATES]);
 }
 
+/* The quotas are stored in MiB in GSettings. */
+static void
+gs_plugin_loader_update_cache_quotas (GsPluginLoader *plugin_loader)
+{
+	gs_cache_manager_set_quota (GS_CACHE_KIND_ICONS,
+				    (guint64) g_settings_get_uint (plugin_loader->settings, "icon-cache-size-maximum") * 1024 * 1024);
+	gs_cache_manager_set_quota (GS_CACHE_KIND_SCREENSHOTS,
+				    (guint64) g_settings_get_uint (plugin_loader->settings, "screenshot-cache-size-maximum") * 1024 * 1024);
+}
+
 static void
 gs_plugin_loader_settings_changed_cb (GSettings *settings,
 				      const gchar *key,
 				      GsPluginLoader *plugin_loader)
 {
-	if (g_strcmp0 (key, "allow-updates") == 0)
+	if (g_strcmp0 (key, "allow-updates") == 0) {
 		gs_plugin_loader_allow_updates_recheck (plugin_loader);
+	} else if (g_strcmp0 (key, "icon-cache-size-maximum") == 0 ||
+		   g_strcmp0 (key, "screenshot-cache-size-maximum") == 0) {
+		gs_plugin_loader_update_cache_quotas (plugin_loader);
+		gs_cache_manager_evict_async (NULL, NULL, NULL);
+	}
 }
 
-static gint
+/* Latency is considered degraded once a job type takes this many times longer
+ * than its baseline. The baseline follows the average down immediately, and
+ * creeps back up towards it by %JOB_LATENCY_BASELINE_DECAY of the difference
+ * with each sample, so a job type which has become slower for good (say,
+ * because there are more apps installed) stops counting as degraded after a
+ * few dozen jobs, rather than keeping the limit halved forever. */
+#define JOB_LATENCY_DEGRADED_FACTOR	2.0
+#define JOB_LATENCY_BASELINE_DECAY	0.02
+#define JOB_LATENCY_MIN_SAMPLES		3
+
+/* Only actions whose jobs take roughly the same time each run are tracked.
+ * Installing and downloading upgrades take as long as the download does, so
+ * a slow job says nothing about contention between them. */
+static gboolean
+action_has_comparable_latency (GsPluginAction action)
+{
+	switch (action) {
+	case GS_PLUGIN_ACTION_LAUNCH:
+	case GS_PLUGIN_ACTION_FILE_TO_APP:
+	case GS_PLUGIN_ACTION_URL_TO_APP:
+	case GS_PLUGIN_ACTION_GET_LANGPACKS:
+	case GS_PLUGIN_ACTION_ENABLE_REPO:
+	case GS_PLUGIN_ACTION_DISABLE_REPO:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/**
+ * gs_plugin_loader_job_latency_add_sample:
+ * @latency: a #GsPluginLoaderJobLatency
+ * @duration_ms: how long a job took, in milliseconds
+ *
+ * Adds the duration of a job to the moving average in @latency, and updates
+ * its baseline.
+ */
+void
+gs_plugin_loader_job_latency_add_sample (GsPluginLoaderJobLatency *latency,
+                                         gdouble                   duration_ms)
+{
+	if (latency->n_samples == 0)
+		latency->average_ms = duration_ms;
+	else
+		latency->average_ms = 0.7 * latency->average_ms + 0.3 * duration_ms;
+	latency->n_samples++;
+
+	if (latency->n_samples < JOB_LATENCY_MIN_SAMPLES)
+		return;
+
+	if (latency->n_samples == JOB_LATENCY_MIN_SAMPLES ||
+	    latency->average_ms < latency->baseline_ms)
+		latency->baseline_ms = latency->average_ms;
+	else
+		latency->baseline_ms += (latency->average_ms - latency->baseline_ms) * JOB_LATENCY_BASELINE_DECAY;
+}
+
+/**
+ * gs_plugin_loader_job_latency_is_degraded:
+ * @latency: a #GsPluginLoaderJobLatency
+ *
+ * Checks whether jobs are currently taking much longer than their baseline,
+ * in which case the background ops limit is halved until they recover.
+ *
+ * Returns: %TRUE if the latency is degraded
+ */
+gboolean
+gs_plugin_loader_job_latency_is_degraded (const GsPluginLoaderJobLatency *latency)
+{
+	return latency->n_samples >= JOB_LATENCY_MIN_SAMPLES &&
+	       latency->average_ms > latency->baseline_ms * JOB_LATENCY_DEGRADED_FACTOR;
+}
+
+/* The limit on queued jobs before taking pressure and latency into account:
+ * one per CPU, but no more than one per GB of memory, and always at least two
+ * so one slow job can’t block everything else. */
+static guint
 get_max_parallel_ops (void)
 {
+	guint n_cpus = g_get_num_processors ();
 	guint mem_total = gs_utils_get_memory_total ();
-	if (mem_total == 0)
-		return 8;
-	/* allow 1 op per GB of memory */
-	return (gint) MAX (round((gdouble) mem_total / 1024), 1.0);
+	guint max_ops = CLAMP (n_cpus, 2, 8);
+
+	if (mem_total != 0)
+		max_ops = MIN (max_ops, MAX ((guint) round ((gdouble) mem_total / 1024), 2));
+
+	return max_ops;
+}
+
+/* Read the percentage of the last 10 seconds in which some tasks were stalled
+ * on @resource, from the kernel’s pressure stall information. Returns 0 if PSI
+ * is not available. */
+static gdouble
+read_pressure (const gchar *resource)
+{
+	g_autofree gchar *filename = g_build_filename ("/proc/pressure", resource, NULL);
+	g_autofree gchar *contents = NULL;
+	const gchar *avg10;
+
+	if (!g_file_get_contents (filename, &contents, NULL, NULL))
+		return 0.0;
+
+	avg10 = strstr (contents, "some avg10=");
+	if (avg10 == NULL)
+		return 0.0;
+
+	return g_ascii_strtod (avg10 + strlen ("some avg10="), NULL);
+}
+
+static void
+set_pool_max_threads (GThreadPool *pool,
+                      guint        max_threads)
+{
+	g_autoptr(GError) local_error = NULL;
+
+	if (pool == NULL || (guint) g_thread_pool_get_max_threads (pool) == max_threads)
+		return;
+
+	if (!g_thread_pool_set_max_threads (pool, max_threads, &local_error))
+		g_warning ("Failed to set the maximum number of ops in parallel: %s",
+			   local_error->message);
+}
+
+/* Recalculate how many queued jobs may run in parallel, at most once every
+ * %GS_PLUGIN_LOADER_PARALLEL_OPS_INTERVAL seconds unless @force is set.
+ *
+ * Background jobs are throttled when the system is under memory or IO
+ * pressure, or when a job type is taking much longer than it has been seen to
+ * take, which suggests they’re contending with each other. Interactive jobs
+ * are only throttled under severe pressure, so the user isn’t kept waiting. */
+static void
+gs_plugin_loader_update_parallel_ops (GsPluginLoader *plugin_loader,
+                                      gboolean        force)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&plugin_loader->parallel_ops_mutex);
+	gint64 now = g_get_monotonic_time ();
+	guint max_ops, max_background_ops, max_interactive_ops;
+	gdouble pressure;
+	GHashTableIter iter;
+	gpointer value;
+
+	if (!force &&
+	    now - plugin_loader->parallel_ops_updated < GS_PLUGIN_LOADER_PARALLEL_OPS_INTERVAL * G_USEC_PER_SEC)
+		return;
+	plugin_loader->parallel_ops_updated = now;
+
+	if (plugin_loader->max_parallel_ops_override != 0) {
+		max_background_ops = plugin_loader->max_parallel_ops_override;
+		max_interactive_ops = plugin_loader->max_parallel_ops_override;
+	} else {
+		max_ops = get_max_parallel_ops ();
+		plugin_loader->memory_pressure = read_pressure ("memory");
+		plugin_loader->io_pressure = read_pressure ("io");
+		pressure = MAX (plugin_loader->memory_pressure, plugin_loader->io_pressure);
+
+		if (pressure >= 40.0) {
+			max_background_ops = 1;
+			max_interactive_ops = MAX (max_ops / 2, 1);
+		} else if (pressure >= 10.0) {
+			max_background_ops = MAX (max_ops / 2, 1);
+			max_interactive_ops = max_ops;
+		} else {
+			max_background_ops = max_ops;
+			max_interactive_ops = max_ops;
+		}
+
+		g_hash_table_iter_init (&iter, plugin_loader->job_latencies);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			const GsPluginLoaderJobLatency *latency = value;
+
+			if (gs_plugin_loader_job_latency_is_degraded (latency)) {
+				max_background_ops = MAX (max_background_ops / 2, 1);
+				break;
+			}
+		}
+	}
+
+	if (max_background_ops != plugin_loader->max_background_ops ||
+	    max_interactive_ops != plugin_loader->max_interactive_ops)
+		g_debug ("Allowing %u background and %u interactive ops in parallel "
+			 "(memory pressure %.1f%%, IO pressure %.1f%%)",
+			 max_background_ops, max_interactive_ops,
+			 plugin_loader->memory_pressure, plugin_loader->io_pressure);
+
+	plugin_loader->max_background_ops = max_background_ops;
+	plugin_loader->max_interactive_ops = max_interactive_ops;
+	set_pool_max_threads (plugin_loader->queued_ops_pool, max_background_ops);
+	set_pool_max_threads (plugin_loader->interactive_ops_pool, max_interactive_ops);
+}
+
+static void
+gs_plugin_loader_add_job_latency (GsPluginLoader *plugin_loader,
+                                  GsPluginAction  action,
+                                  gint64          duration_usec)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	GsPluginLoaderJobLatency *latency;
+
+	if (!action_has_comparable_latency (action))
+		return;
+
+	locker = g_mutex_locker_new (&plugin_loader->parallel_ops_mutex);
+	latency = g_hash_table_lookup (plugin_loader->job_latencies, GINT_TO_POINTER (action));
+	if (latency == NULL) {
+		latency = g_new0 (GsPluginLoaderJobLatency, 1);
+		g_hash_table_insert (plugin_loader->job_latencies, GINT_TO_POINTER (action), latency);
+	}
+
+	gs_plugin_loader_job_latency_add_sample (latency, duration_usec / 1000.0);
+}
+
+static void
+gs_plugin_loader_dump_parallel_ops (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&plugin_loader->parallel_ops_mutex);
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (plugin_loader->queued_ops_pool != NULL)
+		g_info ("background ops: %u running (limit %u), %u queued",
+			g_thread_pool_get_num_threads (plugin_loader->queued_ops_pool),
+			plugin_loader->max_background_ops,
+			g_thread_pool_unprocessed (plugin_loader->queued_ops_pool));
+	if (plugin_loader->interactive_ops_pool != NULL)
+		g_info ("interactive ops: %u running (limit %u), %u queued",
+			g_thread_pool_get_num_threads (plugin_loader->interactive_ops_pool),
+			plugin_loader->max_interactive_ops,
+			g_thread_pool_unprocessed (plugin_loader->interactive_ops_pool));
+	g_info ("parallel ops limit: %s, memory pressure %.1f%%, IO pressure %.1f%%",
+		(plugin_loader->max_parallel_ops_override != 0) ? "fixed" : "adaptive",
+		plugin_loader->memory_pressure, plugin_loader->io_pressure);
+
+	g_hash_table_iter_init (&iter, plugin_loader->job_latencies);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const GsPluginLoaderJobLatency *latency = value;
+		g_info ("%s latency: %.0fms average, %.0fms baseline, %u jobs",
+			gs_plugin_action_to_string (GPOINTER_TO_INT (key)),
+			latency->average_ms, latency->baseline_ms, latency->n_samples);
+	}
+}
+
+static void
+gs_plugin_loader_dump_caches (void)
+{
+	for (GsCacheKind kind = 0; kind < GS_CACHE_KIND_LAST; kind++) {
+		GsCacheStats stats;
+		g_autofree gchar *size_str = NULL;
+		g_autofree gchar *quota_str = NULL;
+
+		gs_cache_manager_get_stats (kind, &stats);
+		size_str = g_format_size (stats.size_bytes);
+		quota_str = (stats.quota_bytes > 0) ? g_format_size (stats.quota_bytes) : g_strdup ("unlimited");
+
+		g_info ("%s cache: %s of %s, %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses, %" G_GUINT64_FORMAT " evictions",
+			gs_cache_kind_to_string (kind), size_str, quota_str,
+			stats.n_hits, stats.n_misses, stats.n_evictions);
+	}
+}
+
+/* Measure the apps held in the plugins’ caches, which are the bulk of the
+ * long-lived ones. */
+static void
+gs_plugin_loader_dump_app_memory (GsPluginLoader *plugin_loader)
+{
+	GsAppMemoryStats stats;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autofree gchar *total_str = NULL;
+	g_autofree gchar *shared_str = NULL;
+
+	for (guint i = 0; i < plugin_loader->plugins->len; i++) {
+		GsPlugin *plugin = g_ptr_array_index (plugin_loader->plugins, i);
+		g_autoptr(GsAppList) cached = gs_plugin_list_cached (plugin);
+
+		gs_app_list_add_list (list, cached);
+	}
+
+	gs_app_get_memory_stats (list, &stats);
+	if (stats.n_apps == 0)
+		return;
+
+	total_str = g_format_size (stats.n_bytes);
+	shared_str = g_format_size (stats.n_bytes_shared);
+	g_info ("%u cached apps: %" G_GSIZE_FORMAT " bytes per app, %s in total, plus %s of interned strings",
+		stats.n_apps, stats.n_bytes / stats.n_apps, total_str, shared_str);
 }
 
 static void
@@ -2716,16 +3040,25 @@ gs_plugin_loader_init (GsPluginLoader *plugin_loader)
 	plugin_loader->scale = 1;
 	plugin_loader->plugins = g_ptr_array_new_with_free_func (g_object_unref);
 	plugin_loader->pending_apps = NULL;
+	g_mutex_init (&plugin_loader->parallel_ops_mutex);
+	plugin_loader->job_latencies = g_hash_table_new_full (NULL, NULL, NULL, g_free);
 	plugin_loader->queued_ops_pool = g_thread_pool_new (gs_plugin_loader_process_in_thread_pool_cb,
 						   plugin_loader,
-						   get_max_parallel_ops (),
+						   1,
 						   FALSE,
 						   NULL);
+	plugin_loader->interactive_ops_pool = g_thread_pool_new (gs_plugin_loader_process_in_thread_pool_cb,
+								 plugin_loader,
+								 1,
+								 FALSE,
+								 NULL);
+	gs_plugin_loader_update_parallel_ops (plugin_loader, TRUE);
 	plugin_loader->file_monitors = g_ptr_array_new_with_free_func (g_object_unref);
 	plugin_loader->locations = g_ptr_array_new_with_free_func (g_free);
 	plugin_loader->settings = g_settings_new ("org.gnome.software");
 	g_signal_connect (plugin_loader->settings, "changed",
 			  G_CALLBACK (gs_plugin_loader_settings_changed_cb), plugin_loader);
+	gs_plugin_loader_update_cache_quotas (plugin_loader);
 	plugin_loader->events_by_id = g_hash_table_new_full ((GHashFunc) as_utils_data_id_hash,
 							     (GEqualFunc) as_utils_data_id_equal,
 							     g_free,
@@ -3356,16 +3689,21 @@ gs_plugin_loader_process_in_thread_pool_cb (gpointer data,
 	GsPluginLoaderHelper *helper = g_task_get_task_data (task);
 	GsApp *app = gs_plugin_job_get_app (helper->plugin_job);
 	GsPluginAction action = gs_plugin_job_get_action (helper->plugin_job);
+	gint64 start_time;
 
-	gs_ioprio_set (G_PRIORITY_LOW);
+	gs_ioprio_set (gs_plugin_job_get_interactive (helper->plugin_job) ? G_PRIORITY_DEFAULT : G_PRIORITY_LOW);
 
+	start_time = g_get_monotonic_time ();
 	gs_plugin_loader_process_old_api_job_cb (g_object_ref (task), plugin_loader);
+	gs_plugin_loader_add_job_latency (plugin_loader, action, g_get_monotonic_time () - start_time);
 
 	/* Clear any pending action set in gs_plugin_loader_schedule_task() */
 	if (app != NULL && gs_app_get_pending_action (app) == action)
 		gs_app_set_pending_action (app, GS_PLUGIN_ACTION_UNKNOWN);
 
 	g_object_unref (task);
+
+	gs_plugin_loader_update_parallel_ops (plugin_loader, FALSE);
 }
 
 static void
@@ -3384,14 +3722,13 @@ gs_plugin_loader_schedule_task (GsPluginLoader *plugin_loader,
 				GTask *task)
 {
 	GsPluginLoaderHelper *helper = g_task_get_task_data (task);
-	GsApp *app = gs_plugin_job_get_app (helper->plugin_job);
 
-	if (app != NULL) {
-		/* set the pending-action to the app */
-		GsPluginAction action = gs_plugin_job_get_action (helper->plugin_job);
-		gs_app_set_pending_action (app, action);
-	}
-	g_thread_pool_push (plugin_loader->queued_ops_pool, g_object_ref (task), NULL);
+	gs_plugin_loader_update_parallel_ops (plugin_loader, FALSE);
+
+	if (gs_plugin_job_get_interactive (helper->plugin_job))
+		g_thread_pool_push (plugin_loader->interactive_ops_pool, g_object_ref (task), NULL);
+	else
+		g_thread_pool_push (plugin_loader->queued_ops_pool, g_object_ref (task), NULL);
 }
 
 static void
@@ -3719,9 +4056,19 @@ job_process_cb (GTask *task)
 	case GS_PLUGIN_ACTION_UPGRADE_DOWNLOAD:
 		/* these actions must be performed by the thread pool because we
 		 * want to limit the number of them running in parallel */
+		if (gs_plugin_job_get_app (plugin_job) != NULL)
+			gs_app_set_pending_action (gs_plugin_job_get_app (plugin_job), action);
 		gs_plugin_loader_schedule_task (plugin_loader, task);
 		return;
 	default:
+		/* these go through the same thread pools, so that their
+		 * latency feeds into the limit and they are throttled along
+		 * with the rest when the system is under pressure */
+		if (action_has_comparable_latency (action)) {
+			gs_plugin_loader_schedule_task (plugin_loader, task);
+			return;
+		}
+
 		/* run in an unrestricted thread pool thread */
 		g_thread_pool_push (plugin_loader->old_api_thread_pool,
 				    g_object_ref (task), NULL);
@@ -3966,19 +4313,26 @@ gs_plugin_loader_get_odrs_provider (GsPluginLoader *plugin_loader)
  * @plugin_loader: a #GsPluginLoader
  * @max_ops: the maximum number of parallel operations
  *
- * Sets the number of maximum number of queued operations (install/update/upgrade-download)
- * to be processed at a time. If @max_ops is 0, then it will set the default maximum number.
+ * Sets the number of maximum number of queued operations (upgrade-download,
+ * launch, file-to-app, url-to-app, get-langpacks and enabling or disabling
+ * repos) to be processed at a time, for each of the interactive and
+ * background queues.
+ *
+ * If @max_ops is 0, then the limits are calculated automatically from the
+ * number of CPUs, the memory and IO pressure of the system, and how long the
+ * queued operations are taking, and are updated as those change.
  */
 void
 gs_plugin_loader_set_max_parallel_ops (GsPluginLoader *plugin_loader,
 				       guint max_ops)
 {
-	g_autoptr(GError) error = NULL;
-	if (max_ops == 0)
-		max_ops = get_max_parallel_ops ();
-	if (!g_thread_pool_set_max_threads (plugin_loader->queued_ops_pool, max_ops, &error))
-		g_warning ("Failed to set the maximum number of ops in parallel: %s",
-			   error->message);
+	g_return_if_fail (GS_IS_PLUGIN_LOADER (plugin_loader));
+
+	g_mutex_lock (&plugin_loader->parallel_ops_mutex);
+	plugin_loader->max_parallel_ops_override = max_ops;
+	g_mutex_unlock (&plugin_loader->parallel_ops_mutex);
+
+	gs_plugin_loader_update_parallel_ops (plugin_loader, TRUE);
 }
 
 /**
@@ -101,6 +101,17 @@ GsPlugin	*gs_plugin_loader_find_plugin		(GsPluginLoader	*plugin_loader,
 void            gs_plugin_loader_set_max_parallel_ops  (GsPluginLoader *plugin_loader,
                                                         guint           max_ops);
 
+/* Measured latency of the queued jobs of one #GsPluginAction. */
+typedef struct {
+	guint		 n_samples;
+	gdouble		 average_ms;  /* exponentially weighted moving average */
+	gdouble		 baseline_ms;  /* slowly decaying minimum of @average_ms */
+} GsPluginLoaderJobLatency;
+
+void		 gs_plugin_loader_job_latency_add_sample	(GsPluginLoaderJobLatency	*latency,
+								 gdouble			 duration_ms);
+gboolean	 gs_plugin_loader_job_latency_is_degraded	(const GsPluginLoaderJobLatency	*latency);
+
 GsJobManager	*gs_plugin_loader_get_job_manager	(GsPluginLoader	*plugin_loader);
 
 GsCategoryManager *gs_plugin_loader_get_category_manager (GsPluginLoader *plugin_loader);
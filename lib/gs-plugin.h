@@ -103,6 +103,13 @@ G_DECLARE_DERIVABLE_TYPE (GsPlugin, gs_plugin, GS, PLUGIN, GObject)
  * @cancel_offline_update_finish: (nullable): Finish method for
  *   @cancel_offline_update_async. Must be implemented if
  *   @cancel_offline_update_async is implemented. (Since: 47)
+ * @refine_flags_consumed: Refine flags for data which @refine_async reads from
+ *   apps after it has been set by other plugins; for example the provenance of
+ *   an app. (Since: 47)
+ * @refine_flags_produced: Refine flags for data which @refine_async sets on
+ *   apps. If neither this nor @refine_flags_consumed is set, the plugin is
+ *   assumed to read and set all data, and is only run after every plugin
+ *   ordered before it has finished refining. (Since: 47)
  *
  * The class structure for a #GsPlugin. Virtual methods here should be
  * implemented by plugin implementations derived from #GsPlugin to provide their
@@ -286,7 +293,10 @@ struct _GsPluginClass
 								 GAsyncResult			*result,
 								 GError				**error);
 
-	gpointer		 padding[23];
+	GsPluginRefineFlags	 refine_flags_consumed;
+	GsPluginRefineFlags	 refine_flags_produced;
+
+	gpointer		 padding[22];
 };
 
 /* helpers */
@@ -0,0 +1,273 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Software contributors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#ifdef HAVE_SYSPROF
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sysprof-capture.h>
+#include <unistd.h>
+#endif
+
+#include "gs-profiler.h"
+
+/* Marks and counters normally go to the Sysprof collector, which is only
+ * active when gnome-software is being run by Sysprof. A #GsProfilerCapture
+ * redirects them into a capture file instead, for tools like
+ * `gnome-software-cmd --profile`.
+ *
+ * #SysprofCaptureWriter isn’t thread-safe, so all use of it is under the lock.
+ * The collector is, and marks and counters are added from hot paths, so when
+ * there’s no capture they don’t take the lock at all. */
+G_LOCK_DEFINE_STATIC (profiler);
+
+#ifdef HAVE_SYSPROF
+static SysprofCaptureWriter *capture_writer = NULL;  /* (owned) (nullable) (locked-by profiler) (atomic) */
+static guint counter_base_id = 0;  /* (locked-by profiler), read without it once counters_defined is set */
+static gint counters_defined = FALSE;  /* (atomic) */
+static gssize counter_values[GS_PROFILER_N_COUNTERS];  /* (atomic) */
+
+static const struct {
+	const gchar *name;
+	const gchar *description;
+} counter_info[GS_PROFILER_N_COUNTERS] = {
+	[GS_PROFILER_COUNTER_APPS_REFINED] = { "Apps refined", "Number of apps passed to refine jobs" },
+	[GS_PROFILER_COUNTER_BYTES_DOWNLOADED] = { "Bytes downloaded", "Number of bytes downloaded over HTTP" },
+	[GS_PROFILER_COUNTER_CACHE_HITS] = { "Cache hits", "Lookups answered from a cache" },
+	[GS_PROFILER_COUNTER_CACHE_MISSES] = { "Cache misses", "Lookups which had to be computed or fetched" },
+	[GS_PROFILER_COUNTER_NOTIFIES] = { "Notifies", "Property notifications dispatched in the main loop" },
+};
+#endif
+
+struct _GsProfilerCapture {
+	gchar *filename;  /* (owned) (not nullable) */
+};
+
+/**
+ * gs_profiler_add_mark:
+ * @begin_time: start time of the mark, from `SYSPROF_CAPTURE_CURRENT_TIME`
+ * @duration: duration of the mark, in nanoseconds
+ * @name: (not nullable): name of the mark
+ * @description: (nullable): description of the mark
+ *
+ * Add a mark to the profile. This is normally used through the GS_PROFILER_*()
+ * macros.
+ *
+ * Since: 47
+ */
+void
+gs_profiler_add_mark (gint64       begin_time,
+                      gint64       duration,
+                      const gchar *name,
+                      const gchar *description)
+{
+#ifdef HAVE_SYSPROF
+	if (g_atomic_pointer_get (&capture_writer) == NULL) {
+		sysprof_collector_mark (begin_time, duration, "gnome-software", name, description);
+		return;
+	}
+
+	G_LOCK (profiler);
+
+	if (capture_writer != NULL) {
+		sysprof_capture_writer_add_mark (capture_writer,
+						 begin_time,
+						 sched_getcpu (),
+						 getpid (),
+						 duration,
+						 "gnome-software",
+						 name,
+						 description);
+		G_UNLOCK (profiler);
+		return;
+	}
+
+	G_UNLOCK (profiler);
+
+	sysprof_collector_mark (begin_time, duration, "gnome-software", name, description);
+#endif
+}
+
+#ifdef HAVE_SYSPROF
+/* Must be called with the profiler lock held. */
+static void
+ensure_counters_defined_locked (void)
+{
+	SysprofCaptureCounter counters[GS_PROFILER_N_COUNTERS];
+
+	if (g_atomic_int_get (&counters_defined))
+		return;
+
+	if (capture_writer != NULL)
+		counter_base_id = sysprof_capture_writer_request_counter (capture_writer, GS_PROFILER_N_COUNTERS);
+	else
+		counter_base_id = sysprof_collector_request_counters (GS_PROFILER_N_COUNTERS);
+
+	for (guint i = 0; i < GS_PROFILER_N_COUNTERS; i++) {
+		memset (&counters[i], 0, sizeof (counters[i]));
+		g_strlcpy (counters[i].category, "GNOME Software", sizeof (counters[i].category));
+		g_strlcpy (counters[i].name, counter_info[i].name, sizeof (counters[i].name));
+		g_strlcpy (counters[i].description, counter_info[i].description, sizeof (counters[i].description));
+		counters[i].id = counter_base_id + i;
+		counters[i].type = SYSPROF_CAPTURE_COUNTER_INT64;
+		counters[i].value.v64 = (gssize) g_atomic_pointer_get (&counter_values[i]);
+	}
+
+	if (capture_writer != NULL)
+		sysprof_capture_writer_define_counters (capture_writer, SYSPROF_CAPTURE_CURRENT_TIME,
+							sched_getcpu (), getpid (),
+							counters, GS_PROFILER_N_COUNTERS);
+	else
+		sysprof_collector_define_counters (counters, GS_PROFILER_N_COUNTERS);
+
+	g_atomic_int_set (&counters_defined, TRUE);
+}
+#endif
+
+/**
+ * gs_profiler_counter_add:
+ * @counter: the counter to change
+ * @delta: amount to add to the counter
+ *
+ * Add @delta to a profiling counter. Counters accumulate over the lifetime of
+ * the process, and are shown as graphs in Sysprof. This is normally used
+ * through GS_PROFILER_COUNTER_ADD().
+ *
+ * Since: 47
+ */
+void
+gs_profiler_counter_add (GsProfilerCounter counter,
+                         gint64            delta)
+{
+#ifdef HAVE_SYSPROF
+	guint id;
+	SysprofCaptureCounterValue value;
+
+	g_return_if_fail (counter < GS_PROFILER_N_COUNTERS);
+
+	value.v64 = g_atomic_pointer_add (&counter_values[counter], delta) + delta;
+
+	if (g_atomic_int_get (&counters_defined) &&
+	    g_atomic_pointer_get (&capture_writer) == NULL) {
+		id = counter_base_id + counter;
+		sysprof_collector_set_counters (&id, &value, 1);
+		return;
+	}
+
+	G_LOCK (profiler);
+
+	ensure_counters_defined_locked ();
+	id = counter_base_id + counter;
+
+	if (capture_writer != NULL)
+		sysprof_capture_writer_set_counters (capture_writer, SYSPROF_CAPTURE_CURRENT_TIME,
+						     sched_getcpu (), getpid (),
+						     &id, &value, 1);
+	else
+		sysprof_collector_set_counters (&id, &value, 1);
+
+	G_UNLOCK (profiler);
+#endif
+}
+
+/**
+ * gs_profiler_capture_new:
+ * @filename: (type filename): path to write the capture to
+ * @error: return location for a #GError, or %NULL
+ *
+ * Start writing all profiling marks and counters from this process to a
+ * Sysprof capture file at @filename, which can be opened in Sysprof or read
+ * with `sysprof-cat`. The capture is finished when the returned object is
+ * freed.
+ *
+ * Only one capture can be active at once.
+ *
+ * Returns: (transfer full): a new #GsProfilerCapture, or %NULL on error
+ * Since: 47
+ */
+GsProfilerCapture *
+gs_profiler_capture_new (const gchar  *filename,
+                         GError      **error)
+{
+#ifdef HAVE_SYSPROF
+	g_autoptr(GsProfilerCapture) capture = NULL;
+	SysprofCaptureWriter *writer;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	writer = sysprof_capture_writer_new (filename, 0);
+	if (writer == NULL) {
+		int errsv = errno;
+		g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+			     "Failed to open capture file ‘%s’: %s", filename, g_strerror (errsv));
+		return NULL;
+	}
+
+	G_LOCK (profiler);
+	if (capture_writer != NULL) {
+		G_UNLOCK (profiler);
+		sysprof_capture_writer_unref (writer);
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+				     "A profiling capture is already in progress");
+		return NULL;
+	}
+
+	/* counters have to be redefined in the capture before anything is
+	 * written to it */
+	g_atomic_int_set (&counters_defined, FALSE);
+	g_atomic_pointer_set (&capture_writer, writer);
+	G_UNLOCK (profiler);
+
+	capture = g_new0 (GsProfilerCapture, 1);
+	capture->filename = g_strdup (filename);
+
+	return g_steal_pointer (&capture);
+#else
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     "gnome-software was built without Sysprof support");
+	return NULL;
+#endif
+}
+
+/**
+ * gs_profiler_capture_free:
+ * @capture: (transfer full): a #GsProfilerCapture
+ *
+ * Finish writing a capture started with gs_profiler_capture_new(). Profiling
+ * marks and counters go back to the Sysprof collector afterwards.
+ *
+ * Since: 47
+ */
+void
+gs_profiler_capture_free (GsProfilerCapture *capture)
+{
+	g_return_if_fail (capture != NULL);
+
+#ifdef HAVE_SYSPROF
+	G_LOCK (profiler);
+	g_atomic_int_set (&counters_defined, FALSE);
+	if (capture_writer != NULL) {
+		SysprofCaptureWriter *writer = capture_writer;
+
+		g_atomic_pointer_set (&capture_writer, NULL);
+		sysprof_capture_writer_flush (writer);
+		sysprof_capture_writer_unref (writer);
+	}
+	G_UNLOCK (profiler);
+
+	g_debug ("Wrote profiling capture to %s", capture->filename);
+#endif
+
+	g_free (capture->filename);
+	g_free (capture);
+}
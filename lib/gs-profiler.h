@@ -76,9 +76,58 @@
  * GS_PROFILER_ADD_MARK(Foo, task->begin_time, "do-something", NULL);
  *```
  *
+ * The begin time should be set with GS_PROFILER_CURRENT_TIME, which is always
+ * defined, so it can be stored without needing `#ifdef HAVE_SYSPROF` blocks.
+ *
+ * Counters for things like the number of apps refined or bytes downloaded are
+ * shown as graphs in Sysprof, and can be increased with
+ * GS_PROFILER_COUNTER_ADD():
+ *
+ * ```
+ * GS_PROFILER_COUNTER_ADD (GS_PROFILER_COUNTER_CACHE_HITS, 1);
+ *```
+ *
+ * Marks and counters go to Sysprof when gnome-software is run by it, or to a
+ * capture file while a #GsProfilerCapture exists.
+ *
  * Since: 44
  */
 
+/**
+ * GsProfilerCounter:
+ * @GS_PROFILER_COUNTER_APPS_REFINED: Number of apps passed to refine jobs
+ * @GS_PROFILER_COUNTER_BYTES_DOWNLOADED: Number of bytes downloaded over HTTP
+ * @GS_PROFILER_COUNTER_CACHE_HITS: Lookups answered from a cache
+ * @GS_PROFILER_COUNTER_CACHE_MISSES: Lookups which had to be computed or fetched
+ * @GS_PROFILER_COUNTER_NOTIFIES: Property notifications dispatched in the main loop
+ *
+ * Counters which can be increased with GS_PROFILER_COUNTER_ADD().
+ *
+ * Since: 47
+ */
+typedef enum {
+	GS_PROFILER_COUNTER_APPS_REFINED,
+	GS_PROFILER_COUNTER_BYTES_DOWNLOADED,
+	GS_PROFILER_COUNTER_CACHE_HITS,
+	GS_PROFILER_COUNTER_CACHE_MISSES,
+	GS_PROFILER_COUNTER_NOTIFIES,
+	GS_PROFILER_N_COUNTERS  /*< skip >*/
+} GsProfilerCounter;
+
+typedef struct _GsProfilerCapture GsProfilerCapture;
+
+void			 gs_profiler_add_mark		(gint64			 begin_time,
+							 gint64			 duration,
+							 const gchar		*name,
+							 const gchar		*description);
+void			 gs_profiler_counter_add	(GsProfilerCounter	 counter,
+							 gint64			 delta);
+GsProfilerCapture	*gs_profiler_capture_new	(const gchar		*filename,
+							 GError		       **error);
+void			 gs_profiler_capture_free	(GsProfilerCapture	*capture);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsProfilerCapture, gs_profiler_capture_free)
+
 #ifdef HAVE_SYSPROF
 #include <sysprof-capture.h>
 
@@ -89,14 +138,15 @@ typedef struct
 	gchar *description;
 } GsProfilerHead;
 
+#define GS_PROFILER_CURRENT_TIME SYSPROF_CAPTURE_CURRENT_TIME
+
 static inline void
 gs_profiler_tracing_end (GsProfilerHead *head)
 {
-	sysprof_collector_mark (head->begin_time,
-				SYSPROF_CAPTURE_CURRENT_TIME - head->begin_time,
-				"gnome-software",
-				head->name,
-				head->description);
+	gs_profiler_add_mark (head->begin_time,
+			      SYSPROF_CAPTURE_CURRENT_TIME - head->begin_time,
+			      head->name,
+			      head->description);
 
 	g_clear_pointer (&head->name, g_free);
 	g_clear_pointer (&head->description, g_free);
@@ -129,18 +179,22 @@ gs_profiler_auto_trace_end_helper (GsProfilerHead **head)
 	G_STMT_START { \
 		g_autofree char *_owned_sysprof_name_##Name = sysprof_name; \
 		g_autofree char *_owned_sysprof_description_##Name = sysprof_description; \
-		sysprof_collector_mark (begin_time, \
-					SYSPROF_CAPTURE_CURRENT_TIME - begin_time, \
-					"gnome-software", \
-					_owned_sysprof_name_##Name, \
-					_owned_sysprof_description_##Name); \
+		gs_profiler_add_mark (begin_time, \
+				      SYSPROF_CAPTURE_CURRENT_TIME - begin_time, \
+				      _owned_sysprof_name_##Name, \
+				      _owned_sysprof_description_##Name); \
 	} G_STMT_END
 
 #define GS_PROFILER_ADD_MARK(Name, begin_time, sysprof_name, sysprof_description) \
 	GS_PROFILER_ADD_MARK_TAKE (Name, begin_time, g_strdup (sysprof_name), g_strdup (sysprof_description))
 
+#define GS_PROFILER_COUNTER_ADD(counter, delta) \
+	gs_profiler_counter_add ((counter), (delta))
+
 #else
 
+#define GS_PROFILER_CURRENT_TIME 0
+
 #define GS_PROFILER_BEGIN_SCOPED_TAKE(Name, sysprof_name, sysprof_description) \
 	G_STMT_START {
 #define GS_PROFILER_BEGIN_SCOPED(Name, sysprof_name, sysprof_description) \
@@ -149,5 +203,6 @@ gs_profiler_auto_trace_end_helper (GsProfilerHead **head)
 	} G_STMT_END
 #define GS_PROFILER_ADD_MARK_TAKE(Name, begin_time, sysprof_name, sysprof_description)
 #define GS_PROFILER_ADD_MARK(Name, begin_time, sysprof_name, sysprof_description)
+#define GS_PROFILER_COUNTER_ADD(counter, delta)
 
 #endif
@@ -23,7 +23,9 @@
  * #GsRemoteIcon is immutable after construction and hence is entirely thread
  * safe.
  *
- * FIXME: Currently does no cache invalidation.
+ * Cached icons are revalidated with the server using HTTP conditional requests
+ * once they are a day old, so they are only downloaded again if they have
+ * changed.
  *
  * Since: 40
  */
@@ -39,6 +41,8 @@
 #include <sys/stat.h>
 #include <libsoup/soup.h>
 
+#include "gs-cache-manager.h"
+#include "gs-download-utils.h"
 #include "gs-remote-icon.h"
 #include "gs-utils.h"
 
@@ -236,55 +240,109 @@ gs_remote_icon_get_uri (GsRemoteIcon *self)
 	return self->uri;
 }
 
-static GdkPixbuf *
-gs_icon_download (SoupSession   *session,
-                  const gchar   *uri,
-                  const gchar   *destination_path,
-                  guint          max_size,
-                  GCancellable  *cancellable,
-                  GError       **error)
+/* How long a cached icon is used without checking with the server whether it
+ * has changed. The modification time of the cached file is updated whenever the
+ * server confirms it’s still current, so this is measured from the last check
+ * rather than from the original download. */
+#define REVALIDATE_INTERVAL_SECS (60 * 60 * 24)
+
+/* Whether the cached icon at @cache_filename exists and was last checked
+ * against the server recently enough to be used without checking again. */
+static gboolean
+cache_file_is_fresh (const gchar *cache_filename)
+{
+	GStatBuf stat_buf;
+
+	return (g_stat (cache_filename, &stat_buf) != -1 &&
+		S_ISREG (stat_buf.st_mode) &&
+		(g_get_real_time () / G_USEC_PER_SEC) - stat_buf.st_mtim.tv_sec < REVALIDATE_INTERVAL_SECS);
+}
+
+/* Ensure the dimensions of the cached icon are stored on @self. This only
+ * reads the image header, so is cheap. */
+static void
+ensure_size_from_cache_file (GsRemoteIcon *self,
+                             const gchar  *cache_filename)
+{
+	gint width = 0, height = 0;
+
+	if (!g_object_get_data (G_OBJECT (self), "width") &&
+	    gdk_pixbuf_get_file_info (cache_filename, &width, &height)) {
+		g_object_set_data (G_OBJECT (self), "width", GINT_TO_POINTER (width));
+		g_object_set_data (G_OBJECT (self), "height", GINT_TO_POINTER (height));
+	}
+}
+
+/* Read the dimensions from the IHDR chunk of the PNG in @bytes, without
+ * decoding it. Returns %FALSE if @bytes is not a PNG. */
+static gboolean
+png_get_size (GBytes *bytes,
+              guint  *width_out,
+              guint  *height_out)
+{
+	static const guint8 png_signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	const guint8 *data;
+	gsize size;
+	guint32 width, height;
+
+	data = g_bytes_get_data (bytes, &size);
+
+	/* signature, then the IHDR chunk length and type, which must come first */
+	if (size < 24 ||
+	    memcmp (data, png_signature, sizeof (png_signature)) != 0 ||
+	    memcmp (data + 12, "IHDR", 4) != 0)
+		return FALSE;
+
+	memcpy (&width, data + 16, sizeof (width));
+	memcpy (&height, data + 20, sizeof (height));
+	width = GUINT32_FROM_BE (width);
+	height = GUINT32_FROM_BE (height);
+
+	if (width == 0 || height == 0)
+		return FALSE;
+
+	*width_out = width;
+	*height_out = height;
+
+	return TRUE;
+}
+
+/* Save the downloaded icon in @bytes to @destination_path, scaling it down to
+ * be at most @max_size square and converting it to PNG if needed. Typically
+ * these icons are 64x64px PNG files already, in which case they are saved as
+ * they are, without decoding and re-encoding them. */
+static gboolean
+save_icon (GBytes       *bytes,
+           const gchar  *destination_path,
+           guint         max_size,
+           guint        *width_out,
+           guint        *height_out,
+           GCancellable *cancellable,
+           GError      **error)
 {
-	guint status_code;
-	g_autoptr(SoupMessage) msg = NULL;
+	guint width, height;
 	g_autoptr(GInputStream) stream = NULL;
 	g_autoptr(GdkPixbuf) pixbuf = NULL;
 	g_autoptr(GdkPixbuf) scaled_pixbuf = NULL;
 
-	/* Create the request */
-	msg = soup_message_new (SOUP_METHOD_GET, uri);
-	if (msg == NULL) {
-		g_set_error_literal (error,
-				     G_IO_ERROR,
-				     G_IO_ERROR_INVALID_DATA,
-				     "Icon has an invalid URL");
-		return NULL;
-	}
+	if (png_get_size (bytes, &width, &height) &&
+	    width <= max_size && height <= max_size) {
+		if (!g_file_set_contents (destination_path,
+					  g_bytes_get_data (bytes, NULL),
+					  g_bytes_get_size (bytes),
+					  error))
+			return FALSE;
 
-	/* Send request synchronously and start reading the response. */
-	stream = soup_session_send (session, msg, cancellable, error);
-
-#if SOUP_CHECK_VERSION(3, 0, 0)
-	status_code = soup_message_get_status (msg);
-#else
-	status_code = msg->status_code;
-#endif
-	if (stream == NULL) {
-		return NULL;
-	} else if (status_code != SOUP_STATUS_OK) {
-		g_set_error (error,
-			     G_IO_ERROR,
-			     G_IO_ERROR_FAILED,
-			     "Failed to download icon %s: %s",
-			     uri, soup_status_get_phrase (status_code));
-		return NULL;
+		*width_out = width;
+		*height_out = height;
+
+		return TRUE;
 	}
 
-	/* Typically these icons are 64x64px PNG files. If not, resize down
-	 * so it’s at most @max_size square, to minimise the size of the on-disk
-	 * cache.*/
+	stream = g_memory_input_stream_new_from_bytes (bytes);
 	pixbuf = gdk_pixbuf_new_from_stream (stream, cancellable, error);
 	if (pixbuf == NULL)
-		return NULL;
+		return FALSE;
 
 	if ((guint) gdk_pixbuf_get_height (pixbuf) <= max_size &&
 	    (guint) gdk_pixbuf_get_width (pixbuf) <= max_size) {
@@ -296,9 +354,214 @@ gs_icon_download (SoupSession   *session,
 
 	/* write file */
 	if (!gdk_pixbuf_save (scaled_pixbuf, destination_path, "png", error, NULL))
-		return NULL;
+		return FALSE;
+
+	*width_out = gdk_pixbuf_get_width (scaled_pixbuf);
+	*height_out = gdk_pixbuf_get_height (scaled_pixbuf);
+
+	return TRUE;
+}
+
+typedef struct {
+	gchar *cache_filename;  /* (owned) (not nullable) */
+	guint maximum_icon_size;
+	GOutputStream *output_stream;  /* (owned) (not nullable) */
+} EnsureCachedData;
+
+static void
+ensure_cached_data_free (EnsureCachedData *data)
+{
+	g_free (data->cache_filename);
+	g_clear_object (&data->output_stream);
+	g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (EnsureCachedData, ensure_cached_data_free)
+
+static void download_cb (GObject      *source_object,
+                         GAsyncResult *result,
+                         gpointer      user_data);
+
+/**
+ * gs_remote_icon_ensure_cached_async:
+ * @self: a #GsRemoteIcon
+ * @soup_session: a #SoupSession to use to download the icon
+ * @maximum_icon_size: maximum size (in device pixels) of the icon to save
+ * @io_priority: I/O priority to download and write the icon at
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: callback for once the asynchronous operation is complete
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of gs_remote_icon_ensure_cached().
+ *
+ * The download is done asynchronously, so several icons can be downloaded
+ * in parallel over the same @soup_session. Once downloaded, the icon is
+ * decoded (if needed) and saved to the cache synchronously in the
+ * thread-default main context of the caller, so this should be called from a
+ * worker thread rather than the main thread.
+ *
+ * Since: 47
+ */
+void
+gs_remote_icon_ensure_cached_async (GsRemoteIcon        *self,
+                                    SoupSession         *soup_session,
+                                    guint                maximum_icon_size,
+                                    int                  io_priority,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+	g_autoptr(GTask) task = NULL;
+	g_autoptr(EnsureCachedData) data_owned = NULL;
+	EnsureCachedData *data;
+	g_autoptr(GFile) cache_file = NULL;
+	g_autofree gchar *last_etag = NULL;
+	g_autoptr(GDateTime) last_modified_date = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	g_return_if_fail (GS_IS_REMOTE_ICON (self));
+	g_return_if_fail (SOUP_IS_SESSION (soup_session));
+	g_return_if_fail (maximum_icon_size > 0);
+	g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+	task = g_task_new (self, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_remote_icon_ensure_cached_async);
+
+	data = data_owned = g_new0 (EnsureCachedData, 1);
+	data->maximum_icon_size = maximum_icon_size;
+
+	/* Work out cache filename. */
+	data->cache_filename = gs_remote_icon_get_cache_filename (self->uri, TRUE, &local_error);
+	if (data->cache_filename == NULL) {
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
+
+	/* Already in cache and checked recently */
+	if (cache_file_is_fresh (data->cache_filename)) {
+		gs_cache_manager_record_lookup (GS_CACHE_KIND_ICONS, data->cache_filename, TRUE);
+		ensure_size_from_cache_file (self, data->cache_filename);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	/* Otherwise ask the server for the icon, only sending it if it’s
+	 * changed since it was cached, if it was. */
+	cache_file = g_file_new_for_path (data->cache_filename);
+	last_etag = gs_utils_get_file_etag (cache_file, &last_modified_date, cancellable);
+
+	data->output_stream = g_memory_output_stream_new_resizable ();
+	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) ensure_cached_data_free);
+
+	gs_download_stream_async (soup_session, self->uri, data->output_stream,
+				  last_etag, last_modified_date, io_priority,
+				  NULL, NULL, cancellable,
+				  download_cb, g_steal_pointer (&task));
+}
+
+static void
+download_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+	SoupSession *soup_session = SOUP_SESSION (source_object);
+	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	GsRemoteIcon *self = g_task_get_source_object (task);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+	EnsureCachedData *data = g_task_get_task_data (task);
+	g_autoptr(GFile) cache_file = g_file_new_for_path (data->cache_filename);
+	g_autofree gchar *new_etag = NULL;
+	g_autoptr(GBytes) bytes = NULL;
+	guint width, height;
+	g_autoptr(GError) local_error = NULL;
+
+	if (!gs_download_stream_finish (soup_session, result, &new_etag, NULL, &local_error)) {
+		if (g_error_matches (local_error, GS_DOWNLOAD_ERROR, GS_DOWNLOAD_ERROR_NOT_MODIFIED)) {
+			/* Record that the cached copy was checked now. */
+			g_clear_error (&local_error);
+			if (!g_file_set_attribute_uint64 (cache_file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+							  g_get_real_time () / G_USEC_PER_SEC,
+							  G_FILE_QUERY_INFO_NONE, cancellable, &local_error))
+				g_debug ("Failed to update modification time of ‘%s’: %s",
+					 data->cache_filename, local_error->message);
+
+			gs_cache_manager_record_lookup (GS_CACHE_KIND_ICONS, data->cache_filename, TRUE);
+			ensure_size_from_cache_file (self, data->cache_filename);
+			g_task_return_boolean (task, TRUE);
+			return;
+		}
+
+		/* If the server couldn’t be asked whether the cached copy is
+		 * still current, keep using it rather than losing the icon.
+		 * Its modification time isn’t updated, so it’s checked again
+		 * next time. */
+		if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+		    g_file_test (data->cache_filename, G_FILE_TEST_IS_REGULAR)) {
+			g_debug ("Failed to revalidate ‘%s’, using the cached copy: %s",
+				 data->cache_filename, local_error->message);
+			gs_cache_manager_record_lookup (GS_CACHE_KIND_ICONS, data->cache_filename, TRUE);
+			ensure_size_from_cache_file (self, data->cache_filename);
+			g_task_return_boolean (task, TRUE);
+			return;
+		}
 
-	return g_steal_pointer (&scaled_pixbuf);
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
+
+	gs_cache_manager_record_lookup (GS_CACHE_KIND_ICONS, data->cache_filename, FALSE);
+
+	bytes = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (data->output_stream));
+
+	if (!save_icon (bytes, data->cache_filename, data->maximum_icon_size,
+			&width, &height, cancellable, &local_error)) {
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
+
+	gs_utils_set_file_etag (cache_file, new_etag, cancellable);
+	gs_cache_manager_record_store (GS_CACHE_KIND_ICONS, data->cache_filename);
+
+	/* Ensure the dimensions are set correctly on the icon. */
+	g_object_set_data (G_OBJECT (self), "width", GUINT_TO_POINTER (width));
+	g_object_set_data (G_OBJECT (self), "height", GUINT_TO_POINTER (height));
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * gs_remote_icon_ensure_cached_finish:
+ * @self: a #GsRemoteIcon
+ * @result: a #GAsyncResult
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finish an asynchronous operation started with
+ * gs_remote_icon_ensure_cached_async().
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 47
+ */
+gboolean
+gs_remote_icon_ensure_cached_finish (GsRemoteIcon  *self,
+                                     GAsyncResult  *result,
+                                     GError       **error)
+{
+	g_return_val_if_fail (GS_IS_REMOTE_ICON (self), FALSE);
+	g_return_val_if_fail (g_task_is_valid (result, self), FALSE);
+	g_return_val_if_fail (g_async_result_is_tagged (result, gs_remote_icon_ensure_cached_async), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+ensure_cached_sync_cb (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+	GAsyncResult **result_out = user_data;
+
+	*result_out = g_object_ref (result);
 }
 
 /**
@@ -318,6 +581,11 @@ gs_icon_download (SoupSession   *session,
  * this will be 160px multiplied by the device scale
  * (`gtk_widget_get_scale_factor()`).
  *
+ * Cached icons are periodically checked for updates on the server, using the
+ * ETag or modification time of the cached copy so that unchanged icons are not
+ * downloaded again. If the server can’t be reached for such a check, the
+ * cached copy continues to be used.
+ *
  * This can be called from any thread, as #GsRemoteIcon is immutable and hence
  * thread-safe.
  *
@@ -331,10 +599,9 @@ gs_remote_icon_ensure_cached (GsRemoteIcon  *self,
                               GCancellable  *cancellable,
                               GError       **error)
 {
-	const gchar *uri;
-	g_autofree gchar *cache_filename = NULL;
-	g_autoptr(GdkPixbuf) cached_pixbuf = NULL;
-	GStatBuf stat_buf;
+	g_autoptr(GMainContext) context = NULL;
+	g_autoptr(GMainContextPusher) pusher = NULL;
+	g_autoptr(GAsyncResult) result = NULL;
 
 	g_return_val_if_fail (GS_IS_REMOTE_ICON (self), FALSE);
 	g_return_val_if_fail (SOUP_IS_SESSION (soup_session), FALSE);
@@ -342,34 +609,15 @@ gs_remote_icon_ensure_cached (GsRemoteIcon  *self,
 	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-	uri = gs_remote_icon_get_uri (self);
+	context = g_main_context_new ();
+	pusher = g_main_context_pusher_new (context);
 
-	/* Work out cache filename. */
-	cache_filename = gs_remote_icon_get_cache_filename (uri, TRUE, error);
-	if (cache_filename == NULL)
-		return FALSE;
+	gs_remote_icon_ensure_cached_async (self, soup_session, maximum_icon_size,
+					    G_PRIORITY_DEFAULT, cancellable,
+					    ensure_cached_sync_cb, &result);
 
-	/* Already in cache and not older than 30 days */
-	if (g_stat (cache_filename, &stat_buf) != -1 &&
-	    S_ISREG (stat_buf.st_mode) &&
-	    (g_get_real_time () / G_USEC_PER_SEC) - stat_buf.st_mtim.tv_sec < (60 * 60 * 24 * 30)) {
-		gint width = 0, height = 0;
-		/* Ensure the downloaded image dimensions are stored on the icon */
-		if (!g_object_get_data (G_OBJECT (self), "width") &&
-		    gdk_pixbuf_get_file_info (cache_filename, &width, &height)) {
-			g_object_set_data (G_OBJECT (self), "width", GINT_TO_POINTER (width));
-			g_object_set_data (G_OBJECT (self), "height", GINT_TO_POINTER (height));
-		}
-		return TRUE;
-	}
-
-	cached_pixbuf = gs_icon_download (soup_session, uri, cache_filename, maximum_icon_size, cancellable, error);
-	if (cached_pixbuf == NULL)
-		return FALSE;
+	while (result == NULL)
+		g_main_context_iteration (context, TRUE);
 
-	/* Ensure the dimensions are set correctly on the icon. */
-	g_object_set_data (G_OBJECT (self), "width", GUINT_TO_POINTER (gdk_pixbuf_get_width (cached_pixbuf)));
-	g_object_set_data (G_OBJECT (self), "height", GUINT_TO_POINTER (gdk_pixbuf_get_height (cached_pixbuf)));
-
-	return TRUE;
+	return gs_remote_icon_ensure_cached_finish (self, result, error);
 }
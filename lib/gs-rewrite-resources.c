@@ -31,8 +31,9 @@
  */
 
 typedef struct {
-	GError *saved_error;  /* (owned) (nullable) */
-	guint n_pending_ops;
+	GPtrArray *apps;  /* (owned) (element-type GsApp); the app for each resource */
+	GPtrArray *keys;  /* (owned) (element-type utf8) (unowned elements); the metadata key for each resource */
+	guint64 bytes_downloaded;
 
 #ifdef HAVE_SYSPROF
 	gint64 begin_time_nsec;
@@ -42,35 +43,16 @@ typedef struct {
 static void
 rewrite_resources_data_free (RewriteResourcesData *data)
 {
-	g_assert (data->saved_error == NULL);
-	g_assert (data->n_pending_ops == 0);
-
+	g_clear_pointer (&data->apps, g_ptr_array_unref);
+	g_clear_pointer (&data->keys, g_ptr_array_unref);
 	g_free (data);
 }
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (RewriteResourcesData, rewrite_resources_data_free)
 
-typedef struct {
-	GTask *task;  /* (owned) (not nullable) */
-	GsApp *app;  /* (owned) (not nullable) */
-	const gchar *key;  /* (not nullable) */
-} OpData;
-
-static void
-op_data_free (OpData *data)
-{
-	g_clear_object (&data->task);
-	g_clear_object (&data->app);
-	g_free (data);
-}
-
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (OpData, op_data_free)
-
-static void rewrite_resource_cb (GObject      *source_object,
-                                 GAsyncResult *result,
-                                 gpointer      user_data);
-static void finish_op (GTask  *task,
-                       GError *error);
+static void rewrite_resources_cb (GObject      *source_object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data);
 
 /**
  * gs_rewrite_resources_async:
@@ -82,6 +64,9 @@ static void finish_op (GTask  *task,
  * Downloads remote resources for the apps in @list, caches those downloads
  * locally and rewrites the apps’ metadata to refer to the local copies.
  *
+ * The resources for all the apps are downloaded together, so a resource which
+ * is shared between several apps is only downloaded once.
+ *
  * This currently acts on the following app metadata keys:
  *  - `GnomeSoftware::FeatureTile-css`
  *  - `GnomeSoftware::UpgradeBanner-css`
@@ -97,13 +82,15 @@ gs_rewrite_resources_async (GsAppList           *list,
 	g_autoptr(GTask) task = NULL;
 	RewriteResourcesData *data;
 	g_autoptr(RewriteResourcesData) data_owned = NULL;
+	g_autoptr(GPtrArray) resources = g_ptr_array_new ();
 	g_autoptr(GError) local_error = NULL;
 
 	task = g_task_new (NULL, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_rewrite_resources_async);
 
 	data = data_owned = g_new0 (RewriteResourcesData, 1);
-	data->n_pending_ops = 1;  /* count setup as an operation */
+	data->apps = g_ptr_array_new_with_free_func (g_object_unref);
+	data->keys = g_ptr_array_new ();
 
 	g_task_set_task_data (task, g_steal_pointer (&data_owned), (GDestroyNotify) rewrite_resources_data_free);
 
@@ -120,91 +107,89 @@ gs_rewrite_resources_async (GsAppList           *list,
 		};
 
 		/* Handle cancellation */
-		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error))
-			break;
+		if (g_cancellable_set_error_if_cancelled (cancellable, &local_error)) {
+			g_task_return_error (task, g_steal_pointer (&local_error));
+			return;
+		}
 
 		/* rewrite URIs */
 		for (gsize j = 0; keys[j] != NULL; j++) {
 			const gchar *css = gs_app_get_metadata_item (app, keys[j]);
-			g_autoptr(OpData) op_data = NULL;
 
 			if (css == NULL)
 				continue;
 
-			op_data = g_new0 (OpData, 1);
-			op_data->task = g_object_ref (task);
-			op_data->app = g_object_ref (app);
-			op_data->key = keys[j];
-
-			data->n_pending_ops++;
-			gs_download_rewrite_resource_async (css,
-							    cancellable,
-							    rewrite_resource_cb,
-							    g_steal_pointer (&op_data));
+			g_ptr_array_add (resources, (gpointer) css);
+			g_ptr_array_add (data->apps, g_object_ref (app));
+			g_ptr_array_add (data->keys, (gpointer) keys[j]);
 		}
 	}
 
-	finish_op (task, g_steal_pointer (&local_error));
-}
-
-static void
-rewrite_resource_cb (GObject      *source_object,
-                     GAsyncResult *result,
-                     gpointer      user_data)
-{
-	g_autoptr(OpData) op_data = g_steal_pointer (&user_data);
-	GTask *task = op_data->task;
-	g_autoptr(GError) local_error = NULL;
-	const gchar *css_old;
-	g_autofree gchar *css_new = NULL;
-
-	css_new = gs_download_rewrite_resource_finish (result, &local_error);
-
-	/* Successfully rewritten? */
-	css_old = gs_app_get_metadata_item (op_data->app, op_data->key);
-
-	if (css_new != NULL && g_strcmp0 (css_old, css_new) != 0) {
-		gs_app_set_metadata (op_data->app, op_data->key, NULL);
-		gs_app_set_metadata (op_data->app, op_data->key, css_new);
+	if (resources->len == 0) {
+		g_task_return_boolean (task, TRUE);
+		return;
 	}
 
-	finish_op (task, g_steal_pointer (&local_error));
+	g_ptr_array_add (resources, NULL);
+	gs_download_rewrite_resources_async (NULL,
+					     (const gchar * const *) resources->pdata,
+					     cancellable,
+					     rewrite_resources_cb,
+					     g_steal_pointer (&task));
 }
 
-/* @error is (transfer full) if non-%NULL */
 static void
-finish_op (GTask  *task,
-           GError *error)
+rewrite_resources_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
 {
-	g_autoptr(GError) error_owned = g_steal_pointer (&error);
+	g_autoptr(GTask) task = g_steal_pointer (&user_data);
 	RewriteResourcesData *data = g_task_get_task_data (task);
+	g_autoptr(GPtrArray) rewritten_resources = NULL;
+	g_autoptr(GPtrArray) errors = NULL;
+	g_autoptr(GError) local_error = NULL;
 
-	if (error_owned != NULL && data->saved_error == NULL)
-		data->saved_error = g_steal_pointer (&error_owned);
-	else if (error_owned != NULL)
-		g_debug ("Additional error while rewriting resources: %s", error_owned->message);
+	rewritten_resources = gs_download_rewrite_resources_finish (result, &data->bytes_downloaded,
+								    &errors, &local_error);
+	if (rewritten_resources == NULL) {
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
 
-	g_assert (data->n_pending_ops > 0);
-	data->n_pending_ops--;
+	for (guint i = 0; i < rewritten_resources->len; i++) {
+		GsApp *app = data->apps->pdata[i];
+		const gchar *key = data->keys->pdata[i];
+		const gchar *css_new = rewritten_resources->pdata[i];
+		const gchar *css_old;
 
-	if (data->n_pending_ops > 0)
-		return;
+		if (css_new == NULL) {
+			const GError *error = errors->pdata[i];
 
-	if (data->saved_error != NULL) {
-		g_task_return_error (task, g_steal_pointer (&data->saved_error));
-		return;
-	}
+			if (local_error == NULL)
+				local_error = g_error_copy (error);
+			else
+				g_debug ("Additional error while rewriting resources: %s", error->message);
+			continue;
+		}
 
-	g_assert (data->saved_error == NULL);
-	g_assert (data->n_pending_ops == 0);
+		/* Successfully rewritten? */
+		css_old = gs_app_get_metadata_item (app, key);
 
-	/* success */
-	g_task_return_boolean (task, TRUE);
+		if (g_strcmp0 (css_old, css_new) != 0) {
+			gs_app_set_metadata (app, key, NULL);
+			gs_app_set_metadata (app, key, css_new);
+		}
+	}
 
 	GS_PROFILER_ADD_MARK (RewriteResources,
 			      data->begin_time_nsec,
 			      "RewriteResources",
 			      NULL);
+
+	if (local_error != NULL)
+		g_task_return_error (task, g_steal_pointer (&local_error));
+	else
+		g_task_return_boolean (task, TRUE);
 }
 
 /**
@@ -222,5 +207,32 @@ gboolean
 gs_rewrite_resources_finish (GAsyncResult  *result,
                              GError       **error)
 {
+	return gs_rewrite_resources_finish_full (result, NULL, error);
+}
+
+/**
+ * gs_rewrite_resources_finish_full:
+ * @result: a #GAsyncResult
+ * @out_bytes_downloaded: (out) (optional): return location for the number of
+ *   bytes downloaded, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Like gs_rewrite_resources_finish(), but also returns the number of bytes
+ * downloaded. This is returned even if some of the resources couldn’t be
+ * downloaded.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ * Since: 47
+ */
+gboolean
+gs_rewrite_resources_finish_full (GAsyncResult  *result,
+                                  guint64       *out_bytes_downloaded,
+                                  GError       **error)
+{
+	RewriteResourcesData *data = g_task_get_task_data (G_TASK (result));
+
+	if (out_bytes_downloaded != NULL)
+		*out_bytes_downloaded = data->bytes_downloaded;
+
 	return g_task_propagate_boolean (G_TASK (result), error);
 }
@@ -23,5 +23,8 @@ void		 gs_rewrite_resources_async		(GsAppList		 *list,
 							 gpointer		  user_data);
 gboolean	 gs_rewrite_resources_finish		(GAsyncResult		 *result,
 							 GError			**error);
+gboolean	 gs_rewrite_resources_finish_full	(GAsyncResult		 *result,
+							 guint64		 *out_bytes_downloaded,
+							 GError			**error);
 
 G_END_DECLS
@@ -9,9 +9,15 @@
 
 #include "config.h"
 
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+
 #include "gnome-software-private.h"
 
 #include "gs-debug.h"
+#include "gs-key-colors.h"
 #include "gs-test.h"
 
 static gboolean
@@ -102,6 +108,225 @@ gs_utils_append_kv_func (void)
 	g_assert_cmpstr (str->str, ==, "key: val\n");
 }
 
+typedef struct {
+	GRWLock			 lock;
+	GsUtilsLockStalls	 stalls;
+	gint			 started;  /* (atomic) */
+} LockStallsData;
+
+static gpointer
+gs_utils_lock_stalls_thread_cb (gpointer user_data)
+{
+	LockStallsData *data = user_data;
+	g_autoptr(GRWLockReaderLocker) locker = NULL;
+
+	g_atomic_int_set (&data->started, TRUE);
+	locker = gs_utils_rw_lock_reader_locker_new (&data->lock, &data->stalls);
+
+	return NULL;
+}
+
+static void
+gs_utils_lock_stalls_func (void)
+{
+	LockStallsData data = { 0, };
+	GThread *thread;
+
+	g_rw_lock_init (&data.lock);
+
+	/* an uncontended lock isn’t counted */
+	{
+		g_autoptr(GRWLockReaderLocker) locker = gs_utils_rw_lock_reader_locker_new (&data.lock, &data.stalls);
+		g_autoptr(GRWLockReaderLocker) locker2 = gs_utils_rw_lock_reader_locker_new (&data.lock, &data.stalls);
+	}
+	g_assert_cmpint (data.stalls.n_stalls, ==, 0);
+	g_assert_cmpint (data.stalls.stall_usec, ==, 0);
+
+	/* a reader waiting for a writer is */
+	g_rw_lock_writer_lock (&data.lock);
+	thread = g_thread_new ("lock-stalls", gs_utils_lock_stalls_thread_cb, &data);
+	while (!g_atomic_int_get (&data.started))
+		g_usleep (G_TIME_SPAN_MILLISECOND);
+	g_usleep (10 * G_TIME_SPAN_MILLISECOND);
+	g_rw_lock_writer_unlock (&data.lock);
+	g_thread_join (thread);
+
+	g_assert_cmpint (data.stalls.n_stalls, ==, 1);
+	g_assert_cmpint (data.stalls.stall_usec, >, 0);
+
+	g_rw_lock_clear (&data.lock);
+}
+
+static void
+gs_utils_glob_set_func (void)
+{
+	const gchar *patterns[] = {
+		"*.desktop",
+		"*release-notes*.desktop",
+		"Rodent-*.desktop",
+		"links.desktop",
+		"wine-?.desktop",
+		"[Uu]ninstall*",
+		"[!a-z]*.app",
+		"[[:digit:]]*",
+		"a\\*b",
+		"usb:v0BDAp8179d*",
+		"pci:v000010DEd*sv*sd*bc03sc*i*",
+		"*é*",
+		NULL
+	};
+	const gchar *strs[] = {
+		"", "org.gnome.Maps.desktop", "my-release-notes-2.desktop", "Rodent-.desktop",
+		"links.desktop", "links.desktop2", "wine-1.desktop", "wine-12.desktop",
+		"Uninstall", "uninstallfoo", "Xyz.app", "xyz.app", "9lives", "a*b", "aXb",
+		"usb:v0BDAp8179d0200dc00dsc00dp00icFFiscFFipFFin00", "usb:v0BDAp8178d0200",
+		"pci:v000010DEd00001C03sv00001043sd000085ABbc03sc00i00",
+		"pci:v000010DEd00001C03sv00001043sd000085ABbc02sc00i00",
+		"café", "cafe",
+		NULL
+	};
+	g_autoptr(GsGlobSet) set = gs_glob_set_new (patterns);
+	g_autoptr(GsGlobSet) empty = gs_glob_set_new (NULL);
+
+	/* the set matches exactly when fnmatch() matches any of the patterns */
+	for (guint i = 0; strs[i] != NULL; i++) {
+		const gchar *match = gs_glob_set_lookup (set, strs[i]);
+		gboolean expected = FALSE;
+
+		for (guint j = 0; patterns[j] != NULL; j++) {
+			g_autoptr(GsGlobSet) single = gs_glob_set_new ((const gchar *[]) { patterns[j], NULL });
+			gboolean matches = (fnmatch (patterns[j], strs[i], 0) == 0);
+
+			g_assert_cmpint (gs_glob_set_match (single, strs[i]), ==, matches);
+			expected |= matches;
+		}
+
+		g_assert_cmpint (match != NULL, ==, expected);
+		if (match != NULL)
+			g_assert_cmpint (fnmatch (match, strs[i], 0), ==, 0);
+	}
+
+	g_assert_false (gs_glob_set_match (empty, ""));
+	g_assert_false (gs_glob_set_match (empty, "foo"));
+}
+
+static void
+gs_utils_glob_set_performance_func (void)
+{
+	const gchar *blocklist[] = {
+		"freeciv-server.desktop",
+		"links.desktop",
+		"nm-connection-editor.desktop",
+		"plank.desktop",
+		"*release-notes*.desktop",
+		"*Release_Notes*.desktop",
+		"Rodent-*.desktop",
+		"rygel-preferences.desktop",
+		"system-config-keyboard.desktop",
+		"tracker-preferences.desktop",
+		"Uninstall*.desktop",
+		"wine-*.desktop",
+		NULL
+	};
+	const gchar *devices[] = {
+		"acpi:PNP0C0A:",
+		"dmi:bvnDellInc.:bvr1.14.0:bd05/24/2023:br1.14:svnDellInc.:pnXPS139310:pvr:rvnDellInc.:rn0DXP1F:rvrA00:cvnDellInc.:ct10:cvr:sku0991:",
+		"hid:b0003g0001v0000046Dp0000C52B",
+		"input:b0003v046DpC52Be0111-e0,1,2,4,k110,111,112,r0,1,6,8,B,C,am4,lsfw",
+		"pci:v00008086d00009A49sv00001028sd00000991bc03sc00i00",
+		"pci:v00008086d0000A0E0sv00001028sd00000991bc07sc80i00",
+		"pci:v000010DEd00001C8Dsv00001028sd00000991bc03sc02i00",
+		"pci:v000014E4d000043ABsv00001028sd00000991bc02sc80i00",
+		"platform:intel_pmc_core",
+		"usb:v1D6Bp0002d0515dc09dsc00dp01ic09isc00ip00in00",
+		"usb:v046DpC52Bd1211dc00dsc00dp00ic03isc01ip01in00",
+		"usb:v0BDAp8152d3000dc00dsc00dp00ic02isc06ip00in00",
+		NULL
+	};
+	g_autoptr(GPtrArray) app_ids = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) device_modaliases = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) modaliases = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GsGlobSet) blocklist_set = NULL;
+	g_autoptr(GsGlobSet) modalias_set = NULL;
+	g_autoptr(GTimer) timer = NULL;
+	guint n_fnmatch = 0, n_set = 0;
+
+	/* 10k app IDs, a few of which are blocklisted */
+	for (guint i = 0; i < 10000; i++) {
+		if (i % 500 == 0)
+			g_ptr_array_add (app_ids, g_strdup_printf ("wine-%u.desktop", i));
+		else
+			g_ptr_array_add (app_ids, g_strdup_printf ("org.example.App%05u.desktop", i));
+	}
+
+	/* a typical laptop has a couple of hundred devices with a modalias */
+	for (guint i = 0; devices[i] != NULL; i++)
+		g_ptr_array_add (device_modaliases, g_strdup (devices[i]));
+	for (guint i = 0; i < 60; i++) {
+		g_ptr_array_add (device_modaliases, g_strdup_printf ("pci:v00008086d%08Xsv00001028sd00000991bc06sc04i00", 0xA0B0 + i));
+		g_ptr_array_add (device_modaliases, g_strdup_printf ("usb:v%04Xp%04Xd0100dc00dsc00dp00ic03isc01ip01in00", 0x1000 + i, 0x2000 + i));
+		g_ptr_array_add (device_modaliases, g_strdup_printf ("input:b0019v0000p%04Xe0000-e0,1,k74,r,am,lsfw", i));
+		g_ptr_array_add (device_modaliases, g_strdup_printf ("platform:device%u", i));
+	}
+
+	/* a driver providing a few hundred modaliases, as GPU drivers do */
+	for (guint i = 0; i < 400; i++)
+		g_ptr_array_add (modaliases, g_strdup_printf ("pci:v000010DEd%08Xsv*sd*bc03sc*i*", 0x1C00 + i));
+	for (guint i = 0; i < 100; i++)
+		g_ptr_array_add (modaliases, g_strdup_printf ("usb:v0BDAp%04Xd*", 0x8100 + i));
+	g_ptr_array_add (modaliases, NULL);
+
+	timer = g_timer_new ();
+	for (guint i = 0; i < app_ids->len; i++) {
+		for (guint j = 0; blocklist[j] != NULL; j++) {
+			if (fnmatch (blocklist[j], g_ptr_array_index (app_ids, i), 0) == 0) {
+				n_fnmatch++;
+				break;
+			}
+		}
+	}
+	g_print ("blocklist fnmatch: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	g_timer_reset (timer);
+	blocklist_set = gs_glob_set_new (blocklist);
+	for (guint i = 0; i < app_ids->len; i++) {
+		if (gs_glob_set_match (blocklist_set, g_ptr_array_index (app_ids, i)))
+			n_set++;
+	}
+	g_print ("glob set: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+	g_assert_cmpuint (n_set, ==, n_fnmatch);
+	g_assert_cmpuint (n_set, ==, 20);
+
+	/* match every device against the driver, compiling the driver’s
+	 * modaliases each time as the modalias plugin does on refine */
+	n_fnmatch = n_set = 0;
+	g_timer_reset (timer);
+	for (guint k = 0; k < 10; k++) {
+		for (guint i = 0; i < device_modaliases->len; i++) {
+			for (guint j = 0; j < modaliases->len - 1; j++) {
+				if (fnmatch (g_ptr_array_index (modaliases, j), g_ptr_array_index (device_modaliases, i), 0) == 0) {
+					n_fnmatch++;
+					break;
+				}
+			}
+		}
+	}
+	g_print ("modalias fnmatch: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	g_timer_reset (timer);
+	for (guint k = 0; k < 10; k++) {
+		g_clear_pointer (&modalias_set, gs_glob_set_unref);
+		modalias_set = gs_glob_set_new ((const gchar * const *) modaliases->pdata);
+		for (guint i = 0; i < device_modaliases->len; i++) {
+			if (gs_glob_set_match (modalias_set, g_ptr_array_index (device_modaliases, i)))
+				n_set++;
+		}
+	}
+	g_print ("glob set: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+	g_assert_cmpuint (n_set, ==, n_fnmatch);
+	g_assert_cmpuint (n_set, ==, 20);
+}
+
 static void
 gs_utils_cache_func (void)
 {
@@ -131,6 +356,59 @@ gs_utils_cache_func (void)
 	g_assert (g_str_has_suffix (fn2, "test/295099f59d12b3eb0b955325fcb699cd23792a89-baz"));
 }
 
+static void
+gs_utils_file_size_func (void)
+{
+	g_autofree gchar *tmp_dir = NULL;
+	g_autofree gchar *sub_dir = NULL;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error = NULL;
+	FILE *file;
+	guint64 size;
+
+	tmp_dir = g_dir_make_tmp ("gs-self-test-file-size-XXXXXX", &error);
+	g_assert_no_error (error);
+
+	/* a few levels of subdirectories, so more than one thread is used */
+	for (guint i = 0; i < 8; i++) {
+		g_autofree gchar *name = g_strdup_printf ("dir%u", i);
+		g_free (sub_dir);
+		sub_dir = g_build_filename (tmp_dir, name, "a", "b", NULL);
+		g_assert_cmpint (g_mkdir_with_parents (sub_dir, 0755), ==, 0);
+		g_free (fn);
+		fn = g_build_filename (sub_dir, "file", NULL);
+		g_file_set_contents (fn, "0123456789", 10, &error);
+		g_assert_no_error (error);
+	}
+	g_free (fn);
+	fn = g_build_filename (tmp_dir, "file", NULL);
+	g_file_set_contents (fn, "01234", 5, &error);
+	g_assert_no_error (error);
+
+	g_assert_cmpuint (gs_utils_get_file_size (fn, NULL, NULL, NULL), ==, 5);
+	g_assert_cmpuint (gs_utils_get_file_size (tmp_dir, NULL, NULL, NULL), ==, 85);
+
+	/* adding a file, and growing an existing one in place, are both
+	 * noticed by the next scan */
+	g_free (fn);
+	fn = g_build_filename (sub_dir, "another-file", NULL);
+	g_file_set_contents (fn, "0123456789", 10, &error);
+	g_assert_no_error (error);
+	size = gs_utils_get_file_size_full (tmp_dir, GS_FILE_SIZE_FLAG_NONE, NULL, NULL, NULL);
+	g_assert_cmpuint (size, ==, 95);
+	file = g_fopen (fn, "a");
+	g_assert_nonnull (file);
+	g_assert_cmpint (fputs ("01234", file), >=, 0);
+	g_assert_cmpint (fclose (file), ==, 0);
+	size = gs_utils_get_file_size_full (tmp_dir, GS_FILE_SIZE_FLAG_NONE, NULL, NULL, NULL);
+	g_assert_cmpuint (size, ==, 100);
+
+	g_assert_cmpuint (gs_utils_get_file_size ("/this/does/not/exist", NULL, NULL, NULL), ==, 0);
+
+	gs_utils_rmtree (tmp_dir, &error);
+	g_assert_no_error (error);
+}
+
 static void
 gs_utils_error_func (void)
 {
@@ -211,6 +489,296 @@ gs_plugin_download_rewrite_func (void)
 	g_assert (css != NULL);
 }
 
+static void
+gs_plugin_download_rewrite_batch_func (void)
+{
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GAsyncResult) result = NULL;
+	g_autoptr(GMainContext) context = g_main_context_new ();
+	g_autoptr(GMainContextPusher) context_pusher = g_main_context_pusher_new (context);
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *resource1 = NULL;
+	g_autofree gchar *resource2 = NULL;
+	g_autofree gchar *expected = NULL;
+	g_autoptr(GPtrArray) rewritten = NULL;
+	g_autoptr(GPtrArray) errors = NULL;
+	guint64 bytes_downloaded = G_MAXUINT64;
+	const gchar *resources[4] = { NULL, };
+	gint fd;
+
+	fd = g_file_open_tmp ("gs-self-test-XXXXXX.png", &filename, &error);
+	g_assert_no_error (error);
+	g_close (fd, NULL);
+
+	/* the same file used by two resources, and a missing one */
+	resource1 = g_strdup_printf ("background: url('file://%s') no-repeat;", filename);
+	resource2 = g_strdup_printf ("background: url(\"%s\");", filename);
+	resources[0] = resource1;
+	resources[1] = resource2;
+	resources[2] = "background: url('file:///gnome-software/does-not-exist.png');";
+
+	gs_download_rewrite_resources_async (NULL, resources, NULL, async_result_cb, &result);
+
+	while (result == NULL)
+		g_main_context_iteration (context, TRUE);
+
+	rewritten = gs_download_rewrite_resources_finish (result, &bytes_downloaded, &errors, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (rewritten);
+	g_assert_cmpuint (rewritten->len, ==, 3);
+	g_assert_cmpuint (errors->len, ==, 3);
+	g_assert_cmpuint (bytes_downloaded, ==, 0);
+
+	expected = g_strdup_printf ("background: url('file://%s') no-repeat;", filename);
+	g_assert_cmpstr (rewritten->pdata[0], ==, expected);
+	g_assert_null (errors->pdata[0]);
+	g_clear_pointer (&expected, g_free);
+	expected = g_strdup_printf ("background: url('file://%s');", filename);
+	g_assert_cmpstr (rewritten->pdata[1], ==, expected);
+	g_assert_null (errors->pdata[1]);
+	g_assert_null (rewritten->pdata[2]);
+	g_assert_error (errors->pdata[2], G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+
+	g_unlink (filename);
+}
+
+#if SOUP_CHECK_VERSION(3, 0, 0)
+typedef struct {
+	GBytes *small_icon;  /* (owned) */
+	GBytes *large_icon;  /* (owned) */
+	guint n_requests;
+	guint n_not_modified;
+} IconServerData;
+
+static void
+icon_server_cb (SoupServer        *server,
+                SoupServerMessage *msg,
+                const char        *path,
+                GHashTable        *query,
+                gpointer           user_data)
+{
+	IconServerData *data = user_data;
+	SoupMessageHeaders *request_headers = soup_server_message_get_request_headers (msg);
+	const gchar *etag = "\"icon-1\"";
+	GBytes *icon = g_str_equal (path, "/large.png") ? data->large_icon : data->small_icon;
+
+	data->n_requests++;
+
+	soup_message_headers_replace (soup_server_message_get_response_headers (msg), "ETag", etag);
+
+	/* The icons never change, so any conditional request is a cache hit. */
+	if (g_strcmp0 (soup_message_headers_get_one (request_headers, "If-None-Match"), etag) == 0 ||
+	    soup_message_headers_get_one (request_headers, "If-Modified-Since") != NULL) {
+		data->n_not_modified++;
+		soup_server_message_set_status (msg, SOUP_STATUS_NOT_MODIFIED, NULL);
+		return;
+	}
+
+	soup_server_message_set_status (msg, SOUP_STATUS_OK, NULL);
+	soup_server_message_set_response (msg, "image/png", SOUP_MEMORY_COPY,
+					  g_bytes_get_data (icon, NULL), g_bytes_get_size (icon));
+}
+
+static GBytes *
+create_png (gint width,
+            gint height)
+{
+	g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, width, height);
+	gchar *buffer = NULL;
+	gsize buffer_size = 0;
+	g_autoptr(GError) error = NULL;
+
+	gdk_pixbuf_fill (pixbuf, 0x336699ff);
+	gdk_pixbuf_save_to_buffer (pixbuf, &buffer, &buffer_size, "png", &error, NULL);
+	g_assert_no_error (error);
+
+	return g_bytes_new_take (buffer, buffer_size);
+}
+
+static gboolean
+remote_icon_ensure_cached (GsRemoteIcon *icon,
+                           SoupSession  *session,
+                           GMainContext *context,
+                           GError      **error)
+{
+	g_autoptr(GAsyncResult) result = NULL;
+
+	gs_remote_icon_ensure_cached_async (icon, session, 64, G_PRIORITY_DEFAULT, NULL,
+					    async_result_cb, &result);
+	while (result == NULL)
+		g_main_context_iteration (context, TRUE);
+
+	return gs_remote_icon_ensure_cached_finish (icon, result, error);
+}
+
+static void
+gs_remote_icon_func (void)
+{
+	g_autoptr(GMainContext) context = g_main_context_new ();
+	g_autoptr(GMainContextPusher) context_pusher = g_main_context_pusher_new (context);
+	g_autoptr(SoupServer) server = NULL;
+	g_autoptr(SoupSession) session = NULL;
+	g_autoptr(GIcon) icon = NULL;
+	g_autoptr(GIcon) large_icon = NULL;
+	g_autofree gchar *base_uri = NULL;
+	g_autofree gchar *uri = NULL;
+	g_autofree gchar *large_uri = NULL;
+	g_autofree gchar *contents = NULL;
+	gsize contents_size;
+	GFile *cache_file;
+	GSList *uris;
+	IconServerData data = { NULL, };
+	g_autoptr(GError) error = NULL;
+
+	data.small_icon = create_png (32, 32);
+	data.large_icon = create_png (256, 128);
+
+	server = soup_server_new (NULL, NULL);
+	soup_server_add_handler (server, NULL, icon_server_cb, &data, NULL);
+	soup_server_listen_local (server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+	g_assert_no_error (error);
+
+	uris = soup_server_get_uris (server);
+	base_uri = g_uri_to_string (uris->data);
+	g_slist_free_full (uris, (GDestroyNotify) g_uri_unref);
+
+	uri = g_build_path ("/", base_uri, "icon.png", NULL);
+	large_uri = g_build_path ("/", base_uri, "large.png", NULL);
+	session = soup_session_new ();
+
+	/* first download; the icon is small enough to be cached as it is */
+	icon = gs_remote_icon_new (uri);
+	g_assert_true (remote_icon_ensure_cached (GS_REMOTE_ICON (icon), session, context, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (data.n_requests, ==, 1);
+	g_assert_cmpuint (gs_icon_get_width (icon), ==, 32);
+
+	cache_file = g_file_icon_get_file (G_FILE_ICON (icon));
+	g_file_load_contents (cache_file, NULL, &contents, &contents_size, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpmem (contents, contents_size,
+			 g_bytes_get_data (data.small_icon, NULL), g_bytes_get_size (data.small_icon));
+
+	/* fresh in the cache, so the server isn’t asked */
+	g_assert_true (remote_icon_ensure_cached (GS_REMOTE_ICON (icon), session, context, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (data.n_requests, ==, 1);
+
+	/* once it’s old, a conditional request is made and nothing is
+	 * downloaded */
+	g_file_set_attribute_uint64 (cache_file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+				     g_get_real_time () / G_USEC_PER_SEC - 60 * 60 * 24 * 2,
+				     G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_assert_no_error (error);
+
+	g_assert_true (remote_icon_ensure_cached (GS_REMOTE_ICON (icon), session, context, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (data.n_requests, ==, 2);
+	g_assert_cmpuint (data.n_not_modified, ==, 1);
+
+	/* and the check is recorded, so the server isn’t asked again */
+	g_assert_true (remote_icon_ensure_cached (GS_REMOTE_ICON (icon), session, context, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (data.n_requests, ==, 2);
+
+	/* large icons are scaled down */
+	large_icon = gs_remote_icon_new (large_uri);
+	g_assert_true (remote_icon_ensure_cached (GS_REMOTE_ICON (large_icon), session, context, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (data.n_requests, ==, 3);
+	g_assert_cmpuint (gs_icon_get_width (large_icon), ==, 64);
+
+	soup_server_disconnect (server);
+	g_bytes_unref (data.small_icon);
+	g_bytes_unref (data.large_icon);
+}
+#endif  /* SOUP_CHECK_VERSION(3, 0, 0) */
+
+static void
+set_file_times (const gchar *filename,
+                gint64       atime_secs,
+                gint64       mtime_secs)
+{
+	const struct timespec times[2] = {
+		{ atime_secs, 0 },
+		{ mtime_secs, 0 },
+	};
+
+	g_assert_cmpint (utimensat (AT_FDCWD, filename, times, 0), ==, 0);
+}
+
+static void
+gs_cache_manager_func (void)
+{
+	g_autofree gchar *cache_dir = NULL;
+	gchar *filenames[5] = { NULL, };
+	g_autofree gchar *contents = g_strnfill (1000, 'x');
+	g_autoptr(GAsyncResult) result = NULL;
+	GsCacheStats stats_before, stats;
+	gint64 now_secs = g_get_real_time () / G_USEC_PER_SEC;
+	guint64 n_evicted = 0;
+	GStatBuf stat_buf;
+	g_autoptr(GError) error = NULL;
+
+	/* the test is run with isolated directories, so the cache is empty */
+	cache_dir = g_build_filename (g_get_user_cache_dir (), "gnome-software",
+				      gs_cache_kind_to_string (GS_CACHE_KIND_SCREENSHOTS),
+				      "112x63", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (cache_dir, 0700), ==, 0);
+
+	gs_cache_manager_get_stats (GS_CACHE_KIND_SCREENSHOTS, &stats_before);
+
+	/* five files, written a day ago, and last used an hour apart */
+	for (guint i = 0; i < G_N_ELEMENTS (filenames); i++) {
+		g_autofree gchar *basename = g_strdup_printf ("screenshot%u.png", i);
+
+		filenames[i] = g_build_filename (cache_dir, basename, NULL);
+		g_file_set_contents (filenames[i], contents, 1000, &error);
+		g_assert_no_error (error);
+		set_file_times (filenames[i],
+				now_secs - 60 * 60 * (G_N_ELEMENTS (filenames) - i),
+				now_secs - 60 * 60 * 24);
+	}
+
+	/* evict down to 90% of the quota, least recently used first */
+	gs_cache_manager_set_quota (GS_CACHE_KIND_SCREENSHOTS, 3000);
+	gs_cache_manager_evict_async (NULL, async_result_cb, &result);
+	while (result == NULL)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_true (gs_cache_manager_evict_finish (result, &n_evicted, &error));
+	g_assert_no_error (error);
+	g_assert_cmpuint (n_evicted, ==, 3);
+
+	for (guint i = 0; i < G_N_ELEMENTS (filenames); i++)
+		g_assert_cmpint (g_file_test (filenames[i], G_FILE_TEST_EXISTS), ==, i >= 3);
+
+	gs_cache_manager_get_stats (GS_CACHE_KIND_SCREENSHOTS, &stats);
+	g_assert_cmpuint (stats.size_bytes, ==, 2000);
+	g_assert_cmpuint (stats.quota_bytes, ==, 3000);
+	g_assert_cmpuint (stats.n_evictions, ==, stats_before.n_evictions + 3);
+
+	/* a hit marks the file as recently used, but leaves its mtime alone */
+	gs_cache_manager_record_lookup (GS_CACHE_KIND_SCREENSHOTS, filenames[3], TRUE);
+	gs_cache_manager_record_lookup (GS_CACHE_KIND_SCREENSHOTS, filenames[0], FALSE);
+	g_assert_cmpint (g_stat (filenames[3], &stat_buf), ==, 0);
+	g_assert_cmpint (stat_buf.st_atime, >=, now_secs);
+	g_assert_cmpint (stat_buf.st_mtime, ==, now_secs - 60 * 60 * 24);
+
+	gs_cache_manager_get_stats (GS_CACHE_KIND_SCREENSHOTS, &stats);
+	g_assert_cmpuint (stats.n_hits, ==, stats_before.n_hits + 1);
+	g_assert_cmpuint (stats.n_misses, ==, stats_before.n_misses + 1);
+
+	/* stores are added to the size */
+	gs_cache_manager_record_store (GS_CACHE_KIND_SCREENSHOTS, filenames[4]);
+	gs_cache_manager_get_stats (GS_CACHE_KIND_SCREENSHOTS, &stats);
+	g_assert_cmpuint (stats.size_bytes, ==, 3000);
+
+	gs_cache_manager_set_quota (GS_CACHE_KIND_SCREENSHOTS, 0);
+
+	for (guint i = 0; i < G_N_ELEMENTS (filenames); i++)
+		g_free (filenames[i]);
+}
+
 static void
 gs_plugin_func (void)
 {
@@ -672,6 +1240,102 @@ gs_app_func (void)
 	gs_app_set_state_recover (app);
 }
 
+static void
+gs_app_notify_count_cb (GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+	guint *count = user_data;
+	(*count)++;
+}
+
+static void
+gs_app_notify_coalesce_func (void)
+{
+	g_autoptr(GsApp) app = gs_app_new ("app");
+	GsAppNotifyStats stats_before, stats_after;
+	guint n_state = 0;
+	guint n_version = 0;
+
+	gs_test_flush_main_context ();
+	g_signal_connect (app, "notify::state", G_CALLBACK (gs_app_notify_count_cb), &n_state);
+	g_signal_connect (app, "notify::version", G_CALLBACK (gs_app_notify_count_cb), &n_version);
+	gs_app_get_notify_stats (&stats_before);
+
+	/* repeated changes to the same property are notified once */
+	gs_app_set_state (app, GS_APP_STATE_AVAILABLE);
+	gs_app_set_state (app, GS_APP_STATE_INSTALLING);
+	gs_app_set_state (app, GS_APP_STATE_INSTALLED);
+	for (guint i = 0; i < 10; i++) {
+		g_autofree gchar *version = g_strdup_printf ("1.%u", i);
+		gs_app_set_version (app, version);
+	}
+	g_assert_cmpuint (n_state, ==, 0);
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_state, ==, 1);
+	g_assert_cmpuint (n_version, ==, 1);
+	g_assert_cmpint (gs_app_get_state (app), ==, GS_APP_STATE_INSTALLED);
+
+	gs_app_get_notify_stats (&stats_after);
+	g_assert_cmpuint (stats_after.n_queued - stats_before.n_queued, >=, 13);
+	g_assert_cmpuint (stats_after.n_emitted - stats_before.n_emitted, >=, 2);
+	g_assert_cmpuint (stats_after.n_emitted - stats_before.n_emitted, <, 13);
+	g_assert_cmpuint (stats_after.n_dispatches - stats_before.n_dispatches, ==, 1);
+
+	/* and changes after a flush are notified again */
+	gs_app_set_version (app, "2.0");
+	gs_test_flush_main_context ();
+	g_assert_cmpuint (n_version, ==, 2);
+}
+
+static void
+gs_app_memory_func (void)
+{
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GFile) file = g_file_new_for_path ("/tmp/app.flatpakref");
+	GsAppMemoryStats stats;
+	GdkRGBA rgba = { 1.0, 0.0, 0.0, 1.0 };
+	GdkRGBA rgba_out;
+	GsApp *app0;
+
+	for (guint i = 0; i < 100; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%u", i);
+		g_autofree gchar *origin = g_strdup ("flathub");
+		GsApp *app = gs_app_new (id);
+
+		gs_app_set_origin (app, origin);
+		gs_app_set_license (app, GS_APP_QUALITY_NORMAL, "GPL-2.0-or-later");
+		gs_app_set_metadata (app, "GnomeSoftware::Creator", "test");
+		g_ptr_array_add (apps, app);
+		gs_app_list_add (list, app);
+	}
+
+	/* repeated values are shared between the apps */
+	app0 = g_ptr_array_index (apps, 0);
+	g_assert_cmpstr (gs_app_get_origin (app0), ==, "flathub");
+	g_assert_true (gs_app_get_origin (app0) == gs_app_get_origin (g_ptr_array_index (apps, 99)));
+	g_assert_true (gs_app_get_license (app0) == gs_app_get_license (g_ptr_array_index (apps, 99)));
+	g_assert_cmpstr (gs_app_get_metadata_item (app0, "GnomeSoftware::Creator"), ==, "test");
+
+	/* rarely used fields are only allocated when set */
+	g_assert_null (gs_app_get_local_file (app0));
+	g_assert_null (gs_app_get_url_missing (app0));
+	g_assert_false (gs_app_get_key_color_for_color_scheme (app0, GS_COLOR_SCHEME_ANY, &rgba_out));
+	gs_app_set_local_file (app0, file);
+	gs_app_set_key_color_for_color_scheme (app0, GS_COLOR_SCHEME_DARK, &rgba);
+	g_assert_true (gs_app_get_local_file (app0) == file);
+	g_assert_true (gs_app_get_key_color_for_color_scheme (app0, GS_COLOR_SCHEME_ANY, &rgba_out));
+	g_assert_true (gdk_rgba_equal (&rgba, &rgba_out));
+	g_assert_false (gs_app_get_key_color_for_color_scheme (app0, GS_COLOR_SCHEME_LIGHT, &rgba_out));
+	gs_app_set_local_file (app0, NULL);
+	g_assert_null (gs_app_get_local_file (app0));
+
+	gs_app_get_memory_stats (list, &stats);
+	g_assert_cmpuint (stats.n_apps, ==, apps->len);
+	g_assert_cmpuint (stats.n_bytes, >, 0);
+	g_assert_cmpuint (stats.n_bytes_shared, >=, strlen ("flathub") + 1);
+	g_print ("%" G_GSIZE_FORMAT " bytes per app ", stats.n_bytes / stats.n_apps);
+}
+
 static void
 gs_app_progress_clamping_func (void)
 {
@@ -773,6 +1437,112 @@ gs_app_list_performance_func (void)
 	g_print ("%.2fms ", g_timer_elapsed (timer, NULL) * 1000);
 }
 
+static void
+gs_app_list_performance_large_func (void)
+{
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GsAppList) list_merged = gs_app_list_new ();
+	g_autoptr(GTimer) timer = NULL;
+	const guint n_apps = 50000;
+
+	/* create lots of apps, as for a large installed list */
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%05u", i);
+		GsApp *app = gs_app_new (id);
+		gs_app_set_origin (app, "flathub");
+		gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_FLATPAK);
+		g_ptr_array_add (apps, app);
+	}
+
+	/* add them to the list */
+	timer = g_timer_new ();
+	for (guint i = 0; i < apps->len; i++)
+		gs_app_list_add (list, g_ptr_array_index (apps, i));
+	g_assert_cmpuint (gs_app_list_length (list), ==, n_apps);
+	g_print ("add: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	/* adding them all again should not add any duplicates */
+	g_timer_reset (timer);
+	for (guint i = 0; i < apps->len; i++)
+		gs_app_list_add (list, g_ptr_array_index (apps, i));
+	g_assert_cmpuint (gs_app_list_length (list), ==, n_apps);
+	g_print ("re-add: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	/* merging into another list, as with results from several plugins */
+	g_timer_reset (timer);
+	gs_app_list_add_list (list_merged, list);
+	gs_app_list_add_list (list_merged, list);
+	g_assert_cmpuint (gs_app_list_length (list_merged), ==, n_apps);
+	g_print ("merge: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	/* look up each app, with and without wildcards */
+	g_timer_reset (timer);
+	for (guint i = 0; i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		g_autofree gchar *wildcard_id = g_strdup_printf ("*/*/*/%s/*", gs_app_get_id (app));
+
+		g_assert_true (gs_app_list_lookup (list, gs_app_get_unique_id (app)) == app);
+		g_assert_true (gs_app_list_lookup (list, wildcard_id) == app);
+	}
+	g_assert_null (gs_app_list_lookup (list, "*/*/*/org.example.Missing/*"));
+	g_print ("lookup: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	/* the index must follow changes to the list */
+	gs_app_list_truncate (list, 10);
+	g_assert_null (gs_app_list_lookup (list, gs_app_get_unique_id (g_ptr_array_index (apps, 10))));
+	g_assert_nonnull (gs_app_list_lookup (list, gs_app_get_unique_id (g_ptr_array_index (apps, 9))));
+	gs_app_list_add (list, g_ptr_array_index (apps, 10));
+	g_assert_cmpuint (gs_app_list_length (list), ==, 11);
+	gs_app_set_id (g_ptr_array_index (apps, 10), "org.example.Renamed");
+	g_assert_nonnull (gs_app_list_lookup (list, "*/*/*/org.example.Renamed/*"));
+
+	/* setting the ID of an app which didn’t have one must too */
+	{
+		g_autoptr(GsApp) app_no_id = gs_app_new (NULL);
+		g_autoptr(GsApp) app_no_unique_id = gs_app_new (NULL);
+
+		gs_app_list_add (list, app_no_id);
+		gs_app_list_add (list, app_no_unique_id);
+		g_assert_null (gs_app_list_lookup (list, "*/*/*/org.example.Late/*"));
+		gs_app_set_id (app_no_id, "org.example.Late");
+		g_assert_true (gs_app_list_lookup (list, "*/*/*/org.example.Late/*") == app_no_id);
+		g_assert_true (gs_app_list_lookup (list, gs_app_get_unique_id (app_no_id)) == app_no_id);
+
+		g_assert_null (gs_app_list_lookup (list, "system/flatpak/flathub/org.example.LateUnique/stable"));
+		gs_app_set_unique_id (app_no_unique_id, "system/flatpak/flathub/org.example.LateUnique/stable");
+		g_assert_true (gs_app_list_lookup (list, "system/flatpak/flathub/org.example.LateUnique/stable") == app_no_unique_id);
+	}
+}
+
+static void
+gs_app_list_performance_interleaved_func (void)
+{
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GTimer) timer = g_timer_new ();
+	const guint n_apps = 50000;
+
+	/* create each app just before adding it, as when converting results
+	 * from a plugin; creating an app must not make every list rebuild its
+	 * index, only changing the ID of an app in that list */
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.App%05u", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		gs_app_set_origin (app, "flathub");
+		gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_FLATPAK);
+		gs_app_list_add (list, app);
+	}
+	g_assert_cmpuint (gs_app_list_length (list), ==, n_apps);
+	g_print ("create and add: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+
+	g_timer_reset (timer);
+	for (guint i = 0; i < n_apps; i++) {
+		g_autofree gchar *wildcard_id = g_strdup_printf ("*/*/*/org.example.App%05u/*", i);
+		g_assert_true (gs_app_list_lookup (list, wildcard_id) == gs_app_list_index (list, i));
+	}
+	g_print ("lookup: %.2fms ", g_timer_elapsed (timer, NULL) * 1000);
+}
+
 static void
 gs_app_list_related_func (void)
 {
@@ -793,6 +1563,341 @@ gs_app_list_related_func (void)
 	g_assert_cmpint (gs_app_list_get_progress (list), ==, 50);
 }
 
+typedef struct {
+	GsWorkerThread *worker;  /* (unowned) */
+	GMutex mutex;
+	GArray *serial_order;  /* (element-type guint) (locked-by mutex) */
+	GThread *serial_thread;  /* (unowned) (locked-by mutex) */
+	guint n_parallel;  /* (locked-by mutex) */
+	guint n_done;
+	GCond cond;
+	gboolean blocked;  /* (locked-by mutex) */
+	gboolean released;  /* (locked-by mutex) */
+} WorkerPoolData;
+
+/* Blocks its worker thread until the test releases it. */
+static void
+worker_pool_blocking_cb (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+	WorkerPoolData *data = g_task_get_task_data (task);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&data->mutex);
+
+	data->blocked = TRUE;
+	g_cond_broadcast (&data->cond);
+	while (!data->released)
+		g_cond_wait (&data->cond, &data->mutex);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+worker_pool_serial_cb (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+	WorkerPoolData *data = g_task_get_task_data (task);
+	guint idx = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (task), "idx"));
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&data->mutex);
+
+	g_assert_true (gs_worker_thread_is_in_worker_context (data->worker));
+	if (data->serial_thread == NULL)
+		data->serial_thread = g_thread_self ();
+	g_assert_true (data->serial_thread == g_thread_self ());
+	g_array_append_val (data->serial_order, idx);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+worker_pool_parallel_cb (GTask        *task,
+                         gpointer      source_object,
+                         gpointer      task_data,
+                         GCancellable *cancellable)
+{
+	WorkerPoolData *data = g_task_get_task_data (task);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&data->mutex);
+
+	g_assert_true (gs_worker_thread_is_in_worker_context (data->worker));
+	data->n_parallel++;
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+worker_pool_done_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+	WorkerPoolData *data = user_data;
+	g_autoptr(GError) error = NULL;
+
+	g_assert_true (g_task_propagate_boolean (G_TASK (result), &error));
+	g_assert_no_error (error);
+	data->n_done++;
+}
+
+/* A solid @red, @green, @blue icon, with a few transparent pixels which
+ * should be ignored, and which leave an odd number of pixels to cluster. */
+static GdkPixbuf *
+create_solid_icon (guint8 red,
+                   guint8 green,
+                   guint8 blue)
+{
+	GdkPixbuf *pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8, 32, 32);
+	guint8 *pixels = gdk_pixbuf_get_pixels (pixbuf);
+	gint rowstride = gdk_pixbuf_get_rowstride (pixbuf);
+
+	for (gint y = 0; y < 32; y++) {
+		for (gint x = 0; x < 32; x++) {
+			guint8 *p = pixels + y * rowstride + x * 4;
+			p[0] = red;
+			p[1] = green;
+			p[2] = blue;
+			p[3] = (y == 0 && x < 3) ? 0 : 255;
+		}
+	}
+
+	return pixbuf;
+}
+
+static void
+assert_key_colors (GArray *colors,
+                   guint8  red,
+                   guint8  green,
+                   guint8  blue)
+{
+	g_assert_nonnull (colors);
+	g_assert_cmpuint (colors->len, >, 0);
+
+	for (guint i = 0; i < colors->len; i++) {
+		const GdkRGBA *color = &g_array_index (colors, GdkRGBA, i);
+		g_assert_cmpint ((gint) (color->red * 255.0 + 0.5), ==, red);
+		g_assert_cmpint ((gint) (color->green * 255.0 + 0.5), ==, green);
+		g_assert_cmpint ((gint) (color->blue * 255.0 + 0.5), ==, blue);
+	}
+}
+
+static void
+gs_key_colors_func (void)
+{
+	g_autoptr(GPtrArray) pixbufs = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GPtrArray) results = NULL;
+	g_autoptr(GArray) colors = NULL;
+	g_autoptr(GArray) cached_colors = NULL;
+
+	g_ptr_array_add (pixbufs, create_solid_icon (200, 16, 70));
+	g_ptr_array_add (pixbufs, create_solid_icon (0, 128, 255));
+	g_ptr_array_add (pixbufs, create_solid_icon (33, 33, 33));
+
+	colors = gs_calculate_key_colors (pixbufs->pdata[0]);
+	assert_key_colors (colors, 200, 16, 70);
+	g_clear_pointer (&colors, g_array_unref);
+	colors = gs_calculate_key_colors (pixbufs->pdata[2]);
+	assert_key_colors (colors, 33, 33, 33);
+
+	/* the batch results come back in order */
+	results = gs_calculate_key_colors_batch (pixbufs, GS_KEY_COLORS_FLAGS_NONE);
+	g_assert_cmpuint (results->len, ==, 3);
+	assert_key_colors (results->pdata[0], 200, 16, 70);
+	assert_key_colors (results->pdata[1], 0, 128, 255);
+	assert_key_colors (results->pdata[2], 33, 33, 33);
+
+	/* the second lookup comes from the cache */
+	g_clear_pointer (&colors, g_array_unref);
+	colors = gs_calculate_key_colors_full (pixbufs->pdata[1], GS_KEY_COLORS_FLAGS_USE_CACHE);
+	cached_colors = gs_calculate_key_colors_full (pixbufs->pdata[1], GS_KEY_COLORS_FLAGS_USE_CACHE);
+	assert_key_colors (cached_colors, 0, 128, 255);
+	g_assert_cmpuint (cached_colors->len, ==, colors->len);
+}
+
+static void
+gs_utils_pixbuf_blur_func (void)
+{
+	g_autoptr(GdkPixbuf) solid = create_solid_icon (200, 16, 70);
+	g_autoptr(GdkPixbuf) copy = gdk_pixbuf_copy (solid);
+	g_autoptr(GdkPixbuf) edge = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, 256, 512);
+	guint8 *pixels;
+	gint rowstride;
+
+	/* a solid colour stays the same, and the alpha channel is untouched */
+	gs_utils_pixbuf_blur (solid, 5, 3);
+	g_assert_true (g_bytes_equal (gdk_pixbuf_read_pixel_bytes (solid),
+				      gdk_pixbuf_read_pixel_bytes (copy)));
+
+	/* a horizontal edge big enough to be split into bands of rows, which
+	 * are blurred in parallel, becomes a vertical gradient, the same
+	 * across each row */
+	pixels = gdk_pixbuf_get_pixels (edge);
+	rowstride = gdk_pixbuf_get_rowstride (edge);
+	for (gint y = 0; y < 512; y++)
+		memset (pixels + y * rowstride, (y < 256) ? 0 : 255, 256 * 3);
+
+	gs_utils_pixbuf_blur (edge, 5, 3);
+
+	g_assert_cmpuint (pixels[0], ==, 0);
+	g_assert_cmpuint (pixels[511 * rowstride], ==, 255);
+	g_assert_cmpuint (pixels[255 * rowstride], >, 0);
+	g_assert_cmpuint (pixels[256 * rowstride], <, 255);
+	for (gint y = 0; y < 512; y++) {
+		const guint8 *row = pixels + y * rowstride;
+
+		for (gint i = 1; i < 256 * 3; i++)
+			g_assert_cmpuint (row[i], ==, row[0]);
+		if (y > 0)
+			g_assert_cmpuint (row[0], >=, row[-rowstride]);
+	}
+}
+
+static void
+gs_worker_thread_pool_func (void)
+{
+	g_autoptr(GMainContext) context = g_main_context_new ();
+	g_autoptr(GMainContextPusher) context_pusher = g_main_context_pusher_new (context);
+	g_autoptr(GsWorkerThread) worker = gs_worker_thread_new_pool ("gs-self-test", 3);
+	g_autoptr(GAsyncResult) result = NULL;
+	g_autoptr(GError) error = NULL;
+	WorkerPoolData data = { NULL, };
+	const guint n_tasks = 50;
+
+	data.worker = worker;
+	g_mutex_init (&data.mutex);
+	data.serial_order = g_array_new (FALSE, FALSE, sizeof (guint));
+
+	g_assert_false (gs_worker_thread_is_in_worker_context (worker));
+
+	for (guint i = 0; i < n_tasks; i++) {
+		g_autoptr(GTask) serial_task = g_task_new (NULL, NULL, worker_pool_done_cb, &data);
+		g_autoptr(GTask) parallel_task = g_task_new (NULL, NULL, worker_pool_done_cb, &data);
+
+		g_task_set_task_data (serial_task, &data, NULL);
+		g_object_set_data (G_OBJECT (serial_task), "idx", GUINT_TO_POINTER (i));
+		gs_worker_thread_queue (worker, G_PRIORITY_DEFAULT,
+					worker_pool_serial_cb, g_steal_pointer (&serial_task));
+
+		g_task_set_task_data (parallel_task, &data, NULL);
+		gs_worker_thread_queue_parallel (worker, G_PRIORITY_DEFAULT,
+						 worker_pool_parallel_cb, g_steal_pointer (&parallel_task));
+	}
+
+	while (data.n_done < n_tasks * 2)
+		g_main_context_iteration (context, TRUE);
+
+	/* serialised tasks run in the order they were queued, on one thread */
+	g_assert_cmpuint (data.serial_order->len, ==, n_tasks);
+	for (guint i = 0; i < n_tasks; i++)
+		g_assert_cmpuint (g_array_index (data.serial_order, guint, i), ==, i);
+	g_assert_cmpuint (data.n_parallel, ==, n_tasks);
+
+	gs_worker_thread_shutdown_async (worker, NULL, async_result_cb, &result);
+	while (result == NULL)
+		g_main_context_iteration (context, TRUE);
+	g_assert_true (gs_worker_thread_shutdown_finish (worker, result, &error));
+	g_assert_no_error (error);
+
+	g_array_unref (data.serial_order);
+	g_mutex_clear (&data.mutex);
+}
+
+static void
+gs_worker_thread_pool_steal_func (void)
+{
+	g_autoptr(GMainContext) context = g_main_context_new ();
+	g_autoptr(GMainContextPusher) context_pusher = g_main_context_pusher_new (context);
+	g_autoptr(GsWorkerThread) worker = gs_worker_thread_new_pool ("gs-self-test", 2);
+	g_autoptr(GTask) blocking_task = NULL;
+	g_autoptr(GAsyncResult) result = NULL;
+	g_autoptr(GError) error = NULL;
+	WorkerPoolData data = { NULL, };
+	const guint n_tasks = 50;
+
+	data.worker = worker;
+	g_mutex_init (&data.mutex);
+	g_cond_init (&data.cond);
+
+	/* block the first worker thread with a serialised task */
+	blocking_task = g_task_new (NULL, NULL, worker_pool_done_cb, &data);
+	g_task_set_task_data (blocking_task, &data, NULL);
+	gs_worker_thread_queue (worker, G_PRIORITY_DEFAULT,
+				worker_pool_blocking_cb, g_steal_pointer (&blocking_task));
+
+	g_mutex_lock (&data.mutex);
+	while (!data.blocked)
+		g_cond_wait (&data.cond, &data.mutex);
+	g_mutex_unlock (&data.mutex);
+
+	/* the parallel tasks queued behind it are all run by the other
+	 * worker thread, including the ones which are queued to the blocked
+	 * one while the other is busy */
+	for (guint i = 0; i < n_tasks; i++) {
+		g_autoptr(GTask) parallel_task = g_task_new (NULL, NULL, worker_pool_done_cb, &data);
+
+		g_task_set_task_data (parallel_task, &data, NULL);
+		gs_worker_thread_queue_parallel (worker, G_PRIORITY_DEFAULT,
+						 worker_pool_parallel_cb, g_steal_pointer (&parallel_task));
+	}
+
+	while (data.n_done < n_tasks)
+		g_main_context_iteration (context, TRUE);
+
+	g_mutex_lock (&data.mutex);
+	g_assert_cmpuint (data.n_parallel, ==, n_tasks);
+	g_assert_false (data.released);
+	data.released = TRUE;
+	g_cond_broadcast (&data.cond);
+	g_mutex_unlock (&data.mutex);
+
+	while (data.n_done < n_tasks + 1)
+		g_main_context_iteration (context, TRUE);
+
+	gs_worker_thread_shutdown_async (worker, NULL, async_result_cb, &result);
+	while (result == NULL)
+		g_main_context_iteration (context, TRUE);
+	g_assert_true (gs_worker_thread_shutdown_finish (worker, result, &error));
+	g_assert_no_error (error);
+
+	g_cond_clear (&data.cond);
+	g_mutex_clear (&data.mutex);
+}
+
+static void
+gs_plugin_loader_job_latency_func (void)
+{
+	GsPluginLoaderJobLatency latency = { 0, };
+
+	/* not enough samples to judge yet */
+	gs_plugin_loader_job_latency_add_sample (&latency, 10.0);
+	gs_plugin_loader_job_latency_add_sample (&latency, 100.0);
+	g_assert_false (gs_plugin_loader_job_latency_is_degraded (&latency));
+
+	/* settle on a steady latency */
+	for (guint i = 0; i < 15; i++)
+		gs_plugin_loader_job_latency_add_sample (&latency, 10.0);
+	g_assert_false (gs_plugin_loader_job_latency_is_degraded (&latency));
+
+	/* jobs suddenly taking five times as long halve the limit… */
+	for (guint i = 0; i < 3; i++)
+		gs_plugin_loader_job_latency_add_sample (&latency, 50.0);
+	g_assert_true (gs_plugin_loader_job_latency_is_degraded (&latency));
+
+	/* …until they recover */
+	for (guint i = 0; i < 5; i++)
+		gs_plugin_loader_job_latency_add_sample (&latency, 10.0);
+	g_assert_false (gs_plugin_loader_job_latency_is_degraded (&latency));
+
+	/* a job type which has become slower for good stops being degraded
+	 * once the baseline has caught up with it */
+	for (guint i = 0; i < 3; i++)
+		gs_plugin_loader_job_latency_add_sample (&latency, 50.0);
+	g_assert_true (gs_plugin_loader_job_latency_is_degraded (&latency));
+	for (guint i = 0; i < 100; i++)
+		gs_plugin_loader_job_latency_add_sample (&latency, 50.0);
+	g_assert_false (gs_plugin_loader_job_latency_is_degraded (&latency));
+}
+
 int
 main (int argc, char **argv)
 {
@@ -805,19 +1910,37 @@ main (int argc, char **argv)
 	g_test_add_func ("/gnome-software/lib/utils{wilson}", gs_utils_wilson_func);
 	g_test_add_func ("/gnome-software/lib/utils{error}", gs_utils_error_func);
 	g_test_add_func ("/gnome-software/lib/utils{cache}", gs_utils_cache_func);
+	g_test_add_func ("/gnome-software/lib/utils{file-size}", gs_utils_file_size_func);
+	g_test_add_func ("/gnome-software/lib/utils{pixbuf-blur}", gs_utils_pixbuf_blur_func);
 	g_test_add_func ("/gnome-software/lib/utils{append-kv}", gs_utils_append_kv_func);
+	g_test_add_func ("/gnome-software/lib/utils{lock-stalls}", gs_utils_lock_stalls_func);
+	g_test_add_func ("/gnome-software/lib/utils{glob-set}", gs_utils_glob_set_func);
+	g_test_add_func ("/gnome-software/lib/utils{glob-set-performance}", gs_utils_glob_set_performance_func);
 	g_test_add_func ("/gnome-software/lib/os-release", gs_os_release_func);
 	g_test_add_func ("/gnome-software/lib/app", gs_app_func);
 	g_test_add_func ("/gnome-software/lib/app/progress-clamping", gs_app_progress_clamping_func);
+	g_test_add_func ("/gnome-software/lib/app/notify-coalesce", gs_app_notify_coalesce_func);
+	g_test_add_func ("/gnome-software/lib/app/memory", gs_app_memory_func);
 	g_test_add_func ("/gnome-software/lib/app{addons}", gs_app_addons_func);
 	g_test_add_func ("/gnome-software/lib/app{unique-id}", gs_app_unique_id_func);
 	g_test_add_data_func ("/gnome-software/lib/app{thread}", debug, gs_app_thread_func);
 	g_test_add_func ("/gnome-software/lib/app{list}", gs_app_list_func);
 	g_test_add_func ("/gnome-software/lib/app{list-wildcard-dedupe}", gs_app_list_wildcard_dedupe_func);
 	g_test_add_func ("/gnome-software/lib/app{list-performance}", gs_app_list_performance_func);
+	g_test_add_func ("/gnome-software/lib/app{list-performance-large}", gs_app_list_performance_large_func);
+	g_test_add_func ("/gnome-software/lib/app{list-performance-interleaved}", gs_app_list_performance_interleaved_func);
 	g_test_add_func ("/gnome-software/lib/app{list-related}", gs_app_list_related_func);
+	g_test_add_func ("/gnome-software/lib/cache-manager", gs_cache_manager_func);
 	g_test_add_func ("/gnome-software/lib/plugin", gs_plugin_func);
 	g_test_add_func ("/gnome-software/lib/plugin{download-rewrite}", gs_plugin_download_rewrite_func);
+	g_test_add_func ("/gnome-software/lib/plugin{download-rewrite-batch}", gs_plugin_download_rewrite_batch_func);
+#if SOUP_CHECK_VERSION(3, 0, 0)
+	g_test_add_func ("/gnome-software/lib/remote-icon", gs_remote_icon_func);
+#endif
+	g_test_add_func ("/gnome-software/lib/worker-thread{pool}", gs_worker_thread_pool_func);
+	g_test_add_func ("/gnome-software/lib/worker-thread{pool-steal}", gs_worker_thread_pool_steal_func);
+	g_test_add_func ("/gnome-software/lib/key-colors", gs_key_colors_func);
+	g_test_add_func ("/gnome-software/lib/plugin-loader{job-latency}", gs_plugin_loader_job_latency_func);
 
 	return g_test_run ();
 }
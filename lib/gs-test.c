@@ -10,6 +10,7 @@
 #include <gtk/gtk.h>
 
 #include "gs-plugin-loader-sync.h"
+#include "gs-profiler.h"
 #include "gs-test.h"
 
 /**
@@ -122,9 +123,7 @@ gs_test_reinitialise_plugin_loader (GsPluginLoader      *plugin_loader,
                                     const gchar * const *blocklist)
 {
 	g_autoptr(GError) local_error = NULL;
-#ifdef HAVE_SYSPROF
-	gint64 begin_time_nsec G_GNUC_UNUSED = SYSPROF_CAPTURE_CURRENT_TIME;
-#endif
+	gint64 begin_time_nsec G_GNUC_UNUSED = GS_PROFILER_CURRENT_TIME;
 
 	/* Shut down */
 	gs_plugin_loader_shutdown (plugin_loader, NULL);
@@ -140,16 +139,5 @@ gs_test_reinitialise_plugin_loader (GsPluginLoader      *plugin_loader,
 	gs_plugin_loader_setup (plugin_loader, allowlist, blocklist, NULL, &local_error);
 	g_assert_no_error (local_error);
 
-#ifdef HAVE_SYSPROF
-	if (plugin_loader->sysprof_writer != NULL) {
-		sysprof_capture_writer_add_mark (plugin_loader->sysprof_writer,
-						 begin_time_nsec,
-						 sched_getcpu (),
-						 getpid (),
-						 SYSPROF_CAPTURE_CURRENT_TIME - begin_time_nsec,
-						 "gnome-software",
-						 "setup-again",
-						 NULL);
-	}
-#endif  /* HAVE_SYSPROF */
+	GS_PROFILER_ADD_MARK (TestReinitialise, begin_time_nsec, "setup-again", NULL);
 }
@@ -20,10 +20,14 @@
 
 #include "config.h"
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <math.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <glib/gi18n-lib.h>
 #include <glib/gstdio.h>
 #include <json-glib/json-glib.h>
@@ -383,6 +387,8 @@ gs_utils_get_content_type (GFile *file,
  *
  * Matches a string against a list of globs.
  *
+ * To match many strings against the same list, use a #GsGlobSet instead.
+ *
  * Returns: %TRUE if the list matches
  */
 gboolean
@@ -402,6 +408,739 @@ gs_utils_strv_fnmatch (gchar **strv, const gchar *str)
 	return FALSE;
 }
 
+/* Compiled glob matching
+ *
+ * Each pattern is parsed into a sequence of tokens. Patterns with no
+ * wildcards go into a hash table. The others are split into a literal prefix,
+ * which is compared directly and used to bucket the patterns by their first
+ * byte, and the remaining tokens, which are compiled into a bit-parallel NFA:
+ * bit `i` of the state is set if the string so far can be matched by the
+ * first `i` tokens. Each step of the NFA is then a couple of bitwise
+ * operations, regardless of how many `*` wildcards the pattern has.
+ *
+ * The transition tables are indexed by a ‘row’ for each byte rather than by
+ * the byte itself. Bytes which no pattern mentions share row 0, so the tables
+ * stay small even for large sets of patterns.
+ *
+ * fnmatch() is still used for anything the compiler doesn’t handle: non-ASCII
+ * patterns or strings (where fnmatch() matches multi-byte characters),
+ * malformed bracket expressions or ones using equivalence classes or
+ * collating symbols, and patterns which would need more than 63 NFA states. */
+
+typedef enum {
+	GLOB_TOKEN_LITERAL,
+	GLOB_TOKEN_ANY,
+	GLOB_TOKEN_STAR,
+	GLOB_TOKEN_CLASS,
+} GlobTokenKind;
+
+typedef struct {
+	GlobTokenKind	 kind;
+	guint8		 literal;  /* for GLOB_TOKEN_LITERAL */
+	guint32		 class_bits[4];  /* for GLOB_TOKEN_CLASS, a bit per ASCII byte */
+} GlobToken;
+
+#define GLOB_MAX_NFA_STATES 63
+
+typedef struct {
+	const gchar	*pattern;  /* (unowned) */
+	gchar		*prefix;  /* (owned) unescaped literal prefix */
+	gsize		 prefix_len;
+	gchar		*suffix;  /* (owned) (nullable) literal suffix after the last ‘*’ */
+	gsize		 suffix_len;
+	guint		 n_states;
+	guint64		 star_mask;
+	guint64		*accept;  /* (owned) indexed by byte row */
+} GlobNfa;
+
+struct _GsGlobSet {
+	gchar		**patterns;  /* (owned) (nullable) */
+	GHashTable	*literals;  /* (owned) unescaped pattern ~> (unowned) pattern */
+	GlobNfa		*nfas;  /* (owned) (array length=n_nfas) sorted by first byte of prefix */
+	guint		 n_nfas;
+	guint		 bucket_start[129];  /* index into @nfas for each first byte; 0 is for patterns with no prefix */
+	guint8		 byte_rows[128];
+	guint		 n_rows;
+	GPtrArray	*fallbacks;  /* (owned) (element-type utf8) (unowned) patterns left to fnmatch() */
+};
+
+static inline void
+glob_class_add (guint32 *class_bits,
+                guint8   c)
+{
+	class_bits[c / 32] |= (1u << (c % 32));
+}
+
+static inline gboolean
+glob_class_has (const guint32 *class_bits,
+                guint8         c)
+{
+	return (class_bits[c / 32] & (1u << (c % 32))) != 0;
+}
+
+static gboolean
+glob_class_add_named (guint32     *class_bits,
+                      const gchar *name)
+{
+	for (guint8 c = 1; c < 128; c++) {
+		gboolean in_class;
+
+		if (g_str_equal (name, "alnum"))
+			in_class = g_ascii_isalnum (c);
+		else if (g_str_equal (name, "alpha"))
+			in_class = g_ascii_isalpha (c);
+		else if (g_str_equal (name, "blank"))
+			in_class = (c == ' ' || c == '\t');
+		else if (g_str_equal (name, "cntrl"))
+			in_class = g_ascii_iscntrl (c);
+		else if (g_str_equal (name, "digit"))
+			in_class = g_ascii_isdigit (c);
+		else if (g_str_equal (name, "graph"))
+			in_class = g_ascii_isgraph (c);
+		else if (g_str_equal (name, "lower"))
+			in_class = g_ascii_islower (c);
+		else if (g_str_equal (name, "print"))
+			in_class = g_ascii_isprint (c);
+		else if (g_str_equal (name, "punct"))
+			in_class = g_ascii_ispunct (c);
+		else if (g_str_equal (name, "space"))
+			in_class = g_ascii_isspace (c);
+		else if (g_str_equal (name, "upper"))
+			in_class = g_ascii_isupper (c);
+		else if (g_str_equal (name, "xdigit"))
+			in_class = g_ascii_isxdigit (c);
+		else
+			return FALSE;
+
+		if (in_class)
+			glob_class_add (class_bits, c);
+	}
+
+	return TRUE;
+}
+
+/* Parse the bracket expression starting after the ‘[’ at @p. Returns a
+ * pointer after the closing ‘]’, or sets @out_unsupported and returns %NULL if
+ * the expression can’t be compiled. */
+static const gchar *
+glob_parse_bracket (const gchar *p,
+                    guint32     *class_bits,
+                    gboolean    *out_unsupported)
+{
+	gboolean negate = FALSE;
+	gboolean first = TRUE;
+
+	if (*p == '!' || *p == '^') {
+		negate = TRUE;
+		p++;
+	}
+
+	while (*p != '\0' && (*p != ']' || first)) {
+		guint8 lo, hi;
+
+		first = FALSE;
+
+		if (p[0] == '[' && (p[1] == '=' || p[1] == '.')) {
+			*out_unsupported = TRUE;
+			return NULL;
+		}
+
+		/* an unterminated ‘[:’ is treated as literal characters */
+		if (p[0] == '[' && p[1] == ':' && strstr (p + 2, ":]") != NULL) {
+			const gchar *end = strstr (p + 2, ":]");
+			g_autofree gchar *name = g_strndup (p + 2, end - (p + 2));
+
+			if (!glob_class_add_named (class_bits, name)) {
+				*out_unsupported = TRUE;
+				return NULL;
+			}
+			p = end + 2;
+			continue;
+		}
+
+		if (p[0] == '\\' && p[1] != '\0')
+			p++;
+		lo = hi = (guint8) *p++;
+
+		if (p[0] == '-' && p[1] != ']' && p[1] != '\0') {
+			p++;
+			if (p[0] == '\\' && p[1] != '\0')
+				p++;
+			else if (p[0] == '[')
+				*out_unsupported = TRUE;
+			hi = (guint8) *p++;
+		}
+		if (lo > hi)
+			*out_unsupported = TRUE;
+		if (*out_unsupported)
+			return NULL;
+
+		for (guint c = lo; c <= hi; c++)
+			glob_class_add (class_bits, c);
+	}
+
+	/* fnmatch() is inconsistent about unterminated expressions, so leave
+	 * them to it */
+	if (*p != ']') {
+		*out_unsupported = TRUE;
+		return NULL;
+	}
+
+	if (negate) {
+		for (guint i = 0; i < 4; i++)
+			class_bits[i] = ~class_bits[i];
+	}
+
+	/* The NUL byte is never part of a string */
+	class_bits[0] &= ~1u;
+
+	return p + 1;
+}
+
+/* Parse @pattern into @tokens, returning %FALSE if it can’t be compiled. The
+ * first @skip bytes are known to be literals, and aren’t added to @tokens. */
+static gboolean
+glob_parse (const gchar *pattern,
+            gsize        skip,
+            GArray      *tokens)
+{
+	for (const gchar *p = pattern; *p != '\0'; p++) {
+		if ((guint8) *p >= 0x80)
+			return FALSE;
+	}
+
+	for (const gchar *p = pattern + skip; *p != '\0';) {
+		GlobToken token = { 0, };
+
+		switch (*p) {
+		case '*':
+			p++;
+			/* ‘**’ is the same as ‘*’ */
+			if (tokens->len > 0 &&
+			    g_array_index (tokens, GlobToken, tokens->len - 1).kind == GLOB_TOKEN_STAR)
+				continue;
+			token.kind = GLOB_TOKEN_STAR;
+			break;
+		case '?':
+			p++;
+			token.kind = GLOB_TOKEN_ANY;
+			break;
+		case '[': {
+			gboolean unsupported = FALSE;
+			const gchar *end = glob_parse_bracket (p + 1, token.class_bits, &unsupported);
+
+			if (unsupported)
+				return FALSE;
+			token.kind = GLOB_TOKEN_CLASS;
+			p = end;
+			break;
+		}
+		case '\\':
+			/* a trailing backslash is an error to fnmatch() */
+			if (p[1] == '\0')
+				return FALSE;
+			p++;
+			token.kind = GLOB_TOKEN_LITERAL;
+			token.literal = (guint8) *p++;
+			break;
+		default:
+			token.kind = GLOB_TOKEN_LITERAL;
+			token.literal = (guint8) *p++;
+			break;
+		}
+
+		g_array_append_val (tokens, token);
+	}
+
+	return TRUE;
+}
+
+/* Build the string of @head followed by the literal @tokens from @start to @end. */
+static gchar *
+glob_tokens_to_string (const gchar *head,
+                       gsize        head_len,
+                       GArray      *tokens,
+                       guint        start,
+                       guint        end)
+{
+	gchar *str = g_new (gchar, head_len + end - start + 1);
+
+	memcpy (str, head, head_len);
+	for (guint i = start; i < end; i++)
+		str[head_len + i - start] = (gchar) g_array_index (tokens, GlobToken, i).literal;
+	str[head_len + end - start] = '\0';
+
+	return str;
+}
+
+static guint8
+glob_nfa_get_first_byte (const GlobNfa *nfa)
+{
+	return (nfa->prefix_len > 0) ? (guint8) nfa->prefix[0] : 0;
+}
+
+static gint
+glob_nfa_compare_first_byte (gconstpointer a,
+                             gconstpointer b)
+{
+	return (gint) glob_nfa_get_first_byte (a) - (gint) glob_nfa_get_first_byte (b);
+}
+
+/**
+ * gs_glob_set_new:
+ * @patterns: (nullable) (array zero-terminated=1): glob patterns, as
+ *   understood by `fnmatch()` with no flags
+ *
+ * Compile @patterns into a set which strings can be matched against. This is
+ * equivalent to calling `fnmatch()` with each pattern in turn, but much
+ * faster when matching many strings against more than a couple of patterns.
+ *
+ * The set is immutable, so it can be used from multiple threads.
+ *
+ * Returns: (transfer full): a new #GsGlobSet
+ * Since: 47
+ */
+GsGlobSet *
+gs_glob_set_new (const gchar * const *patterns)
+{
+	GsGlobSet *self = g_atomic_rc_box_new0 (GsGlobSet);
+	g_autoptr(GArray) nfas = g_array_new (FALSE, TRUE, sizeof (GlobNfa));
+	g_autoptr(GArray) tokens = g_array_new (FALSE, TRUE, sizeof (GlobToken));
+	g_autoptr(GArray) nfa_tokens = g_array_new (FALSE, FALSE, sizeof (GlobToken));  /* concatenated tokens of all @nfas */
+	g_autoptr(GArray) nfa_tokens_start = g_array_new (FALSE, FALSE, sizeof (guint));
+	gboolean byte_used[128] = { FALSE, };
+	guint8 row_bytes[128] = { 0, };
+
+	self->patterns = g_strdupv ((gchar **) patterns);
+	self->literals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->fallbacks = g_ptr_array_new ();
+
+	for (guint i = 0; self->patterns != NULL && self->patterns[i] != NULL; i++) {
+		const gchar *pattern = self->patterns[i];
+		GlobNfa nfa = { NULL, };
+		gsize skip;
+		guint prefix_len, suffix_start;
+
+		/* the literal prefix of most patterns needs no tokenizing */
+		skip = strcspn (pattern, "*?[\\");
+
+		g_array_set_size (tokens, 0);
+		if (!glob_parse (pattern, skip, tokens)) {
+			g_ptr_array_add (self->fallbacks, (gpointer) pattern);
+			continue;
+		}
+
+		for (prefix_len = 0; prefix_len < tokens->len; prefix_len++) {
+			if (g_array_index (tokens, GlobToken, prefix_len).kind != GLOB_TOKEN_LITERAL)
+				break;
+		}
+
+		/* no wildcards */
+		if (prefix_len == tokens->len) {
+			g_hash_table_insert (self->literals,
+					     glob_tokens_to_string (pattern, skip, tokens, 0, prefix_len),
+					     (gpointer) pattern);
+			continue;
+		}
+
+		if (tokens->len - prefix_len > GLOB_MAX_NFA_STATES) {
+			g_ptr_array_add (self->fallbacks, (gpointer) pattern);
+			continue;
+		}
+
+		/* A literal suffix after the last ‘*’ must match the end of
+		 * the string, which is a cheap check to do before the NFA. */
+		for (suffix_start = tokens->len; suffix_start > prefix_len; suffix_start--) {
+			if (g_array_index (tokens, GlobToken, suffix_start - 1).kind != GLOB_TOKEN_LITERAL)
+				break;
+		}
+		if (suffix_start < tokens->len &&
+		    g_array_index (tokens, GlobToken, suffix_start - 1).kind == GLOB_TOKEN_STAR) {
+			nfa.suffix = glob_tokens_to_string (NULL, 0, tokens, suffix_start, tokens->len);
+			nfa.suffix_len = tokens->len - suffix_start;
+		}
+
+		nfa.pattern = pattern;
+		nfa.prefix = glob_tokens_to_string (pattern, skip, tokens, 0, prefix_len);
+		nfa.prefix_len = skip + prefix_len;
+		nfa.n_states = tokens->len - prefix_len;
+
+		/* note which bytes the NFA needs to tell apart */
+		for (guint j = prefix_len; j < tokens->len; j++) {
+			const GlobToken *token = &g_array_index (tokens, GlobToken, j);
+
+			if (token->kind == GLOB_TOKEN_LITERAL) {
+				byte_used[token->literal] = TRUE;
+			} else if (token->kind == GLOB_TOKEN_CLASS) {
+				for (guint8 c = 1; c < 128; c++) {
+					if (glob_class_has (token->class_bits, c))
+						byte_used[c] = TRUE;
+				}
+			}
+		}
+
+		g_array_append_val (nfas, nfa);
+		g_array_append_val (nfa_tokens_start, nfa_tokens->len);
+		g_array_append_vals (nfa_tokens, &g_array_index (tokens, GlobToken, prefix_len), nfa.n_states);
+	}
+
+	/* assign rows to the bytes which are used; the rest share row 0 */
+	self->n_rows = 1;
+	for (guint8 c = 1; c < 128; c++) {
+		if (byte_used[c]) {
+			self->byte_rows[c] = self->n_rows;
+			row_bytes[self->n_rows] = c;
+			self->n_rows++;
+		}
+	}
+
+	/* build the transition tables */
+	for (guint i = 0; i < nfas->len; i++) {
+		GlobNfa *nfa = &g_array_index (nfas, GlobNfa, i);
+		const GlobToken *nfa_token = &g_array_index (nfa_tokens, GlobToken,
+							     g_array_index (nfa_tokens_start, guint, i));
+
+		nfa->accept = g_new0 (guint64, self->n_rows);
+
+		for (guint j = 0; j < nfa->n_states; j++) {
+			const GlobToken *token = &nfa_token[j];
+			guint64 bit = G_GUINT64_CONSTANT (1) << j;
+
+			switch (token->kind) {
+			case GLOB_TOKEN_LITERAL:
+				nfa->accept[self->byte_rows[token->literal]] |= bit;
+				break;
+			case GLOB_TOKEN_ANY:
+				for (guint r = 0; r < self->n_rows; r++)
+					nfa->accept[r] |= bit;
+				break;
+			case GLOB_TOKEN_STAR:
+				nfa->star_mask |= bit;
+				break;
+			case GLOB_TOKEN_CLASS:
+				for (guint r = 1; r < self->n_rows; r++) {
+					if (glob_class_has (token->class_bits, row_bytes[r]))
+						nfa->accept[r] |= bit;
+				}
+				break;
+			default:
+				g_assert_not_reached ();
+			}
+		}
+	}
+
+	/* bucket the NFAs by the first byte of their prefix */
+	g_array_sort (nfas, glob_nfa_compare_first_byte);
+	self->n_nfas = nfas->len;
+	self->nfas = (GlobNfa *) g_array_free (g_steal_pointer (&nfas), FALSE);
+
+	for (guint b = 0, i = 0; b < G_N_ELEMENTS (self->bucket_start); b++) {
+		self->bucket_start[b] = i;
+		while (i < self->n_nfas && glob_nfa_get_first_byte (&self->nfas[i]) == b)
+			i++;
+	}
+
+	return self;
+}
+
+/**
+ * gs_glob_set_ref:
+ * @self: a #GsGlobSet
+ *
+ * Increment the reference count of @self.
+ *
+ * Returns: (transfer full): @self
+ * Since: 47
+ */
+GsGlobSet *
+gs_glob_set_ref (GsGlobSet *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+
+	return g_atomic_rc_box_acquire (self);
+}
+
+static void
+glob_set_clear (GsGlobSet *self)
+{
+	for (guint i = 0; i < self->n_nfas; i++) {
+		g_free (self->nfas[i].prefix);
+		g_free (self->nfas[i].suffix);
+		g_free (self->nfas[i].accept);
+	}
+	g_free (self->nfas);
+	g_ptr_array_unref (self->fallbacks);
+	g_hash_table_unref (self->literals);
+	g_strfreev (self->patterns);
+}
+
+/**
+ * gs_glob_set_unref:
+ * @self: (transfer full): a #GsGlobSet
+ *
+ * Decrement the reference count of @self, freeing it if it reaches zero.
+ *
+ * Since: 47
+ */
+void
+gs_glob_set_unref (GsGlobSet *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_atomic_rc_box_release_full (self, (GDestroyNotify) glob_set_clear);
+}
+
+static gboolean
+glob_nfa_match (const GsGlobSet *self,
+                const GlobNfa   *nfa,
+                const gchar     *str,
+                gsize            len)
+{
+	guint64 state;
+
+	if (len < nfa->prefix_len + nfa->suffix_len)
+		return FALSE;
+	if (memcmp (str, nfa->prefix, nfa->prefix_len) != 0)
+		return FALSE;
+	if (nfa->suffix_len > 0 &&
+	    memcmp (str + len - nfa->suffix_len, nfa->suffix, nfa->suffix_len) != 0)
+		return FALSE;
+
+	/* a ‘*’ can always match nothing */
+	state = 1;
+	state |= (state & nfa->star_mask) << 1;
+
+	for (gsize i = nfa->prefix_len; i < len; i++) {
+		guint64 accept = nfa->accept[self->byte_rows[(guint8) str[i]]];
+
+		state = ((state & accept) << 1) | (state & nfa->star_mask);
+		state |= (state & nfa->star_mask) << 1;
+		if (state == 0)
+			return FALSE;
+	}
+
+	return (state & (G_GUINT64_CONSTANT (1) << nfa->n_states)) != 0;
+}
+
+/**
+ * gs_glob_set_lookup:
+ * @self: a #GsGlobSet
+ * @str: string to match
+ *
+ * Match @str against the patterns in @self.
+ *
+ * If more than one pattern matches, which of them is returned is undefined.
+ *
+ * Returns: (nullable): a pattern which matches @str, or %NULL if none do
+ * Since: 47
+ */
+const gchar *
+gs_glob_set_lookup (GsGlobSet   *self,
+                    const gchar *str)
+{
+	const gchar *pattern;
+	gsize len;
+	guint8 first;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (str != NULL, NULL);
+
+	for (len = 0; str[len] != '\0'; len++) {
+		if ((guint8) str[len] >= 0x80) {
+			for (guint i = 0; self->patterns != NULL && self->patterns[i] != NULL; i++) {
+				if (fnmatch (self->patterns[i], str, 0) == 0)
+					return self->patterns[i];
+			}
+			return NULL;
+		}
+	}
+
+	pattern = g_hash_table_lookup (self->literals, str);
+	if (pattern != NULL)
+		return pattern;
+
+	first = (guint8) str[0];
+	for (guint i = self->bucket_start[first]; i < self->bucket_start[first + 1]; i++) {
+		if (glob_nfa_match (self, &self->nfas[i], str, len))
+			return self->nfas[i].pattern;
+	}
+	if (first != 0) {
+		for (guint i = self->bucket_start[0]; i < self->bucket_start[1]; i++) {
+			if (glob_nfa_match (self, &self->nfas[i], str, len))
+				return self->nfas[i].pattern;
+		}
+	}
+
+	for (guint i = 0; i < self->fallbacks->len; i++) {
+		pattern = g_ptr_array_index (self->fallbacks, i);
+		if (fnmatch (pattern, str, 0) == 0)
+			return pattern;
+	}
+
+	return NULL;
+}
+
+/**
+ * gs_glob_set_match:
+ * @self: a #GsGlobSet
+ * @str: string to match
+ *
+ * Check whether @str matches any of the patterns in @self.
+ *
+ * Returns: %TRUE if any pattern matches
+ * Since: 47
+ */
+gboolean
+gs_glob_set_match (GsGlobSet   *self,
+                   const gchar *str)
+{
+	return gs_glob_set_lookup (self, str) != NULL;
+}
+
+/* One call to gs_utils_run_in_parallel(), shared with the helper threads it
+ * pushed to the pool. Helpers which only start once the caller has finished
+ * all the work don’t run @func at all, so the caller never has to wait for
+ * the pool to get round to them. */
+typedef struct {
+	gint			 ref_count;  /* (atomic) */
+	GsUtilsParallelFunc	 func;
+	gpointer		 user_data;
+	GMutex			 mutex;
+	GCond			 cond;
+	guint			 n_running;  /* (locked-by mutex) */
+	gboolean		 closed;  /* (locked-by mutex) */
+} ParallelRun;
+
+static void
+parallel_run_unref (ParallelRun *run)
+{
+	if (!g_atomic_int_dec_and_test (&run->ref_count))
+		return;
+	g_mutex_clear (&run->mutex);
+	g_cond_clear (&run->cond);
+	g_free (run);
+}
+
+static void
+parallel_run_helper_cb (gpointer data,
+			gpointer user_data)
+{
+	ParallelRun *run = data;
+
+	g_mutex_lock (&run->mutex);
+	if (run->closed) {
+		g_mutex_unlock (&run->mutex);
+		parallel_run_unref (run);
+		return;
+	}
+	run->n_running++;
+	g_mutex_unlock (&run->mutex);
+
+	run->func (run->user_data);
+
+	g_mutex_lock (&run->mutex);
+	run->n_running--;
+	g_cond_signal (&run->cond);
+	g_mutex_unlock (&run->mutex);
+	parallel_run_unref (run);
+}
+
+static GThreadPool *
+gs_utils_get_parallel_pool (void)
+{
+	static gsize pool = 0;
+
+	if (g_once_init_enter (&pool)) {
+		GThreadPool *new_pool = g_thread_pool_new (parallel_run_helper_cb, NULL,
+							   (gint) g_get_num_processors (),
+							   FALSE, NULL);
+		g_once_init_leave (&pool, (gsize) new_pool);
+	}
+
+	return (GThreadPool *) pool;
+}
+
+/**
+ * gs_utils_rw_lock_reader_locker_new:
+ * @lock: a #GRWLock
+ * @stalls: statistics to add to if the lock is contended
+ *
+ * Like g_rw_lock_reader_locker_new(), but if @lock is held by a writer,
+ * counts the wait in @stalls.
+ *
+ * Returns: (transfer full): a #GRWLockReaderLocker
+ *
+ * Since: 47
+ **/
+GRWLockReaderLocker *
+gs_utils_rw_lock_reader_locker_new (GRWLock           *lock,
+				    GsUtilsLockStalls *stalls)
+{
+	if (!g_rw_lock_reader_trylock (lock)) {
+		gint64 begin = g_get_monotonic_time ();
+		g_rw_lock_reader_lock (lock);
+		g_atomic_int_inc (&stalls->n_stalls);
+		g_atomic_pointer_add (&stalls->stall_usec, g_get_monotonic_time () - begin);
+	}
+	return (GRWLockReaderLocker *) lock;
+}
+
+/**
+ * gs_utils_run_in_parallel:
+ * @func: function to run
+ * @user_data: data to pass to @func
+ * @n_threads: maximum number of threads to run @func on, including the
+ *   calling thread
+ *
+ * Runs @func on the calling thread and on up to @n_threads - 1 threads from
+ * a pool shared by all callers, and waits for all of them to return. @func
+ * must take its work items from @user_data until there are none left, as the
+ * helper threads may start late, or not at all if the pool is busy.
+ *
+ * Since: 47
+ **/
+void
+gs_utils_run_in_parallel (GsUtilsParallelFunc func,
+			  gpointer            user_data,
+			  guint               n_threads)
+{
+	ParallelRun *run;
+	GThreadPool *pool;
+
+	g_return_if_fail (func != NULL);
+
+	if (n_threads <= 1) {
+		func (user_data);
+		return;
+	}
+
+	run = g_new0 (ParallelRun, 1);
+	run->ref_count = 1;
+	run->func = func;
+	run->user_data = user_data;
+	g_mutex_init (&run->mutex);
+	g_cond_init (&run->cond);
+
+	pool = gs_utils_get_parallel_pool ();
+	for (guint i = 1; i < n_threads; i++) {
+		g_atomic_int_inc (&run->ref_count);
+		if (!g_thread_pool_push (pool, run, NULL))
+			parallel_run_unref (run);
+	}
+
+	func (user_data);
+
+	/* all the work has been taken, so wait for the helpers which are
+	 * still running it, and stop any others from starting */
+	g_mutex_lock (&run->mutex);
+	run->closed = TRUE;
+	while (run->n_running > 0)
+		g_cond_wait (&run->cond, &run->mutex);
+	g_mutex_unlock (&run->mutex);
+
+	parallel_run_unref (run);
+}
+
 /**
  * gs_utils_sort_key:
  * @str: A string to convert to a sort key
@@ -1253,114 +1992,152 @@ gs_utils_build_unique_id (AsComponentScope scope,
 				_fix_data_id_part (branch));
 }
 
+typedef struct {
+	guint8		*pixels;  /* (not owned); the image being blurred */
+	gint		 rowstride;
+	guint8		*tmp;  /* (not owned); @height rows of @row_length bytes, RGB only */
+	gint		 width;
+	gint		 height;
+	gint		 n_channels;
+	gsize		 row_length;
+	gint		 radius;
+	guint32		 kernel_size;
+	guint32		 div_multiplier;  /* 0 if the kernel is too big to divide by multiplying */
+	const guint8	*div_kernel_size;  /* (not owned); sum → mean lookup table */
+	gint		 n_bands;
+	gint		 next_band;  /* (atomic) */
+	void		(*pass) (gpointer data, gint y0, gint y1);
+} BlurData;
+
+/* Horizontal pass, from @pixels to @tmp, using a sliding window along each row. */
 static void
-gs_pixbuf_blur_private (GdkPixbuf *src, GdkPixbuf *dest, guint radius, guint8 *div_kernel_size)
-{
-	gint width, height, src_rowstride, dest_rowstride, n_channels;
-	guchar *p_src, *p_dest, *c1, *c2;
-	gint x, y, i, i1, i2, width_minus_1, height_minus_1, radius_plus_1;
-	gint r, g, b;
-	guchar *p_dest_row, *p_dest_col;
-
-	width = gdk_pixbuf_get_width (src);
-	height = gdk_pixbuf_get_height (src);
-	n_channels = gdk_pixbuf_get_n_channels (src);
-	radius_plus_1 = radius + 1;
-
-	/* horizontal blur */
-	p_src = gdk_pixbuf_get_pixels (src);
-	p_dest = gdk_pixbuf_get_pixels (dest);
-	src_rowstride = gdk_pixbuf_get_rowstride (src);
-	dest_rowstride = gdk_pixbuf_get_rowstride (dest);
-	width_minus_1 = width - 1;
-	for (y = 0; y < height; y++) {
+blur_horizontal_pass (gpointer user_data,
+                      gint     y0,
+                      gint     y1)
+{
+	const BlurData *data = user_data;
+	const guint8 *div_kernel_size = data->div_kernel_size;
+	gint n_channels = data->n_channels;
+	gint radius = data->radius;
+	gint width_minus_1 = data->width - 1;
+
+	for (gint y = y0; y < y1; y++) {
+		const guint8 *p_src = data->pixels + y * data->rowstride;
+		guint8 *p_dest = data->tmp + y * data->row_length;
+		gint r = 0, g = 0, b = 0;
 
 		/* calc the initial sums of the kernel */
-		r = g = b = 0;
-		for (i = -radius; i <= (gint) radius; i++) {
-			c1 = p_src + (CLAMP (i, 0, width_minus_1) * n_channels);
-			r += c1[0];
-			g += c1[1];
-			b += c1[2];
+		for (gint i = -radius; i <= radius; i++) {
+			const guint8 *c = p_src + CLAMP (i, 0, width_minus_1) * n_channels;
+			r += c[0];
+			g += c[1];
+			b += c[2];
 		}
 
-		p_dest_row = p_dest;
-		for (x = 0; x < width; x++) {
+		for (gint x = 0; x < data->width; x++) {
+			/* the pixels to add to and remove from the kernel */
+			const guint8 *c1 = p_src + MIN (x + radius + 1, width_minus_1) * n_channels;
+			const guint8 *c2 = p_src + MAX (x - radius, 0) * n_channels;
+
 			/* set as the mean of the kernel */
-			p_dest_row[0] = div_kernel_size[r];
-			p_dest_row[1] = div_kernel_size[g];
-			p_dest_row[2] = div_kernel_size[b];
-			p_dest_row += n_channels;
-
-			/* the pixel to add to the kernel */
-			i1 = x + radius_plus_1;
-			if (i1 > width_minus_1)
-				i1 = width_minus_1;
-			c1 = p_src + (i1 * n_channels);
-
-			/* the pixel to remove from the kernel */
-			i2 = x - radius;
-			if (i2 < 0)
-				i2 = 0;
-			c2 = p_src + (i2 * n_channels);
-
-			/* calc the new sums of the kernel */
+			p_dest[0] = div_kernel_size[r];
+			p_dest[1] = div_kernel_size[g];
+			p_dest[2] = div_kernel_size[b];
+			p_dest += 3;
+
 			r += c1[0] - c2[0];
 			g += c1[1] - c2[1];
 			b += c1[2] - c2[2];
 		}
+	}
+}
 
-		p_src += src_rowstride;
-		p_dest += dest_rowstride;
+/* Vertical pass, from @tmp back to @pixels. Rather than walking down each
+ * column, which touches a new cache line for every pixel, this keeps a row of
+ * kernel sums and slides it down the image a whole row at a time, so the inner
+ * loops are over contiguous memory and can be vectorised.
+ *
+ * For kernels smaller than 256 pixels, the sums are divided by the kernel size
+ * exactly by multiplying by its rounded-up reciprocal, as 255 × kernel_size² is
+ * less than 2²⁴. */
+static void
+blur_vertical_pass (gpointer user_data,
+                    gint     y0,
+                    gint     y1)
+{
+	const BlurData *data = user_data;
+	gsize row_length = data->row_length;
+	guint32 div_multiplier = data->div_multiplier;
+	gint height_minus_1 = data->height - 1;
+	g_autofree guint32 *sums = g_new0 (guint32, row_length);
+	g_autofree guint8 *out = g_new (guint8, row_length);
+
+	/* calc the initial sums of the kernel */
+	for (gint i = y0 - data->radius; i <= y0 + data->radius; i++) {
+		const guint8 *row = data->tmp + CLAMP (i, 0, height_minus_1) * row_length;
+		for (gsize j = 0; j < row_length; j++)
+			sums[j] += row[j];
 	}
 
-	/* vertical blur */
-	p_src = gdk_pixbuf_get_pixels (dest);
-	p_dest = gdk_pixbuf_get_pixels (src);
-	src_rowstride = gdk_pixbuf_get_rowstride (dest);
-	dest_rowstride = gdk_pixbuf_get_rowstride (src);
-	height_minus_1 = height - 1;
-	for (x = 0; x < width; x++) {
+	for (gint y = y0; y < y1; y++) {
+		guint8 *p_dest = data->pixels + y * data->rowstride;
+		const guint8 *add = data->tmp + MIN (y + data->radius + 1, height_minus_1) * row_length;
+		const guint8 *remove = data->tmp + MAX (y - data->radius, 0) * row_length;
 
-		/* calc the initial sums of the kernel */
-		r = g = b = 0;
-		for (i = -radius; i <= (gint) radius; i++) {
-			c1 = p_src + (CLAMP (i, 0, height_minus_1) * src_rowstride);
-			r += c1[0];
-			g += c1[1];
-			b += c1[2];
+		/* set as the mean of the kernel, then calc the new sums */
+		if (div_multiplier != 0) {
+			for (gsize j = 0; j < row_length; j++) {
+				out[j] = (sums[j] * div_multiplier) >> 24;
+				sums[j] += add[j] - remove[j];
+			}
+		} else {
+			for (gsize j = 0; j < row_length; j++) {
+				out[j] = data->div_kernel_size[sums[j]];
+				sums[j] += add[j] - remove[j];
+			}
 		}
 
-		p_dest_col = p_dest;
-		for (y = 0; y < height; y++) {
-			/* set as the mean of the kernel */
+		/* leave any alpha channel alone */
+		if (data->n_channels == 3) {
+			memcpy (p_dest, out, row_length);
+		} else {
+			for (gint x = 0; x < data->width; x++) {
+				p_dest[x * data->n_channels + 0] = out[x * 3 + 0];
+				p_dest[x * data->n_channels + 1] = out[x * 3 + 1];
+				p_dest[x * data->n_channels + 2] = out[x * 3 + 2];
+			}
+		}
+	}
+}
 
-			p_dest_col[0] = div_kernel_size[r];
-			p_dest_col[1] = div_kernel_size[g];
-			p_dest_col[2] = div_kernel_size[b];
-			p_dest_col += dest_rowstride;
+/* Images with fewer pixels than this are blurred on the calling thread, as
+ * handing them to other threads costs more than it saves. */
+#define BLUR_PARALLEL_MIN_PIXELS (256 * 256)
 
-			/* the pixel to add to the kernel */
-			i1 = y + radius_plus_1;
-			if (i1 > height_minus_1)
-				i1 = height_minus_1;
-			c1 = p_src + (i1 * src_rowstride);
+static void
+blur_thread_cb (gpointer user_data)
+{
+	BlurData *data = user_data;
+	gint band;
 
-			/* the pixel to remove from the kernel */
-			i2 = y - radius;
-			if (i2 < 0)
-				i2 = 0;
-			c2 = p_src + (i2 * src_rowstride);
+	while ((band = g_atomic_int_add (&data->next_band, 1)) < data->n_bands) {
+		gint y0 = (gint64) data->height * band / data->n_bands;
+		gint y1 = (gint64) data->height * (band + 1) / data->n_bands;
+		data->pass (data, y0, y1);
+	}
+}
 
-			/* calc the new sums of the kernel */
-			r += c1[0] - c2[0];
-			g += c1[1] - c2[1];
-			b += c1[2] - c2[2];
-		}
+/* Run @pass over all the rows of the image, split into bands across up to
+ * @n_threads threads from the shared pool. */
+static void
+blur_run_pass (BlurData  *data,
+               guint      n_threads,
+               void     (*pass) (gpointer data, gint y0, gint y1))
+{
+	data->pass = pass;
+	data->next_band = 0;
 
-		p_src += n_channels;
-		p_dest += n_channels;
-	}
+	gs_utils_run_in_parallel (blur_thread_cb, data, n_threads);
 }
 
 /**
@@ -1369,111 +2146,279 @@ gs_pixbuf_blur_private (GdkPixbuf *src, GdkPixbuf *dest, guint radius, guint8 *d
  * @radius: the pixel radius for the gaussian blur, typical values are 1..3
  * @iterations: Amount to blur the image, typical values are 1..5
  *
- * Blurs an image. Warning, this method is s..l..o..w... for large images.
+ * Blurs an image in place, by applying a box blur @iterations times, which
+ * approximates a gaussian blur. Any alpha channel is left unchanged.
+ *
+ * The cost is independent of @radius. Large images are split into bands of
+ * rows which are blurred in parallel on a shared thread pool.
  **/
 void
 gs_utils_pixbuf_blur (GdkPixbuf *src, guint radius, guint iterations)
 {
-	gint kernel_size;
-	gint i;
-	g_autofree guchar *div_kernel_size = NULL;
-	g_autoptr(GdkPixbuf) tmp = NULL;
+	BlurData data = { 0, };
+	g_autofree guint8 *tmp = NULL;
+	g_autofree guint8 *div_kernel_size = NULL;
+	guint n_threads;
+
+	g_return_if_fail (GDK_IS_PIXBUF (src));
+	g_return_if_fail (gdk_pixbuf_get_bits_per_sample (src) == 8);
+
+	data.pixels = gdk_pixbuf_get_pixels (src);
+	data.rowstride = gdk_pixbuf_get_rowstride (src);
+	data.width = gdk_pixbuf_get_width (src);
+	data.height = gdk_pixbuf_get_height (src);
+	data.n_channels = gdk_pixbuf_get_n_channels (src);
+	data.row_length = (gsize) data.width * 3;
+	data.radius = radius;
+	data.kernel_size = 2 * radius + 1;
+	data.div_multiplier = (data.kernel_size < 256) ? ((1u << 24) + data.kernel_size - 1) / data.kernel_size : 0;
+
+	div_kernel_size = g_new (guint8, 256 * data.kernel_size);
+	for (guint i = 0; i < 256 * data.kernel_size; i++)
+		div_kernel_size[i] = (guint8) (i / data.kernel_size);
+	data.div_kernel_size = div_kernel_size;
+
+	tmp = g_malloc0 (data.row_length * data.height);
+	data.tmp = tmp;
+
+	/* only use extra threads if the image is big enough, and there are
+	 * enough rows to share out */
+	if ((gint64) data.width * data.height < BLUR_PARALLEL_MIN_PIXELS)
+		n_threads = 1;
+	else
+		n_threads = CLAMP (g_get_num_processors (), 1, MAX (data.height / 128, 1));
+	data.n_bands = n_threads * 2;
+
+	while (iterations-- > 0) {
+		blur_run_pass (&data, n_threads, blur_horizontal_pass);
+		blur_run_pass (&data, n_threads, blur_vertical_pass);
+	}
+}
+
+/* Maximum number of threads scanning one directory tree in parallel; more
+ * than this tends to be limited by the disk rather than the CPU. */
+#define GS_FILE_SIZE_SCAN_THREADS_MAX 4
+
+typedef struct {
+	GMutex			 mutex;
+	GCond			 cond;
+	GQueue			 queue;  /* (element-type filename) (owned) (locked-by mutex); directories to scan */
+	guint			 n_busy;  /* (locked-by mutex) */
 
-	tmp = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (src),
-			      gdk_pixbuf_get_has_alpha (src),
-			      gdk_pixbuf_get_bits_per_sample (src),
-			      gdk_pixbuf_get_width (src),
-			      gdk_pixbuf_get_height (src));
-	kernel_size = 2 * radius + 1;
-	div_kernel_size = g_new (guchar, 256 * kernel_size);
-	for (i = 0; i < 256 * kernel_size; i++)
-		div_kernel_size[i] = (guchar) (i / kernel_size);
+	gsize			 base_len;
+	GsFileSizeFlags		 flags;
+	GsFileSizeIncludeFunc	 include_func;
+	gpointer		 user_data;
+	GCancellable		*cancellable;
 
-	while (iterations-- > 0)
-		gs_pixbuf_blur_private (src, tmp, radius, div_kernel_size);
+	guint64			 size;  /* (locked-by mutex) */
+} FileSizeScan;
+
+/* Called with @scan->mutex held. */
+static void
+file_size_scan_push_locked (FileSizeScan *scan,
+                            gchar        *path)
+{
+	g_queue_push_tail (&scan->queue, path);
+	g_cond_signal (&scan->cond);
+}
+
+static void
+file_size_scan_dir (FileSizeScan *scan,
+                    const gchar  *path)
+{
+	int fd;
+	DIR *dir;
+	struct dirent *de;
+	g_autoptr(GPtrArray) subdirs = NULL;
+	guint64 apparent_size = 0;
+	guint64 allocated_size = 0;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	fd = open (path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	dir = fdopendir (fd);
+	if (dir == NULL) {
+		close (fd);
+		return;
+	}
+
+	subdirs = g_ptr_array_new_with_free_func (g_free);
+	while ((de = readdir (dir)) != NULL && !g_cancellable_is_cancelled (scan->cancellable)) {
+		struct stat st;
+		gboolean is_symlink;
+
+		if (g_str_equal (de->d_name, ".") || g_str_equal (de->d_name, ".."))
+			continue;
+
+		if (fstatat (dirfd (dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+			continue;
+		is_symlink = S_ISLNK (st.st_mode);
+		if (is_symlink && fstatat (dirfd (dir), de->d_name, &st, 0) != 0)
+			continue;
+
+		if (scan->include_func != NULL) {
+			g_autofree gchar *full_path = g_build_filename (path, de->d_name, NULL);
+			if (!scan->include_func (full_path + scan->base_len,
+						 is_symlink ? G_FILE_TEST_IS_SYMLINK :
+						 S_ISDIR (st.st_mode) ? G_FILE_TEST_IS_DIR :
+						 G_FILE_TEST_IS_REGULAR,
+						 scan->user_data))
+				continue;
+		}
+
+		if (S_ISDIR (st.st_mode)) {
+			/* Skip symlinks, they can point to a shared storage */
+			if (!is_symlink)
+				g_ptr_array_add (subdirs, g_strdup (de->d_name));
+		} else {
+			apparent_size += st.st_size;
+			allocated_size += (guint64) st.st_blocks * 512;
+		}
+	}
+	closedir (dir);
+
+	locker = g_mutex_locker_new (&scan->mutex);
+
+	if (g_cancellable_is_cancelled (scan->cancellable))
+		return;
+
+	scan->size += (scan->flags & GS_FILE_SIZE_FLAG_ALLOCATED) ? allocated_size : apparent_size;
+	for (guint i = 0; i < subdirs->len; i++)
+		file_size_scan_push_locked (scan, g_build_filename (path, g_ptr_array_index (subdirs, i), NULL));
+}
+
+/* Run on the calling thread and on threads from the shared pool, until there
+ * are no directories left to scan and no other thread is scanning one. */
+static void
+file_size_scan_thread_cb (gpointer data)
+{
+	FileSizeScan *scan = data;
+
+	g_mutex_lock (&scan->mutex);
+	for (;;) {
+		g_autofree gchar *path = NULL;
+
+		/* wait for more work, unless all the other threads are idle
+		 * too, in which case the scan is finished */
+		while (g_queue_is_empty (&scan->queue) && scan->n_busy > 0)
+			g_cond_wait (&scan->cond, &scan->mutex);
+		if (g_queue_is_empty (&scan->queue))
+			break;
+
+		path = g_queue_pop_head (&scan->queue);
+		scan->n_busy++;
+		g_mutex_unlock (&scan->mutex);
+
+		if (!g_cancellable_is_cancelled (scan->cancellable))
+			file_size_scan_dir (scan, path);
+
+		g_mutex_lock (&scan->mutex);
+		scan->n_busy--;
+		if (scan->n_busy == 0 && g_queue_is_empty (&scan->queue))
+			g_cond_broadcast (&scan->cond);
+	}
+	g_mutex_unlock (&scan->mutex);
 }
 
 /**
- * gs_utils_get_file_size:
+ * gs_utils_get_file_size_full:
  * @filename: a file name to get the size of; it can be a file or a directory
+ * @flags: flags affecting how the size is calculated
  * @include_func: (nullable) (scope call): optional callback to limit what files to count
  * @user_data: user data passed to the @include_func
  * @cancellable: (nullable): an optional #GCancellable or %NULL
  *
  * Gets the size of the file or a directory identified by @filename.
  *
- * When the @include_func is not %NULL, it can limit which files are included
- * in the resulting size. When it's %NULL, all files and subdirectories are included.
+ * Directories are scanned by several threads in parallel, so @include_func
+ * may be called from several threads at once. When the @include_func is not
+ * %NULL, it can limit which files are included in the resulting size. When
+ * it's %NULL, all files and subdirectories are included. Symbolic links to
+ * directories are not followed.
  *
  * Returns: disk size of the @filename; or 0 when not found
  *
- * Since: 41
+ * Since: 47
  **/
 guint64
-gs_utils_get_file_size (const gchar *filename,
-			GsFileSizeIncludeFunc include_func,
-			gpointer user_data,
-			GCancellable *cancellable)
+gs_utils_get_file_size_full (const gchar           *filename,
+                             GsFileSizeFlags        flags,
+                             GsFileSizeIncludeFunc  include_func,
+                             gpointer               user_data,
+                             GCancellable          *cancellable)
 {
-	guint64 size = 0;
+	FileSizeScan scan = { 0, };
+	guint64 size;
 
 	g_return_val_if_fail (filename != NULL, 0);
 
-	if (g_file_test (filename, G_FILE_TEST_IS_DIR)) {
-		GSList *dirs_to_do = NULL;
-		gsize base_len = strlen (filename);
-
-		/* The `include_func()` expects a path relative to the `filename`, without
-		   a leading dir separator. As the `dirs_to_do` contains the full path,
-		   constructed with `g_build_filename()`, the added dir separator needs
-		   to be skipped, when it's not part of the `filename` already. */
-		if (!g_str_has_suffix (filename, G_DIR_SEPARATOR_S))
-			base_len++;
-
-		dirs_to_do = g_slist_prepend (dirs_to_do, g_strdup (filename));
-		while (dirs_to_do != NULL && !g_cancellable_is_cancelled (cancellable)) {
-			g_autofree gchar *path = NULL;
-			g_autoptr(GDir) dir = NULL;
-
-			/* Steal the top `path` out of the `dirs_to_do`. */
-			path = dirs_to_do->data;
-			dirs_to_do = g_slist_remove (dirs_to_do, path);
-
-			dir = g_dir_open (path, 0, NULL);
-			if (dir) {
-				const gchar *name;
-				while (name = g_dir_read_name (dir), name != NULL && !g_cancellable_is_cancelled (cancellable)) {
-					g_autofree gchar *full_path = g_build_filename (path, name, NULL);
-					GStatBuf st;
-
-					if (g_stat (full_path, &st) == 0 && (include_func == NULL ||
-					    include_func (full_path + base_len,
-							  g_file_test (full_path, G_FILE_TEST_IS_SYMLINK) ? G_FILE_TEST_IS_SYMLINK :
-							  S_ISDIR (st.st_mode) ? G_FILE_TEST_IS_DIR :
-							  G_FILE_TEST_IS_REGULAR,
-							  user_data))) {
-						if (S_ISDIR (st.st_mode)) {
-							/* Skip symlinks, they can point to a shared storage */
-							if (!g_file_test (full_path, G_FILE_TEST_IS_SYMLINK))
-								dirs_to_do = g_slist_prepend (dirs_to_do, g_steal_pointer (&full_path));
-						} else {
-							size += st.st_size;
-						}
-					}
-				}
-			}
-		}
-		g_slist_free_full (dirs_to_do, g_free);
-	} else {
+	if (!g_file_test (filename, G_FILE_TEST_IS_DIR)) {
 		GStatBuf st;
 
-		if (g_stat (filename, &st) == 0)
-			size = st.st_size;
+		if (g_stat (filename, &st) != 0)
+			return 0;
+		return (flags & GS_FILE_SIZE_FLAG_ALLOCATED) ? (guint64) st.st_blocks * 512 : (guint64) st.st_size;
 	}
 
+	/* The `include_func()` expects a path relative to the `filename`, without
+	   a leading dir separator. As the queued directories contain the full path,
+	   constructed with `g_build_filename()`, the added dir separator needs
+	   to be skipped, when it's not part of the `filename` already. */
+	scan.base_len = strlen (filename);
+	if (!g_str_has_suffix (filename, G_DIR_SEPARATOR_S))
+		scan.base_len++;
+
+	g_mutex_init (&scan.mutex);
+	g_cond_init (&scan.cond);
+	g_queue_init (&scan.queue);
+	scan.flags = flags;
+	scan.include_func = include_func;
+	scan.user_data = user_data;
+	scan.cancellable = cancellable;
+
+	g_mutex_lock (&scan.mutex);
+	file_size_scan_push_locked (&scan, g_strdup (filename));
+	g_mutex_unlock (&scan.mutex);
+
+	gs_utils_run_in_parallel (file_size_scan_thread_cb, &scan, GS_FILE_SIZE_SCAN_THREADS_MAX);
+
+	size = scan.size;
+
+	g_queue_clear_full (&scan.queue, g_free);
+	g_cond_clear (&scan.cond);
+	g_mutex_clear (&scan.mutex);
+
 	return size;
 }
 
+/**
+ * gs_utils_get_file_size:
+ * @filename: a file name to get the size of; it can be a file or a directory
+ * @include_func: (nullable) (scope call): optional callback to limit what files to count
+ * @user_data: user data passed to the @include_func
+ * @cancellable: (nullable): an optional #GCancellable or %NULL
+ *
+ * Gets the size of the file or a directory identified by @filename.
+ *
+ * This is equivalent to calling gs_utils_get_file_size_full() with no flags.
+ *
+ * Returns: disk size of the @filename; or 0 when not found
+ *
+ * Since: 41
+ **/
+guint64
+gs_utils_get_file_size (const gchar *filename,
+			GsFileSizeIncludeFunc include_func,
+			gpointer user_data,
+			GCancellable *cancellable)
+{
+	return gs_utils_get_file_size_full (filename, GS_FILE_SIZE_FLAG_NONE,
+					    include_func, user_data, cancellable);
+}
+
 #define METADATA_ETAG_ATTRIBUTE "xattr::gnome-software::etag"
 
 /**
@@ -62,6 +62,62 @@ GPermission	*gs_utils_get_permission_finish	(GAsyncResult	*result,
 						 GError		**error);
 gboolean	 gs_utils_strv_fnmatch		(gchar		**strv,
 						 const gchar	*str);
+
+/**
+ * GsGlobSet:
+ *
+ * A set of glob patterns, compiled for matching many strings against them
+ * quickly. See gs_glob_set_new().
+ *
+ * Since: 47
+ */
+typedef struct _GsGlobSet GsGlobSet;
+
+GsGlobSet	*gs_glob_set_new		(const gchar * const *patterns);
+GsGlobSet	*gs_glob_set_ref		(GsGlobSet	*self);
+void		 gs_glob_set_unref		(GsGlobSet	*self);
+const gchar	*gs_glob_set_lookup		(GsGlobSet	*self,
+						 const gchar	*str);
+gboolean	 gs_glob_set_match		(GsGlobSet	*self,
+						 const gchar	*str);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsGlobSet, gs_glob_set_unref)
+
+/**
+ * GsUtilsParallelFunc:
+ * @user_data: data passed to gs_utils_run_in_parallel()
+ *
+ * A function which gs_utils_run_in_parallel() runs on several threads at
+ * once. It should keep taking work items from @user_data, which is shared
+ * between all the threads, until there are none left.
+ *
+ * Since: 47
+ */
+typedef void (*GsUtilsParallelFunc) (gpointer user_data);
+
+void		 gs_utils_run_in_parallel	(GsUtilsParallelFunc	 func,
+						 gpointer		 user_data,
+						 guint			 n_threads);
+
+/**
+ * GsUtilsLockStalls:
+ * @n_stalls: number of times a reader had to wait for the lock
+ * @stall_usec: total time readers spent waiting for the lock, in microseconds
+ *
+ * Counts how often, and for how long, readers of a #GRWLock were blocked
+ * by a writer. Both fields are accessed atomically.
+ *
+ * Since: 47
+ */
+typedef struct {
+	gint		 n_stalls;
+	gssize		 stall_usec;
+} GsUtilsLockStalls;
+
+GRWLockReaderLocker *gs_utils_rw_lock_reader_locker_new
+						(GRWLock		*lock,
+						 GsUtilsLockStalls	*stalls);
+
 gchar           *gs_utils_sort_key		(const gchar    *str);
 gint             gs_utils_sort_strcmp		(const gchar    *str1,
 						 const gchar	*str2);
@@ -132,6 +188,26 @@ guint64		 gs_utils_get_file_size		(const gchar		*filename,
 						 GsFileSizeIncludeFunc	 include_func,
 						 gpointer		 user_data,
 						 GCancellable		*cancellable);
+
+/**
+ * GsFileSizeFlags:
+ * @GS_FILE_SIZE_FLAG_NONE:		No flags set
+ * @GS_FILE_SIZE_FLAG_ALLOCATED:	Count the disk space allocated to files, rather than their apparent size
+ *
+ * Flags for gs_utils_get_file_size_full().
+ *
+ * Since: 47
+ **/
+typedef enum {
+	GS_FILE_SIZE_FLAG_NONE		= 0,
+	GS_FILE_SIZE_FLAG_ALLOCATED	= 1 << 0,
+} GsFileSizeFlags;
+
+guint64		 gs_utils_get_file_size_full	(const gchar		*filename,
+						 GsFileSizeFlags	 flags,
+						 GsFileSizeIncludeFunc	 include_func,
+						 gpointer		 user_data,
+						 GCancellable		*cancellable);
 gchar *		 gs_utils_get_file_etag		(GFile			*file,
 						 GDateTime		**last_modified_date_out,
 						 GCancellable		*cancellable);
@@ -33,6 +33,21 @@
  * gs_worker_thread_shutdown_async() is called. This must be called before the
  * final reference to the #GsWorkerThread is dropped.
  *
+ * A #GsWorkerThread can also be created as a pool of several worker threads,
+ * using gs_worker_thread_new_pool(). Tasks queued with gs_worker_thread_queue()
+ * are still all executed by the first worker thread, one at a time, so that
+ * code which modifies state (such as installing apps) stays serialised. Tasks
+ * queued with gs_worker_thread_queue_parallel() may be executed by any of the
+ * worker threads, in parallel with each other and with the serialised tasks.
+ * This is intended for read-only work, such as refining apps or searching.
+ *
+ * Each worker thread has its own queue. Parallel tasks are queued to an idle
+ * worker thread if there is one, and a worker thread which runs out of tasks
+ * steals the most urgent parallel task from the other queues, so a long
+ * running task does not hold up the ones queued behind it. If a parallel task
+ * has to be queued behind a busy worker thread, an idle one is woken up to
+ * steal it.
+ *
  * Since: 42
  */
 
@@ -50,43 +65,176 @@ typedef enum {
 	GS_WORKER_THREAD_STATE_SHUT_DOWN = 2,
 } GsWorkerThreadState;
 
+typedef struct {
+	GTaskThreadFunc work_func;
+	GTask *task;  /* (owned) */
+	gint priority;
+	gsize sequence;
+	gboolean parallel;
+} WorkData;
+
+static void
+work_data_free (WorkData *data)
+{
+	g_clear_object (&data->task);
+	g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WorkData, work_data_free)
+
+/* A binary min-heap of #WorkData, ordered by priority and then by the order
+ * the tasks were queued in. */
+typedef struct {
+	GPtrArray *items;  /* (owned) (element-type WorkData) */
+	guint n_parallel;
+} WorkQueue;
+
+static gboolean
+work_data_lt (const WorkData *a,
+              const WorkData *b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority;
+	return a->sequence < b->sequence;
+}
+
+static void
+work_queue_swap (WorkQueue *queue,
+                 guint      i,
+                 guint      j)
+{
+	gpointer tmp = queue->items->pdata[i];
+	queue->items->pdata[i] = queue->items->pdata[j];
+	queue->items->pdata[j] = tmp;
+}
+
+static void
+work_queue_push (WorkQueue *queue,
+                 WorkData  *data)
+{
+	guint i = queue->items->len;
+
+	g_ptr_array_add (queue->items, data);
+	if (data->parallel)
+		queue->n_parallel++;
+
+	/* sift up */
+	while (i > 0) {
+		guint parent = (i - 1) / 2;
+		if (!work_data_lt (g_ptr_array_index (queue->items, i),
+				   g_ptr_array_index (queue->items, parent)))
+			break;
+		work_queue_swap (queue, i, parent);
+		i = parent;
+	}
+}
+
+static WorkData *
+work_queue_remove_index (WorkQueue *queue,
+                         guint      i)
+{
+	WorkData *data = g_ptr_array_index (queue->items, i);
+	guint len;
+
+	g_ptr_array_remove_index_fast (queue->items, i);
+	if (data->parallel)
+		queue->n_parallel--;
+	len = queue->items->len;
+	if (i >= len)
+		return data;
+
+	/* the last item was moved to @i, so sift it up or down */
+	while (i > 0) {
+		guint parent = (i - 1) / 2;
+		if (!work_data_lt (g_ptr_array_index (queue->items, i),
+				   g_ptr_array_index (queue->items, parent)))
+			break;
+		work_queue_swap (queue, i, parent);
+		i = parent;
+	}
+	for (;;) {
+		guint left = 2 * i + 1;
+		guint right = left + 1;
+		guint smallest = i;
+
+		if (left < len &&
+		    work_data_lt (g_ptr_array_index (queue->items, left),
+				  g_ptr_array_index (queue->items, smallest)))
+			smallest = left;
+		if (right < len &&
+		    work_data_lt (g_ptr_array_index (queue->items, right),
+				  g_ptr_array_index (queue->items, smallest)))
+			smallest = right;
+		if (smallest == i)
+			break;
+		work_queue_swap (queue, i, smallest);
+		i = smallest;
+	}
+
+	return data;
+}
+
+static WorkData *
+work_queue_pop (WorkQueue *queue)
+{
+	if (queue->items->len == 0)
+		return NULL;
+	return work_queue_remove_index (queue, 0);
+}
+
+/* Removes the most urgent task which may be run by another worker thread. */
+static WorkData *
+work_queue_steal (WorkQueue *queue)
+{
+	WorkData *best = NULL;
+	guint best_idx = 0;
+
+	if (queue->n_parallel == 0)
+		return NULL;
+
+	for (guint i = 0; i < queue->items->len; i++) {
+		WorkData *data = g_ptr_array_index (queue->items, i);
+		if (data->parallel && (best == NULL || work_data_lt (data, best))) {
+			best = data;
+			best_idx = i;
+		}
+	}
+
+	return work_queue_remove_index (queue, best_idx);
+}
+
+typedef struct {
+	GsWorkerThread		*owner;  /* (unowned) */
+	guint			 index;
+	GMainContext		*context;  /* (owned); may be NULL before setup or after shutdown */
+	GThread			*thread;  /* (owned); may be NULL before setup or after shutdown */
+	GMutex			 queue_mutex;
+	WorkQueue		 queue;  /* (locked-by queue_mutex) */
+	gint			 busy;  /* (atomic) */
+} GsWorker;
+
 struct _GsWorkerThread
 {
 	GObject			 parent;
 
 	gchar			*name;  /* (nullable) (owned) */
+	guint			 n_threads;
 
 	GsWorkerThreadState	 worker_state;  /* (atomic) */
-	GMainContext		*worker_context;  /* (owned); may be NULL before setup or after shutdown */
-	GThread			*worker_thread;  /* (atomic); may be NULL before setup or after shutdown */
-
-	GMutex			 queue_mutex;
-	GQueue			 queue;
+	GsWorker		*workers;  /* (owned) (array length=n_threads) */
+	gsize			 sequence;  /* (atomic) */
+	gint			 next_worker;  /* (atomic) */
 };
 
 typedef enum {
 	PROP_NAME = 1,
+	PROP_N_THREADS,
 } GsWorkerThreadProperty;
 
-static GParamSpec *props[PROP_NAME + 1] = { NULL, };
+static GParamSpec *props[PROP_N_THREADS + 1] = { NULL, };
 
 G_DEFINE_TYPE (GsWorkerThread, gs_worker_thread, G_TYPE_OBJECT)
 
-typedef struct {
-	GTaskThreadFunc work_func;
-	GTask *task;  /* (owned) */
-	gint priority;
-} WorkData;
-
-static void
-work_data_free (WorkData *data)
-{
-	g_clear_object (&data->task);
-	g_free (data);
-}
-
-G_DEFINE_AUTOPTR_CLEANUP_FUNC (WorkData, work_data_free)
-
 static void
 gs_worker_thread_get_property (GObject    *object,
                                guint       prop_id,
@@ -99,6 +247,9 @@ gs_worker_thread_get_property (GObject    *object,
 	case PROP_NAME:
 		g_value_set_string (value, self->name);
 		break;
+	case PROP_N_THREADS:
+		g_value_set_uint (value, self->n_threads);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -119,26 +270,56 @@ gs_worker_thread_set_property (GObject      *object,
 		g_assert (self->name == NULL);
 		self->name = g_value_dup_string (value);
 		break;
+	case PROP_N_THREADS:
+		/* Construct only */
+		self->n_threads = g_value_get_uint (value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
 	}
 }
 
+/* Returns %G_IO_ERROR_CANCELLED for all the tasks still queued on @worker,
+ * so none of them are dropped without being returned. */
+static void
+gs_worker_cancel_queue (GsWorker *worker)
+{
+	WorkData *data_unowned;
+
+	for (;;) {
+		g_autoptr(WorkData) data = NULL;
+
+		g_mutex_lock (&worker->queue_mutex);
+		data_unowned = work_queue_pop (&worker->queue);
+		g_mutex_unlock (&worker->queue_mutex);
+
+		if (data_unowned == NULL)
+			break;
+
+		data = data_unowned;
+		g_task_return_new_error (data->task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+					 "Worker thread shut down before task was run");
+	}
+}
+
 static void
 gs_worker_thread_dispose (GObject *object)
 {
 	GsWorkerThread *self = GS_WORKER_THREAD (object);
 
-	/* Should have stopped by now. */
-	g_assert (self->worker_thread == NULL);
-
 	g_clear_pointer (&self->name, g_free);
-	g_clear_pointer (&self->worker_context, g_main_context_unref);
 
-	g_mutex_lock (&self->queue_mutex);
-	g_queue_clear_full (&self->queue, (GDestroyNotify) work_data_free);
-	g_mutex_unlock (&self->queue_mutex);
+	for (guint i = 0; self->workers != NULL && i < self->n_threads; i++) {
+		GsWorker *worker = &self->workers[i];
+
+		/* Should have stopped by now. */
+		g_assert (worker->thread == NULL);
+
+		g_clear_pointer (&worker->context, g_main_context_unref);
+
+		gs_worker_cancel_queue (worker);
+	}
 
 	G_OBJECT_CLASS (gs_worker_thread_parent_class)->dispose (object);
 }
@@ -148,7 +329,11 @@ gs_worker_thread_finalize (GObject *object)
 {
 	GsWorkerThread *self = GS_WORKER_THREAD (object);
 
-	g_mutex_clear (&self->queue_mutex);
+	for (guint i = 0; self->workers != NULL && i < self->n_threads; i++) {
+		g_mutex_clear (&self->workers[i].queue_mutex);
+		g_clear_pointer (&self->workers[i].queue.items, g_ptr_array_unref);
+	}
+	g_clear_pointer (&self->workers, g_free);
 
 	G_OBJECT_CLASS (gs_worker_thread_parent_class)->finalize (object);
 }
@@ -162,12 +347,31 @@ gs_worker_thread_constructed (GObject *object)
 
 	G_OBJECT_CLASS (gs_worker_thread_parent_class)->constructed (object);
 
-	/* Start up a worker thread and its #GMainContext. The worker will run
-	 * and process events on @worker_context until @worker_state changes
-	 * from %GS_WORKER_THREAD_STATE_RUNNING. */
+	/* Start up the worker threads, each with its own #GMainContext. The
+	 * workers will run and process events on their contexts until
+	 * @worker_state changes to %GS_WORKER_THREAD_STATE_SHUT_DOWN. */
 	self->worker_state = GS_WORKER_THREAD_STATE_RUNNING;
-	self->worker_context = g_main_context_new ();
-	self->worker_thread = g_thread_new (self->name, thread_cb, self);
+	self->workers = g_new0 (GsWorker, self->n_threads);
+
+	for (guint i = 0; i < self->n_threads; i++) {
+		GsWorker *worker = &self->workers[i];
+
+		worker->owner = self;
+		worker->index = i;
+		worker->context = g_main_context_new ();
+		g_mutex_init (&worker->queue_mutex);
+		worker->queue.items = g_ptr_array_new_with_free_func ((GDestroyNotify) work_data_free);
+	}
+
+	for (guint i = 0; i < self->n_threads; i++) {
+		GsWorker *worker = &self->workers[i];
+		g_autofree gchar *thread_name = NULL;
+
+		if (self->n_threads > 1)
+			thread_name = g_strdup_printf ("%s-%u", self->name, i);
+		worker->thread = g_thread_new ((thread_name != NULL) ? thread_name : self->name,
+					       thread_cb, worker);
+	}
 }
 
 static void
@@ -195,57 +399,126 @@ gs_worker_thread_class_init (GsWorkerThreadClass *klass)
 				     NULL,
 				     G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
 
+	/**
+	 * GsWorkerThread:n-threads:
+	 *
+	 * Number of worker threads to run tasks queued with
+	 * gs_worker_thread_queue_parallel() on.
+	 *
+	 * Tasks queued with gs_worker_thread_queue() are always run on the
+	 * first worker thread.
+	 *
+	 * Since: 47
+	 */
+	props[PROP_N_THREADS] =
+		g_param_spec_uint ("n-threads",
+				   "Number of Threads",
+				   "Number of worker threads to run tasks on.",
+				   1, G_MAXUINT, 1,
+				   G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
 	g_object_class_install_properties (object_class, G_N_ELEMENTS (props), props);
 }
 
+/* Takes the next task for @worker to run: the most urgent one in its own
+ * queue, or else the most urgent parallel task queued for another worker. */
+static WorkData *
+gs_worker_thread_take_work (GsWorker *worker)
+{
+	GsWorkerThread *self = worker->owner;
+	WorkData *data;
+
+	g_mutex_lock (&worker->queue_mutex);
+	data = work_queue_pop (&worker->queue);
+	g_mutex_unlock (&worker->queue_mutex);
+	if (data != NULL)
+		return data;
+
+	for (guint i = 1; i < self->n_threads; i++) {
+		GsWorker *victim = &self->workers[(worker->index + i) % self->n_threads];
+
+		g_mutex_lock (&victim->queue_mutex);
+		data = work_queue_steal (&victim->queue);
+		g_mutex_unlock (&victim->queue_mutex);
+		if (data != NULL)
+			return data;
+	}
+
+	return NULL;
+}
+
 static void
-gs_worker_thread_run_queue (GsWorkerThread *self)
+gs_worker_thread_run_queue (GsWorker *worker)
 {
-	g_mutex_lock (&self->queue_mutex);
-	while (!g_queue_is_empty (&self->queue)) {
-		g_autoptr(WorkData) data = g_queue_pop_head (&self->queue);
+	WorkData *data_unowned;
+
+	g_atomic_int_set (&worker->busy, TRUE);
+
+	for (;;) {
+		g_autoptr(WorkData) data = NULL;
 		GTask *task;
 		gpointer source_object;
 		gpointer task_data;
 		GCancellable *cancellable;
 
-		/* thus the other threads can queue more work */
-		g_mutex_unlock (&self->queue_mutex);
+		data_unowned = gs_worker_thread_take_work (worker);
+
+		/* Work may have been queued to a busy worker after the last
+		 * check, without waking this one as it still looked busy, so
+		 * check again once it no longer does. */
+		if (data_unowned == NULL) {
+			g_atomic_int_set (&worker->busy, FALSE);
+			data_unowned = gs_worker_thread_take_work (worker);
+			if (data_unowned == NULL)
+				break;
+			g_atomic_int_set (&worker->busy, TRUE);
+		}
 
+		data = data_unowned;
 		task = data->task;
 		source_object = g_task_get_source_object (task);
 		task_data = g_task_get_task_data (task);
 		cancellable = g_task_get_cancellable (task);
 
+		/* Tasks which are still queued once shutdown has been processed
+		 * are cancelled rather than run. */
+		if (g_atomic_int_get (&worker->owner->worker_state) == GS_WORKER_THREAD_STATE_SHUT_DOWN) {
+			g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+						 "Worker thread shut down before task was run");
+			continue;
+		}
+
 		/* Set the I/O priority of the thread to match the priority of the task. */
 		gs_ioprio_set (data->priority);
 
 		data->work_func (task, source_object, task_data, cancellable);
-
-		g_mutex_lock (&self->queue_mutex);
 	}
-	g_mutex_unlock (&self->queue_mutex);
 }
 
 static gpointer
 thread_cb (gpointer data)
 {
-	GsWorkerThread *self = GS_WORKER_THREAD (data);
-	g_autoptr(GMainContextPusher) pusher = g_main_context_pusher_new (self->worker_context);
+	GsWorker *worker = data;
+	GsWorkerThread *self = worker->owner;
+	g_autoptr(GMainContext) context = g_main_context_ref (worker->context);
+	g_autoptr(GMainContextPusher) pusher = g_main_context_pusher_new (context);
 
 	while (g_atomic_int_get (&self->worker_state) != GS_WORKER_THREAD_STATE_SHUT_DOWN) {
-		g_main_context_iteration (self->worker_context, TRUE);
-		gs_worker_thread_run_queue (self);
+		g_main_context_iteration (context, TRUE);
+		gs_worker_thread_run_queue (worker);
 	}
 
+	/* Tasks may have been queued for this worker after it last checked
+	 * its queue, but before it noticed the state change. */
+	gs_worker_cancel_queue (worker);
+
 	return NULL;
 }
 
 static void
 gs_worker_thread_init (GsWorkerThread *self)
 {
-	g_mutex_init (&self->queue_mutex);
-	g_queue_init (&self->queue);
+	self->n_threads = 1;
 }
 
 /**
@@ -269,14 +542,87 @@ gs_worker_thread_new (const gchar *name)
 			     NULL);
 }
 
-static gint
-gs_worker_thread_cmp (gconstpointer a,
-		      gconstpointer b,
-		      gpointer user_data)
+/**
+ * gs_worker_thread_new_pool:
+ * @name: (not nullable): name for the worker threads
+ * @n_threads: number of worker threads, at least 1
+ *
+ * Create and start a new #GsWorkerThread with @n_threads worker threads.
+ *
+ * See gs_worker_thread_queue_parallel() for how tasks are shared between the
+ * threads.
+ *
+ * Returns: (transfer full): a new #GsWorkerThread
+ * Since: 47
+ */
+GsWorkerThread *
+gs_worker_thread_new_pool (const gchar *name,
+                           guint        n_threads)
 {
-	const WorkData *dta = a;
-	const WorkData *dtb = b;
-	return dta->priority - dtb->priority;
+	g_return_val_if_fail (name != NULL, NULL);
+	g_return_val_if_fail (n_threads >= 1, NULL);
+
+	return g_object_new (GS_TYPE_WORKER_THREAD,
+			     "name", name,
+			     "n-threads", n_threads,
+			     NULL);
+}
+
+static void
+gs_worker_thread_push (GsWorkerThread  *self,
+                       gint             priority,
+                       GTaskThreadFunc  work_func,
+                       GTask           *task,
+                       gboolean         parallel)
+{
+	g_autoptr(WorkData) data = NULL;
+	GsWorker *worker = &self->workers[0];
+	gboolean parallel;
+
+	g_assert (g_atomic_int_get (&self->worker_state) == GS_WORKER_THREAD_STATE_RUNNING ||
+		  g_task_get_source_tag (task) == gs_worker_thread_shutdown_async);
+
+	data = g_new0 (WorkData, 1);
+	data->work_func = work_func;
+	data->task = g_steal_pointer (&task);
+	data->priority = priority;
+	data->parallel = parallel && self->n_threads > 1;
+	data->sequence = g_atomic_pointer_add (&self->sequence, 1);
+	parallel = data->parallel;
+
+	/* prefer an idle worker, otherwise share the work out in turn and
+	 * leave it to the idle workers to steal it */
+	if (data->parallel) {
+		guint start = (guint) g_atomic_int_add (&self->next_worker, 1);
+
+		worker = &self->workers[start % self->n_threads];
+		for (guint i = 0; i < self->n_threads; i++) {
+			GsWorker *candidate = &self->workers[(start + i) % self->n_threads];
+			if (!g_atomic_int_get (&candidate->busy)) {
+				worker = candidate;
+				break;
+			}
+		}
+	}
+
+	g_mutex_lock (&worker->queue_mutex);
+	work_queue_push (&worker->queue, g_steal_pointer (&data));
+	g_mutex_unlock (&worker->queue_mutex);
+
+	g_main_context_wakeup (worker->context);
+
+	/* if the task is stuck behind a busy worker, wake an idle one to
+	 * steal it */
+	if (parallel && g_atomic_int_get (&worker->busy)) {
+		for (guint i = 0; i < self->n_threads; i++) {
+			GsWorker *idle = &self->workers[i];
+
+			if (idle != worker && !g_atomic_int_get (&idle->busy)) {
+				g_main_context_wakeup (idle->context);
+				break;
+			}
+		}
+	}
 }
 
 /**
@@ -318,31 +664,51 @@ gs_worker_thread_queue (GsWorkerThread  *self,
                         GTaskThreadFunc  work_func,
                         GTask           *task)
 {
-	g_autoptr(WorkData) data = NULL;
-	g_autoptr(GMutexLocker) locker = NULL;
-
 	g_return_if_fail (GS_IS_WORKER_THREAD (self));
 	g_return_if_fail (work_func != NULL);
 	g_return_if_fail (G_IS_TASK (task));
 
-	g_assert (g_atomic_int_get (&self->worker_state) == GS_WORKER_THREAD_STATE_RUNNING ||
-		  g_task_get_source_tag (task) == gs_worker_thread_shutdown_async);
+	gs_worker_thread_push (self, priority, work_func, task, FALSE);
+}
 
-	data = g_new0 (WorkData, 1);
-	data->work_func = work_func;
-	data->task = g_steal_pointer (&task);
-	data->priority = priority;
+/**
+ * gs_worker_thread_queue_parallel:
+ * @self: a #GsWorkerThread
+ * @priority: (default G_PRIORITY_DEFAULT): priority to queue the task at,
+ *   typically #G_PRIORITY_DEFAULT
+ * @work_func: (not nullable): function to run the task
+ * @task: (transfer full) (not nullable): the #GTask containing context data to
+ *   pass to @work_func
+ *
+ * Queue @task to be run in any of the worker threads at the given @priority.
+ *
+ * This is like gs_worker_thread_queue(), except that if @self was created
+ * with more than one thread using gs_worker_thread_new_pool(), @task may be run
+ * in parallel with other tasks, including those queued with
+ * gs_worker_thread_queue(). @work_func must only use state which is safe to
+ * access from several threads at once.
+ *
+ * Since: 47
+ */
+void
+gs_worker_thread_queue_parallel (GsWorkerThread  *self,
+                                 gint             priority,
+                                 GTaskThreadFunc  work_func,
+                                 GTask           *task)
+{
+	g_return_if_fail (GS_IS_WORKER_THREAD (self));
+	g_return_if_fail (work_func != NULL);
+	g_return_if_fail (G_IS_TASK (task));
 
-	locker = g_mutex_locker_new (&self->queue_mutex);
-	g_queue_insert_sorted (&self->queue, g_steal_pointer (&data), gs_worker_thread_cmp, NULL);
-	g_main_context_wakeup (self->worker_context);
+	gs_worker_thread_push (self, priority, work_func, task, TRUE);
 }
 
 /**
  * gs_worker_thread_is_in_worker_context:
  * @self: a #GsWorkerThread
  *
- * Returns whether the calling thread is the worker thread.
+ * Returns whether the calling thread is the worker thread, or one of them if
+ * @self was created with gs_worker_thread_new_pool().
  *
  * This is intended to be used as a precondition check to ensure that worker
  * code is not accidentally run from the wrong thread.
@@ -363,7 +729,13 @@ gs_worker_thread_queue (GsWorkerThread  *self,
 gboolean
 gs_worker_thread_is_in_worker_context (GsWorkerThread *self)
 {
-	return g_main_context_is_owner (self->worker_context);
+	for (guint i = 0; i < self->n_threads; i++) {
+		GMainContext *context = self->workers[i].context;
+		if (context != NULL && g_main_context_is_owner (context))
+			return TRUE;
+	}
+
+	return FALSE;
 }
 
 static void shutdown_cb (GTask        *task,
@@ -428,9 +800,12 @@ shutdown_cb (GTask        *task,
 							   GS_WORKER_THREAD_STATE_SHUT_DOWN);
 	g_assert (updated_state);
 
-	/* Tidy up. We can’t join the thread here as this function is executing
-	 * within the thread and that would deadlock. */
-	g_clear_pointer (&self->worker_context, g_main_context_unref);
+	/* Wake the other worker threads so they notice the state change and
+	 * exit once their queues are empty. We can’t join the threads here as
+	 * this function is executing within one of them and that would
+	 * deadlock. */
+	for (guint i = 1; i < self->n_threads; i++)
+		g_main_context_wakeup (self->workers[i].context);
 
 	g_task_return_boolean (task, TRUE);
 }
@@ -461,8 +836,11 @@ gs_worker_thread_shutdown_finish (GsWorkerThread  *self,
 
 	success = g_task_propagate_boolean (G_TASK (result), error);
 
-	if (success)
-		g_thread_join (g_steal_pointer (&self->worker_thread));
+	/* Tidy up. */
+	for (guint i = 0; success && i < self->n_threads; i++) {
+		g_thread_join (g_steal_pointer (&self->workers[i].thread));
+		g_clear_pointer (&self->workers[i].context, g_main_context_unref);
+	}
 
 	return success;
 }
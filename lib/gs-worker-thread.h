@@ -21,11 +21,17 @@ G_BEGIN_DECLS
 G_DECLARE_FINAL_TYPE (GsWorkerThread, gs_worker_thread, GS, WORKER_THREAD, GObject)
 
 GsWorkerThread	*gs_worker_thread_new			(const gchar *name);
+GsWorkerThread	*gs_worker_thread_new_pool		(const gchar *name,
+							 guint        n_threads);
 
 void		 gs_worker_thread_queue			(GsWorkerThread  *self,
 							 gint             priority,
 							 GTaskThreadFunc  work_func,
 							 GTask           *task);
+void		 gs_worker_thread_queue_parallel	(GsWorkerThread  *self,
+							 gint             priority,
+							 GTaskThreadFunc  work_func,
+							 GTask           *task);
 
 gboolean	 gs_worker_thread_is_in_worker_context	(GsWorkerThread *self);
 
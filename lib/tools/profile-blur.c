@@ -0,0 +1,239 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2024 GNOME Software contributors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <locale.h>
+#include <string.h>
+
+#include <gnome-software.h>
+
+/* Test program which measures the performance of gs_utils_pixbuf_blur() on
+ * screenshot-sized images, and checks that its output is identical to the
+ * original column-by-column implementation, which is kept below as a
+ * reference. It is linked against libgnomesoftware, so will use the function
+ * implementation from there. */
+
+static void
+reference_blur_private (GdkPixbuf *src, GdkPixbuf *dest, guint radius, guint8 *div_kernel_size)
+{
+	gint width, height, src_rowstride, dest_rowstride, n_channels;
+	guchar *p_src, *p_dest, *c1, *c2;
+	gint x, y, i, i1, i2, width_minus_1, height_minus_1, radius_plus_1;
+	gint r, g, b;
+	guchar *p_dest_row, *p_dest_col;
+
+	width = gdk_pixbuf_get_width (src);
+	height = gdk_pixbuf_get_height (src);
+	n_channels = gdk_pixbuf_get_n_channels (src);
+	radius_plus_1 = radius + 1;
+
+	/* horizontal blur */
+	p_src = gdk_pixbuf_get_pixels (src);
+	p_dest = gdk_pixbuf_get_pixels (dest);
+	src_rowstride = gdk_pixbuf_get_rowstride (src);
+	dest_rowstride = gdk_pixbuf_get_rowstride (dest);
+	width_minus_1 = width - 1;
+	for (y = 0; y < height; y++) {
+		r = g = b = 0;
+		for (i = -radius; i <= (gint) radius; i++) {
+			c1 = p_src + (CLAMP (i, 0, width_minus_1) * n_channels);
+			r += c1[0];
+			g += c1[1];
+			b += c1[2];
+		}
+
+		p_dest_row = p_dest;
+		for (x = 0; x < width; x++) {
+			p_dest_row[0] = div_kernel_size[r];
+			p_dest_row[1] = div_kernel_size[g];
+			p_dest_row[2] = div_kernel_size[b];
+			p_dest_row += n_channels;
+
+			i1 = MIN (x + radius_plus_1, width_minus_1);
+			c1 = p_src + (i1 * n_channels);
+			i2 = MAX (x - (gint) radius, 0);
+			c2 = p_src + (i2 * n_channels);
+
+			r += c1[0] - c2[0];
+			g += c1[1] - c2[1];
+			b += c1[2] - c2[2];
+		}
+
+		p_src += src_rowstride;
+		p_dest += dest_rowstride;
+	}
+
+	/* vertical blur */
+	p_src = gdk_pixbuf_get_pixels (dest);
+	p_dest = gdk_pixbuf_get_pixels (src);
+	src_rowstride = gdk_pixbuf_get_rowstride (dest);
+	dest_rowstride = gdk_pixbuf_get_rowstride (src);
+	height_minus_1 = height - 1;
+	for (x = 0; x < width; x++) {
+		r = g = b = 0;
+		for (i = -radius; i <= (gint) radius; i++) {
+			c1 = p_src + (CLAMP (i, 0, height_minus_1) * src_rowstride);
+			r += c1[0];
+			g += c1[1];
+			b += c1[2];
+		}
+
+		p_dest_col = p_dest;
+		for (y = 0; y < height; y++) {
+			p_dest_col[0] = div_kernel_size[r];
+			p_dest_col[1] = div_kernel_size[g];
+			p_dest_col[2] = div_kernel_size[b];
+			p_dest_col += dest_rowstride;
+
+			i1 = MIN (y + radius_plus_1, height_minus_1);
+			c1 = p_src + (i1 * src_rowstride);
+			i2 = MAX (y - (gint) radius, 0);
+			c2 = p_src + (i2 * src_rowstride);
+
+			r += c1[0] - c2[0];
+			g += c1[1] - c2[1];
+			b += c1[2] - c2[2];
+		}
+
+		p_src += n_channels;
+		p_dest += n_channels;
+	}
+}
+
+static void
+reference_blur (GdkPixbuf *src, guint radius, guint iterations)
+{
+	gint kernel_size = 2 * radius + 1;
+	g_autofree guchar *div_kernel_size = NULL;
+	g_autoptr(GdkPixbuf) tmp = NULL;
+
+	tmp = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (src),
+			      gdk_pixbuf_get_has_alpha (src),
+			      gdk_pixbuf_get_bits_per_sample (src),
+			      gdk_pixbuf_get_width (src),
+			      gdk_pixbuf_get_height (src));
+	div_kernel_size = g_new (guchar, 256 * kernel_size);
+	for (gint i = 0; i < 256 * kernel_size; i++)
+		div_kernel_size[i] = (guchar) (i / kernel_size);
+
+	while (iterations-- > 0)
+		reference_blur_private (src, tmp, radius, div_kernel_size);
+}
+
+/* Fill a pixbuf with noise, so the blur has something to average. */
+static GdkPixbuf *
+create_noise_pixbuf (gint     width,
+                     gint     height,
+                     gboolean has_alpha)
+{
+	g_autoptr(GdkPixbuf) pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, has_alpha, 8, width, height);
+	g_autoptr(GRand) rand = g_rand_new_with_seed (42);
+	guint8 *pixels = gdk_pixbuf_get_pixels (pixbuf);
+	gsize length = gdk_pixbuf_get_byte_length (pixbuf);
+
+	for (gsize i = 0; i < length; i++)
+		pixels[i] = g_rand_int_range (rand, 0, 256);
+
+	return g_steal_pointer (&pixbuf);
+}
+
+static gboolean
+pixbufs_equal (GdkPixbuf *a,
+               GdkPixbuf *b)
+{
+	gint height = gdk_pixbuf_get_height (a);
+	gint rowstride = gdk_pixbuf_get_rowstride (a);
+	gsize row_length = (gsize) gdk_pixbuf_get_width (a) * gdk_pixbuf_get_n_channels (a);
+
+	for (gint y = 0; y < height; y++) {
+		if (memcmp (gdk_pixbuf_read_pixels (a) + y * rowstride,
+			    gdk_pixbuf_read_pixels (b) + y * rowstride,
+			    row_length) != 0)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gint64
+time_blur (void      (*blur) (GdkPixbuf *, guint, guint),
+           GdkPixbuf  *src,
+           guint       radius,
+           guint       iterations,
+           guint       n_repeats,
+           GdkPixbuf **out_result)
+{
+	gint64 best = G_MAXINT64;
+
+	for (guint i = 0; i < n_repeats; i++) {
+		g_autoptr(GdkPixbuf) copy = gdk_pixbuf_copy (src);
+		gint64 start_time = g_get_monotonic_time ();
+
+		blur (copy, radius, iterations);
+		best = MIN (best, g_get_monotonic_time () - start_time);
+
+		if (i == n_repeats - 1)
+			*out_result = g_steal_pointer (&copy);
+	}
+
+	return best;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+	g_autoptr(GOptionContext) context = NULL;
+	gint width = 1920, height = 1080, radius = 5, iterations = 3, n_repeats = 5;
+	g_autoptr(GError) error = NULL;
+	const GOptionEntry options[] = {
+		{ "width", 'w', 0, G_OPTION_ARG_INT, &width, "Width of the test image", "PIXELS" },
+		{ "height", 'h', 0, G_OPTION_ARG_INT, &height, "Height of the test image", "PIXELS" },
+		{ "radius", 'r', 0, G_OPTION_ARG_INT, &radius, "Blur radius", "PIXELS" },
+		{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations, "Number of blur iterations", "N" },
+		{ "repeats", 'n', 0, G_OPTION_ARG_INT, &n_repeats, "Number of timed runs, of which the fastest is reported", "N" },
+		{ NULL }
+	};
+	gboolean all_equal = TRUE;
+
+	setlocale (LC_ALL, "");
+
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+
+	if (width < 1 || height < 1 || radius < 0 || iterations < 0 || n_repeats < 1) {
+		g_printerr ("Invalid arguments\n");
+		return 1;
+	}
+
+	for (guint has_alpha = 0; has_alpha <= 1; has_alpha++) {
+		g_autoptr(GdkPixbuf) src = create_noise_pixbuf (width, height, has_alpha);
+		g_autoptr(GdkPixbuf) reference_result = NULL;
+		g_autoptr(GdkPixbuf) result = NULL;
+		gint64 reference_duration, duration;
+		gboolean equal;
+
+		reference_duration = time_blur (reference_blur, src, radius, iterations, n_repeats, &reference_result);
+		duration = time_blur (gs_utils_pixbuf_blur, src, radius, iterations, n_repeats, &result);
+		equal = pixbufs_equal (reference_result, result);
+		all_equal = all_equal && equal;
+
+		g_print ("%s %dx%d, radius %d, %d iterations: reference %.1fms, gs_utils_pixbuf_blur() %.1fms (%.1f×), %s\n",
+			 has_alpha ? "RGBA" : "RGB", width, height, radius, iterations,
+			 reference_duration / 1000.0, duration / 1000.0,
+			 (gdouble) reference_duration / MAX (duration, 1),
+			 equal ? "identical" : "DIFFERENT");
+	}
+
+	return all_equal ? 0 : 2;
+}
@@ -20,8 +20,18 @@
 /* Test program which can be used to check the output and performance of the
  * gs_calculate_key_colors() function. It is linked against libgnomesoftware, so
  * will use the function implementation from there. It outputs a HTML page which
- * lists each icon from the flathub appstream data in your home directory, along
- * with its extracted key colors and how long extraction took. */
+ * lists each icon from the flathub appstream data in your home directory (or
+ * the given directory), along with its extracted key colors and how long
+ * extraction took.
+ *
+ * The key colors shown are calculated for all the icons at once with
+ * gs_calculate_key_colors_batch(), and the durations are timed for each icon
+ * on its own.
+ *
+ * With `--benchmark`, it instead measures the throughput of calculating the key
+ * colors for all the icons, one at a time and with
+ * gs_calculate_key_colors_batch(). Set `GS_KEY_COLORS_IMPL` to `scalar`, `sse2`
+ * or `avx2` to compare implementations. */
 
 static void
 print_colours (GString *html_output,
@@ -74,20 +84,81 @@ print_summary_statistics (GString *html_output,
 				min, max, mean, stddev, n_measurements);
 }
 
+static void
+print_throughput (const gchar *label,
+                  guint        n_icons,
+                  gint64       duration)
+{
+	g_print ("%s: %u icons in %.1fms, %.0f icons/s, %.1fμs per icon\n",
+		 label, n_icons, duration / 1000.0,
+		 n_icons / (duration / (gdouble) G_USEC_PER_SEC),
+		 (gdouble) duration / n_icons);
+}
+
+static void
+run_benchmark (GPtrArray *pixbufs,
+               guint      n_iterations)
+{
+	gint64 start_time, duration;
+
+	/* Warm up, so the first iteration isn’t penalised for page faults. */
+	for (guint i = 0; i < pixbufs->len; i++)
+		g_array_unref (gs_calculate_key_colors (pixbufs->pdata[i]));
+
+	for (guint iteration = 0; iteration < n_iterations; iteration++) {
+		g_autoptr(GPtrArray) results = NULL;
+
+		start_time = g_get_monotonic_time ();
+		for (guint i = 0; i < pixbufs->len; i++)
+			g_array_unref (gs_calculate_key_colors (pixbufs->pdata[i]));
+		duration = g_get_monotonic_time () - start_time;
+		print_throughput ("Sequential", pixbufs->len, duration);
+
+		start_time = g_get_monotonic_time ();
+		results = gs_calculate_key_colors_batch (pixbufs, GS_KEY_COLORS_FLAGS_NONE);
+		duration = g_get_monotonic_time () - start_time;
+		print_throughput ("Batch", pixbufs->len, duration);
+	}
+}
+
 int
-main (void)
+main (int    argc,
+      char **argv)
 {
 	const gchar *icons_subdir = ".local/share/flatpak/appstream/flathub/x86_64/active/icons/128x128";
-	g_autofree gchar *icons_dir = g_build_filename (g_get_home_dir (), icons_subdir, NULL);
+	g_autofree gchar *icons_dir = NULL;
 	g_autoptr(GDir) dir = NULL;
 	const gchar *entry;
 	g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
 	g_autoptr(GPtrArray) pixbufs = g_ptr_array_new_with_free_func (g_object_unref);
 	g_autoptr(GString) html_output = g_string_new ("");
 	g_autoptr(GArray) durations = g_array_new (FALSE, FALSE, sizeof (gint64));
+	g_autoptr(GPtrArray) batch_colours = NULL;
+	gint64 batch_start_time, batch_duration;
+	g_autoptr(GOptionContext) context = NULL;
+	gboolean benchmark = FALSE;
+	gint n_iterations = 5;
+	g_autoptr(GError) error = NULL;
+	const GOptionEntry options[] = {
+		{ "benchmark", 'b', 0, G_OPTION_ARG_NONE, &benchmark, "Measure throughput rather than outputting HTML", NULL },
+		{ "iterations", 'n', 0, G_OPTION_ARG_INT, &n_iterations, "Number of benchmark iterations", "N" },
+		{ NULL }
+	};
 
 	setlocale (LC_ALL, "");
 
+	context = g_option_context_new ("[ICONS-DIRECTORY]");
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error)) {
+		g_printerr ("%s\n", error->message);
+		return 1;
+	}
+
+	if (argc > 1)
+		icons_dir = g_strdup (argv[1]);
+	else
+		icons_dir = g_build_filename (g_get_home_dir (), icons_subdir, NULL);
+
 	/* Load pixbufs from the icons directory. */
 	dir = g_dir_open (icons_dir, 0, NULL);
 	if (dir == NULL)
@@ -107,6 +178,18 @@ main (void)
 	if (!pixbufs->len)
 		return 2;
 
+	if (benchmark) {
+		run_benchmark (pixbufs, MAX (n_iterations, 1));
+		return 0;
+	}
+
+	/* Calculate the key colours for the whole directory at once. */
+	batch_start_time = g_get_monotonic_time ();
+	batch_colours = gs_calculate_key_colors_batch (pixbufs, GS_KEY_COLORS_FLAGS_NONE);
+	batch_duration = g_get_monotonic_time () - batch_start_time;
+	g_message ("Calculated key colours for %u icons in %.1fms",
+		   pixbufs->len, batch_duration / 1000.0);
+
 	/* Set up an output page */
 	g_string_append (html_output,
 			 "<!DOCTYPE html>\n"
@@ -133,18 +216,18 @@ main (void)
 			 "        </tr>\n"
 			 "      </thead>\n");
 
-	/* For each pixbuf, run both algorithms. */
+	/* For each pixbuf, time the calculation on its own. */
 	for (guint i = 0; i < pixbufs->len; i++) {
 		GdkPixbuf *pixbuf = pixbufs->pdata[i];
 		const gchar *filename = filenames->pdata[i];
 		g_autofree gchar *basename = g_path_get_basename (filename);
-		g_autoptr(GArray) colours = NULL;
+		GArray *colours = batch_colours->pdata[i];
 		gint64 start_time, duration;
 
 		g_message ("Processing %u of %u, %s", i + 1, pixbufs->len, filename);
 
 		start_time = g_get_real_time ();
-		colours = gs_calculate_key_colors (pixbuf);
+		g_array_unref (gs_calculate_key_colors (pixbuf));
 		duration = g_get_real_time () - start_time;
 
 		g_string_append_printf (html_output,
@@ -17,6 +17,7 @@
 #include "gs-appstream.h"
 #include "gs-external-appstream-utils.h"
 #include "gs-plugin-appstream.h"
+#include "gs-profiler.h"
 
 /*
  * SECTION:
@@ -35,8 +36,13 @@ struct _GsPluginAppstream
 
 	GsWorkerThread		*worker;  /* (owned) */
 
+	/* @silo_lock is only held for writing while a new silo is published;
+	 * it is built with @silo_build_mutex held instead */
 	XbSilo			*silo;
 	GRWLock			 silo_lock;
+	GMutex			 silo_build_mutex;
+	gint			 silo_rebuilding; /* (atomic); threads rebuilding it or waiting to */
+	GsUtilsLockStalls	 silo_reader_stalls;
 	gchar			*silo_filename;
 	GHashTable		*silo_installed_by_desktopid;
 	GHashTable		*silo_installed_by_id;
@@ -44,6 +50,7 @@ struct _GsPluginAppstream
 	GSettings		*settings;
 
 	GPtrArray		*file_monitors; /* (owned) (element-type GFileMonitor) */
+	GPtrArray		*silo_cache_ids; /* (owned) (element-type filename) (locked-by silo_build_mutex) */
 	/* The stamps help to avoid locking the silo lock in the main thread
 	   and also to detect changes while loading other appstream data. */
 	gint			 file_monitor_stamp; /* the file monitor stamp, increased on every file monitor change */
@@ -66,8 +73,10 @@ gs_plugin_appstream_dispose (GObject *object)
 	g_clear_pointer (&self->silo_installed_by_id, g_hash_table_unref);
 	g_clear_object (&self->settings);
 	g_rw_lock_clear (&self->silo_lock);
+	g_mutex_clear (&self->silo_build_mutex);
 	g_clear_object (&self->worker);
 	g_clear_pointer (&self->file_monitors, g_ptr_array_unref);
+	g_clear_pointer (&self->silo_cache_ids, g_ptr_array_unref);
 
 	G_OBJECT_CLASS (gs_plugin_appstream_parent_class)->dispose (object);
 }
@@ -80,6 +89,7 @@ gs_plugin_appstream_init (GsPluginAppstream *self)
 	/* XbSilo needs external locking as we destroy the silo and build a new
 	 * one when something changes */
 	g_rw_lock_init (&self->silo_lock);
+	g_mutex_init (&self->silo_build_mutex);
 
 	/* need package name */
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_RUN_AFTER, "dpkg");
@@ -94,6 +104,7 @@ gs_plugin_appstream_init (GsPluginAppstream *self)
 	}
 
 	self->file_monitors = g_ptr_array_new_with_free_func (g_object_unref);
+	self->silo_cache_ids = g_ptr_array_new_with_free_func (g_free);
 }
 
 static const gchar *
@@ -278,6 +289,22 @@ gs_plugin_appstream_load_appdata_fn (GsPluginAppstream  *self,
 	return TRUE;
 }
 
+/* Called with @silo_build_mutex held. Remembers @cache_id, so the cached silo
+ * is kept by gs_appstream_remove_unused_cached_silos() after the rebuild. */
+static gboolean
+gs_plugin_appstream_import_cached_silo (GsPluginAppstream    *self,
+                                        XbBuilder            *builder,
+                                        XbBuilder            *sub_builder,
+                                        const gchar          *cache_id,
+                                        const gchar * const  *elements_to_tokenize,
+                                        GCancellable         *cancellable,
+                                        GError              **error)
+{
+	g_ptr_array_add (self->silo_cache_ids, g_strdup (cache_id));
+	return gs_appstream_import_cached_silo (builder, sub_builder, cache_id,
+						elements_to_tokenize, cancellable, error);
+}
+
 static gboolean
 gs_plugin_appstream_load_appdata (GsPluginAppstream  *self,
                                   XbBuilder          *builder,
@@ -290,6 +317,7 @@ gs_plugin_appstream_load_appdata (GsPluginAppstream  *self,
 	g_autoptr(GFile) parent = g_file_new_for_path (path);
 	g_autoptr(GFileMonitor) file_monitor = NULL;
 	g_autoptr(GError) local_error = NULL;
+	g_autoptr(XbBuilder) sub_builder = NULL;
 	if (!g_file_query_exists (parent, cancellable)) {
 		g_debug ("appstream: Skipping appdata path '%s' as %s", path, g_cancellable_is_cancelled (cancellable) ? "cancelled" : "does not exist");
 		return TRUE;
@@ -306,13 +334,16 @@ gs_plugin_appstream_load_appdata (GsPluginAppstream  *self,
 		g_debug ("appstream: Failed to create file monitor for '%s': %s", path, local_error->message);
 	gs_plugin_appstream_maybe_store_file_monitor (self, file_monitor);
 
+	sub_builder = xb_builder_new ();
+	gs_appstream_add_current_locales (sub_builder);
+
 	while ((fn = g_dir_read_name (dir)) != NULL) {
 		if (g_str_has_suffix (fn, ".appdata.xml") ||
 		    g_str_has_suffix (fn, ".metainfo.xml")) {
 			g_autofree gchar *filename = g_build_filename (path, fn, NULL);
 			g_autoptr(GError) error_local = NULL;
 			if (!gs_plugin_appstream_load_appdata_fn (self,
-								  builder,
+								  sub_builder,
 								  filename,
 								  cancellable,
 								  &error_local)) {
@@ -322,8 +353,8 @@ gs_plugin_appstream_load_appdata (GsPluginAppstream  *self,
 		}
 	}
 
-	/* success */
-	return TRUE;
+	return gs_plugin_appstream_import_cached_silo (self, builder, sub_builder, path, NULL,
+						       cancellable, error);
 }
 
 static GInputStream *
@@ -369,21 +400,22 @@ gs_plugin_appstream_load_dep11_cb (XbBuilderSource *self,
 	return g_memory_input_stream_new_from_data (g_steal_pointer (&xml), (gssize) -1, g_free);
 }
 
+static const gchar * const elements_to_tokenize[] = {
+	"id",
+	"keyword",
+	"launchable",
+	"mimetype",
+	"name",
+	"pkgname",
+	"summary",
+	NULL };
+
 static gboolean
 gs_plugin_appstream_tokenize_cb (XbBuilderFixup *self,
 				 XbBuilderNode *bn,
 				 gpointer user_data,
 				 GError **error)
 {
-	const gchar * const elements_to_tokenize[] = {
-		"id",
-		"keyword",
-		"launchable",
-		"mimetype",
-		"name",
-		"pkgname",
-		"summary",
-		NULL };
 	if (xb_builder_node_get_element (bn) != NULL &&
 	    g_strv_contains (elements_to_tokenize, xb_builder_node_get_element (bn)))
 		xb_builder_node_tokenize_text (bn);
@@ -404,6 +436,7 @@ gs_plugin_appstream_load_appstream_fn (GsPluginAppstream  *self,
 	g_autoptr(XbBuilderFixup) fixup3 = NULL;
 	g_autoptr(XbBuilderFixup) fixup4 = NULL;
 	g_autoptr(XbBuilderFixup) fixup5 = NULL;
+	g_autoptr(XbBuilder) sub_builder = xb_builder_new ();
 	g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
 
 	/* add support for DEP-11 files */
@@ -461,9 +494,13 @@ gs_plugin_appstream_load_appstream_fn (GsPluginAppstream  *self,
 	xb_builder_fixup_set_max_depth (fixup5, 3);
 	xb_builder_source_add_fixup (source, fixup5);
 
-	/* success */
-	xb_builder_import_source (builder, source);
-	return TRUE;
+	/* compile each catalog separately, so that a change to one of them
+	 * does not require all the others to be parsed again */
+	gs_appstream_add_current_locales (sub_builder);
+	xb_builder_import_source (sub_builder, source);
+	return gs_plugin_appstream_import_cached_silo (self, builder, sub_builder, filename,
+						       elements_to_tokenize,
+						       cancellable, error);
 }
 
 static gboolean
@@ -534,38 +571,54 @@ gs_add_appstream_metainfo_location (GPtrArray *locations, const gchar *root)
 }
 
 static gboolean
-gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
-                                GCancellable       *cancellable,
-                                GError            **error)
+gs_plugin_appstream_silo_is_loaded (GsPluginAppstream *self)
+{
+	g_autoptr(GRWLockReaderLocker) locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
+	return self->silo != NULL;
+}
+
+static gboolean
+gs_plugin_appstream_silo_is_current (GsPluginAppstream *self)
+{
+	g_autoptr(GRWLockReaderLocker) locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
+	return self->silo != NULL && xb_silo_is_valid (self->silo) &&
+	       g_atomic_int_get (&self->file_monitor_stamp_current) == g_atomic_int_get (&self->file_monitor_stamp);
+}
+
+/* Called with @silo_build_mutex held. */
+static gboolean
+gs_plugin_appstream_rebuild_silo (GsPluginAppstream  *self,
+                                  GCancellable       *cancellable,
+                                  GError            **error)
 {
 	const gchar *test_xml;
 	g_autofree gchar *blobfn = NULL;
+	g_autofree gchar *indexfn = NULL;
 	g_autoptr(XbBuilder) builder = NULL;
 	g_autoptr(XbNode) n = NULL;
 	g_autoptr(GFile) file = NULL;
 	g_autoptr(GPtrArray) installed = NULL;
-	g_autoptr(GRWLockReaderLocker) reader_locker = NULL;
 	g_autoptr(GRWLockWriterLocker) writer_locker = NULL;
 	g_autoptr(GPtrArray) parent_appdata = g_ptr_array_new_with_free_func (g_free);
 	g_autoptr(GPtrArray) parent_appstream = NULL;
 	g_autoptr(GMainContext) old_thread_default = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+	g_autofree gchar *silo_filename = NULL;
+	g_autoptr(GHashTable) installed_by_desktopid = NULL;
+	g_autoptr(GHashTable) installed_by_id = NULL;
+	AsComponentScope default_scope = AS_COMPONENT_SCOPE_UNKNOWN;
 
-	reader_locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-	/* everything is okay */
-	if (self->silo != NULL && xb_silo_is_valid (self->silo) &&
-	    g_atomic_int_get (&self->file_monitor_stamp_current) == g_atomic_int_get (&self->file_monitor_stamp))
-		return TRUE;
-	g_clear_pointer (&reader_locker, g_rw_lock_reader_locker_free);
-
-	/* drat! silo needs regenerating */
-	writer_locker = g_rw_lock_writer_locker_new (&self->silo_lock);
  reload:
-	g_clear_object (&self->silo);
-	g_clear_pointer (&self->silo_filename, g_free);
-	g_clear_pointer (&self->silo_installed_by_desktopid, g_hash_table_unref);
-	g_clear_pointer (&self->silo_installed_by_id, g_hash_table_unref);
-	self->default_scope = AS_COMPONENT_SCOPE_UNKNOWN;
+	g_clear_pointer (&blobfn, g_free);
+	g_clear_object (&file);
+	g_clear_object (&builder);
+	g_clear_object (&silo);
+	g_clear_pointer (&silo_filename, g_free);
+	g_clear_pointer (&installed_by_desktopid, g_hash_table_unref);
+	g_clear_pointer (&installed_by_id, g_hash_table_unref);
+	default_scope = AS_COMPONENT_SCOPE_UNKNOWN;
 	g_ptr_array_set_size (self->file_monitors, 0);
+	g_ptr_array_set_size (self->silo_cache_ids, 0);
 	g_atomic_int_set (&self->file_monitor_stamp_current, g_atomic_int_get (&self->file_monitor_stamp));
 
 	/* FIXME: https://gitlab.gnome.org/GNOME/gnome-software/-/issues/1422 */
@@ -656,8 +709,11 @@ gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
 		}
 		for (guint i = 0; i < parent_desktop->len; i++) {
 			g_autoptr(GFileMonitor) file_monitor = NULL;
+			g_autoptr(XbBuilder) sub_builder = xb_builder_new ();
 			const gchar *dir = g_ptr_array_index (parent_desktop, i);
-			if (!gs_appstream_load_desktop_files (builder, dir, NULL, &file_monitor, cancellable, error)) {
+			gs_appstream_add_current_locales (sub_builder);
+			if (!gs_appstream_load_desktop_files (sub_builder, dir, NULL, &file_monitor, cancellable, error) ||
+			    !gs_plugin_appstream_import_cached_silo (self, builder, sub_builder, dir, NULL, cancellable, error)) {
 				if (old_thread_default != NULL)
 					g_main_context_push_thread_default (old_thread_default);
 				return FALSE;
@@ -692,11 +748,13 @@ gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
 	if (old_thread_default != NULL)
 		g_main_context_pop_thread_default (old_thread_default);
 
-	self->silo = xb_builder_ensure (builder, file,
-					XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
-					XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
-					NULL, error);
-	if (self->silo == NULL) {
+	GS_PROFILER_BEGIN_SCOPED (AppstreamEnsureSilo, "appstream-ensure-silo", NULL);
+	silo = xb_builder_ensure (builder, file,
+				  XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
+				  XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
+				  NULL, error);
+	GS_PROFILER_END_SCOPED (AppstreamEnsureSilo);
+	if (silo == NULL) {
 		if (old_thread_default != NULL)
 			g_main_context_push_thread_default (old_thread_default);
 		return FALSE;
@@ -713,7 +771,7 @@ gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
 	}
 
 	/* test we found something */
-	n = xb_silo_query_first (self->silo, "components/component", NULL);
+	n = xb_silo_query_first (silo, "components/component", NULL);
 	if (n == NULL) {
 		g_warning ("No AppStream data, try 'make install-sample-data' in data/");
 		g_set_error (error,
@@ -725,55 +783,117 @@ gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
 
 	g_clear_object (&n);
 
-	self->silo_installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-	self->silo_installed_by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	/* drop the cached silos of sources which have gone away */
+	if (test_xml == NULL)
+		gs_appstream_remove_unused_cached_silos (self->silo_cache_ids);
+
+	/* build the search index now rather than on the first search */
+	indexfn = gs_utils_get_cache_filename ("appstream", "components-search.idx",
+					       GS_UTILS_CACHE_FLAG_WRITEABLE |
+					       GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					       NULL);
+	if (indexfn != NULL) {
+		g_autoptr(GFile) index_file = g_file_new_for_path (indexfn);
+		gs_appstream_search_index_ensure (silo, index_file);
+	}
+
+	installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+	installed_by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-	installed = xb_silo_query (self->silo, "/component[@type='desktop-application']/launchable[@type='desktop-id']", 0, NULL);
+	installed = xb_silo_query (silo, "/component[@type='desktop-application']/launchable[@type='desktop-id']", 0, NULL);
 	for (guint i = 0; installed != NULL && i < installed->len; i++) {
 		XbNode *launchable = g_ptr_array_index (installed, i);
 		const gchar *id = xb_node_get_text (launchable);
 		if (id != NULL && *id != '\0') {
-			GPtrArray *nodes = g_hash_table_lookup (self->silo_installed_by_desktopid, id);
+			GPtrArray *nodes = g_hash_table_lookup (installed_by_desktopid, id);
 			if (nodes == NULL) {
 				nodes = g_ptr_array_new_with_free_func (g_object_unref);
-				g_hash_table_insert (self->silo_installed_by_desktopid, g_strdup (id), nodes);
+				g_hash_table_insert (installed_by_desktopid, g_strdup (id), nodes);
 			}
 			g_ptr_array_add (nodes, xb_node_get_parent (launchable));
 		}
 	}
 
 	g_clear_pointer (&installed, g_ptr_array_unref);
-	installed = xb_silo_query (self->silo, "/component/id", 0, NULL);
+	installed = xb_silo_query (silo, "/component/id", 0, NULL);
 	for (guint i = 0; installed != NULL && i < installed->len; i++) {
 		XbNode *id_node = g_ptr_array_index (installed, i);
 		const gchar *id = xb_node_get_text (id_node);
 		if (id != NULL && *id != '\0')
-			g_hash_table_add (self->silo_installed_by_id, g_strdup (id));
+			g_hash_table_add (installed_by_id, g_strdup (id));
 	}
 
-	n = xb_silo_query_first (self->silo, "info", NULL);
+	n = xb_silo_query_first (silo, "info", NULL);
 	if (n != NULL) {
 		g_autoptr(XbNode) child = NULL;
 		g_autoptr(XbNode) next = NULL;
 		for (child = xb_node_get_child (n);
-		     child != NULL && (self->silo_filename == NULL || self->default_scope == AS_COMPONENT_SCOPE_UNKNOWN);
+		     child != NULL && (silo_filename == NULL || default_scope == AS_COMPONENT_SCOPE_UNKNOWN);
 		     g_object_unref (child), child = g_steal_pointer (&next)) {
 			const gchar *elem = xb_node_get_element (child);
 			next = xb_node_get_next (child);
-			if (self->silo_filename == NULL && g_strcmp0 (elem, "filename") == 0) {
-				self->silo_filename = g_strdup (xb_node_get_text (child));
-			} else if (self->default_scope == AS_COMPONENT_SCOPE_UNKNOWN && g_strcmp0 (elem, "scope") == 0) {
+			if (silo_filename == NULL && g_strcmp0 (elem, "filename") == 0) {
+				silo_filename = g_strdup (xb_node_get_text (child));
+			} else if (default_scope == AS_COMPONENT_SCOPE_UNKNOWN && g_strcmp0 (elem, "scope") == 0) {
 				const gchar *tmp = xb_node_get_text (child);
 				if (tmp != NULL)
-					self->default_scope = as_component_scope_from_string (tmp);
+					default_scope = as_component_scope_from_string (tmp);
 			}
 		}
 	}
 
+	/* publish the new silo; this only waits for readers of the old one */
+	writer_locker = g_rw_lock_writer_locker_new (&self->silo_lock);
+	g_set_object (&self->silo, silo);
+	g_clear_pointer (&self->silo_filename, g_free);
+	self->silo_filename = g_steal_pointer (&silo_filename);
+	g_clear_pointer (&self->silo_installed_by_desktopid, g_hash_table_unref);
+	self->silo_installed_by_desktopid = g_steal_pointer (&installed_by_desktopid);
+	g_clear_pointer (&self->silo_installed_by_id, g_hash_table_unref);
+	self->silo_installed_by_id = g_steal_pointer (&installed_by_id);
+	self->default_scope = default_scope;
+	g_clear_pointer (&writer_locker, g_rw_lock_writer_locker_free);
+
+	g_debug ("appstream: readers stalled %u times on the silo lock, for %.1fms in total",
+		 (guint) g_atomic_int_get (&self->silo_reader_stalls.n_stalls),
+		 (gdouble) (gsize) g_atomic_pointer_get (&self->silo_reader_stalls.stall_usec) / 1000.0);
+
 	/* success */
 	return TRUE;
 }
 
+static gboolean
+gs_plugin_appstream_check_silo (GsPluginAppstream  *self,
+                                GCancellable       *cancellable,
+                                GError            **error)
+{
+	g_autoptr(GMutexLocker) build_locker = NULL;
+	gboolean ret;
+
+	/* everything is okay */
+	if (gs_plugin_appstream_silo_is_current (self))
+		return TRUE;
+
+	/* another thread is already regenerating it, so carry on using the
+	 * old silo until the new one is published */
+	if (g_atomic_int_get (&self->silo_rebuilding) > 0 &&
+	    gs_plugin_appstream_silo_is_loaded (self))
+		return TRUE;
+
+	/* drat! silo needs regenerating; say so before waiting for the build
+	 * lock, so other threads don’t queue up behind it meanwhile */
+	g_atomic_int_inc (&self->silo_rebuilding);
+	build_locker = g_mutex_locker_new (&self->silo_build_mutex);
+	if (gs_plugin_appstream_silo_is_current (self))
+		ret = TRUE;
+	else
+		ret = gs_plugin_appstream_rebuild_silo (self, cancellable, error);
+	g_clear_pointer (&build_locker, g_mutex_locker_free);
+	g_atomic_int_add (&self->silo_rebuilding, -1);
+
+	return ret;
+}
+
 static void
 gs_plugin_appstream_reload (GsPlugin *plugin)
 {
@@ -917,7 +1037,7 @@ gs_plugin_url_to_app (GsPlugin *plugin,
 	if (!gs_plugin_appstream_check_silo (self, cancellable, error))
 		return FALSE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	return gs_appstream_url_to_app (plugin, self->silo, list, url, cancellable, error);
 }
@@ -978,7 +1098,7 @@ gs_plugin_appstream_refine_state (GsPluginAppstream  *self,
 	if (gs_app_get_id (app) == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	if (g_hash_table_contains (self->silo_installed_by_id, gs_app_get_id (app)))
 		gs_app_set_state (app, GS_APP_STATE_INSTALLED);
@@ -1003,7 +1123,7 @@ gs_plugin_refine_from_id (GsPluginAppstream    *self,
 	if (id == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	origin = gs_app_get_origin_appstream (app);
 
@@ -1055,7 +1175,7 @@ gs_plugin_refine_from_pkgname (GsPluginAppstream    *self,
 		g_autoptr(GString) xpath = g_string_new (NULL);
 		g_autoptr(XbNode) component = NULL;
 
-		locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+		locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 		/* prefer actual apps and then fallback to anything else */
 		xb_string_append_union (xpath, "components/component[@type='desktop-application']/pkgname[text()='%s']/..", pkgname);
@@ -1148,7 +1268,7 @@ refine_thread_cb (GTask        *task,
 	apps_by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 	apps_by_origin_and_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	components = xb_silo_query (self->silo, "components/component/id", 0, NULL);
 	for (guint i = 0; components != NULL && i < components->len; i++) {
@@ -1285,7 +1405,7 @@ refine_wildcard (GsPluginAppstream    *self,
 	if (id == NULL)
 		return TRUE;
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	components = g_hash_table_lookup (apps_by_id, id);
 	if (components == NULL)
@@ -1372,7 +1492,7 @@ refine_categories_thread_cb (GTask        *task,
 		return;
 	}
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	if (!gs_appstream_refine_category_sizes (self->silo, data->list, cancellable, &local_error)) {
 		g_task_return_error (task, g_steal_pointer (&local_error));
@@ -1483,7 +1603,7 @@ list_apps_thread_cb (GTask        *task,
 		return;
 	}
 
-	locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	if (released_since != NULL &&
 	    !gs_appstream_add_recent (GS_PLUGIN (self), self->silo, list, age_secs,
@@ -217,6 +217,10 @@ gs_plugin_icons_class_init (GsPluginIconsClass *klass)
 	plugin_class->shutdown_finish = gs_plugin_icons_shutdown_finish;
 	plugin_class->refine_async = gs_plugin_icons_refine_async;
 	plugin_class->refine_finish = gs_plugin_icons_refine_finish;
+
+	/* loads the icons which other plugins have added to apps */
+	plugin_class->refine_flags_consumed = GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON;
+	plugin_class->refine_flags_produced = GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON;
 }
 
 GType
@@ -190,6 +190,10 @@ gs_plugin_provenance_license_class_init (GsPluginProvenanceLicenseClass *klass)
 
 	plugin_class->refine_async = gs_plugin_provenance_license_refine_async;
 	plugin_class->refine_finish = gs_plugin_provenance_license_refine_finish;
+
+	plugin_class->refine_flags_consumed = GS_PLUGIN_REFINE_FLAGS_REQUIRE_ORIGIN |
+					      GS_PLUGIN_REFINE_FLAGS_REQUIRE_PROVENANCE;
+	plugin_class->refine_flags_produced = GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE;
 }
 
 GType
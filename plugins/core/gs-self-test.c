@@ -9,6 +9,7 @@
 #include "config.h"
 
 #include <glib/gstdio.h>
+#include <utime.h>
 
 #include "gnome-software-private.h"
 
@@ -65,6 +66,326 @@ gs_plugins_core_search_repo_name_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DESKTOP_APP);
 }
 
+static void
+gs_plugins_core_search_index_func (GsPluginLoader *plugin_loader)
+{
+	const gchar *keywords_list[][3] = {
+		/* substring of the package name, only matched by contains() */
+		{ "rachn", NULL, },
+		/* every term has to match */
+		{ "arach", "test", NULL },
+		/* refines the previous search, as when typing */
+		{ "arachn", "test", NULL },
+		/* no longer than the bigram keys of the index */
+		{ "ar", NULL, },
+	};
+
+	for (gsize i = 0; i < G_N_ELEMENTS (keywords_list); i++) {
+		GsApp *app;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(GsAppList) list = NULL;
+		g_autoptr(GsPluginJob) plugin_job = NULL;
+		g_autoptr(GsAppQuery) query = NULL;
+
+		query = gs_app_query_new ("keywords", keywords_list[i],
+					  "dedupe-flags", GS_PLUGIN_JOB_DEDUPE_FLAGS_DEFAULT,
+					  "sort-func", gs_utils_app_sort_match_value,
+					  NULL);
+		plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+
+		list = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+		gs_test_flush_main_context ();
+		g_assert_no_error (error);
+		g_assert_nonnull (list);
+
+		g_assert_cmpint (gs_app_list_length (list), >=, 1);
+		app = gs_app_list_index (list, 0);
+		g_assert_cmpstr (gs_app_get_id (app), ==, "arachne.desktop");
+	}
+}
+
+/* Checks that gs_appstream_search() returns exactly the components which the
+ * search queries match without the search index. */
+static void
+gs_plugins_core_search_index_check (GsPlugin    *plugin,
+				    XbSilo      *silo,
+				    const gchar *value)
+{
+	const gchar *xpaths[] = {
+		"components/component/name[text()~=stem(?)]/..",
+		"components/component/name[contains(text(),stem(?))]/..",
+		"components/component/summary[text()~=stem(?)]/..",
+		"components/component/id[text()~=stem(?)]/..",
+		NULL
+	};
+	const gchar *values[] = { value, NULL };
+	g_autoptr(GHashTable) expected = g_hash_table_new (g_str_hash, g_str_equal);
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GError) error = NULL;
+	gboolean ret;
+
+	for (guint i = 0; xpaths[i] != NULL; i++) {
+		g_auto(XbQueryContext) context = XB_QUERY_CONTEXT_INIT ();
+		g_autoptr(XbQuery) query = xb_query_new (silo, xpaths[i], &error);
+		g_autoptr(GPtrArray) components = NULL;
+
+		g_assert_no_error (error);
+		xb_value_bindings_bind_str (xb_query_context_get_bindings (&context), 0, value, NULL);
+		components = xb_silo_query_with_context (silo, query, &context, NULL);
+		for (guint j = 0; components != NULL && j < components->len; j++) {
+			XbNode *component = g_ptr_array_index (components, j);
+			g_hash_table_add (expected, (gpointer) xb_node_query_text (component, "id", NULL));
+		}
+	}
+
+	ret = gs_appstream_search (plugin, silo, values, list, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	g_debug ("search for %s matched %u components", value, g_hash_table_size (expected));
+	g_assert_cmpuint (gs_app_list_length (list), ==, g_hash_table_size (expected));
+	for (guint i = 0; i < gs_app_list_length (list); i++)
+		g_assert_true (g_hash_table_contains (expected, gs_app_get_id (gs_app_list_index (list, i))));
+}
+
+static void
+gs_plugins_core_search_stemming_func (GsPluginLoader *plugin_loader)
+{
+	GsPlugin *plugin = gs_plugin_loader_find_plugin (plugin_loader, "appstream");
+	g_autoptr(XbBuilder) builder = xb_builder_new ();
+	g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
+	g_autoptr(XbSilo) silo = NULL;
+	g_autoptr(GError) error = NULL;
+	gboolean ret;
+	const gchar *xml =
+		"<components origin=\"stemming\">\n"
+		"  <component type=\"desktop-application\">\n"
+		"    <id>org.example.Contacts</id>\n"
+		"    <name>Address Book</name>\n"
+		"    <summary>Keep track of people</summary>\n"
+		"  </component>\n"
+		"  <component type=\"desktop-application\">\n"
+		"    <id>org.example.Launcher</id>\n"
+		"    <name>Game Launcher</name>\n"
+		"    <summary>Start your games</summary>\n"
+		"  </component>\n"
+		"  <component type=\"desktop-application\">\n"
+		"    <id>org.example.Monitor</id>\n"
+		"    <name>Gamin</name>\n"
+		"    <summary>File alteration monitor</summary>\n"
+		"  </component>\n"
+		"  <component type=\"desktop-application\">\n"
+		"    <id>org.example.Survival</id>\n"
+		"    <name>Dying Light</name>\n"
+		"    <summary>Survive the night</summary>\n"
+		"  </component>\n"
+		"</components>\n";
+
+	g_assert_nonnull (plugin);
+
+	ret = xb_builder_source_load_xml (source, xml, XB_BUILDER_SOURCE_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	xb_builder_import_source (builder, source);
+	silo = xb_builder_compile (builder, XB_BUILDER_COMPILE_FLAG_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+
+	/* “ads” stems to “ad”, which matches “Address Book” even though it
+	 * doesn’t contain “ads” */
+	gs_plugins_core_search_index_check (plugin, silo, "ads");
+
+	/* irregular words are stemmed to something else entirely */
+	gs_plugins_core_search_index_check (plugin, silo, "die");
+
+	/* typing a longer term can match more, as “gaming” stems to “game”
+	 * while “gamin” isn’t stemmed, so the results of each search mustn’t
+	 * be narrowed down to those of the previous one */
+	gs_plugins_core_search_index_check (plugin, silo, "ga");
+	gs_plugins_core_search_index_check (plugin, silo, "gam");
+	gs_plugins_core_search_index_check (plugin, silo, "gamin");
+	gs_plugins_core_search_index_check (plugin, silo, "gaming");
+	gs_plugins_core_search_index_check (plugin, silo, "ad");
+	gs_plugins_core_search_index_check (plugin, silo, "ads");
+
+	/* longer terms whose stems extend the previous ones are narrowed down
+	 * to the previous results, which must not lose any */
+	gs_plugins_core_search_index_check (plugin, silo, "surv");
+	gs_plugins_core_search_index_check (plugin, silo, "survi");
+	gs_plugins_core_search_index_check (plugin, silo, "surviv");
+
+	/* terms which libxmlb splits into several tokens are never narrowed,
+	 * as any one of the tokens may match */
+	gs_plugins_core_search_index_check (plugin, silo, "org.");
+	gs_plugins_core_search_index_check (plugin, silo, "org.example.m");
+}
+
+static XbSilo *
+gs_plugins_core_incremental_silo_build (const gchar *catalog_fn,
+					const gchar *desktop_dir)
+{
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (catalog_fn);
+	g_autoptr(XbBuilder) builder = xb_builder_new ();
+	g_autoptr(XbBuilder) catalog_builder = xb_builder_new ();
+	g_autoptr(XbBuilder) desktop_builder = xb_builder_new ();
+	g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
+	g_autoptr(XbSilo) silo = NULL;
+	gboolean ret;
+
+	ret = xb_builder_source_load_file (source, file, XB_BUILDER_SOURCE_FLAG_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	xb_builder_import_source (catalog_builder, source);
+	ret = gs_appstream_import_cached_silo (builder, catalog_builder, catalog_fn, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	ret = gs_appstream_load_desktop_files (desktop_builder, desktop_dir, NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	ret = gs_appstream_import_cached_silo (builder, desktop_builder, desktop_dir, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	silo = xb_builder_compile (builder, XB_BUILDER_COMPILE_FLAG_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+
+	return g_steal_pointer (&silo);
+}
+
+static void
+gs_plugins_core_incremental_silo_func (void)
+{
+	const guint n_components = 5000;
+	const guint n_desktop_files = 50;
+	gboolean ret;
+	gdouble elapsed_full, elapsed_incremental;
+	GStatBuf statbuf;
+	dev_t catalog_silo_dev;
+	ino_t catalog_silo_ino;
+	g_autofree gchar *tmp_dir = NULL;
+	g_autofree gchar *catalog_fn = NULL;
+	g_autofree gchar *catalog_checksum = NULL;
+	g_autofree gchar *catalog_silo_basename = NULL;
+	g_autofree gchar *catalog_silo_fn = NULL;
+	g_autofree gchar *desktop_checksum = NULL;
+	g_autofree gchar *desktop_silo_basename = NULL;
+	g_autofree gchar *desktop_silo_fn = NULL;
+	g_autoptr(GPtrArray) cache_ids = g_ptr_array_new ();
+	g_autofree gchar *desktop_dir = NULL;
+	g_autofree gchar *desktop_fn = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) xml = g_string_new ("<components origin=\"bench\" version=\"0.9\">\n");
+	g_autoptr(GTimer) timer = g_timer_new ();
+	g_autoptr(XbNode) node = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+
+	tmp_dir = g_build_filename (g_getenv ("GS_SELF_TEST_CACHEDIR"), "incremental-silo", NULL);
+	desktop_dir = g_build_filename (tmp_dir, "applications", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (desktop_dir, 0755), ==, 0);
+
+	/* a large catalog, which should not be parsed again below */
+	for (guint i = 0; i < n_components; i++) {
+		g_string_append_printf (xml,
+					"  <component type=\"desktop-application\">\n"
+					"    <id>org.example.Bench%u</id>\n"
+					"    <name>Bench %u</name>\n"
+					"    <summary>Benchmark application number %u</summary>\n"
+					"    <pkgname>bench%u</pkgname>\n"
+					"  </component>\n", i, i, i, i);
+	}
+	g_string_append (xml, "</components>\n");
+	catalog_fn = g_build_filename (tmp_dir, "catalog.xml", NULL);
+	ret = g_file_set_contents (catalog_fn, xml->str, -1, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	for (guint i = 0; i < n_desktop_files; i++) {
+		g_autofree gchar *basename = g_strdup_printf ("org.example.Desktop%u.desktop", i);
+		g_autofree gchar *contents = g_strdup_printf ("[Desktop Entry]\n"
+							      "Type=Application\n"
+							      "Name=Desktop %u\n"
+							      "Comment=Desktop file number %u\n"
+							      "Exec=true\n", i, i);
+		g_clear_pointer (&desktop_fn, g_free);
+		desktop_fn = g_build_filename (desktop_dir, basename, NULL);
+		ret = g_file_set_contents (desktop_fn, contents, -1, &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+	}
+
+	g_timer_start (timer);
+	silo = gs_plugins_core_incremental_silo_build (catalog_fn, desktop_dir);
+	elapsed_full = g_timer_elapsed (timer, NULL);
+	g_clear_object (&silo);
+
+	catalog_checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, catalog_fn, -1);
+	catalog_silo_basename = g_strdup_printf ("source-%s.xmlb", catalog_checksum);
+	catalog_silo_fn = gs_utils_get_cache_filename ("appstream", catalog_silo_basename,
+						       GS_UTILS_CACHE_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (g_stat (catalog_silo_fn, &statbuf), ==, 0);
+
+	/* a rewritten silo is saved to a new file which replaces the old one,
+	 * so its inode changes even if its mtime is within the same second */
+	catalog_silo_dev = statbuf.st_dev;
+	catalog_silo_ino = statbuf.st_ino;
+
+	/* change one desktop file; libxmlb uses the modification time of the
+	 * sources, so make sure it changes even on coarse file systems */
+	ret = g_file_set_contents (desktop_fn,
+				   "[Desktop Entry]\n"
+				   "Type=Application\n"
+				   "Name=Changed\n"
+				   "Exec=true\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_cmpint (g_stat (desktop_fn, &statbuf), ==, 0);
+	{
+		struct utimbuf times = { statbuf.st_atime, statbuf.st_mtime + 10 };
+		g_assert_cmpint (g_utime (desktop_fn, &times), ==, 0);
+	}
+
+	g_timer_start (timer);
+	silo = gs_plugins_core_incremental_silo_build (catalog_fn, desktop_dir);
+	elapsed_incremental = g_timer_elapsed (timer, NULL);
+
+	g_test_message ("full build of %u components and %u desktop files took %.1fms, "
+			"rebuild after changing one desktop file took %.1fms",
+			n_components, n_desktop_files,
+			elapsed_full * 1000, elapsed_incremental * 1000);
+
+	/* the cached catalog silo was reused, not rewritten */
+	g_assert_cmpint (g_stat (catalog_silo_fn, &statbuf), ==, 0);
+	g_assert_cmpuint (statbuf.st_dev, ==, catalog_silo_dev);
+	g_assert_cmpuint (statbuf.st_ino, ==, catalog_silo_ino);
+
+	/* and the change made it into the combined silo */
+	node = xb_silo_query_first (silo, "component/name[text()='Changed']", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (node);
+	g_clear_object (&node);
+	node = xb_silo_query_first (silo, "components/component/id[text()='org.example.Bench42']", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (node);
+
+	/* once the catalog is no longer a source, its cached silo is removed
+	 * and the desktop one is kept */
+	desktop_checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, desktop_dir, -1);
+	desktop_silo_basename = g_strdup_printf ("source-%s.xmlb", desktop_checksum);
+	desktop_silo_fn = gs_utils_get_cache_filename ("appstream", desktop_silo_basename,
+						       GS_UTILS_CACHE_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_ptr_array_add (cache_ids, desktop_dir);
+	gs_appstream_remove_unused_cached_silos (cache_ids);
+	g_assert_false (g_file_test (catalog_silo_fn, G_FILE_TEST_EXISTS));
+	g_assert_true (g_file_test (desktop_silo_fn, G_FILE_TEST_EXISTS));
+
+	gs_utils_rmtree (tmp_dir, NULL);
+}
+
 static void
 gs_plugins_core_os_release_func (GsPluginLoader *plugin_loader)
 {
@@ -262,6 +583,14 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/core/search-repo-name",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_core_search_repo_name_func);
+	g_test_add_data_func ("/gnome-software/plugins/core/search-index",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_core_search_index_func);
+	g_test_add_data_func ("/gnome-software/plugins/core/search-stemming",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_core_search_stemming_func);
+	g_test_add_func ("/gnome-software/plugins/core/incremental-silo",
+			 gs_plugins_core_incremental_silo_func);
 	g_test_add_data_func ("/gnome-software/plugins/core/os-release",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_core_os_release_func);
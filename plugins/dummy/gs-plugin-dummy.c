@@ -27,6 +27,8 @@ struct _GsPluginDummy {
 	GsApp			*cached_origin;
 	GHashTable		*installed_apps;	/* id:1 */
 	GHashTable		*available_apps;	/* id:1 */
+	gint			 n_url_to_app_running;	/* (atomic) */
+	gint			 n_url_to_app_running_max;	/* (atomic) */
 };
 
 G_DEFINE_TYPE (GsPluginDummy, gs_plugin_dummy, GS_TYPE_PLUGIN)
@@ -304,7 +306,28 @@ gs_plugin_url_to_app (GsPlugin *plugin,
 
 	/* create app */
 	path = gs_utils_get_url_path (url);
-	app = gs_app_new (path);
+
+	/* take a while, and record how many of these ran at once, so the
+	 * self tests can check the parallel ops limit */
+	if (g_str_has_prefix (path, "slow-")) {
+		GsPluginDummy *self = GS_PLUGIN_DUMMY (plugin);
+		gint n_running = g_atomic_int_add (&self->n_url_to_app_running, 1) + 1;
+		gint n_running_max = g_atomic_int_get (&self->n_url_to_app_running_max);
+		g_autofree gchar *n_running_max_str = NULL;
+
+		while (n_running > n_running_max &&
+		       !g_atomic_int_compare_and_exchange (&self->n_url_to_app_running_max, n_running_max, n_running))
+			n_running_max = g_atomic_int_get (&self->n_url_to_app_running_max);
+
+		g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+		g_atomic_int_add (&self->n_url_to_app_running, -1);
+
+		app = gs_app_new (path);
+		n_running_max_str = g_strdup_printf ("%d", g_atomic_int_get (&self->n_url_to_app_running_max));
+		gs_app_set_metadata (app, "GnomeSoftware::Dummy::MaxParallel", n_running_max_str);
+	} else {
+		app = gs_app_new (path);
+	}
 	gs_app_set_management_plugin (app, plugin);
 	gs_app_set_metadata (app, "GnomeSoftware::Creator",
 			     gs_plugin_get_name (plugin));
@@ -1022,6 +1045,12 @@ gs_plugin_dummy_list_apps_async (GsPlugin              *plugin,
 			gs_plugin_dummy_timeout_async (self, 5000, cancellable,
 						       list_apps_timeout_cb, g_steal_pointer (&task));
 			return;
+		} else if (g_getenv ("GS_SELF_TEST_DUMMY_SEARCH_DELAY") != NULL) {
+			/* return nothing, but only after the other plugins
+			 * have returned their results */
+			gs_plugin_dummy_timeout_async (self, 500, cancellable,
+						       list_apps_timeout_cb, g_steal_pointer (&task));
+			return;
 		} else if (g_strcmp0 (keywords[0], "chiron") == 0) {
 			g_autoptr(GsApp) app = NULL;
 
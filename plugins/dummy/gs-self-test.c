@@ -149,6 +149,54 @@ gs_plugins_dummy_refine_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpstr (gs_app_get_url (app, AS_URL_KIND_HOMEPAGE), ==, "http://www.test.org/");
 }
 
+static void
+gs_plugins_dummy_refine_ordering_func (GsPluginLoader *plugin_loader)
+{
+	gboolean ret;
+	GsPlugin *dummy = gs_plugin_loader_find_plugin (plugin_loader, "dummy");
+	GsPlugin *provenance = gs_plugin_loader_find_plugin (plugin_loader, "provenance");
+	GsPlugin *provenance_license = gs_plugin_loader_find_plugin (plugin_loader, "provenance-license");
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GPtrArray) apps = g_ptr_array_new_with_free_func (g_object_unref);
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+
+	/* the rules still order the plugins */
+	g_assert_nonnull (dummy);
+	g_assert_nonnull (provenance);
+	g_assert_nonnull (provenance_license);
+	g_assert_cmpint (gs_plugin_get_order (provenance), >, gs_plugin_get_order (dummy));
+	g_assert_cmpint (gs_plugin_get_order (provenance_license), >, gs_plugin_get_order (provenance));
+
+	/* the provenance-license plugin only sets the license of apps which
+	 * the provenance plugin has already marked, so it must not be run in
+	 * parallel with it, even though other plugins now are */
+	for (guint i = 0; i < 20; i++) {
+		g_autofree gchar *id = g_strdup_printf ("org.example.Ordering%u.desktop", i);
+		g_autoptr(GsApp) app = gs_app_new (id);
+		gs_app_set_origin (app, "london-east");
+		gs_app_list_add (list, app);
+		g_ptr_array_add (apps, g_steal_pointer (&app));
+	}
+
+	plugin_job = gs_plugin_job_refine_new (list,
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_LICENSE |
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_PROVENANCE |
+					       GS_PLUGIN_REFINE_FLAGS_DISABLE_FILTERING);
+	ret = gs_plugin_loader_job_action (plugin_loader, plugin_job, NULL, &error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert_true (ret);
+
+	for (guint i = 0; i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		g_assert_true (gs_app_has_quirk (app, GS_APP_QUIRK_PROVENANCE));
+		g_assert_cmpstr (gs_app_get_license (app), ==,
+				 "LicenseRef-free=https://www.debian.org/");
+	}
+}
+
 static void
 gs_plugins_dummy_metadata_quirks (GsPluginLoader *plugin_loader)
 {
@@ -449,6 +497,67 @@ gs_plugins_dummy_search_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DESKTOP_APP);
 }
 
+typedef struct {
+	guint n_partial_results;
+	gboolean finished;
+} SearchPartialResultsData;
+
+static void
+search_partial_results_cb (GsPluginJobListApps *plugin_job,
+                           GsAppList           *list,
+                           gpointer             user_data)
+{
+	SearchPartialResultsData *data = user_data;
+
+	/* partial results must all arrive before the final ones */
+	g_assert_false (data->finished);
+
+	g_assert_true (GS_IS_APP_LIST (list));
+	for (guint i = 0; i < gs_app_list_length (list); i++)
+		g_assert_true (GS_IS_APP (gs_app_list_index (list, i)));
+
+	data->n_partial_results++;
+}
+
+static void
+gs_plugins_dummy_search_partial_results_func (GsPluginLoader *plugin_loader)
+{
+	GsApp *app;
+	SearchPartialResultsData data = { 0, FALSE };
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+	g_autoptr(GsAppQuery) query = NULL;
+	const gchar *keywords[2] = { "zeus", NULL };
+
+	/* make the dummy plugin return after the appstream plugin, so the
+	 * appstream results have to be emitted as partial results */
+	g_setenv ("GS_SELF_TEST_DUMMY_SEARCH_DELAY", "1", TRUE);
+
+	/* each plugin’s results are refined separately when streaming, but the
+	 * final results must be the same */
+	query = gs_app_query_new ("keywords", keywords,
+				  "refine-flags", GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON,
+				  "dedupe-flags", GS_PLUGIN_JOB_DEDUPE_FLAGS_DEFAULT,
+				  "sort-func", gs_utils_app_sort_match_value,
+				  NULL);
+	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+	g_signal_connect (plugin_job, "partial-results",
+			  G_CALLBACK (search_partial_results_cb), &data);
+	list = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+	data.finished = TRUE;
+	gs_test_flush_main_context ();
+	g_unsetenv ("GS_SELF_TEST_DUMMY_SEARCH_DELAY");
+	g_assert_no_error (error);
+	g_assert_nonnull (list);
+	g_assert_cmpuint (data.n_partial_results, >=, 1);
+
+	g_assert_cmpint (gs_app_list_length (list), >=, 1);
+	app = gs_app_list_index (list, 0);
+	g_assert_cmpstr (gs_app_get_id (app), ==, "zeus.desktop");
+	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DESKTOP_APP);
+}
+
 static void
 gs_plugins_dummy_search_alternate_func (GsPluginLoader *plugin_loader)
 {
@@ -704,6 +813,66 @@ gs_plugins_dummy_limit_parallel_ops_func (GsPluginLoader *plugin_loader)
 	gs_plugin_loader_set_max_parallel_ops (plugin_loader, 0);
 }
 
+static void
+gs_plugins_dummy_limit_parallel_ops_url_to_app_func (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(GMainContext) context = NULL;
+	GAsyncResult *results[6] = { NULL, };
+	gint max_parallel = 0;
+
+	/* the jobs which the loader measures the latency of run in the same
+	 * limited pools as upgrade downloads */
+	gs_plugin_loader_set_max_parallel_ops (plugin_loader, 2);
+
+	context = g_main_context_new ();
+	g_main_context_push_thread_default (context);
+
+	for (guint i = 0; i < G_N_ELEMENTS (results); i++) {
+		g_autofree gchar *url = g_strdup_printf ("dummy://slow-%u.desktop", i);
+		g_autoptr(GsPluginJob) plugin_job = NULL;
+
+		plugin_job = gs_plugin_job_newv (GS_PLUGIN_ACTION_URL_TO_APP,
+						 "search", url,
+						 NULL);
+		gs_plugin_loader_job_process_async (plugin_loader,
+						    plugin_job,
+						    NULL,
+						    async_result_cb,
+						    &results[i]);
+	}
+
+	for (guint i = 0; i < G_N_ELEMENTS (results); i++) {
+		while (results[i] == NULL)
+			g_main_context_iteration (context, TRUE);
+	}
+
+	g_main_context_pop_thread_default (context);
+
+	gs_test_flush_main_context ();
+
+	for (guint i = 0; i < G_N_ELEMENTS (results); i++) {
+		g_autoptr(GsAppList) list = NULL;
+		g_autoptr(GError) local_error = NULL;
+		const gchar *max_parallel_str;
+
+		list = gs_plugin_loader_job_process_finish (plugin_loader, results[i], &local_error);
+		g_assert_no_error (local_error);
+		g_assert_cmpuint (gs_app_list_length (list), ==, 1);
+
+		max_parallel_str = gs_app_get_metadata_item (gs_app_list_index (list, 0),
+							     "GnomeSoftware::Dummy::MaxParallel");
+		g_assert_nonnull (max_parallel_str);
+		max_parallel = MAX (max_parallel, (gint) g_ascii_strtoll (max_parallel_str, NULL, 10));
+		g_object_unref (results[i]);
+	}
+
+	g_assert_cmpint (max_parallel, >=, 1);
+	g_assert_cmpint (max_parallel, <=, 2);
+
+	/* set the default max parallel ops */
+	gs_plugin_loader_set_max_parallel_ops (plugin_loader, 0);
+}
+
 static void
 gs_plugins_dummy_app_size_calc_func (GsPluginLoader *loader)
 {
@@ -914,6 +1083,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/dummy/search",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_search_func);
+	g_test_add_data_func ("/gnome-software/plugins/dummy/search-partial-results",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_dummy_search_partial_results_func);
 	g_test_add_data_func ("/gnome-software/plugins/dummy/search-alternate",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_search_alternate_func);
@@ -932,6 +1104,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/dummy/refine",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_refine_func);
+	g_test_add_data_func ("/gnome-software/plugins/dummy/refine-ordering",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_dummy_refine_ordering_func);
 	g_test_add_data_func ("/gnome-software/plugins/dummy/updates",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_updates_func);
@@ -944,6 +1119,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/dummy/limit-parallel-ops",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_limit_parallel_ops_func);
+	g_test_add_data_func ("/gnome-software/plugins/dummy/limit-parallel-ops-url-to-app",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_dummy_limit_parallel_ops_url_to_app_func);
 	g_test_add_data_func ("/gnome-software/plugins/dummy/app-size-calc",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_app_size_calc_func);
@@ -45,6 +45,9 @@ struct _GsFlatpak {
 	GsFlatpakFlags		 flags;
 	FlatpakInstallation	*installation_noninteractive;  /* (owned) */
 	FlatpakInstallation	*installation_interactive;  /* (owned) */
+	/* @installed_refs and @remotes_by_name are shared between refine and
+	 * list jobs running in parallel with transactions on other worker
+	 * threads, so are only accessed with @installed_refs_mutex held */
 	GPtrArray		*installed_refs;  /* must be entirely replaced rather than updated internally */
 	GHashTable		*remotes_by_name;
 	GMutex			 installed_refs_mutex;
@@ -53,8 +56,13 @@ struct _GsFlatpak {
 	GFileMonitor		*monitor;
 	AsComponentScope	 scope;
 	GsPlugin		*plugin;
+	/* @silo_lock is only held for writing while a new silo is published;
+	 * it is built with @silo_build_mutex held instead */
 	XbSilo			*silo;
 	GRWLock			 silo_lock;
+	GMutex			 silo_build_mutex;
+	gint			 silo_rebuilding; /* (atomic); threads rebuilding it or waiting to */
+	GsUtilsLockStalls	 silo_reader_stalls;
 	gchar			*silo_filename;
 	GHashTable		*silo_installed_by_desktopid;
 	gchar			*id;
@@ -63,9 +71,9 @@ struct _GsFlatpak {
 	GMutex			 app_silos_mutex;
 	GHashTable		*remote_title; /* gchar *remote name ~> gchar *remote title */
 	GMutex			 remote_title_mutex;
-	gboolean		 requires_full_rescan;
+	gint			 requires_full_rescan; /* (atomic) */
 	gint			 busy; /* (atomic) */
-	gboolean		 changed_while_busy;
+	gint			 changed_while_busy; /* (atomic) */
 };
 
 G_DEFINE_TYPE (GsFlatpak, gs_flatpak, G_TYPE_OBJECT)
@@ -683,7 +691,7 @@ gs_flatpak_internal_data_changed (GsFlatpak *self)
 
 	gs_flatpak_invalidate_silo (self);
 
-	self->requires_full_rescan = TRUE;
+	g_atomic_int_set (&self->requires_full_rescan, TRUE);
 }
 
 static gboolean
@@ -706,7 +714,7 @@ gs_plugin_flatpak_changed_cb (GFileMonitor *monitor,
 			      GsFlatpak *self)
 {
 	if (gs_flatpak_get_busy (self)) {
-		self->changed_while_busy = TRUE;
+		g_atomic_int_set (&self->changed_while_busy, TRUE);
 	} else {
 		gs_flatpak_claim_changed_idle_cb (self);
 	}
@@ -1085,32 +1093,23 @@ gs_flatpak_rescan_installed (GsFlatpak *self,
 		g_debug ("Failed to read flatpak .desktop files in %s: %s", path, error_local->message);
 }
 
+/* Called with @silo_build_mutex held. */
 static gboolean
-gs_flatpak_rescan_appstream_store (GsFlatpak *self,
-				   gboolean interactive,
-				   GCancellable *cancellable,
-				   GError **error)
+gs_flatpak_rebuild_appstream_store (GsFlatpak *self,
+				    gboolean interactive,
+				    GCancellable *cancellable,
+				    GError **error)
 {
 	g_autofree gchar *blobfn = NULL;
 	g_autoptr(GFile) file = NULL;
 	g_autoptr(GPtrArray) xremotes = NULL;
 	g_autoptr(GPtrArray) desktop_paths = NULL;
-	g_autoptr(GRWLockReaderLocker) reader_locker = NULL;
 	g_autoptr(GRWLockWriterLocker) writer_locker = NULL;
 	g_autoptr(XbBuilder) builder = NULL;
 	g_autoptr(GMainContext) old_thread_default = NULL;
-
-	reader_locker = g_rw_lock_reader_locker_new (&self->silo_lock);
-	/* everything is okay */
-	if (self->silo != NULL && xb_silo_is_valid (self->silo))
-		return TRUE;
-	g_clear_pointer (&reader_locker, g_rw_lock_reader_locker_free);
-
-	/* drat! silo needs regenerating */
-	writer_locker = g_rw_lock_writer_locker_new (&self->silo_lock);
-	g_clear_object (&self->silo);
-	g_clear_pointer (&self->silo_filename, g_free);
-	g_clear_pointer (&self->silo_installed_by_desktopid, g_hash_table_unref);
+	g_autoptr(XbSilo) silo = NULL;
+	g_autofree gchar *silo_filename = NULL;
+	g_autoptr(GHashTable) installed_by_desktopid = NULL;
 
 	/* FIXME: https://gitlab.gnome.org/GNOME/gnome-software/-/issues/1422 */
 	old_thread_default = g_main_context_ref_thread_default ();
@@ -1187,41 +1186,112 @@ gs_flatpak_rescan_appstream_store (GsFlatpak *self,
 	if (old_thread_default != NULL)
 		g_main_context_pop_thread_default (old_thread_default);
 
-	self->silo = xb_builder_ensure (builder, file,
-					XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
-					XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
-					cancellable, error);
+	GS_PROFILER_BEGIN_SCOPED (FlatpakEnsureSilo, "Flatpak (ensure silo)", gs_flatpak_get_id (self));
+	silo = xb_builder_ensure (builder, file,
+				  XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID |
+				  XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
+				  cancellable, error);
+	GS_PROFILER_END_SCOPED (FlatpakEnsureSilo);
 
 	if (old_thread_default != NULL)
 		g_main_context_push_thread_default (old_thread_default);
 
-	if (self->silo != NULL) {
+	if (silo != NULL) {
 		g_autoptr(GPtrArray) installed = NULL;
 		g_autoptr(XbNode) info_filename = NULL;
+		g_autofree gchar *indexfn = NULL;
+
+		/* build the search index now rather than on the first search */
+		indexfn = gs_utils_get_cache_filename (gs_flatpak_get_id (self),
+						       "components-search.idx",
+						       GS_UTILS_CACHE_FLAG_WRITEABLE |
+						       GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+						       NULL);
+		if (indexfn != NULL) {
+			g_autoptr(GFile) index_file = g_file_new_for_path (indexfn);
+			gs_appstream_search_index_ensure (silo, index_file);
+		}
 
-		self->silo_installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+		installed_by_desktopid = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
 
-		installed = xb_silo_query (self->silo, "/component[@type='desktop-application']/launchable[@type='desktop-id']", 0, NULL);
+		installed = xb_silo_query (silo, "/component[@type='desktop-application']/launchable[@type='desktop-id']", 0, NULL);
 		for (guint i = 0; installed != NULL && i < installed->len; i++) {
 			XbNode *launchable = g_ptr_array_index (installed, i);
 			const gchar *id = xb_node_get_text (launchable);
 			if (id != NULL && *id != '\0') {
-				GPtrArray *nodes = g_hash_table_lookup (self->silo_installed_by_desktopid, id);
+				GPtrArray *nodes = g_hash_table_lookup (installed_by_desktopid, id);
 				if (nodes == NULL) {
 					nodes = g_ptr_array_new_with_free_func (g_object_unref);
-					g_hash_table_insert (self->silo_installed_by_desktopid, g_strdup (id), nodes);
+					g_hash_table_insert (installed_by_desktopid, g_strdup (id), nodes);
 				}
 				g_ptr_array_add (nodes, xb_node_get_parent (launchable));
 			}
 		}
 
-		info_filename = xb_silo_query_first (self->silo, "/info/filename", NULL);
+		info_filename = xb_silo_query_first (silo, "/info/filename", NULL);
 		if (info_filename != NULL)
-			self->silo_filename = g_strdup (xb_node_get_text (info_filename));
+			silo_filename = g_strdup (xb_node_get_text (info_filename));
 	}
 
+	if (silo == NULL)
+		return FALSE;
+
+	/* publish the new silo; this only waits for readers of the old one */
+	writer_locker = g_rw_lock_writer_locker_new (&self->silo_lock);
+	g_set_object (&self->silo, silo);
+	g_clear_pointer (&self->silo_filename, g_free);
+	self->silo_filename = g_steal_pointer (&silo_filename);
+	g_clear_pointer (&self->silo_installed_by_desktopid, g_hash_table_unref);
+	self->silo_installed_by_desktopid = g_steal_pointer (&installed_by_desktopid);
+	g_clear_pointer (&writer_locker, g_rw_lock_writer_locker_free);
+
+	g_debug ("flatpak: readers of %s stalled %u times on the silo lock, for %.1fms in total",
+		 gs_flatpak_get_id (self),
+		 (guint) g_atomic_int_get (&self->silo_reader_stalls.n_stalls),
+		 (gdouble) (gsize) g_atomic_pointer_get (&self->silo_reader_stalls.stall_usec) / 1000.0);
+
 	/* success */
-	return self->silo != NULL;
+	return TRUE;
+}
+
+static gboolean
+gs_flatpak_rescan_appstream_store (GsFlatpak *self,
+				   gboolean interactive,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	g_autoptr(GRWLockReaderLocker) reader_locker = NULL;
+	g_autoptr(GMutexLocker) build_locker = NULL;
+	gboolean ret;
+
+	reader_locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
+	/* everything is okay */
+	if (self->silo != NULL && xb_silo_is_valid (self->silo))
+		return TRUE;
+	/* another thread is already regenerating it, so carry on using the
+	 * old silo until the new one is published */
+	if (self->silo != NULL && g_atomic_int_get (&self->silo_rebuilding) > 0)
+		return TRUE;
+	g_clear_pointer (&reader_locker, g_rw_lock_reader_locker_free);
+
+	/* drat! silo needs regenerating; this is done without holding
+	 * @silo_lock, so other threads are not blocked on it meanwhile, and is
+	 * announced before waiting for the build lock, so they don’t queue up
+	 * behind it either */
+	g_atomic_int_inc (&self->silo_rebuilding);
+	build_locker = g_mutex_locker_new (&self->silo_build_mutex);
+	reader_locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
+	if (self->silo != NULL && xb_silo_is_valid (self->silo)) {
+		ret = TRUE;
+	} else {
+		g_clear_pointer (&reader_locker, g_rw_lock_reader_locker_free);
+		ret = gs_flatpak_rebuild_appstream_store (self, interactive, cancellable, error);
+	}
+	g_clear_pointer (&reader_locker, g_rw_lock_reader_locker_free);
+	g_clear_pointer (&build_locker, g_mutex_locker_free);
+	g_atomic_int_add (&self->silo_rebuilding, -1);
+
+	return ret;
 }
 
 static gboolean
@@ -1230,11 +1300,11 @@ gs_flatpak_rescan_app_data (GsFlatpak *self,
 			    GCancellable *cancellable,
 			    GError **error)
 {
-	if (self->requires_full_rescan) {
+	/* clear the flag before refreshing, so a change notified by another
+	 * thread while the refresh is running is not lost */
+	if (g_atomic_int_compare_and_exchange (&self->requires_full_rescan, TRUE, FALSE)) {
 		gboolean res = gs_flatpak_refresh (self, 60, interactive, cancellable, error);
-		if (res)
-			self->requires_full_rescan = FALSE;
-		else
+		if (!res)
 			gs_flatpak_internal_data_changed (self);
 		return res;
 	}
@@ -1263,7 +1333,7 @@ ensure_flatpak_silo_with_locker (GsFlatpak            *self,
 	if (!gs_flatpak_rescan_app_data (self, interactive, cancellable, error))
 		return FALSE;
 
-	*locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+	*locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 
 	while (self->silo == NULL) {
 		g_clear_pointer (locker, g_rw_lock_reader_locker_free);
@@ -1276,7 +1346,7 @@ ensure_flatpak_silo_with_locker (GsFlatpak            *self,
 		/* At this point either rescan_appstream_store() returned an error or it successfully
 		 * initialised self->silo. There is the possibility that another thread will invalidate
 		 * the silo before we regain the lock. If so, we’ll have to rescan again. */
-		*locker = g_rw_lock_reader_locker_new (&self->silo_lock);
+		*locker = gs_utils_rw_lock_reader_locker_new (&self->silo_lock, &self->silo_reader_stalls);
 	}
 
 	return TRUE;
@@ -3186,10 +3256,12 @@ gs_flatpak_refine_appstream_from_bytes (GsFlatpak *self,
 	if (old_thread_default != NULL)
 		g_main_context_pop_thread_default (old_thread_default);
 
+	GS_PROFILER_BEGIN_SCOPED (FlatpakCompileAppSilo, "Flatpak (compile app silo)", NULL);
 	silo = xb_builder_compile (builder,
 				   XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
 				   cancellable,
 				   error);
+	GS_PROFILER_END_SCOPED (FlatpakCompileAppSilo);
 
 	if (old_thread_default != NULL)
 		g_main_context_push_thread_default (old_thread_default);
@@ -4259,10 +4331,12 @@ gs_flatpak_file_to_app_ref (GsFlatpak *self,
 	/* build silo */
 	/* No need to change the thread-default main context because the silo
 	 * doesn’t live beyond this function */
+	GS_PROFILER_BEGIN_SCOPED (FlatpakCompileRemoteSilo, "Flatpak (compile remote silo)", NULL);
 	silo = xb_builder_compile (builder,
 				   XB_BUILDER_COMPILE_FLAG_SINGLE_LANG,
 				   cancellable,
 				   error);
+	GS_PROFILER_END_SCOPED (FlatpakCompileRemoteSilo);
 	if (silo == NULL)
 		return NULL;
 	if (g_getenv ("GS_XMLB_VERBOSE") != NULL) {
@@ -4655,6 +4729,7 @@ gs_flatpak_finalize (GObject *object)
 	g_hash_table_unref (self->broken_remotes);
 	g_mutex_clear (&self->broken_remotes_mutex);
 	g_rw_lock_clear (&self->silo_lock);
+	g_mutex_clear (&self->silo_build_mutex);
 	g_hash_table_unref (self->app_silos);
 	g_mutex_clear (&self->app_silos_mutex);
 	g_clear_pointer (&self->remote_title, g_hash_table_unref);
@@ -4676,6 +4751,7 @@ gs_flatpak_init (GsFlatpak *self)
 	/* XbSilo needs external locking as we destroy the silo and build a new
 	 * one when something changes */
 	g_rw_lock_init (&self->silo_lock);
+	g_mutex_init (&self->silo_build_mutex);
 
 	g_mutex_init (&self->installed_refs_mutex);
 	self->installed_refs = NULL;
@@ -4726,8 +4802,7 @@ gs_flatpak_set_busy (GsFlatpak *self,
 	} else {
 		g_return_if_fail (g_atomic_int_get (&self->busy) > 0);
 		if (g_atomic_int_dec_and_test (&self->busy)) {
-			if (self->changed_while_busy) {
-				self->changed_while_busy = FALSE;
+			if (g_atomic_int_compare_and_exchange (&self->changed_while_busy, TRUE, FALSE)) {
 				g_idle_add_full (G_PRIORITY_DEFAULT_IDLE, gs_flatpak_claim_changed_idle_cb,
 					g_object_ref (self), g_object_unref);
 			}
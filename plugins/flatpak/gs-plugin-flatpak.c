@@ -16,9 +16,14 @@
  * Some GsApp's created have have flatpak::kind of app or runtime
  * The GsApp:origin is the remote name, e.g. test-repo
  *
- * The plugin has a worker thread which all operations are delegated to, as the
- * libflatpak API is entirely synchronous (and thread-safe). * Message passing
- * to the worker thread is by gs_worker_thread_queue().
+ * The plugin has a pool of worker threads which all operations are delegated
+ * to, as the libflatpak API is entirely synchronous (and thread-safe). Message
+ * passing to the worker threads is by gs_worker_thread_queue() for operations
+ * which modify an installation, so they are serialised, and by
+ * gs_worker_thread_queue_parallel() for read-only operations (refining and
+ * listing apps), so they are not held up by a long running transaction.
+ * Any #GsFlatpak state shared between them, such as the installed refs cache
+ * and the rescan flags, must be protected by a mutex or accessed atomically.
  *
  * FIXME: It may speed things up in future to have one worker thread *per*
  * `FlatpakInstallation`, all operating in parallel.
@@ -270,8 +275,9 @@ gs_plugin_flatpak_setup_async (GsPlugin            *plugin,
 	/* Shouldn’t end up setting up twice */
 	g_assert (self->installations == NULL || self->installations->len == 0);
 
-	/* Start up a worker thread to process all the plugin’s function calls. */
-	self->worker = gs_worker_thread_new ("gs-plugin-flatpak");
+	/* Start up the worker threads to process all the plugin’s function calls. */
+	self->worker = gs_worker_thread_new_pool ("gs-plugin-flatpak",
+						  CLAMP (g_get_num_processors (), 1, 4));
 
 	/* Queue a job to find and set up the installations. */
 	gs_worker_thread_queue (self->worker, G_PRIORITY_DEFAULT,
@@ -647,8 +653,8 @@ gs_plugin_flatpak_refine_async (GsPlugin            *plugin,
 	g_task_set_source_tag (task, gs_plugin_flatpak_refine_async);
 
 	/* Queue a job to refine the apps. */
-	gs_worker_thread_queue (self->worker, get_priority_for_interactivity (interactive),
-				refine_thread_cb, g_steal_pointer (&task));
+	gs_worker_thread_queue_parallel (self->worker, get_priority_for_interactivity (interactive),
+					 refine_thread_cb, g_steal_pointer (&task));
 }
 
 /* Run in @worker. */
@@ -2269,8 +2275,8 @@ gs_plugin_flatpak_refine_categories_async (GsPlugin                      *plugin
 	}
 
 	/* Queue a job to get the apps. */
-	gs_worker_thread_queue (self->worker, get_priority_for_interactivity (interactive),
-				refine_categories_thread_cb, g_steal_pointer (&task));
+	gs_worker_thread_queue_parallel (self->worker, get_priority_for_interactivity (interactive),
+					 refine_categories_thread_cb, g_steal_pointer (&task));
 }
 
 /* Run in @worker. */
@@ -2329,8 +2335,8 @@ gs_plugin_flatpak_list_apps_async (GsPlugin              *plugin,
 	g_task_set_source_tag (task, gs_plugin_flatpak_list_apps_async);
 
 	/* Queue a job to get the apps. */
-	gs_worker_thread_queue (self->worker, get_priority_for_interactivity (interactive),
-				list_apps_thread_cb, g_steal_pointer (&task));
+	gs_worker_thread_queue_parallel (self->worker, get_priority_for_interactivity (interactive),
+					 list_apps_thread_cb, g_steal_pointer (&task));
 }
 
 /* Run in @worker. */
@@ -0,0 +1,360 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gnome-software.h>
+
+#include "gs-modalias-index.h"
+
+/*
+ * An index of the devices on the system and of the driver components seen so
+ * far, keyed by the bus and (for PCI and USB) vendor ID at the start of each
+ * modalias, such as `pci:v000010DE`. Each driver records how many devices it
+ * matches, which is computed once when the driver is added and then kept up to
+ * date as devices are added and removed.
+ *
+ * The index is not thread safe; the caller is expected to lock it.
+ */
+
+/* A driver component, and how many of the current devices it supports. */
+typedef struct {
+	GsGlobSet	*modaliases;  /* (owned) (nullable) */
+	GPtrArray	*keys;  /* (owned) (element-type utf8) index keys of @modaliases */
+	guint		 n_matched_devices;
+} DriverEntry;
+
+struct _GsModaliasIndex {
+	GHashTable	*devices;  /* (owned) sysfs path ~> (owned) modalias */
+	GHashTable	*devices_by_key;  /* (owned) key ~> (owned) GPtrArray of (unowned) modalias */
+	GHashTable	*drivers;  /* (owned) unique ID ~> (owned) DriverEntry */
+	GHashTable	*drivers_by_key;  /* (owned) key ~> (owned) GPtrArray of (unowned) DriverEntry */
+};
+
+static void
+driver_entry_free (DriverEntry *entry)
+{
+	g_clear_pointer (&entry->modaliases, gs_glob_set_unref);
+	g_ptr_array_unref (entry->keys);
+	g_free (entry);
+}
+
+/* The length of the bus at the start of @modalias, such as `pci:`, or 0 if
+ * it doesn’t have one. */
+static gsize
+modalias_get_bus_key_len (const gchar *modalias)
+{
+	const gchar *colon = strchr (modalias, ':');
+
+	return (colon != NULL) ? (gsize) (colon - modalias) + 1 : 0;
+}
+
+/* The length of the bus and vendor ID at the start of @modalias, such as
+ * `pci:v000010DE`, or 0 if it doesn’t have a vendor ID. */
+static gsize
+modalias_get_vendor_key_len (const gchar *modalias)
+{
+	gsize vendor_id_len;
+
+	if (g_str_has_prefix (modalias, "pci:v"))
+		vendor_id_len = 8;
+	else if (g_str_has_prefix (modalias, "usb:v"))
+		vendor_id_len = 4;
+	else
+		return 0;
+
+	if (strnlen (modalias + 5, vendor_id_len) < vendor_id_len)
+		return 0;
+
+	return 5 + vendor_id_len;
+}
+
+/**
+ * gs_modalias_pattern_get_key:
+ * @pattern: a modalias glob
+ *
+ * Gets the index key for a modalias glob: the longest key which is entirely
+ * literal in @pattern, so any device it matches is guaranteed to have the
+ * same key. Patterns which start with a wildcard get the empty key, which is
+ * checked against every device.
+ *
+ * Returns: (transfer full): the key, which may be empty
+ */
+gchar *
+gs_modalias_pattern_get_key (const gchar *pattern)
+{
+	gsize literal_len = strcspn (pattern, "*?[\\");
+	gsize key_len;
+
+	key_len = modalias_get_vendor_key_len (pattern);
+	if (key_len == 0 || key_len > literal_len)
+		key_len = modalias_get_bus_key_len (pattern);
+	if (key_len > literal_len)
+		key_len = 0;
+
+	return g_strndup (pattern, key_len);
+}
+
+static void
+index_add (GHashTable  *index,
+           const gchar *key,
+           gpointer     value)
+{
+	GPtrArray *values = g_hash_table_lookup (index, key);
+
+	if (values == NULL) {
+		values = g_ptr_array_new ();
+		g_hash_table_insert (index, g_strdup (key), values);
+	}
+	g_ptr_array_add (values, value);
+}
+
+static void
+index_remove (GHashTable  *index,
+              const gchar *key,
+              gpointer     value)
+{
+	GPtrArray *values = g_hash_table_lookup (index, key);
+
+	if (values == NULL)
+		return;
+	g_ptr_array_remove_fast (values, value);
+	if (values->len == 0)
+		g_hash_table_remove (index, key);
+}
+
+GsModaliasIndex *
+gs_modalias_index_new (void)
+{
+	GsModaliasIndex *index = g_new0 (GsModaliasIndex, 1);
+
+	index->devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	index->devices_by_key = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+	index->drivers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) driver_entry_free);
+	index->drivers_by_key = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+
+	return index;
+}
+
+void
+gs_modalias_index_free (GsModaliasIndex *index)
+{
+	/* the indexes hold unowned pointers into the main tables */
+	g_hash_table_unref (index->devices_by_key);
+	g_hash_table_unref (index->devices);
+	g_hash_table_unref (index->drivers_by_key);
+	g_hash_table_unref (index->drivers);
+	g_free (index);
+}
+
+/* Adjust the matched device count by @delta for each driver which matches
+ * @modalias, checking only the drivers indexed under the device’s keys. */
+static void
+update_drivers_for_device (GsModaliasIndex *index,
+                           const gchar     *modalias,
+                           gint             delta)
+{
+	g_autoptr(GHashTable) checked = g_hash_table_new (NULL, NULL);
+	g_autofree gchar *vendor_key = g_strndup (modalias, modalias_get_vendor_key_len (modalias));
+	g_autofree gchar *bus_key = g_strndup (modalias, modalias_get_bus_key_len (modalias));
+	const gchar *keys[] = { vendor_key, bus_key, "" };
+
+	for (gsize i = 0; i < G_N_ELEMENTS (keys); i++) {
+		GPtrArray *drivers;
+
+		/* a device without a vendor ID or bus only has the empty key */
+		if (i < 2 && *keys[i] == '\0')
+			continue;
+
+		drivers = g_hash_table_lookup (index->drivers_by_key, keys[i]);
+		for (guint j = 0; drivers != NULL && j < drivers->len; j++) {
+			DriverEntry *entry = g_ptr_array_index (drivers, j);
+
+			if (!g_hash_table_add (checked, entry))
+				continue;
+			if (gs_glob_set_match (entry->modaliases, modalias))
+				entry->n_matched_devices += delta;
+		}
+	}
+}
+
+/**
+ * gs_modalias_index_remove_device:
+ * @index: a #GsModaliasIndex
+ * @sysfs_path: sysfs path of the device
+ *
+ * Removes a device, and decrements the matched device count of each driver
+ * which supports it. This is a no-op if the device is not in the index.
+ */
+void
+gs_modalias_index_remove_device (GsModaliasIndex *index,
+                                 const gchar     *sysfs_path)
+{
+	const gchar *modalias = g_hash_table_lookup (index->devices, sysfs_path);
+	g_autofree gchar *vendor_key = NULL;
+	g_autofree gchar *bus_key = NULL;
+
+	if (modalias == NULL)
+		return;
+
+	update_drivers_for_device (index, modalias, -1);
+
+	vendor_key = g_strndup (modalias, modalias_get_vendor_key_len (modalias));
+	bus_key = g_strndup (modalias, modalias_get_bus_key_len (modalias));
+	if (*vendor_key != '\0')
+		index_remove (index->devices_by_key, vendor_key, (gpointer) modalias);
+	if (*bus_key != '\0')
+		index_remove (index->devices_by_key, bus_key, (gpointer) modalias);
+
+	g_hash_table_remove (index->devices, sysfs_path);
+}
+
+/**
+ * gs_modalias_index_add_device:
+ * @index: a #GsModaliasIndex
+ * @sysfs_path: sysfs path of the device
+ * @modalias: modalias of the device
+ *
+ * Adds a device, replacing any previous one at @sysfs_path, and increments
+ * the matched device count of each driver which supports it.
+ */
+void
+gs_modalias_index_add_device (GsModaliasIndex *index,
+                              const gchar     *sysfs_path,
+                              const gchar     *modalias)
+{
+	gchar *modalias_copy = g_strdup (modalias);
+	g_autofree gchar *vendor_key = NULL;
+	g_autofree gchar *bus_key = NULL;
+
+	gs_modalias_index_remove_device (index, sysfs_path);
+	g_hash_table_insert (index->devices, g_strdup (sysfs_path), modalias_copy);
+
+	/* the indexes point to the copy owned by @devices */
+	vendor_key = g_strndup (modalias_copy, modalias_get_vendor_key_len (modalias_copy));
+	bus_key = g_strndup (modalias_copy, modalias_get_bus_key_len (modalias_copy));
+	if (*vendor_key != '\0')
+		index_add (index->devices_by_key, vendor_key, modalias_copy);
+	if (*bus_key != '\0')
+		index_add (index->devices_by_key, bus_key, modalias_copy);
+
+	update_drivers_for_device (index, modalias_copy, 1);
+}
+
+guint
+gs_modalias_index_get_n_devices (GsModaliasIndex *index)
+{
+	return g_hash_table_size (index->devices);
+}
+
+/**
+ * gs_modalias_index_add_driver:
+ * @index: a #GsModaliasIndex
+ * @unique_id: unique ID of the driver component
+ * @patterns: (array zero-terminated=1): modalias globs the driver supports
+ *
+ * Adds a driver to the index, and counts the devices it matches.
+ *
+ * Returns: the number of devices the driver matches
+ */
+guint
+gs_modalias_index_add_driver (GsModaliasIndex     *index,
+                              const gchar         *unique_id,
+                              const gchar * const *patterns)
+{
+	DriverEntry *entry;
+	g_autoptr(GHashTable) checked = g_hash_table_new (NULL, NULL);
+
+	g_return_val_if_fail (!g_hash_table_contains (index->drivers, unique_id), 0);
+
+	entry = g_new0 (DriverEntry, 1);
+	entry->keys = g_ptr_array_new_with_free_func (g_free);
+	g_hash_table_insert (index->drivers, g_strdup (unique_id), entry);
+
+	for (gsize i = 0; patterns[i] != NULL; i++) {
+		g_autofree gchar *key = gs_modalias_pattern_get_key (patterns[i]);
+
+		if (!g_ptr_array_find_with_equal_func (entry->keys, key, g_str_equal, NULL)) {
+			index_add (index->drivers_by_key, key, entry);
+			g_ptr_array_add (entry->keys, g_steal_pointer (&key));
+		}
+	}
+
+	if (patterns[0] == NULL)
+		return 0;
+	entry->modaliases = gs_glob_set_new (patterns);
+
+	/* do any of the modaliases match any installed hardware; a pattern
+	 * with the empty key has to be checked against all of it */
+	if (g_ptr_array_find_with_equal_func (entry->keys, "", g_str_equal, NULL)) {
+		GHashTableIter iter;
+		const gchar *modalias;
+
+		g_hash_table_iter_init (&iter, index->devices);
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &modalias)) {
+			if (gs_glob_set_match (entry->modaliases, modalias)) {
+				g_debug ("matched %s against %s", modalias, unique_id);
+				entry->n_matched_devices++;
+			}
+		}
+		return entry->n_matched_devices;
+	}
+
+	for (guint i = 0; i < entry->keys->len; i++) {
+		GPtrArray *devices = g_hash_table_lookup (index->devices_by_key,
+							  g_ptr_array_index (entry->keys, i));
+
+		for (guint j = 0; devices != NULL && j < devices->len; j++) {
+			const gchar *modalias = g_ptr_array_index (devices, j);
+
+			if (!g_hash_table_add (checked, (gpointer) modalias))
+				continue;
+			if (gs_glob_set_match (entry->modaliases, modalias)) {
+				g_debug ("matched %s against %s", modalias, unique_id);
+				entry->n_matched_devices++;
+			}
+		}
+	}
+
+	return entry->n_matched_devices;
+}
+
+/**
+ * gs_modalias_index_lookup_driver:
+ * @index: a #GsModaliasIndex
+ * @unique_id: unique ID of the driver component
+ * @out_n_matched_devices: (out) (optional): return location for the number
+ *   of devices the driver matches
+ *
+ * Looks up a driver previously added with gs_modalias_index_add_driver().
+ *
+ * Returns: %TRUE if the driver is in the index
+ */
+gboolean
+gs_modalias_index_lookup_driver (GsModaliasIndex *index,
+                                 const gchar     *unique_id,
+                                 guint           *out_n_matched_devices)
+{
+	DriverEntry *entry = g_hash_table_lookup (index->drivers, unique_id);
+
+	if (entry == NULL)
+		return FALSE;
+	if (out_n_matched_devices != NULL)
+		*out_n_matched_devices = entry->n_matched_devices;
+	return TRUE;
+}
+
+/* The driver components may have changed, so they have to be added afresh. */
+void
+gs_modalias_index_remove_drivers (GsModaliasIndex *index)
+{
+	g_hash_table_remove_all (index->drivers_by_key);
+	g_hash_table_remove_all (index->drivers);
+}
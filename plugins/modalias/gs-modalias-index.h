@@ -0,0 +1,39 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ * vi:set noexpandtab tabstop=8 shiftwidth=8:
+ *
+ * Copyright (C) 2016 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GsModaliasIndex GsModaliasIndex;
+
+gchar		*gs_modalias_pattern_get_key		(const gchar		*pattern);
+
+GsModaliasIndex	*gs_modalias_index_new			(void);
+void		 gs_modalias_index_free			(GsModaliasIndex	*index);
+
+void		 gs_modalias_index_add_device		(GsModaliasIndex	*index,
+							 const gchar		*sysfs_path,
+							 const gchar		*modalias);
+void		 gs_modalias_index_remove_device	(GsModaliasIndex	*index,
+							 const gchar		*sysfs_path);
+guint		 gs_modalias_index_get_n_devices	(GsModaliasIndex	*index);
+
+guint		 gs_modalias_index_add_driver		(GsModaliasIndex	*index,
+							 const gchar		*unique_id,
+							 const gchar * const	*patterns);
+gboolean	 gs_modalias_index_lookup_driver	(GsModaliasIndex	*index,
+							 const gchar		*unique_id,
+							 guint			*out_n_matched_devices);
+void		 gs_modalias_index_remove_drivers	(GsModaliasIndex	*index);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GsModaliasIndex, gs_modalias_index_free)
+
+G_END_DECLS
@@ -8,18 +8,32 @@
 
 #include <config.h>
 
-#include <fnmatch.h>
 #include <gudev/gudev.h>
 
 #include <gnome-software.h>
 
+#include "gs-modalias-index.h"
 #include "gs-plugin-modalias.h"
 
+/*
+ * SECTION:
+ * Adds an icon to driver components which support hardware on this machine.
+ *
+ * Driver components list the modaliases of the hardware they support, as
+ * globs. Rather than matching every glob of every driver against every device
+ * on each refine, the plugin keeps a #GsModaliasIndex of the devices and of the
+ * drivers it has seen, which is kept up to date as devices are added and
+ * removed.
+ */
+
 struct _GsPluginModalias {
 	GsPlugin		 parent;
 
 	GUdevClient		*client;
-	GPtrArray		*devices;
+
+	GMutex			 mutex;
+	gboolean		 devices_valid;  /* (locked-by mutex) */
+	GsModaliasIndex		*index;  /* (locked-by mutex) (owned) */
 };
 
 G_DEFINE_TYPE (GsPluginModalias, gs_plugin_modalias, GS_TYPE_PLUGIN)
@@ -31,13 +45,21 @@ gs_plugin_modalias_uevent_cb (GUdevClient *client,
                               gpointer     user_data)
 {
 	GsPluginModalias *self = GS_PLUGIN_MODALIAS (user_data);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->mutex);
+
+	/* devices will be picked up when the index is first needed */
+	if (!self->devices_valid)
+		return;
 
-	if (g_strcmp0 (action, "add") == 0 ||
-	    g_strcmp0 (action, "remove") == 0) {
-		g_debug ("invalidating devices as '%s' sent action '%s'",
-			 g_udev_device_get_sysfs_path (device),
-			 action);
-		g_ptr_array_set_size (self->devices, 0);
+	if (g_strcmp0 (action, "add") == 0) {
+		const gchar *modalias = g_udev_device_get_property (device, "MODALIAS");
+		if (modalias == NULL)
+			return;
+		g_debug ("adding device %s with modalias %s",
+			 g_udev_device_get_sysfs_path (device), modalias);
+		gs_modalias_index_add_device (self->index, g_udev_device_get_sysfs_path (device), modalias);
+	} else if (g_strcmp0 (action, "remove") == 0) {
+		gs_modalias_index_remove_device (self->index, g_udev_device_get_sysfs_path (device));
 	}
 }
 
@@ -45,12 +67,16 @@ static void
 gs_plugin_modalias_init (GsPluginModalias *self)
 {
 	GsPlugin *plugin = GS_PLUGIN (self);
+	/* an empty list means listening for uevents from all subsystems */
+	const gchar * const subsystems[] = { NULL };
 
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_AFTER, "appstream");
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_BEFORE, "icons");
 
-	self->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
-	self->client = g_udev_client_new (NULL);
+	g_mutex_init (&self->mutex);
+	self->index = gs_modalias_index_new ();
+
+	self->client = g_udev_client_new (subsystems);
 	g_signal_connect (self->client, "uevent",
 			  G_CALLBACK (gs_plugin_modalias_uevent_cb), self);
 }
@@ -61,52 +87,85 @@ gs_plugin_modalias_dispose (GObject *object)
 	GsPluginModalias *self = GS_PLUGIN_MODALIAS (object);
 
 	g_clear_object (&self->client);
-	g_clear_pointer (&self->devices, g_ptr_array_unref);
+	g_clear_pointer (&self->index, gs_modalias_index_free);
 
 	G_OBJECT_CLASS (gs_plugin_modalias_parent_class)->dispose (object);
 }
 
 static void
-gs_plugin_modalias_ensure_devices (GsPluginModalias *self)
+gs_plugin_modalias_finalize (GObject *object)
+{
+	GsPluginModalias *self = GS_PLUGIN_MODALIAS (object);
+
+	g_mutex_clear (&self->mutex);
+
+	G_OBJECT_CLASS (gs_plugin_modalias_parent_class)->finalize (object);
+}
+
+static void
+gs_plugin_modalias_ensure_devices_locked (GsPluginModalias *self)
 {
 	g_autoptr(GList) list = NULL;
 
 	/* already set */
-	if (self->devices->len > 0)
+	if (self->devices_valid)
 		return;
 
-	/* get the devices, and assume ownership of each */
+	/* devices on any bus can have a modalias, so enumerate them all and
+	 * skip the ones without */
 	list = g_udev_client_query_by_subsystem (self->client, NULL);
 	for (GList *l = list; l != NULL; l = l->next) {
-		GUdevDevice *device = G_UDEV_DEVICE (l->data);
-		if (g_udev_device_get_sysfs_attr (device, "modalias") == NULL) {
-			g_object_unref (device);
+		g_autoptr(GUdevDevice) device = G_UDEV_DEVICE (l->data);
+		const gchar *modalias = g_udev_device_get_property (device, "MODALIAS");
+
+		if (modalias != NULL)
+			gs_modalias_index_add_device (self->index, g_udev_device_get_sysfs_path (device), modalias);
+	}
+	self->devices_valid = TRUE;
+	g_debug ("%u devices with modalias", gs_modalias_index_get_n_devices (self->index));
+}
+
+/* Add the driver @app to the index, and count the devices it matches. */
+static guint
+add_driver_locked (GsPluginModalias *self,
+                   GsApp            *app,
+                   const gchar      *unique_id)
+{
+	GPtrArray *provided = gs_app_get_provided (app);
+	g_autoptr(GPtrArray) patterns = g_ptr_array_new ();
+
+	for (guint i = 0 ; i < provided->len; i++) {
+		GPtrArray *items;
+		AsProvided *prov = g_ptr_array_index (provided, i);
+		if (as_provided_get_kind (prov) != AS_PROVIDED_KIND_MODALIAS)
 			continue;
-		}
-		g_ptr_array_add (self->devices, device);
+		items = as_provided_get_items (prov);
+		for (guint j = 0; j < items->len; j++)
+			g_ptr_array_add (patterns, g_ptr_array_index (items, j));
 	}
-	g_debug ("%u devices with modalias", self->devices->len);
+	g_ptr_array_add (patterns, NULL);
+
+	return gs_modalias_index_add_driver (self->index, unique_id,
+					     (const gchar * const *) patterns->pdata);
 }
 
 static gboolean
 gs_plugin_modalias_matches (GsPluginModalias *self,
-                            const gchar      *modalias)
+                            GsApp            *app)
 {
-	gs_plugin_modalias_ensure_devices (self);
-	for (guint i = 0; i < self->devices->len; i++) {
-		GUdevDevice *device = g_ptr_array_index (self->devices, i);
-		const gchar *modalias_tmp;
-
-		/* get the (optional) device modalias */
-		modalias_tmp = g_udev_device_get_sysfs_attr (device, "modalias");
-		if (modalias_tmp == NULL)
-			continue;
-		if (fnmatch (modalias, modalias_tmp, 0) == 0) {
-			g_debug ("matched %s against %s", modalias_tmp, modalias);
-			return TRUE;
-		}
-	}
-	return FALSE;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->mutex);
+	const gchar *unique_id = gs_app_get_unique_id (app);
+	guint n_matched_devices;
+
+	if (unique_id == NULL)
+		return FALSE;
+
+	gs_plugin_modalias_ensure_devices_locked (self);
+
+	if (!gs_modalias_index_lookup_driver (self->index, unique_id, &n_matched_devices))
+		n_matched_devices = add_driver_locked (self, app, unique_id);
+
+	return n_matched_devices > 0;
 }
 
 static gboolean
@@ -116,36 +175,31 @@ refine_app (GsPluginModalias     *self,
 	    GCancellable         *cancellable,
 	    GError              **error)
 {
-	GPtrArray *provided;
-	guint i;
-
 	/* not required */
 	if (gs_app_has_icons (app))
 		return TRUE;
 	if (gs_app_get_kind (app) != AS_COMPONENT_KIND_DRIVER)
 		return TRUE;
 
-	/* do any of the modaliases match any installed hardware */
-	provided = gs_app_get_provided (app);
-	for (i = 0 ; i < provided->len; i++) {
-		GPtrArray *items;
-		AsProvided *prov = g_ptr_array_index (provided, i);
-		if (as_provided_get_kind (prov) != AS_PROVIDED_KIND_MODALIAS)
-			continue;
-		items = as_provided_get_items (prov);
-		for (guint j = 0; j < items->len; j++) {
-			if (gs_plugin_modalias_matches (self, (const gchar*) g_ptr_array_index (items, j))) {
-				g_autoptr(GIcon) ic = NULL;
-				ic = g_themed_icon_new ("emblem-system-symbolic");
-				gs_app_add_icon (app, ic);
-				gs_app_add_quirk (app, GS_APP_QUIRK_NOT_LAUNCHABLE);
-				break;
-			}
-		}
+	if (gs_plugin_modalias_matches (self, app)) {
+		g_autoptr(GIcon) ic = NULL;
+		ic = g_themed_icon_new ("emblem-system-symbolic");
+		gs_app_add_icon (app, ic);
+		gs_app_add_quirk (app, GS_APP_QUIRK_NOT_LAUNCHABLE);
 	}
 	return TRUE;
 }
 
+/* The driver components may have changed, so index them afresh. */
+static void
+gs_plugin_modalias_reload (GsPlugin *plugin)
+{
+	GsPluginModalias *self = GS_PLUGIN_MODALIAS (plugin);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->mutex);
+
+	gs_modalias_index_remove_drivers (self->index);
+}
+
 static void
 gs_plugin_modalias_refine_async (GsPlugin            *plugin,
                                  GsAppList           *list,
@@ -187,7 +241,9 @@ gs_plugin_modalias_class_init (GsPluginModaliasClass *klass)
 	GsPluginClass *plugin_class = GS_PLUGIN_CLASS (klass);
 
 	object_class->dispose = gs_plugin_modalias_dispose;
+	object_class->finalize = gs_plugin_modalias_finalize;
 
+	plugin_class->reload = gs_plugin_modalias_reload;
 	plugin_class->refine_async = gs_plugin_modalias_refine_async;
 	plugin_class->refine_finish = gs_plugin_modalias_refine_finish;
 }
@@ -10,8 +10,123 @@
 
 #include "gnome-software-private.h"
 
+#include "gs-modalias-index.h"
 #include "gs-test.h"
 
+static void
+gs_modalias_pattern_get_key_func (void)
+{
+	const struct {
+		const gchar *pattern;
+		const gchar *key;
+	} vectors[] = {
+		{ "pci:v000010DEd*", "pci:v000010DE" },
+		{ "pci:v000010DE*", "pci:v000010DE" },
+		{ "pci:v0000*", "pci:" },
+		{ "pci:v0000?0DEd*", "pci:" },
+		{ "pci:*", "pci:" },
+		{ "usb:v1234p*", "usb:v1234" },
+		{ "usb:v12*", "usb:" },
+		{ "dmi:*", "dmi:" },
+		{ "dmi*", "" },
+		{ "*", "" },
+		{ "", "" },
+	};
+
+	for (gsize i = 0; i < G_N_ELEMENTS (vectors); i++) {
+		g_autofree gchar *key = gs_modalias_pattern_get_key (vectors[i].pattern);
+		g_assert_cmpstr (key, ==, vectors[i].key);
+	}
+}
+
+static void
+gs_modalias_index_func (void)
+{
+	guint n_matched = G_MAXUINT;
+	g_autoptr(GsModaliasIndex) index = gs_modalias_index_new ();
+	const gchar * const nvidia[] = { "pci:v000010DEd*", NULL };
+	const gchar * const any_pci[] = { "pci:*", NULL };
+	const gchar * const any[] = { "*:v000010DE*", NULL };
+	const gchar * const usb[] = { "usb:v1234p*", "usb:v5678p*", NULL };
+	const gchar * const none[] = { NULL };
+
+	/* devices present before the drivers are added */
+	gs_modalias_index_add_device (index, "/sys/devices/pci0", "pci:v000010DEd00001234sv0sd0bc03sc00i00");
+	gs_modalias_index_add_device (index, "/sys/devices/pci1", "pci:v00008086d00005678sv0sd0bc06sc00i00");
+	gs_modalias_index_add_device (index, "/sys/devices/usb0", "usb:v1234p0001d0100dc00dsc00dp00ic03isc01ip01in00");
+	gs_modalias_index_add_device (index, "/sys/devices/acpi0", "acpi:PNP0A08:");
+	g_assert_cmpuint (gs_modalias_index_get_n_devices (index), ==, 4);
+
+	g_assert_false (gs_modalias_index_lookup_driver (index, "nvidia", NULL));
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "nvidia", nvidia), ==, 1);
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "any-pci", any_pci), ==, 2);
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "any", any), ==, 1);
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "usb", usb), ==, 1);
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "none", none), ==, 0);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "nvidia", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 1);
+
+	/* a device being added updates the counts of the drivers it matches */
+	gs_modalias_index_add_device (index, "/sys/devices/pci2", "pci:v000010DEd00009999sv0sd0bc03sc00i00");
+	gs_modalias_index_add_device (index, "/sys/devices/usb1", "usb:v5678p0002d0100dc00dsc00dp00ic03isc01ip01in00");
+	g_assert_cmpuint (gs_modalias_index_get_n_devices (index), ==, 6);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "nvidia", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 2);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any-pci", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 3);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 2);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "usb", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 2);
+
+	/* replacing a device at the same path doesn’t count it twice */
+	gs_modalias_index_add_device (index, "/sys/devices/pci2", "pci:v00008086d00009999sv0sd0bc03sc00i00");
+	g_assert_cmpuint (gs_modalias_index_get_n_devices (index), ==, 6);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "nvidia", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 1);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any-pci", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 3);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 1);
+
+	/* a device being removed updates the counts of the drivers it matched */
+	gs_modalias_index_remove_device (index, "/sys/devices/pci0");
+	gs_modalias_index_remove_device (index, "/sys/devices/usb0");
+	gs_modalias_index_remove_device (index, "/sys/devices/does-not-exist");
+	g_assert_cmpuint (gs_modalias_index_get_n_devices (index), ==, 4);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "nvidia", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 0);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any-pci", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 2);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 0);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "usb", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 1);
+	g_assert_true (gs_modalias_index_lookup_driver (index, "none", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 0);
+
+	/* the drivers are added afresh after removing them, and the devices
+	 * are kept */
+	gs_modalias_index_remove_drivers (index);
+	g_assert_false (gs_modalias_index_lookup_driver (index, "nvidia", NULL));
+	g_assert_cmpuint (gs_modalias_index_get_n_devices (index), ==, 4);
+	g_assert_cmpuint (gs_modalias_index_add_driver (index, "any-pci", any_pci), ==, 2);
+
+	/* devices removed after the drivers are removed don’t touch them */
+	gs_modalias_index_remove_device (index, "/sys/devices/pci1");
+	g_assert_true (gs_modalias_index_lookup_driver (index, "any-pci", &n_matched));
+	g_assert_cmpuint (n_matched, ==, 1);
+}
+
+/* Whether the modalias plugin will find a device matching `pci:*`. */
+static gboolean
+system_has_pci_devices (void)
+{
+	g_autoptr(GDir) dir = g_dir_open ("/sys/bus/pci/devices", 0, NULL);
+
+	return (dir != NULL && g_dir_read_name (dir) != NULL);
+}
+
 static void
 gs_plugins_modalias_func (GsPluginLoader *plugin_loader)
 {
@@ -42,6 +157,15 @@ gs_plugins_modalias_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_kind (app), ==, AS_COMPONENT_KIND_DRIVER);
 	g_assert (gs_app_has_category (app, "Addon"));
 	g_assert (gs_app_has_category (app, "Driver"));
+
+	/* the driver matches any PCI device, so it is only marked as
+	 * supporting this hardware if there are some */
+	if (system_has_pci_devices ()) {
+		g_assert_true (gs_app_has_icons (app));
+		g_assert_true (gs_app_has_quirk (app, GS_APP_QUIRK_NOT_LAUNCHABLE));
+	} else {
+		g_assert_false (gs_app_has_icons (app));
+	}
 }
 
 int
@@ -100,6 +224,10 @@ main (int argc, char **argv)
 	g_assert (ret);
 
 	/* plugin tests go here */
+	g_test_add_func ("/gnome-software/plugins/modalias/pattern-key",
+			 gs_modalias_pattern_get_key_func);
+	g_test_add_func ("/gnome-software/plugins/modalias/index",
+			 gs_modalias_index_func);
 	g_test_add_data_func ("/gnome-software/plugins/modalias",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_modalias_func);
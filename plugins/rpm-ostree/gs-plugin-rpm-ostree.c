@@ -49,6 +49,60 @@ G_DEFINE_AUTO_CLEANUP_FREE_FUNC(Header, headerFree, NULL)
 G_DEFINE_AUTO_CLEANUP_FREE_FUNC(rpmts, rpmtsFree, NULL);
 G_DEFINE_AUTO_CLEANUP_FREE_FUNC(rpmdbMatchIterator, rpmdbFreeIterator, NULL);
 
+/* The installed packages of a deployment, and the owners of files looked up in
+ * the rpmdb, which don’t change until the deployment checksum does. */
+typedef struct {
+	gchar		*checksum;  /* (owned) */
+	GPtrArray	*pkglist;  /* (owned) (element-type RpmOstreePackage) */
+	GHashTable	*packages;  /* (owned) (element-type utf8 RpmOstreePackage); by name, values borrowed from @pkglist */
+	GStrv		 layered_packages_strv;  /* (owned) */
+	GStrv		 layered_local_packages_strv;  /* (owned) */
+	GHashTable	*layered_packages;  /* (owned) (element-type utf8); borrowed from @layered_packages_strv */
+	GHashTable	*layered_local_packages;  /* (owned) (element-type utf8); borrowed from @layered_local_packages_strv */
+
+	GMutex		 file_owners_mutex;
+	GHashTable	*file_owners;  /* (owned) (element-type filename FileOwner) (locked-by file_owners_mutex); %NULL values for files with no owner */
+} PackageDb;
+
+typedef struct {
+	gchar		*name;  /* (owned) */
+	gchar		*nevra;  /* (owned) */
+} FileOwner;
+
+static void
+file_owner_free (FileOwner *owner)
+{
+	if (owner == NULL)
+		return;
+	g_free (owner->name);
+	g_free (owner->nevra);
+	g_free (owner);
+}
+
+static void
+package_db_clear (gpointer data)
+{
+	PackageDb *db = data;
+
+	g_free (db->checksum);
+	g_clear_pointer (&db->packages, g_hash_table_unref);
+	g_clear_pointer (&db->layered_packages, g_hash_table_unref);
+	g_clear_pointer (&db->layered_local_packages, g_hash_table_unref);
+	g_clear_pointer (&db->pkglist, g_ptr_array_unref);
+	g_strfreev (db->layered_packages_strv);
+	g_strfreev (db->layered_local_packages_strv);
+	g_clear_pointer (&db->file_owners, g_hash_table_unref);
+	g_mutex_clear (&db->file_owners_mutex);
+}
+
+static void
+package_db_unref (PackageDb *db)
+{
+	g_rc_box_release_full (db, package_db_clear);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PackageDb, package_db_unref)
+
 struct _GsPluginRpmOstree {
 	GsPlugin		 parent;
 
@@ -64,6 +118,9 @@ struct _GsPluginRpmOstree {
 
 	GHashTable		*cached_sources; /* (nullable) (owned) (element-type utf8 GsApp); sources by id, each value is weak reffed */
 	GMutex			 cached_sources_mutex;
+
+	PackageDb		*package_db;  /* (nullable) (owned) (locked-by package_db_mutex); for the last default deployment seen */
+	GMutex			 package_db_mutex;
 };
 
 G_DEFINE_TYPE (GsPluginRpmOstree, gs_plugin_rpm_ostree, GS_TYPE_PLUGIN)
@@ -113,6 +170,7 @@ gs_plugin_rpm_ostree_dispose (GObject *object)
 	g_clear_object (&self->ot_sysroot);
 	g_clear_object (&self->ot_repo);
 	g_clear_object (&self->worker);
+	g_clear_pointer (&self->package_db, package_db_unref);
 
 	if (self->cached_sources != NULL) {
 		GHashTableIter iter;
@@ -137,6 +195,7 @@ gs_plugin_rpm_ostree_finalize (GObject *object)
 
 	g_mutex_clear (&self->mutex);
 	g_mutex_clear (&self->cached_sources_mutex);
+	g_mutex_clear (&self->package_db_mutex);
 
 	G_OBJECT_CLASS (gs_plugin_rpm_ostree_parent_class)->finalize (object);
 }
@@ -146,6 +205,7 @@ gs_plugin_rpm_ostree_init (GsPluginRpmOstree *self)
 {
 	g_mutex_init (&self->mutex);
 	g_mutex_init (&self->cached_sources_mutex);
+	g_mutex_init (&self->package_db_mutex);
 
 	/* only works on OSTree */
 	if (!g_file_test ("/run/ostree-booted", G_FILE_TEST_EXISTS)) {
@@ -2067,18 +2127,27 @@ resolve_installed_packages_app (GsPlugin *plugin,
 	return FALSE /* not found */;
 }
 
+/* Looks up which package owns @fn in the rpmdb, caching the result in @db.
+ * Returns %FALSE on error; otherwise @out_owner is set to the owner, or %NULL
+ * if no package owns @fn. */
 static gboolean
-resolve_appstream_source_file_to_package_name (GsPlugin *plugin,
-                                               GsApp *app,
-                                               GsPluginRefineFlags flags,
-                                               GCancellable *cancellable,
-                                               GError **error)
+package_db_lookup_file_owner (PackageDb        *db,
+                              const gchar      *fn,
+                              const FileOwner **out_owner,
+                              GError          **error)
 {
 	Header h;
-	const gchar *fn;
 	gint rc;
+	gpointer cached_owner;
+	FileOwner *owner = NULL;
 	g_auto(rpmdbMatchIterator) mi = NULL;
 	g_auto(rpmts) ts = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&db->file_owners_mutex);
+
+	if (g_hash_table_lookup_extended (db->file_owners, fn, NULL, &cached_owner)) {
+		*out_owner = cached_owner;
+		return TRUE;
+	}
 
 	/* open db readonly */
 	ts = rpmtsCreate();
@@ -2092,39 +2161,125 @@ resolve_appstream_source_file_to_package_name (GsPlugin *plugin,
 		return FALSE;
 	}
 
+	/* look for a specific file, and use the first package which owns it */
+	mi = rpmtsInitIterator (ts, RPMDBI_INSTFILENAMES, fn, 0);
+	if (mi != NULL && (h = rpmdbNextIterator (mi)) != NULL) {
+		owner = g_new0 (FileOwner, 1);
+		owner->name = g_strdup (headerGetString (h, RPMTAG_NAME));
+		owner->nevra = g_strdup (headerGetString (h, RPMTAG_NEVRA));
+	}
+
+	g_hash_table_insert (db->file_owners, g_strdup (fn), owner);
+	*out_owner = owner;
+
+	return TRUE;
+}
+
+static gboolean
+resolve_appstream_source_file_to_package_name (GsPlugin *plugin,
+                                               PackageDb *db,
+                                               GsApp *app,
+                                               GsPluginRefineFlags flags,
+                                               GCancellable *cancellable,
+                                               GError **error)
+{
+	const gchar *fn;
+	const FileOwner *owner = NULL;
+
 	/* look for a specific file */
 	fn = gs_app_get_metadata_item (app, "appstream::source-file");
 	if (fn == NULL)
 		return TRUE;
 
-	mi = rpmtsInitIterator (ts, RPMDBI_INSTFILENAMES, fn, 0);
-	if (mi == NULL) {
+	if (!package_db_lookup_file_owner (db, fn, &owner, error))
+		return FALSE;
+	if (owner == NULL) {
 		g_debug ("rpm: no search results for %s", fn);
 		return TRUE;
 	}
 
-	/* process any results */
+	/* add default source */
 	g_debug ("rpm: querying for %s with %s", gs_app_get_id (app), fn);
-	while ((h = rpmdbNextIterator (mi)) != NULL) {
-		const gchar *name;
-
-		/* add default source */
-		name = headerGetString (h, RPMTAG_NAME);
-		if (gs_app_get_source_default (app) == NULL) {
-			const gchar *nevra = headerGetString (h, RPMTAG_NEVRA);
-			g_debug ("rpm: setting source to '%s' with nevra '%s'", name, nevra);
-			gs_app_add_source (app, name);
-			gs_app_set_metadata (app, "GnomeSoftware::packagename-value", nevra);
-			gs_app_set_management_plugin (app, plugin);
-			gs_app_add_quirk (app, GS_APP_QUIRK_NEEDS_REBOOT);
-			app_set_rpm_ostree_packaging_format (app);
-			gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_PACKAGE);
-		}
+	if (gs_app_get_source_default (app) == NULL) {
+		g_debug ("rpm: setting source to '%s' with nevra '%s'", owner->name, owner->nevra);
+		gs_app_add_source (app, owner->name);
+		gs_app_set_metadata (app, "GnomeSoftware::packagename-value", owner->nevra);
+		gs_app_set_management_plugin (app, plugin);
+		gs_app_add_quirk (app, GS_APP_QUIRK_NEEDS_REBOOT);
+		app_set_rpm_ostree_packaging_format (app);
+		gs_app_set_bundle_kind (app, AS_BUNDLE_KIND_PACKAGE);
 	}
 
 	return TRUE;
 }
 
+/* Returns the #PackageDb for @default_deployment, querying its packages only
+ * if the deployment checksum has changed since the last call. */
+static PackageDb *
+gs_rpm_ostree_ref_package_db (GsPluginRpmOstree  *self,
+                              OstreeRepo         *ot_repo,
+                              GVariant           *default_deployment,
+                              GCancellable       *cancellable,
+                              GError            **error)
+{
+	g_autoptr(PackageDb) db = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autofree gchar *checksum = NULL;
+
+	g_assert (g_variant_lookup (default_deployment,
+	                            "checksum", "s",
+	                            &checksum));
+
+	locker = g_mutex_locker_new (&self->package_db_mutex);
+	if (self->package_db != NULL && g_strcmp0 (self->package_db->checksum, checksum) == 0)
+		return g_rc_box_acquire (self->package_db);
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
+	g_debug ("Loading packages for deployment %s", checksum);
+
+	db = g_rc_box_new0 (PackageDb);
+	g_mutex_init (&db->file_owners_mutex);
+	db->file_owners = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) file_owner_free);
+	db->packages = g_hash_table_new (g_str_hash, g_str_equal);
+	db->layered_packages = g_hash_table_new (g_str_hash, g_str_equal);
+	db->layered_local_packages = g_hash_table_new (g_str_hash, g_str_equal);
+
+	g_assert (g_variant_lookup (default_deployment,
+	                            "packages", "^as",
+	                            &db->layered_packages_strv));
+	g_assert (g_variant_lookup (default_deployment,
+	                            "requested-local-packages", "^as",
+	                            &db->layered_local_packages_strv));
+
+	db->pkglist = rpm_ostree_db_query_all (ot_repo, checksum, cancellable, error);
+	if (db->pkglist == NULL) {
+		gs_rpmostree_error_convert (error);
+		return NULL;
+	}
+
+	for (guint ii = 0; ii < db->pkglist->len; ii++) {
+		RpmOstreePackage *pkg = g_ptr_array_index (db->pkglist, ii);
+		if (rpm_ostree_package_get_name (pkg))
+			g_hash_table_insert (db->packages, (gpointer) rpm_ostree_package_get_name (pkg), pkg);
+	}
+
+	for (guint ii = 0; db->layered_packages_strv && db->layered_packages_strv[ii]; ii++) {
+		g_hash_table_add (db->layered_packages, db->layered_packages_strv[ii]);
+	}
+
+	for (guint ii = 0; db->layered_local_packages_strv && db->layered_local_packages_strv[ii]; ii++) {
+		g_hash_table_add (db->layered_local_packages, db->layered_local_packages_strv[ii]);
+	}
+
+	db->checksum = g_steal_pointer (&checksum);
+
+	locker = g_mutex_locker_new (&self->package_db_mutex);
+	g_clear_pointer (&self->package_db, package_db_unref);
+	self->package_db = g_rc_box_acquire (db);
+
+	return g_steal_pointer (&db);
+}
+
 static gboolean
 gs_rpm_ostree_refine_apps (GsPlugin *plugin,
 			   GsAppList *list,
@@ -2133,19 +2288,13 @@ gs_rpm_ostree_refine_apps (GsPlugin *plugin,
 			   GError **error)
 {
 	GsPluginRpmOstree *self = GS_PLUGIN_RPM_OSTREE (plugin);
-	g_autoptr(GHashTable) packages = NULL;
-	g_autoptr(GHashTable) layered_packages = NULL;
-	g_autoptr(GHashTable) layered_local_packages = NULL;
 	g_autoptr(GHashTable) lookup_apps = NULL; /* name ~> GsApp */
 	g_autoptr(GMutexLocker) locker = NULL;
-	g_autoptr(GPtrArray) pkglist = NULL;
 	g_autoptr(GVariant) default_deployment = NULL;
 	g_autoptr(GsRPMOSTreeOS) os_proxy = NULL;
 	g_autoptr(GsRPMOSTreeSysroot) sysroot_proxy = NULL;
 	g_autoptr(OstreeRepo) ot_repo = NULL;
-	g_auto(GStrv) layered_packages_strv = NULL;
-	g_auto(GStrv) layered_local_packages_strv = NULL;
-	g_autofree gchar *checksum = NULL;
+	g_autoptr(PackageDb) db = NULL;
 	gboolean interactive = gs_plugin_has_flags (plugin, GS_PLUGIN_FLAGS_INTERACTIVE);
 
 	locker = g_mutex_locker_new (&self->mutex);
@@ -2168,39 +2317,9 @@ gs_rpm_ostree_refine_apps (GsPlugin *plugin,
 	}
 
 	default_deployment = gs_rpmostree_os_dup_default_deployment (os_proxy);
-	g_assert (g_variant_lookup (default_deployment,
-	                            "packages", "^as",
-	                            &layered_packages_strv));
-	g_assert (g_variant_lookup (default_deployment,
-	                            "requested-local-packages", "^as",
-	                            &layered_local_packages_strv));
-	g_assert (g_variant_lookup (default_deployment,
-	                            "checksum", "s",
-	                            &checksum));
-
-	pkglist = rpm_ostree_db_query_all (ot_repo, checksum, cancellable, error);
-	if (pkglist == NULL) {
-		gs_rpmostree_error_convert (error);
+	db = gs_rpm_ostree_ref_package_db (self, ot_repo, default_deployment, cancellable, error);
+	if (db == NULL)
 		return FALSE;
-	}
-
-	packages = g_hash_table_new (g_str_hash, g_str_equal);
-	layered_packages = g_hash_table_new (g_str_hash, g_str_equal);
-	layered_local_packages = g_hash_table_new (g_str_hash, g_str_equal);
-
-	for (guint ii = 0; ii < pkglist->len; ii++) {
-		RpmOstreePackage *pkg = g_ptr_array_index (pkglist, ii);
-		if (rpm_ostree_package_get_name (pkg))
-			g_hash_table_insert (packages, (gpointer) rpm_ostree_package_get_name (pkg), pkg);
-	}
-
-	for (guint ii = 0; layered_packages_strv && layered_packages_strv[ii]; ii++) {
-		g_hash_table_add (layered_packages, layered_packages_strv[ii]);
-	}
-
-	for (guint ii = 0; layered_local_packages_strv && layered_local_packages_strv[ii]; ii++) {
-		g_hash_table_add (layered_local_packages, layered_local_packages_strv[ii]);
-	}
 
 	lookup_apps = g_hash_table_new (g_str_hash, g_str_equal);
 
@@ -2223,7 +2342,7 @@ gs_rpm_ostree_refine_apps (GsPlugin *plugin,
 		    gs_app_get_bundle_kind (app) == AS_BUNDLE_KIND_UNKNOWN &&
 		    gs_app_get_scope (app) == AS_COMPONENT_SCOPE_SYSTEM &&
 		    gs_app_get_source_default (app) == NULL) {
-			if (!resolve_appstream_source_file_to_package_name (plugin, app, flags, cancellable, error))
+			if (!resolve_appstream_source_file_to_package_name (plugin, db, app, flags, cancellable, error))
 				return FALSE;
 		}
 		if (!gs_app_has_management_plugin (app, plugin))
@@ -2233,7 +2352,7 @@ gs_rpm_ostree_refine_apps (GsPlugin *plugin,
 
 		/* first try to resolve from installed packages and
 		   if we didn't find anything, try resolving from available packages */
-		if (!resolve_installed_packages_app (plugin, packages, layered_packages, layered_local_packages, app))
+		if (!resolve_installed_packages_app (plugin, db->packages, db->layered_packages, db->layered_local_packages, app))
 			g_hash_table_insert (lookup_apps, (gpointer) gs_app_get_source_default (app), app);
 	}
 
@@ -25,6 +25,12 @@
  * the real work is done in the snapd daemon. FIXME: This means the plugin can
  * therefore execute entirely in the main thread, making asynchronous calls,
  * once all the vfuncs have been ported.
+ *
+ * Results from the store are persisted in the user cache, and served from
+ * there on later runs. Cached results older than the
+ * `snap-store-cache-age-maximum` setting are refreshed in the background.
+ * The results of free-text searches are only cached in memory, so that what
+ * the user searched for isn’t recorded.
  */
 
 struct _GsPluginSnap {
@@ -34,23 +40,49 @@ struct _GsPluginSnap {
 	gchar			*store_hostname;
 	SnapdSystemConfinement	 system_confinement;
 
+	/* Store metadata is persisted in the user cache, and served from
+	 * there while it’s younger than @store_cache_age_maximum. Older
+	 * metadata is still served, but revalidated in the background. */
 	GMutex			 store_snaps_lock;
-	GHashTable		*store_snaps;
+	GHashTable		*store_snaps;  /* (element-type utf8 CacheEntry) (owned) (locked-by store_snaps_lock) */
+	GHashTable		*store_queries;  /* (element-type utf8 QueryCacheEntry) (owned) (locked-by store_snaps_lock) */
+	GHashTable		*store_revalidating;  /* (element-type utf8 utf8) (owned) (locked-by store_snaps_lock); set of query keys */
+	GSource			*store_cache_save_source;  /* (owned) (nullable) (locked-by store_snaps_lock) */
+	guint			 store_cache_save_delay_secs;
+	GMutex			 store_cache_save_lock;
+	guint			 store_cache_age_maximum;  /* seconds */
 };
 
 G_DEFINE_TYPE (GsPluginSnap, gs_plugin_snap, GS_TYPE_PLUGIN)
 
+/* Bump this if the format of the persisted store cache changes. */
+#define STORE_CACHE_VERSION 1
+
+/* Metadata older than this is not loaded from the persisted store cache at all. */
+#define STORE_CACHE_EXPIRE_SECONDS (30 * 24 * 60 * 60)
+
+/* Changes to the store cache are batched up and saved this long after the
+ * first one. */
+#define STORE_CACHE_SAVE_DELAY_SECONDS 10
+
+/* The results of free-text searches are only cached in memory, so that the
+ * searches aren’t recorded on disk, and only for this many of the most
+ * recently used searches. */
+#define STORE_QUERY_CACHE_SEARCHES_MAX 32
+
 typedef struct {
 	SnapdSnap *snap;
 	gboolean full_details;
+	gint64 fetch_time;  /* seconds since the Unix epoch */
 } CacheEntry;
 
 static CacheEntry *
-cache_entry_new (SnapdSnap *snap, gboolean full_details)
+cache_entry_new (SnapdSnap *snap, gboolean full_details, gint64 fetch_time)
 {
 	CacheEntry *entry = g_slice_new (CacheEntry);
 	entry->snap = g_object_ref (snap);
 	entry->full_details = full_details;
+	entry->fetch_time = fetch_time;
 	return entry;
 }
 
@@ -61,6 +93,282 @@ cache_entry_free (CacheEntry *entry)
 	g_slice_free (CacheEntry, entry);
 }
 
+/* The names of the snaps returned by a find query, in order. */
+typedef struct {
+	SnapdFindFlags flags;
+	gchar *section;  /* (nullable) */
+	gchar *query;  /* (nullable) */
+	GStrv names;  /* (not nullable) */
+	gint64 fetch_time;  /* seconds since the Unix epoch */
+	gint64 last_used_time;  /* monotonic time, for evicting searches */
+} QueryCacheEntry;
+
+static QueryCacheEntry *
+query_cache_entry_copy (const QueryCacheEntry *entry)
+{
+	QueryCacheEntry *copy = g_slice_new0 (QueryCacheEntry);
+	copy->flags = entry->flags;
+	copy->section = g_strdup (entry->section);
+	copy->query = g_strdup (entry->query);
+	copy->names = g_strdupv (entry->names);
+	copy->fetch_time = entry->fetch_time;
+	copy->last_used_time = entry->last_used_time;
+	return copy;
+}
+
+static void
+query_cache_entry_free (QueryCacheEntry *entry)
+{
+	g_free (entry->section);
+	g_free (entry->query);
+	g_strfreev (entry->names);
+	g_slice_free (QueryCacheEntry, entry);
+}
+
+static gchar *
+query_cache_key (SnapdFindFlags  flags,
+                 const gchar    *section,
+                 const gchar    *query)
+{
+	return g_strdup_printf ("%u:%s:%s", (guint) flags,
+				(section != NULL) ? section : "",
+				(query != NULL) ? query : "");
+}
+
+/* SnapdSnap, and the objects it contains, are immutable objects built from
+ * construct properties, so they can be persisted as their properties. The
+ * pointer array properties in snapd-glib always hold objects. */
+static JsonNode *object_to_json (GObject *object);
+static GObject *object_from_json (GType        type,
+                                  JsonObject  *json,
+                                  GError     **error);
+
+static JsonNode *
+value_to_json (const GValue *value)
+{
+	GType type = G_VALUE_TYPE (value);
+	JsonNode *node = json_node_alloc ();
+
+	if (type == G_TYPE_STRING && g_value_get_string (value) != NULL) {
+		return json_node_init_string (node, g_value_get_string (value));
+	} else if (type == G_TYPE_STRV && g_value_get_boxed (value) != NULL) {
+		const gchar * const *strv = g_value_get_boxed (value);
+		JsonArray *array = json_array_new ();
+
+		for (gsize i = 0; strv[i] != NULL; i++)
+			json_array_add_string_element (array, strv[i]);
+		json_node_init_array (node, array);
+		json_array_unref (array);
+		return node;
+	} else if (type == G_TYPE_BOOLEAN) {
+		return json_node_init_boolean (node, g_value_get_boolean (value));
+	} else if (type == G_TYPE_INT) {
+		return json_node_init_int (node, g_value_get_int (value));
+	} else if (type == G_TYPE_UINT) {
+		return json_node_init_int (node, g_value_get_uint (value));
+	} else if (type == G_TYPE_INT64) {
+		return json_node_init_int (node, g_value_get_int64 (value));
+	} else if (type == G_TYPE_UINT64) {
+		return json_node_init_int (node, (gint64) g_value_get_uint64 (value));
+	} else if (type == G_TYPE_DOUBLE) {
+		return json_node_init_double (node, g_value_get_double (value));
+	} else if (G_TYPE_IS_ENUM (type)) {
+		return json_node_init_int (node, g_value_get_enum (value));
+	} else if (G_TYPE_IS_FLAGS (type)) {
+		return json_node_init_int (node, g_value_get_flags (value));
+	} else if (type == G_TYPE_DATE_TIME && g_value_get_boxed (value) != NULL) {
+		g_autofree gchar *str = g_date_time_format_iso8601 (g_value_get_boxed (value));
+		return json_node_init_string (node, str);
+	} else if (type == G_TYPE_PTR_ARRAY && g_value_get_boxed (value) != NULL) {
+		GPtrArray *objects = g_value_get_boxed (value);
+		JsonArray *array = json_array_new ();
+
+		for (guint i = 0; i < objects->len; i++) {
+			GObject *object = g_ptr_array_index (objects, i);
+			JsonObject *element = json_object_new ();
+
+			json_object_set_string_member (element, "type", G_OBJECT_TYPE_NAME (object));
+			json_object_set_member (element, "properties", object_to_json (object));
+			json_array_add_object_element (array, element);
+		}
+		json_node_init_array (node, array);
+		json_array_unref (array);
+		return node;
+	}
+
+	json_node_unref (node);
+	return NULL;
+}
+
+/* Returns %FALSE without setting @error if @node can’t be converted, in which
+ * case the property is ignored. @error is set if @node holds objects of a type
+ * which isn’t known, as the whole snap then has to be ignored rather than
+ * silently losing some of them. */
+static gboolean
+value_from_json (GValue    *value,
+                 JsonNode  *node,
+                 GError   **error)
+{
+	GType type = G_VALUE_TYPE (value);
+
+	if (JSON_NODE_HOLDS_ARRAY (node)) {
+		JsonArray *array = json_node_get_array (node);
+
+		if (type == G_TYPE_STRV) {
+			g_autoptr(GStrvBuilder) builder = g_strv_builder_new ();
+
+			for (guint i = 0; i < json_array_get_length (array); i++) {
+				JsonNode *element = json_array_get_element (array, i);
+				if (json_node_get_value_type (element) != G_TYPE_STRING)
+					return FALSE;
+				g_strv_builder_add (builder, json_node_get_string (element));
+			}
+			g_value_take_boxed (value, g_strv_builder_end (builder));
+			return TRUE;
+		} else if (type == G_TYPE_PTR_ARRAY) {
+			g_autoptr(GPtrArray) objects = g_ptr_array_new_with_free_func (g_object_unref);
+
+			for (guint i = 0; i < json_array_get_length (array); i++) {
+				JsonNode *element = json_array_get_element (array, i);
+				JsonObject *element_object;
+				JsonNode *properties;
+				GType element_type;
+				GObject *object;
+
+				if (!JSON_NODE_HOLDS_OBJECT (element))
+					return FALSE;
+				element_object = json_node_get_object (element);
+				properties = json_object_get_member (element_object, "properties");
+				if (!json_object_has_member (element_object, "type") ||
+				    properties == NULL || !JSON_NODE_HOLDS_OBJECT (properties))
+					return FALSE;
+
+				element_type = g_type_from_name (json_object_get_string_member (element_object, "type"));
+				if (element_type == G_TYPE_INVALID || !g_type_is_a (element_type, G_TYPE_OBJECT)) {
+					g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+						     "Unknown object type ‘%s’",
+						     json_object_get_string_member (element_object, "type"));
+					return FALSE;
+				}
+
+				object = object_from_json (element_type, json_node_get_object (properties), error);
+				if (object == NULL)
+					return FALSE;
+				g_ptr_array_add (objects, object);
+			}
+			g_value_set_boxed (value, objects);
+			return TRUE;
+		}
+
+		return FALSE;
+	}
+
+	if (!JSON_NODE_HOLDS_VALUE (node))
+		return FALSE;
+
+	if (type == G_TYPE_STRING && json_node_get_value_type (node) == G_TYPE_STRING) {
+		g_value_set_string (value, json_node_get_string (node));
+	} else if (type == G_TYPE_DATE_TIME && json_node_get_value_type (node) == G_TYPE_STRING) {
+		GDateTime *date_time = g_date_time_new_from_iso8601 (json_node_get_string (node), NULL);
+		if (date_time == NULL)
+			return FALSE;
+		g_value_take_boxed (value, date_time);
+	} else if (type == G_TYPE_BOOLEAN && json_node_get_value_type (node) == G_TYPE_BOOLEAN) {
+		g_value_set_boolean (value, json_node_get_boolean (node));
+	} else if (type == G_TYPE_DOUBLE && json_node_get_value_type (node) == G_TYPE_DOUBLE) {
+		g_value_set_double (value, json_node_get_double (node));
+	} else if (json_node_get_value_type (node) == G_TYPE_INT64) {
+		gint64 i = json_node_get_int (node);
+
+		if (type == G_TYPE_INT)
+			g_value_set_int (value, i);
+		else if (type == G_TYPE_UINT)
+			g_value_set_uint (value, i);
+		else if (type == G_TYPE_INT64)
+			g_value_set_int64 (value, i);
+		else if (type == G_TYPE_UINT64)
+			g_value_set_uint64 (value, (guint64) i);
+		else if (G_TYPE_IS_ENUM (type))
+			g_value_set_enum (value, i);
+		else if (G_TYPE_IS_FLAGS (type))
+			g_value_set_flags (value, i);
+		else
+			return FALSE;
+	} else {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static JsonNode *
+object_to_json (GObject *object)
+{
+	g_autoptr(JsonObject) json = json_object_new ();
+	g_autofree GParamSpec **pspecs = NULL;
+	guint n_pspecs;
+
+	pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (object), &n_pspecs);
+	for (guint i = 0; i < n_pspecs; i++) {
+		GParamSpec *pspec = pspecs[i];
+		g_auto(GValue) value = G_VALUE_INIT;
+		JsonNode *node;
+
+		if ((pspec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+		    (pspec->flags & G_PARAM_DEPRECATED))
+			continue;
+
+		g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+		g_object_get_property (object, pspec->name, &value);
+		node = value_to_json (&value);
+		if (node != NULL)
+			json_object_set_member (json, pspec->name, node);
+	}
+
+	return json_node_init_object (json_node_alloc (), json);
+}
+
+static GObject *
+object_from_json (GType        type,
+                  JsonObject  *json,
+                  GError     **error)
+{
+	g_autoptr(GTypeClass) klass = g_type_class_ref (type);
+	g_autoptr(GList) members = json_object_get_members (json);
+	g_autoptr(GPtrArray) names = g_ptr_array_new ();
+	g_autoptr(GArray) values = g_array_new (FALSE, TRUE, sizeof (GValue));
+	g_autoptr(GError) local_error = NULL;
+
+	g_array_set_clear_func (values, (GDestroyNotify) g_value_unset);
+
+	for (GList *l = members; l != NULL; l = l->next) {
+		const gchar *name = l->data;
+		GParamSpec *pspec = g_object_class_find_property (G_OBJECT_CLASS (klass), name);
+		GValue value = G_VALUE_INIT;
+
+		/* ignore properties from other versions of snapd-glib */
+		if (pspec == NULL || !(pspec->flags & G_PARAM_WRITABLE))
+			continue;
+
+		g_value_init (&value, G_PARAM_SPEC_VALUE_TYPE (pspec));
+		if (!value_from_json (&value, json_object_get_member (json, name), &local_error)) {
+			g_value_unset (&value);
+			if (local_error != NULL) {
+				g_propagate_error (error, g_steal_pointer (&local_error));
+				return NULL;
+			}
+			continue;
+		}
+
+		g_ptr_array_add (names, (gpointer) pspec->name);
+		g_array_append_val (values, value);
+	}
+
+	return g_object_new_with_properties (type, names->len,
+					     (const gchar **) names->pdata,
+					     (const GValue *) values->data);
+}
+
 static SnapdAuthData *
 get_auth_data (GsPluginSnap *self)
 {
@@ -136,6 +444,9 @@ gs_plugin_snap_init (GsPluginSnap *self)
 	g_autoptr (GError) error = NULL;
 
 	g_mutex_init (&self->store_snaps_lock);
+	g_mutex_init (&self->store_cache_save_lock);
+
+	self->store_cache_save_delay_secs = (g_getenv ("GS_SELF_TEST_SNAP_STORE_CACHE_SAVE_NOW") != NULL) ? 0 : STORE_CACHE_SAVE_DELAY_SECONDS;
 
 	client = get_client (self, FALSE, &error);
 	if (client == NULL) {
@@ -145,6 +456,9 @@ gs_plugin_snap_init (GsPluginSnap *self)
 
 	self->store_snaps = g_hash_table_new_full (g_str_hash, g_str_equal,
 						   g_free, (GDestroyNotify) cache_entry_free);
+	self->store_queries = g_hash_table_new_full (g_str_hash, g_str_equal,
+						     g_free, (GDestroyNotify) query_cache_entry_free);
+	self->store_revalidating = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_BETTER_THAN, "packagekit");
 	gs_plugin_add_rule (GS_PLUGIN (self), GS_PLUGIN_RULE_RUN_BEFORE, "icons");
@@ -234,6 +548,13 @@ snapd_error_convert (GError **perror)
 	error->domain = GS_PLUGIN_ERROR;
 }
 
+static void store_cache_load_thread_cb (GTask        *task,
+                                        gpointer      source_object,
+                                        gpointer      task_data,
+                                        GCancellable *cancellable);
+static void store_cache_load_cb (GObject      *source_object,
+                                 GAsyncResult *result,
+                                 gpointer      user_data);
 static void get_system_information_cb (GObject      *source_object,
                                        GAsyncResult *result,
                                        gpointer      user_data);
@@ -259,14 +580,40 @@ gs_plugin_snap_setup_async (GsPlugin            *plugin,
                             gpointer             user_data)
 {
 	GsPluginSnap *self = GS_PLUGIN_SNAP (plugin);
-	g_autoptr(SnapdClient) client = NULL;
 	g_autoptr(GTask) task = NULL;
-	gboolean interactive = gs_plugin_has_flags (plugin, GS_PLUGIN_FLAGS_INTERACTIVE);
-	g_autoptr(GError) local_error = NULL;
+	g_autoptr(GTask) load_task = NULL;
+	g_autoptr(GSettings) settings = NULL;
 
 	task = g_task_new (plugin, cancellable, callback, user_data);
 	g_task_set_source_tag (task, gs_plugin_snap_setup_async);
 
+	settings = g_settings_new ("org.gnome.software");
+	self->store_cache_age_maximum = g_settings_get_uint (settings, "snap-store-cache-age-maximum");
+
+	/* load the persisted store metadata first, so the first queries
+	 * don’t have to wait for the store */
+	load_task = g_task_new (plugin, cancellable, store_cache_load_cb, g_steal_pointer (&task));
+	g_task_set_source_tag (load_task, store_cache_load_thread_cb);
+	g_task_run_in_thread (load_task, store_cache_load_thread_cb);
+}
+
+static void
+store_cache_load_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (source_object);
+	g_autoptr(GTask) task = g_steal_pointer (&user_data);
+	GCancellable *cancellable = g_task_get_cancellable (task);
+	gboolean interactive = gs_plugin_has_flags (GS_PLUGIN (self), GS_PLUGIN_FLAGS_INTERACTIVE);
+	g_autoptr(SnapdClient) client = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	if (!g_task_propagate_boolean (G_TASK (result), &local_error)) {
+		g_task_return_error (task, g_steal_pointer (&local_error));
+		return;
+	}
+
 	client = get_client (self, interactive, &local_error);
 	if (client == NULL) {
 		g_task_return_error (task, g_steal_pointer (&local_error));
@@ -319,10 +666,18 @@ gs_plugin_snap_setup_finish (GsPlugin      *plugin,
 	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
+static gboolean
+store_cache_entry_is_stale (GsPluginSnap *self,
+                            gint64        fetch_time)
+{
+	return g_get_real_time () / G_USEC_PER_SEC - fetch_time >= (gint64) self->store_cache_age_maximum;
+}
+
 static SnapdSnap *
 store_snap_cache_lookup (GsPluginSnap *self,
                          const gchar  *name,
-                         gboolean      need_details)
+                         gboolean      need_details,
+                         gboolean     *out_stale)
 {
 	CacheEntry *entry;
 	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
@@ -334,26 +689,477 @@ store_snap_cache_lookup (GsPluginSnap *self,
 	if (need_details && !entry->full_details)
 		return NULL;
 
+	if (out_stale != NULL)
+		*out_stale = store_cache_entry_is_stale (self, entry->fetch_time);
+
 	return g_object_ref (entry->snap);
 }
 
+/* Returns the snaps found by an earlier query, or %NULL if the query hasn’t
+ * been run or some of its results are no longer cached. */
+static GPtrArray *
+store_query_cache_lookup (GsPluginSnap   *self,
+                          SnapdFindFlags  flags,
+                          const gchar    *section,
+                          const gchar    *query,
+                          gboolean       *out_stale)
+{
+	QueryCacheEntry *entry;
+	g_autofree gchar *key = query_cache_key (flags, section, query);
+	g_autoptr(GPtrArray) snaps = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
+
+	entry = g_hash_table_lookup (self->store_queries, key);
+	if (entry == NULL)
+		return NULL;
+
+	snaps = g_ptr_array_new_with_free_func (g_object_unref);
+	for (gsize i = 0; entry->names[i] != NULL; i++) {
+		CacheEntry *snap_entry = g_hash_table_lookup (self->store_snaps, entry->names[i]);
+		if (snap_entry == NULL)
+			return NULL;
+		g_ptr_array_add (snaps, g_object_ref (snap_entry->snap));
+	}
+
+	*out_stale = store_cache_entry_is_stale (self, entry->fetch_time);
+	entry->last_used_time = g_get_monotonic_time ();
+
+	return g_steal_pointer (&snaps);
+}
+
+static void store_cache_queue_save (GsPluginSnap *self);
+
 static void
 store_snap_cache_update (GsPluginSnap *self,
                          GPtrArray    *snaps,
                          gboolean      full_details)
 {
-	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
-	guint i;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+	g_mutex_lock (&self->store_snaps_lock);
 
-	for (i = 0; i < snaps->len; i++) {
+	for (guint i = 0; i < snaps->len; i++) {
 		SnapdSnap *snap = snaps->pdata[i];
+		CacheEntry *old_entry = g_hash_table_lookup (self->store_snaps, snapd_snap_get_name (snap));
+
 		g_debug ("Caching '%s' by '%s' version %s revision %s",
 			snapd_snap_get_title (snap),
 			snapd_snap_get_publisher_display_name (snap),
 			snapd_snap_get_version (snap),
 			snapd_snap_get_revision (snap));
-		g_hash_table_insert (self->store_snaps, g_strdup (snapd_snap_get_name (snap)), cache_entry_new (snap, full_details));
+
+		/* don’t replace full details with a search result, unless
+		 * they’re stale anyway */
+		if (!full_details && old_entry != NULL && old_entry->full_details &&
+		    !store_cache_entry_is_stale (self, old_entry->fetch_time))
+			continue;
+
+		g_hash_table_insert (self->store_snaps, g_strdup (snapd_snap_get_name (snap)), cache_entry_new (snap, full_details, now));
 	}
+
+	g_mutex_unlock (&self->store_snaps_lock);
+
+	/* search results are saved along with the listings they’re in */
+	if (full_details)
+		store_cache_queue_save (self);
+}
+
+/* Drops the least recently used search if there are too many. */
+static void
+store_query_cache_trim_searches_locked (GsPluginSnap *self)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	const gchar *oldest_key = NULL;
+	gint64 oldest_time = G_MAXINT64;
+	guint n_searches = 0;
+
+	g_hash_table_iter_init (&iter, self->store_queries);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const QueryCacheEntry *entry = value;
+
+		if (entry->query == NULL)
+			continue;
+		n_searches++;
+		if (entry->last_used_time < oldest_time) {
+			oldest_time = entry->last_used_time;
+			oldest_key = key;
+		}
+	}
+
+	if (n_searches > STORE_QUERY_CACHE_SEARCHES_MAX)
+		g_hash_table_remove (self->store_queries, oldest_key);
+}
+
+static void
+store_query_cache_update (GsPluginSnap   *self,
+                          SnapdFindFlags  flags,
+                          const gchar    *section,
+                          const gchar    *query,
+                          GPtrArray      *snaps)
+{
+	QueryCacheEntry *entry = g_slice_new0 (QueryCacheEntry);
+	g_autoptr(GStrvBuilder) names = g_strv_builder_new ();
+
+	for (guint i = 0; i < snaps->len; i++)
+		g_strv_builder_add (names, snapd_snap_get_name (g_ptr_array_index (snaps, i)));
+
+	entry->flags = flags;
+	entry->section = g_strdup (section);
+	entry->query = g_strdup (query);
+	entry->names = g_strv_builder_end (names);
+	entry->fetch_time = g_get_real_time () / G_USEC_PER_SEC;
+	entry->last_used_time = g_get_monotonic_time ();
+
+	g_mutex_lock (&self->store_snaps_lock);
+	g_hash_table_insert (self->store_queries, query_cache_key (flags, section, query), entry);
+	if (query != NULL)
+		store_query_cache_trim_searches_locked (self);
+	g_mutex_unlock (&self->store_snaps_lock);
+
+	/* free-text searches aren’t saved */
+	if (query == NULL)
+		store_cache_queue_save (self);
+}
+
+static gchar *
+store_cache_get_filename (GError **error)
+{
+	return gs_utils_get_cache_filename ("snap", "store-cache.json",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE |
+					    GS_UTILS_CACHE_FLAG_CREATE_DIRECTORY,
+					    error);
+}
+
+static void
+store_cache_load_thread_cb (GTask        *task,
+                            gpointer      source_object,
+                            gpointer      task_data,
+                            GCancellable *cancellable)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (source_object);
+	g_autofree gchar *filename = NULL;
+	g_autoptr(JsonParser) parser = NULL;
+	JsonNode *root;
+	JsonObject *object;
+	JsonArray *snaps, *queries;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	filename = store_cache_get_filename (&local_error);
+	if (filename == NULL) {
+		g_debug ("Failed to get snap store cache filename: %s", local_error->message);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	parser = json_parser_new ();
+	if (!json_parser_load_from_mapped_file (parser, filename, &local_error)) {
+		if (!g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("Failed to load snap store cache: %s", local_error->message);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+
+	root = json_parser_get_root (parser);
+	if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root) ||
+	    json_object_get_int_member_with_default (json_node_get_object (root), "version", 0) != STORE_CACHE_VERSION) {
+		g_debug ("Ignoring invalid snap store cache %s", filename);
+		g_task_return_boolean (task, TRUE);
+		return;
+	}
+	object = json_node_get_object (root);
+
+	/* make sure the types of the objects contained in snaps are known;
+	 * snaps containing any other types are ignored */
+	g_type_ensure (SNAPD_TYPE_APP);
+	g_type_ensure (SNAPD_TYPE_CHANNEL);
+	g_type_ensure (SNAPD_TYPE_MEDIA);
+	g_type_ensure (SNAPD_TYPE_PRICE);
+
+	locker = g_mutex_locker_new (&self->store_snaps_lock);
+
+	snaps = json_object_get_array_member_with_default (object, "snaps", NULL);
+	for (guint i = 0; snaps != NULL && i < json_array_get_length (snaps); i++) {
+		JsonNode *node = json_array_get_element (snaps, i);
+		JsonObject *entry_object;
+		JsonObject *snap_object;
+		gint64 fetch_time;
+		g_autoptr(SnapdSnap) snap = NULL;
+		g_autoptr(GError) snap_error = NULL;
+
+		if (!JSON_NODE_HOLDS_OBJECT (node))
+			continue;
+		entry_object = json_node_get_object (node);
+		snap_object = json_object_get_object_member_with_default (entry_object, "snap", NULL);
+		fetch_time = json_object_get_int_member_with_default (entry_object, "fetch-time", 0);
+		if (snap_object == NULL || now - fetch_time > STORE_CACHE_EXPIRE_SECONDS)
+			continue;
+
+		snap = SNAPD_SNAP (object_from_json (SNAPD_TYPE_SNAP, snap_object, &snap_error));
+		if (snap == NULL) {
+			g_debug ("Ignoring cached snap: %s", snap_error->message);
+			continue;
+		}
+		if (snapd_snap_get_name (snap) == NULL)
+			continue;
+
+		/* anything fetched from snapd in the meantime is newer */
+		if (g_hash_table_contains (self->store_snaps, snapd_snap_get_name (snap)))
+			continue;
+
+		g_hash_table_insert (self->store_snaps, g_strdup (snapd_snap_get_name (snap)),
+				     cache_entry_new (snap,
+						      json_object_get_boolean_member_with_default (entry_object, "full-details", FALSE),
+						      fetch_time));
+	}
+
+	queries = json_object_get_array_member_with_default (object, "queries", NULL);
+	for (guint i = 0; queries != NULL && i < json_array_get_length (queries); i++) {
+		JsonNode *node = json_array_get_element (queries, i);
+		JsonObject *entry_object;
+		JsonArray *names;
+		QueryCacheEntry *entry;
+		g_autoptr(GStrvBuilder) names_builder = NULL;
+		g_autofree gchar *key = NULL;
+
+		if (!JSON_NODE_HOLDS_OBJECT (node))
+			continue;
+		entry_object = json_node_get_object (node);
+		names = json_object_get_array_member_with_default (entry_object, "names", NULL);
+		if (names == NULL)
+			continue;
+
+		names_builder = g_strv_builder_new ();
+		for (guint j = 0; j < json_array_get_length (names); j++) {
+			JsonNode *name = json_array_get_element (names, j);
+			if (json_node_get_value_type (name) == G_TYPE_STRING)
+				g_strv_builder_add (names_builder, json_node_get_string (name));
+		}
+
+		entry = g_slice_new0 (QueryCacheEntry);
+		entry->flags = json_object_get_int_member_with_default (entry_object, "flags", 0);
+		entry->section = g_strdup (json_object_get_string_member_with_default (entry_object, "section", NULL));
+		entry->query = g_strdup (json_object_get_string_member_with_default (entry_object, "query", NULL));
+		entry->names = g_strv_builder_end (names_builder);
+		entry->fetch_time = json_object_get_int_member_with_default (entry_object, "fetch-time", 0);
+		entry->last_used_time = g_get_monotonic_time ();
+
+		/* searches were saved by older versions */
+		key = query_cache_key (entry->flags, entry->section, entry->query);
+		if (entry->query != NULL ||
+		    now - entry->fetch_time > STORE_CACHE_EXPIRE_SECONDS ||
+		    g_hash_table_contains (self->store_queries, key)) {
+			query_cache_entry_free (entry);
+			continue;
+		}
+
+		g_hash_table_insert (self->store_queries, g_steal_pointer (&key), entry);
+	}
+
+	g_debug ("Loaded %u snaps and %u queries from the snap store cache",
+		 g_hash_table_size (self->store_snaps), g_hash_table_size (self->store_queries));
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Saves the listings in the store cache, and the snaps which are in them or
+ * whose full details have been fetched. A snapshot of them is taken first, so
+ * lookups aren’t blocked while it’s being written. */
+static void
+store_cache_save (GsPluginSnap *self)
+{
+	g_autoptr(GPtrArray) snap_entries = g_ptr_array_new_with_free_func ((GDestroyNotify) cache_entry_free);
+	g_autoptr(GPtrArray) query_entries = g_ptr_array_new_with_free_func ((GDestroyNotify) query_cache_entry_free);
+	g_autoptr(GHashTable) listed_names = g_hash_table_new (g_str_hash, g_str_equal);
+	g_autoptr(JsonBuilder) builder = json_builder_new ();
+	g_autoptr(JsonGenerator) generator = NULL;
+	g_autoptr(JsonNode) root = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *data = NULL;
+	gsize data_len;
+	GHashTableIter iter;
+	gpointer key, value;
+	g_autoptr(GMutexLocker) save_locker = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	/* serialise saves, so an older snapshot can’t overwrite a newer one */
+	save_locker = g_mutex_locker_new (&self->store_cache_save_lock);
+
+	g_mutex_lock (&self->store_snaps_lock);
+
+	g_hash_table_iter_init (&iter, self->store_queries);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const QueryCacheEntry *entry = value;
+		QueryCacheEntry *copy;
+
+		if (entry->query != NULL)
+			continue;
+
+		copy = query_cache_entry_copy (entry);
+		for (gsize i = 0; copy->names[i] != NULL; i++)
+			g_hash_table_add (listed_names, copy->names[i]);
+		g_ptr_array_add (query_entries, copy);
+	}
+
+	g_hash_table_iter_init (&iter, self->store_snaps);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		const CacheEntry *entry = value;
+
+		if (entry->full_details || g_hash_table_contains (listed_names, key))
+			g_ptr_array_add (snap_entries, cache_entry_new (entry->snap, entry->full_details, entry->fetch_time));
+	}
+
+	g_mutex_unlock (&self->store_snaps_lock);
+
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "version");
+	json_builder_add_int_value (builder, STORE_CACHE_VERSION);
+
+	json_builder_set_member_name (builder, "snaps");
+	json_builder_begin_array (builder);
+	for (guint i = 0; i < snap_entries->len; i++) {
+		const CacheEntry *entry = g_ptr_array_index (snap_entries, i);
+
+		json_builder_begin_object (builder);
+		json_builder_set_member_name (builder, "fetch-time");
+		json_builder_add_int_value (builder, entry->fetch_time);
+		json_builder_set_member_name (builder, "full-details");
+		json_builder_add_boolean_value (builder, entry->full_details);
+		json_builder_set_member_name (builder, "snap");
+		json_builder_add_value (builder, object_to_json (G_OBJECT (entry->snap)));
+		json_builder_end_object (builder);
+	}
+	json_builder_end_array (builder);
+
+	json_builder_set_member_name (builder, "queries");
+	json_builder_begin_array (builder);
+	for (guint i = 0; i < query_entries->len; i++) {
+		const QueryCacheEntry *entry = g_ptr_array_index (query_entries, i);
+
+		json_builder_begin_object (builder);
+		json_builder_set_member_name (builder, "flags");
+		json_builder_add_int_value (builder, entry->flags);
+		if (entry->section != NULL) {
+			json_builder_set_member_name (builder, "section");
+			json_builder_add_string_value (builder, entry->section);
+		}
+		json_builder_set_member_name (builder, "fetch-time");
+		json_builder_add_int_value (builder, entry->fetch_time);
+		json_builder_set_member_name (builder, "names");
+		json_builder_begin_array (builder);
+		for (gsize j = 0; entry->names[j] != NULL; j++)
+			json_builder_add_string_value (builder, entry->names[j]);
+		json_builder_end_array (builder);
+		json_builder_end_object (builder);
+	}
+	json_builder_end_array (builder);
+
+	json_builder_end_object (builder);
+	root = json_builder_get_root (builder);
+
+	generator = json_generator_new ();
+	json_generator_set_root (generator, root);
+	data = json_generator_to_data (generator, &data_len);
+
+	filename = store_cache_get_filename (&local_error);
+	if (filename == NULL ||
+	    !g_file_set_contents (filename, data, data_len, &local_error))
+		g_debug ("Failed to save snap store cache: %s", local_error->message);
+	else
+		g_debug ("Saved %u snaps and %u queries to the snap store cache",
+			 snap_entries->len, query_entries->len);
+}
+
+static void
+store_cache_save_thread_cb (GTask        *task,
+                            gpointer      source_object,
+                            gpointer      task_data,
+                            GCancellable *cancellable)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (source_object);
+
+	store_cache_save (self);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+store_cache_save_timeout_cb (gpointer user_data)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (user_data);
+	g_autoptr(GTask) task = NULL;
+
+	g_mutex_lock (&self->store_snaps_lock);
+	g_clear_pointer (&self->store_cache_save_source, g_source_unref);
+	g_mutex_unlock (&self->store_snaps_lock);
+
+	task = g_task_new (self, NULL, NULL, NULL);
+	g_task_set_source_tag (task, store_cache_save_timeout_cb);
+	g_task_run_in_thread (task, store_cache_save_thread_cb);
+
+	return G_SOURCE_REMOVE;
+}
+
+/* Save the store cache from a worker thread a little while after it’s
+ * changed, so that a burst of changes is only saved once. This can be called
+ * from any thread. */
+static void
+store_cache_queue_save (GsPluginSnap *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
+
+	if (self->store_cache_save_source != NULL)
+		return;
+
+	self->store_cache_save_source = g_timeout_source_new_seconds (self->store_cache_save_delay_secs);
+	g_source_set_name (self->store_cache_save_source, "gs-plugin-snap-store-cache-save");
+	g_source_set_callback (self->store_cache_save_source, store_cache_save_timeout_cb, self, NULL);
+	g_source_attach (self->store_cache_save_source, NULL);
+}
+
+/* Stops any queued save of the store cache, returning whether there was one. */
+static gboolean
+store_cache_cancel_queued_save (GsPluginSnap *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
+
+	if (self->store_cache_save_source == NULL)
+		return FALSE;
+
+	g_source_destroy (self->store_cache_save_source);
+	g_clear_pointer (&self->store_cache_save_source, g_source_unref);
+
+	return TRUE;
+}
+
+static void
+gs_plugin_snap_shutdown_async (GsPlugin            *plugin,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (plugin);
+	g_autoptr(GTask) task = NULL;
+
+	task = g_task_new (plugin, cancellable, callback, user_data);
+	g_task_set_source_tag (task, gs_plugin_snap_shutdown_async);
+
+	/* save any queued changes to the store cache now, rather than
+	 * losing them */
+	if (store_cache_cancel_queued_save (self))
+		g_task_run_in_thread (task, store_cache_save_thread_cb);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+gs_plugin_snap_shutdown_finish (GsPlugin      *plugin,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+	return g_task_propagate_boolean (G_TASK (result), error);
 }
 
 static GPtrArray *
@@ -378,6 +1184,80 @@ find_snaps (GsPluginSnap    *self,
 	return g_steal_pointer (&snaps);
 }
 
+typedef struct {
+	SnapdFindFlags flags;
+	gchar *section;  /* (nullable) */
+	gchar *query;  /* (nullable) */
+	gchar *key;  /* (not nullable) */
+} RevalidateData;
+
+static void
+revalidate_data_free (RevalidateData *data)
+{
+	g_free (data->section);
+	g_free (data->query);
+	g_free (data->key);
+	g_free (data);
+}
+
+static void
+store_cache_revalidate_thread_cb (GTask        *task,
+                                  gpointer      source_object,
+                                  gpointer      task_data,
+                                  GCancellable *cancellable)
+{
+	GsPluginSnap *self = GS_PLUGIN_SNAP (source_object);
+	RevalidateData *data = task_data;
+	g_autoptr(SnapdClient) client = NULL;
+	g_autoptr(GPtrArray) snaps = NULL;
+	g_autoptr(GError) local_error = NULL;
+
+	client = get_client (self, FALSE, &local_error);
+	if (client != NULL)
+		snaps = find_snaps (self, client, data->flags, data->section, data->query, NULL, &local_error);
+
+	/* results of lookups by name are only cached per-snap */
+	if (snaps != NULL && !(data->flags & SNAPD_FIND_FLAGS_MATCH_NAME))
+		store_query_cache_update (self, data->flags, data->section, data->query, snaps);
+	else if (snaps == NULL)
+		g_debug ("Failed to revalidate snap store cache: %s", local_error->message);
+
+	g_mutex_lock (&self->store_snaps_lock);
+	g_hash_table_remove (self->store_revalidating, data->key);
+	g_mutex_unlock (&self->store_snaps_lock);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+/* Refresh stale cached results of a find query in the background, if that’s
+ * not already happening. */
+static void
+store_cache_revalidate (GsPluginSnap   *self,
+                        SnapdFindFlags  flags,
+                        const gchar    *section,
+                        const gchar    *query)
+{
+	g_autoptr(GTask) task = NULL;
+	RevalidateData *data;
+	g_autofree gchar *key = query_cache_key (flags, section, query);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->store_snaps_lock);
+
+	if (g_hash_table_contains (self->store_revalidating, key))
+		return;
+	g_hash_table_add (self->store_revalidating, g_strdup (key));
+
+	data = g_new0 (RevalidateData, 1);
+	data->flags = flags;
+	data->section = g_strdup (section);
+	data->query = g_strdup (query);
+	data->key = g_steal_pointer (&key);
+
+	task = g_task_new (self, NULL, NULL, NULL);
+	g_task_set_source_tag (task, store_cache_revalidate);
+	g_task_set_task_data (task, data, (GDestroyNotify) revalidate_data_free);
+	g_task_run_in_thread (task, store_cache_revalidate_thread_cb);
+}
+
 static gchar *
 get_appstream_id (SnapdSnap *snap)
 {
@@ -493,9 +1373,13 @@ gs_plugin_snap_dispose (GObject *object)
 {
 	GsPluginSnap *self = GS_PLUGIN_SNAP (object);
 
+	store_cache_cancel_queued_save (self);
+
 	g_clear_pointer (&self->store_name, g_free);
 	g_clear_pointer (&self->store_hostname, g_free);
 	g_clear_pointer (&self->store_snaps, g_hash_table_unref);
+	g_clear_pointer (&self->store_queries, g_hash_table_unref);
+	g_clear_pointer (&self->store_revalidating, g_hash_table_unref);
 
 	G_OBJECT_CLASS (gs_plugin_snap_parent_class)->dispose (object);
 }
@@ -506,6 +1390,7 @@ gs_plugin_snap_finalize (GObject *object)
 	GsPluginSnap *self = GS_PLUGIN_SNAP (object);
 
 	g_mutex_clear (&self->store_snaps_lock);
+	g_mutex_clear (&self->store_cache_save_lock);
 
 	G_OBJECT_CLASS (gs_plugin_snap_parent_class)->finalize (object);
 }
@@ -581,6 +1466,12 @@ static void list_alternate_apps_nonsnap_cb (GObject      *source_object,
 static void list_alternative_apps_nonsnap_get_store_snap_cb (GObject      *source_object,
                                                              GAsyncResult *result,
                                                              gpointer      user_data);
+static void list_apps_find_section (GsPluginSnap *self,
+                                    SnapdClient  *client,
+                                    GTask        *task,
+                                    const gchar  *section,
+                                    const gchar  *query,
+                                    GCancellable *cancellable);
 static void list_apps_cb (GObject      *source_object,
                           GAsyncResult *result,
                           gpointer      user_data);
@@ -702,9 +1593,9 @@ gs_plugin_snap_list_apps_async (GsPlugin              *plugin,
 		g_autofree gchar *query_str = NULL;
 
 		query_str = g_strjoinv (" ", (gchar **) keywords);
-		data->n_pending_ops++;
-		snapd_client_find_section_async (client, SNAPD_FIND_FLAGS_SCOPE_WIDE, NULL, query_str,
-						 cancellable, list_apps_cb, g_steal_pointer (&task));
+		data->n_pending_ops = 1;
+		list_apps_find_section (self, client, task, NULL, query_str, cancellable);
+		finish_list_apps_op (task, NULL);
 		return;
 	}
 
@@ -751,11 +1642,8 @@ gs_plugin_snap_list_apps_async (GsPlugin              *plugin,
 	 * the operations are started. */
 	data->n_pending_ops = 1;
 
-	for (gsize i = 0; sections != NULL && sections[i] != NULL; i++) {
-		data->n_pending_ops++;
-		snapd_client_find_section_async (client, SNAPD_FIND_FLAGS_SCOPE_WIDE, sections[i], NULL,
-						 cancellable, list_apps_cb, g_object_ref (task));
-	}
+	for (gsize i = 0; sections != NULL && sections[i] != NULL; i++)
+		list_apps_find_section (self, client, task, sections[i], NULL, cancellable);
 
 	finish_list_apps_op (task, NULL);
 }
@@ -861,13 +1749,78 @@ list_alternative_apps_nonsnap_get_store_snap_cb (GObject      *source_object,
 	finish_list_apps_op (task, g_steal_pointer (&local_error));
 }
 
+typedef struct {
+	GTask *task;  /* (owned) */
+	gchar *section;  /* (nullable) */
+	gchar *query;  /* (nullable) */
+} ListAppsFindData;
+
+static void
+list_apps_find_data_free (ListAppsFindData *data)
+{
+	g_clear_object (&data->task);
+	g_free (data->section);
+	g_free (data->query);
+	g_free (data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ListAppsFindData, list_apps_find_data_free)
+
+static void
+list_apps_add_snaps (GsPluginSnap *self,
+                     GsAppList    *list,
+                     GPtrArray    *snaps)
+{
+	for (guint i = 0; i < snaps->len; i++) {
+		SnapdSnap *snap = g_ptr_array_index (snaps, i);
+		g_autoptr(GsApp) app = NULL;
+
+		app = snap_to_app (self, snap, NULL);
+		gs_app_list_add (list, app);
+	}
+}
+
+/* Add the snaps in @section and/or matching @query to the results, from the
+ * store cache if they’re there. */
+static void
+list_apps_find_section (GsPluginSnap *self,
+                        SnapdClient  *client,
+                        GTask        *task,
+                        const gchar  *section,
+                        const gchar  *query,
+                        GCancellable *cancellable)
+{
+	ListAppsData *data = g_task_get_task_data (task);
+	ListAppsFindData *find_data;
+	g_autoptr(GPtrArray) snaps = NULL;
+	gboolean stale = FALSE;
+
+	snaps = store_query_cache_lookup (self, SNAPD_FIND_FLAGS_SCOPE_WIDE, section, query, &stale);
+	if (snaps != NULL) {
+		if (stale)
+			store_cache_revalidate (self, SNAPD_FIND_FLAGS_SCOPE_WIDE, section, query);
+		list_apps_add_snaps (self, data->results_list, snaps);
+		return;
+	}
+
+	find_data = g_new0 (ListAppsFindData, 1);
+	find_data->task = g_object_ref (task);
+	find_data->section = g_strdup (section);
+	find_data->query = g_strdup (query);
+
+	data->n_pending_ops++;
+	snapd_client_find_section_async (client, SNAPD_FIND_FLAGS_SCOPE_WIDE, section, query,
+					 cancellable, list_apps_cb, find_data);
+}
+
 static void
 list_apps_cb (GObject      *source_object,
               GAsyncResult *result,
               gpointer      user_data)
 {
 	SnapdClient *client = SNAPD_CLIENT (source_object);
-	g_autoptr(GTask) task = G_TASK (user_data);
+	g_autoptr(ListAppsFindData) find_data = user_data;
+	g_autoptr(GTask) task = g_steal_pointer (&find_data->task);
 	GsPluginSnap *self = g_task_get_source_object (task);
 	ListAppsData *data = g_task_get_task_data (task);
 	g_autoptr(GPtrArray) snaps = NULL;
@@ -877,14 +1830,9 @@ list_apps_cb (GObject      *source_object,
 
 	if (snaps != NULL) {
 		store_snap_cache_update (self, snaps, FALSE);
-
-		for (guint i = 0; i < snaps->len; i++) {
-			SnapdSnap *snap = g_ptr_array_index (snaps, i);
-			g_autoptr(GsApp) app = NULL;
-
-			app = snap_to_app (self, snap, NULL);
-			gs_app_list_add (data->results_list, app);
-		}
+		store_query_cache_update (self, SNAPD_FIND_FLAGS_SCOPE_WIDE,
+					  find_data->section, find_data->query, snaps);
+		list_apps_add_snaps (self, data->results_list, snaps);
 	} else {
 		snapd_error_convert (&local_error);
 	}
@@ -974,12 +1922,16 @@ get_store_snap (GsPluginSnap  *self,
                 GError       **error)
 {
 	SnapdSnap *snap = NULL;
+	gboolean stale = FALSE;
 	g_autoptr(GPtrArray) snaps = NULL;
 
 	/* use cached version if available */
-	snap = store_snap_cache_lookup (self, name, need_details);
-	if (snap != NULL)
-		return g_object_ref (snap);
+	snap = store_snap_cache_lookup (self, name, need_details, &stale);
+	if (snap != NULL) {
+		if (stale)
+			store_cache_revalidate (self, SNAPD_FIND_FLAGS_SCOPE_WIDE | SNAPD_FIND_FLAGS_MATCH_NAME, NULL, name);
+		return snap;
+	}
 
 	snaps = find_snaps (self, client,
 			    SNAPD_FIND_FLAGS_SCOPE_WIDE | SNAPD_FIND_FLAGS_MATCH_NAME,
@@ -1005,14 +1957,17 @@ get_store_snap_async (GsPluginSnap        *self,
 {
 	g_autoptr(GTask) task = NULL;
 	SnapdSnap *snap = NULL;
+	gboolean stale = FALSE;
 
 	task = g_task_new (self, cancellable, callback, user_data);
 	g_task_set_source_tag (task, get_store_snap_async);
 
 	/* use cached version if available */
-	snap = store_snap_cache_lookup (self, name, need_details);
+	snap = store_snap_cache_lookup (self, name, need_details, &stale);
 	if (snap != NULL) {
-		g_task_return_pointer (task, g_object_ref (snap), (GDestroyNotify) g_object_unref);
+		if (stale)
+			store_cache_revalidate (self, SNAPD_FIND_FLAGS_SCOPE_WIDE | SNAPD_FIND_FLAGS_MATCH_NAME, NULL, name);
+		g_task_return_pointer (task, snap, (GDestroyNotify) g_object_unref);
 		return;
 	}
 
@@ -1481,7 +2436,7 @@ get_snaps_cb (GObject      *object,
 
 		/* get information from locally installed snaps and information we already have */
 		local_snap = find_snap_in_array (local_snaps, snap_name);
-		store_snap = store_snap_cache_lookup (self, snap_name, FALSE);
+		store_snap = store_snap_cache_lookup (self, snap_name, FALSE, NULL);
 		if (store_snap != NULL)
 			store_channel = expand_channel_name (snapd_snap_get_channel (store_snap));
 
@@ -2560,6 +3515,8 @@ gs_plugin_snap_class_init (GsPluginSnapClass *klass)
 
 	plugin_class->setup_async = gs_plugin_snap_setup_async;
 	plugin_class->setup_finish = gs_plugin_snap_setup_finish;
+	plugin_class->shutdown_async = gs_plugin_snap_shutdown_async;
+	plugin_class->shutdown_finish = gs_plugin_snap_shutdown_finish;
 	plugin_class->refine_async = gs_plugin_snap_refine_async;
 	plugin_class->refine_finish = gs_plugin_snap_refine_finish;
 	plugin_class->list_apps_async = gs_plugin_snap_list_apps_async;
@@ -6,6 +6,8 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
 #include <snapd-glib/snapd-glib.h>
 
 #include "config.h"
@@ -358,12 +360,93 @@ gs_plugins_snap_test_func (GsPluginLoader *plugin_loader)
 	g_assert (ret);
 }
 
+static void
+gs_plugins_snap_store_cache_func (GsPluginLoader *plugin_loader)
+{
+	g_autoptr(GsPluginJob) plugin_job = NULL;
+	g_autoptr(GsAppList) apps = NULL;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsAppQuery) query = NULL;
+	g_autoptr(JsonParser) parser = NULL;
+	g_autofree gchar *cache_filename = NULL;
+	g_autofree gchar *contents = NULL;
+	g_autoptr(GError) error = NULL;
+	const gchar *keywords[] = { "privatesearch", NULL };
+	JsonObject *root;
+	JsonArray *snaps, *queries;
+	gboolean found_snap = FALSE;
+	gint64 timeout;
+
+	/* no snap, abort */
+	if (!gs_plugin_loader_get_enabled (plugin_loader, "snap")) {
+		g_test_skip ("not enabled");
+		return;
+	}
+
+	cache_filename = g_build_filename (g_getenv ("GS_SELF_TEST_CACHEDIR"), "snap", "store-cache.json", NULL);
+	g_unlink (cache_filename);
+
+	/* a free-text search must only be cached in memory */
+	query = gs_app_query_new ("keywords", keywords,
+				  "dedupe-flags", GS_PLUGIN_JOB_DEDUPE_FLAGS_DEFAULT,
+				  NULL);
+	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+	apps = gs_plugin_loader_job_process (plugin_loader, plugin_job, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (apps);
+
+	/* looking up a snap by name gets its full details, which are saved */
+	g_clear_object (&plugin_job);
+	plugin_job = gs_plugin_job_newv (GS_PLUGIN_ACTION_URL_TO_APP,
+					 "search", "snap://snap",
+					 NULL);
+	app = gs_plugin_loader_job_process_app (plugin_loader, plugin_job, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (app);
+
+	/* the save is done in the background */
+	timeout = g_get_monotonic_time () + 5 * G_USEC_PER_SEC;
+	while (!g_file_test (cache_filename, G_FILE_TEST_EXISTS) &&
+	       g_get_monotonic_time () < timeout) {
+		g_main_context_iteration (NULL, FALSE);
+		g_usleep (10000);
+	}
+
+	g_assert_true (g_file_get_contents (cache_filename, &contents, NULL, &error));
+	g_assert_no_error (error);
+	g_assert_null (strstr (contents, "privatesearch"));
+
+	parser = json_parser_new ();
+	g_assert_true (json_parser_load_from_data (parser, contents, -1, &error));
+	g_assert_no_error (error);
+	root = json_node_get_object (json_parser_get_root (parser));
+	g_assert_cmpint (json_object_get_int_member (root, "version"), ==, 1);
+
+	snaps = json_object_get_array_member (root, "snaps");
+	for (guint i = 0; i < json_array_get_length (snaps); i++) {
+		JsonObject *entry = json_array_get_object_element (snaps, i);
+		JsonObject *snap = json_object_get_object_member (entry, "snap");
+
+		if (g_strcmp0 (json_object_get_string_member (snap, "name"), "snap") == 0) {
+			g_assert_true (json_object_get_boolean_member (entry, "full-details"));
+			g_assert_cmpuint (json_array_get_length (json_object_get_array_member (snap, "media")), ==, 2);
+			found_snap = TRUE;
+		}
+	}
+	g_assert_true (found_snap);
+
+	queries = json_object_get_array_member (root, "queries");
+	for (guint i = 0; i < json_array_get_length (queries); i++)
+		g_assert_false (json_object_has_member (json_array_get_object_element (queries, i), "query"));
+}
+
 int
 main (int argc, char **argv)
 {
 	gboolean ret;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GsPluginLoader) plugin_loader = NULL;
+	g_autofree gchar *tmp_root = NULL;
 	const gchar * const allowlist[] = {
 		"snap",
 		NULL
@@ -371,6 +454,13 @@ main (int argc, char **argv)
 
 	gs_test_init (&argc, &argv);
 
+	/* keep the store cache out of the user’s cache, and save it as soon as
+	 * it changes so the test doesn’t have to wait */
+	tmp_root = g_dir_make_tmp ("gnome-software-snap-test-XXXXXX", NULL);
+	g_assert_true (tmp_root != NULL);
+	g_setenv ("GS_SELF_TEST_CACHEDIR", tmp_root, TRUE);
+	g_setenv ("GS_SELF_TEST_SNAP_STORE_CACHE_SAVE_NOW", "1", TRUE);
+
 	/* we can only load this once per process */
 	plugin_loader = gs_plugin_loader_new (NULL, NULL);
 	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR);
@@ -387,5 +477,8 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/snap/test",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_snap_test_func);
+	g_test_add_data_func ("/gnome-software/plugins/snap/store-cache",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_snap_store_cache_func);
 	return g_test_run ();
 }
@@ -13,6 +13,7 @@
 #include <string.h>
 #include <glib/gi18n.h>
 
+#include "gnome-software-private.h"
 #include "gs-shell.h"
 #include "gs-installed-page.h"
 #include "gs-common.h"
@@ -34,6 +35,7 @@ struct _GsInstalledPage
 	GSettings		*settings;
 	guint			 pending_apps_counter;
 	gboolean		 is_narrow;
+	GsAppNotifyStats	 load_notify_stats;  /* at the start of the last load */
 
 	GtkWidget		*group_install_in_progress;
 	GtkWidget		*group_install_apps;
@@ -402,6 +404,7 @@ gs_installed_page_get_installed_cb (GObject *source_object,
 	g_autoptr(GsAppList) list = NULL;
 	g_autoptr(GsAppList) pending = gs_plugin_loader_get_pending (plugin_loader);
 	g_autoptr(GsPluginJob) plugin_job = NULL;
+	GsAppNotifyStats notify_stats;
 
 	gtk_spinner_stop (GTK_SPINNER (self->spinner_install));
 	gtk_stack_set_visible_child_name (GTK_STACK (self->stack_install), "view");
@@ -422,6 +425,15 @@ gs_installed_page_get_installed_cb (GObject *source_object,
 		app = gs_app_list_index (list, i);
 		gs_installed_page_add_app (self, list, app);
 	}
+
+	/* to measure how well app property notifications are coalesced */
+	gs_app_get_notify_stats (&notify_stats);
+	g_debug ("Loading %u installed apps queued %" G_GUINT64_FORMAT " app property "
+		 "notifications, emitted %" G_GUINT64_FORMAT " in %" G_GUINT64_FORMAT " main loop dispatches",
+		 gs_app_list_length (list),
+		 notify_stats.n_queued - self->load_notify_stats.n_queued,
+		 notify_stats.n_emitted - self->load_notify_stats.n_emitted,
+		 notify_stats.n_dispatches - self->load_notify_stats.n_dispatches);
 out:
 	if (gs_app_list_length (pending) > 0) {
 		plugin_job = gs_plugin_job_refine_new (pending,
@@ -504,6 +516,7 @@ gs_installed_page_load (GsInstalledPage *self)
 	if (self->waiting)
 		return;
 	self->waiting = TRUE;
+	gs_app_get_notify_stats (&self->load_notify_stats);
 
 	/* remove old entries */
 	gs_widget_remove_all (self->list_box_install_in_progress, gs_installed_page_remove_all_cb);
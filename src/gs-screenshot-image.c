@@ -222,11 +222,15 @@ gs_pixbuf_save_filename (GdkPixbuf *pixbuf,
 
 	/* resample & save pixbuf */
 	pb = gs_pixbuf_resample (pixbuf, width, height, FALSE);
-	return gdk_pixbuf_save (pb,
-				filename,
-				"png",
-				error,
-				NULL);
+	if (!gdk_pixbuf_save (pb,
+			      filename,
+			      "png",
+			      error,
+			      NULL))
+		return FALSE;
+
+	gs_cache_manager_record_store (GS_CACHE_KIND_SCREENSHOTS, filename);
+	return TRUE;
 }
 
 static void
@@ -631,8 +635,13 @@ gs_screenshot_video_downloaded_cb (GObject *source_object,
 {
 	g_autoptr(GsScreenshotImage) ssimg = user_data;
 	g_autoptr(GError) error = NULL;
+	gboolean downloaded;
 
-	if (gs_download_file_finish (ssimg->session, result, &error) ||
+	downloaded = gs_download_file_finish (ssimg->session, result, &error);
+	if (downloaded)
+		gs_cache_manager_record_store (GS_CACHE_KIND_SCREENSHOTS, ssimg->filename);
+
+	if (downloaded ||
 	    g_error_matches (error, GS_DOWNLOAD_ERROR, GS_DOWNLOAD_ERROR_NOT_MODIFIED)) {
 		gs_screenshot_image_stop_spinner (ssimg);
 		as_screenshot_show_image (ssimg);
@@ -704,6 +713,8 @@ gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 		guint64 age_max;
 		g_autoptr(GFile) file = NULL;
 
+		gs_cache_manager_record_lookup (GS_CACHE_KIND_SCREENSHOTS, ssimg->filename, TRUE);
+
 		/* show the image we have in cache while we're checking for the
 		 * new screenshot (which probably won't have changed) */
 		as_screenshot_show_image (ssimg);
@@ -715,6 +726,8 @@ gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 		/* image new enough, not re-requesting from server */
 		if (age_max > 0 && gs_utils_get_file_age (file) < age_max)
 			return;
+	} else {
+		gs_cache_manager_record_lookup (GS_CACHE_KIND_SCREENSHOTS, ssimg->filename, FALSE);
 	}
 
 	/* if we're not showing a full-size image, we try loading a blurred
@@ -102,17 +102,57 @@ typedef struct {
 	guint stamp;
 } GetSearchData;
 
+static void
+gs_search_page_show_apps (GsSearchPage *self,
+                          GsAppList    *list)
+{
+	/* remove old entries */
+	gs_widget_remove_all (self->list_box_search, (GsRemoveFunc) gtk_list_box_remove);
+
+	gtk_spinner_stop (GTK_SPINNER (self->spinner_search));
+	gtk_stack_set_visible_child_name (GTK_STACK (self->stack_search), "results");
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		GtkWidget *app_row = gs_app_row_new (app);
+		gs_app_row_set_show_rating (GS_APP_ROW (app_row), TRUE);
+		g_signal_connect (app_row, "button-clicked",
+				  G_CALLBACK (gs_search_page_app_row_clicked_cb),
+				  self);
+		gtk_list_box_append (GTK_LIST_BOX (self->list_box_search), app_row);
+		gs_app_row_set_size_groups (GS_APP_ROW (app_row),
+					    self->sizegroup_name,
+					    self->sizegroup_button_label,
+					    self->sizegroup_button_image);
+		gtk_widget_set_visible (app_row, TRUE);
+	}
+}
+
+static void
+gs_search_page_partial_results_cb (GsPluginJobListApps *plugin_job,
+                                   GsAppList           *list,
+                                   gpointer             user_data)
+{
+	GetSearchData *search_data = user_data;
+	GsSearchPage *self = search_data->self;
+
+	/* different stamps means another search has been started since */
+	if (search_data->stamp != self->stamp ||
+	    gs_app_list_length (list) == 0)
+		return;
+
+	/* show what has been found so far, the final results replace these */
+	gs_search_page_waiting_cancel (self);
+	gs_search_page_show_apps (self, list);
+}
+
 static void
 gs_search_page_get_search_cb (GObject *source_object,
                               GAsyncResult *res,
                               gpointer user_data)
 {
-	guint i;
 	g_autofree GetSearchData *search_data = user_data;
-	GsApp *app;
 	GsSearchPage *self = search_data->self;
 	GsPluginLoader *plugin_loader = GS_PLUGIN_LOADER (source_object);
-	GtkWidget *app_row;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GsAppList) list = NULL;
 
@@ -149,25 +189,7 @@ gs_search_page_get_search_cb (GObject *source_object,
 		return;
 	}
 
-	/* remove old entries */
-	gs_widget_remove_all (self->list_box_search, (GsRemoveFunc) gtk_list_box_remove);
-
-	gtk_spinner_stop (GTK_SPINNER (self->spinner_search));
-	gtk_stack_set_visible_child_name (GTK_STACK (self->stack_search), "results");
-	for (i = 0; i < gs_app_list_length (list); i++) {
-		app = gs_app_list_index (list, i);
-		app_row = gs_app_row_new (app);
-		gs_app_row_set_show_rating (GS_APP_ROW (app_row), TRUE);
-		g_signal_connect (app_row, "button-clicked",
-				  G_CALLBACK (gs_search_page_app_row_clicked_cb),
-				  self);
-		gtk_list_box_append (GTK_LIST_BOX (self->list_box_search), app_row);
-		gs_app_row_set_size_groups (GS_APP_ROW (app_row),
-					    self->sizegroup_name,
-					    self->sizegroup_button_label,
-					    self->sizegroup_button_image);
-		gtk_widget_set_visible (app_row, TRUE);
-	}
+	gs_search_page_show_apps (self, list);
 
 	/* too many results */
 	if (gs_app_list_has_flag (list, GS_APP_LIST_FLAG_IS_TRUNCATED)) {
@@ -275,6 +297,7 @@ gs_search_page_load (GsSearchPage *self)
 	g_autoptr(GsAppQuery) query = NULL;
 	const gchar *keywords[2] = { NULL, };
 	g_autofree GetSearchData *search_data = NULL;
+	GetSearchData *partial_data;
 
 	self->changed = FALSE;
 
@@ -312,6 +335,15 @@ gs_search_page_load (GsSearchPage *self)
 				  "developer-verified-type", gs_page_get_query_developer_verified_type (GS_PAGE (self)),
 				  NULL);
 	plugin_job = gs_plugin_job_list_apps_new (query, GS_PLUGIN_LIST_APPS_FLAGS_NONE);
+
+	/* show results from the fastest plugins while waiting for the others */
+	partial_data = g_new0 (GetSearchData, 1);
+	partial_data->self = self;
+	partial_data->stamp = self->stamp;
+	g_signal_connect_data (plugin_job, "partial-results",
+			       G_CALLBACK (gs_search_page_partial_results_cb),
+			       partial_data, (GClosureNotify) g_free, 0);
+
 	gs_plugin_loader_job_process_async (self->plugin_loader, plugin_job,
 					    self->search_cancellable,
 					    gs_search_page_get_search_cb,